@@ -1,9 +1,24 @@
 #ifndef IMG_IMAGE_H
 #define IMG_IMAGE_H
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <limits>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
 #include <type_traits>
+#include <utility>
+
+#include "ImageInstrumentation.h"
+#include "ImageMemory.h"
+#include "ImageParallel.h"
+#include "ImageSimd.h"
 
 namespace img {
 
@@ -12,12 +27,121 @@ namespace img {
     return std::is_floating_point_v<T> ? static_cast<T>(1.0) : std::numeric_limits<T>::max();
   }
 
+  namespace detail {
+    __extension__ typedef unsigned __int128 UInt128;
+
+    /**
+     * Exact `floor(src * targetMax / sourceMax)` between integer types, whose maxima are all `2^b - 1`.
+     * With `targetMax = c * sourceMax + r` the result is `src * c + floor(src * r / sourceMax)`, and
+     * `floor(x / (2^b - 1)) = (x + 1 + (x >> b)) >> b` for every `x <= (2^b - 1)^2`: a multiply and
+     * a few shifts instead of a divide, computed on 128 bits when the product needs it, so it never overflows.
+     * When `src * targetMax` fits in 32 bits, the division by a constant is left to the compiler.
+     * Negative samples are scaled symmetrically, and become 0 in unsigned types.
+     */
+    template<typename TargetT, typename SourceT>
+    constexpr TargetT crossProductInteger(const SourceT src) {
+      constexpr int bits = std::numeric_limits<SourceT>::digits;
+      constexpr int targetBits = std::numeric_limits<TargetT>::digits;
+      using Wide = std::conditional_t<(bits + targetBits <= 32), std::uint32_t,
+                                      std::conditional_t<(bits <= 32), std::uint64_t, UInt128>>;
+      constexpr auto sourceMax = static_cast<Wide>(std::numeric_limits<SourceT>::max());
+      constexpr auto targetMax = static_cast<Wide>(std::numeric_limits<TargetT>::max());
+      constexpr Wide quotient = targetMax / sourceMax;
+      constexpr Wide remainder = targetMax % sourceMax;
+
+      const auto scale = [](const Wide magnitude) {
+        if constexpr (bits + targetBits <= 31) {
+          // In int, like the promoted original formula: the compiler knows the range and vectorizes on 16 bits.
+          return static_cast<Wide>(static_cast<int>(magnitude) * static_cast<int>(targetMax) / static_cast<int>(sourceMax));
+        } else if constexpr (bits + targetBits <= 32) {
+          return magnitude * targetMax / sourceMax;
+        } else if constexpr (remainder == 0) {
+          return magnitude * quotient;
+        } else {
+          const Wide x = magnitude * remainder;
+          return magnitude * quotient + ((x + 1 + (x >> bits)) >> bits);
+        }
+      };
+      if constexpr (std::is_unsigned_v<SourceT>) {
+        return static_cast<TargetT>(scale(static_cast<Wide>(src)));
+      } else if constexpr (std::is_unsigned_v<TargetT>) {
+        return src < 0 ? TargetT{0} : static_cast<TargetT>(scale(static_cast<Wide>(src)));
+      } else {
+        // |src| is computed from `-(src + 1)`, which never overflows.
+        const bool negative = src < 0;
+        const auto biased = negative ? -(src + 1) : src;
+        const Wide result = scale(static_cast<Wide>(biased) + (negative ? 1 : 0));
+        return negative ? static_cast<TargetT>(-static_cast<TargetT>(result - 1) - 1) : static_cast<TargetT>(result);
+      }
+    }
+
+    /**
+     * `cross_product` without the lookup tables.
+     */
+    template<typename TargetT, typename SourceT>
+    constexpr TargetT crossProductCompute(const SourceT src) {
+      if constexpr (std::is_same_v<TargetT, SourceT>) {
+        return src;
+      } else if constexpr (std::is_integral_v<SourceT> && std::is_integral_v<TargetT>) {
+        return crossProductInteger<TargetT>(src);
+      } else if constexpr (std::is_integral_v<SourceT>) {
+        // `src * 1 / sourceMax`: once rounded to TargetT, a maximum with more bits than the mantissa is a
+        // power of two, so the divide is an exact multiply.
+        constexpr TargetT divisor = static_cast<TargetT>(std::numeric_limits<SourceT>::max());
+        if constexpr (std::numeric_limits<SourceT>::digits > std::numeric_limits<TargetT>::digits) {
+          return static_cast<TargetT>(src) * (TargetT{1} / divisor);
+        } else {
+          return static_cast<TargetT>(src) / divisor;
+        }
+      } else if constexpr (std::is_integral_v<TargetT>) {
+        // `src * targetMax`. The maximum of a 64-bit type rounds up to 2^63 or 2^64 in floating point,
+        // which no longer fits the target: that product saturates.
+        constexpr SourceT targetMax = static_cast<SourceT>(std::numeric_limits<TargetT>::max());
+        const SourceT scaled = src * targetMax;
+        if constexpr (std::numeric_limits<TargetT>::digits > std::numeric_limits<SourceT>::digits) {
+          if (scaled >= targetMax) return std::numeric_limits<TargetT>::max();
+          if (scaled <= -targetMax) return std::is_unsigned_v<TargetT> ? TargetT{0} : -std::numeric_limits<TargetT>::max();
+        }
+        return static_cast<TargetT>(scaled);
+      } else {
+        return static_cast<TargetT>(src);
+      }
+    }
+
+    // Result of `crossProductCompute` for every value of an 8 or 16-bit source type, indexed by `src - min`.
+    template<typename TargetT, typename SourceT>
+    constexpr auto makeCrossProductTable() {
+      constexpr std::size_t size = std::size_t{1} << (8 * sizeof(SourceT));
+      struct Table { TargetT values[size]; } table{};
+      for (std::size_t i = 0; i < size; ++i) {
+        const auto src = static_cast<SourceT>(static_cast<long long>(i) + std::numeric_limits<SourceT>::min());
+        table.values[i] = crossProductCompute<TargetT>(src);
+      }
+      return table;
+    }
+
+    template<typename TargetT, typename SourceT>
+    inline constexpr auto crossProductTable = makeCrossProductTable<TargetT, SourceT>();
+  }
+
+  /**
+   * Rescale a sample from the range of `SourceT` to the range of `TargetT` (`src * targetMax / sourceMax`,
+   * the maximum of floating point types being 1).
+   * 8-bit integer sources going to an integer type read a constexpr table of 256 results, which stays in L1;
+   * other integer pairs are computed exactly with a multiply and shifts, never overflowing. Floating point
+   * targets divide only when the maximum of the source is not a power of two in the target type, and
+   * 64-bit integer targets saturate where their maximum rounds up in the floating point source.
+   */
   template<typename TargetT, typename SourceT>
   constexpr TargetT cross_product(const SourceT& src) {
-    if constexpr (std::is_same_v<TargetT, SourceT>) return src;
-    TargetT targetMaxValue = getMaxInContext<TargetT>();
-    SourceT sourceMaxValue = getMaxInContext<SourceT>();
-    return static_cast<TargetT>(src * targetMaxValue / sourceMaxValue);
+    if constexpr (std::is_same_v<TargetT, SourceT>) {
+      return src;
+    } else if constexpr (std::is_integral_v<SourceT> && std::is_integral_v<TargetT> && sizeof(SourceT) == 1
+                         && !std::is_same_v<SourceT, bool>) {
+      return detail::crossProductTable<TargetT, SourceT>.values[static_cast<long long>(src) - std::numeric_limits<SourceT>::min()];
+    } else {
+      return detail::crossProductCompute<TargetT>(src);
+    }
   }
 
   // Struct to store a color
@@ -144,8 +268,1068 @@ namespace img {
     }
   };
 
+  /** ----- Planar layouts ----- **/
+
+  /**
+   * Planar RGB: each channel is stored in its own plane (red, green then blue), so a pixel is made of
+   * one sample per plane, `planeStride` samples apart. Inside a plane the samples of a row are contiguous.
+   */
+  template<typename T>
+  struct PlanarRGB {
+    static constexpr int PlaneCount = 3;
+    static constexpr bool IsPlanar = true;
+    static constexpr auto Max = getMaxInContext<T>();
+
+    using DataType = T;
+
+    // Cast a raw color value to a Color object
+    static constexpr void fromRaw(Color<T>& color, const T* data, const std::size_t planeStride) {
+      color.red = data[0];
+      color.green = data[planeStride];
+      color.blue = data[2 * planeStride];
+      color.alpha = Max;
+    }
+
+    // Cast a Color object to a raw value
+    static constexpr void toRaw(T* data, const std::size_t planeStride, const Color<T>& color) {
+      data[0] = color.red;
+      data[planeStride] = color.green;
+      data[2 * planeStride] = color.blue;
+    }
+  };
+
+  /**
+   * Planar RGBA: like `PlanarRGB` with a fourth plane for alpha.
+   */
+  template<typename T>
+  struct PlanarRGBA {
+    static constexpr int PlaneCount = 4;
+    static constexpr bool IsPlanar = true;
+    static constexpr auto Max = getMaxInContext<T>();
+
+    using DataType = T;
+
+    // Cast a raw color value to a Color object
+    static constexpr void fromRaw(Color<T>& color, const T* data, const std::size_t planeStride) {
+      color.red = data[0];
+      color.green = data[planeStride];
+      color.blue = data[2 * planeStride];
+      color.alpha = data[3 * planeStride];
+    }
+
+    // Cast a Color object to a raw value
+    static constexpr void toRaw(T* data, const std::size_t planeStride, const Color<T>& color) {
+      data[0] = color.red;
+      data[planeStride] = color.green;
+      data[2 * planeStride] = color.blue;
+      data[3 * planeStride] = color.alpha;
+    }
+  };
+
+  template<typename Pixel, typename = void>
+  struct IsPlanarPixel : std::false_type {};
+
+  template<typename Pixel>
+  struct IsPlanarPixel<Pixel, std::enable_if_t<Pixel::IsPlanar>> : std::true_type {};
+
+  // `true` for pixel policies storing each channel in its own plane (policies with `IsPlanar = true`).
+  template<typename Pixel>
+  inline constexpr bool isPlanar = IsPlanarPixel<Pixel>::value;
+
+  // Number of samples between two pixels of a row: 1 in a plane, `PlaneCount` when interleaved.
+  template<typename Pixel>
+  inline constexpr std::size_t pixelStep = isPlanar<Pixel> ? 1 : Pixel::PlaneCount;
+
+  /**
+   * Read the color of a pixel of any layout.
+   * @param color the color read
+   * @param data the first sample of the pixel
+   * @param planeStride the distance between two planes, ignored by interleaved pixels
+   */
+  template<typename Pixel>
+  constexpr void loadPixel(Color<typename Pixel::DataType>& color, const typename Pixel::DataType* data, const std::size_t planeStride) {
+    if constexpr (isPlanar<Pixel>) {
+      Pixel::fromRaw(color, data, planeStride);
+    } else {
+      Pixel::fromRaw(color, data);
+    }
+  }
+
+  /**
+   * Write the color of a pixel of any layout.
+   * @param data the first sample of the pixel
+   * @param planeStride the distance between two planes, ignored by interleaved pixels
+   * @param color the color to write
+   */
+  template<typename Pixel>
+  constexpr void storePixel(typename Pixel::DataType* data, const std::size_t planeStride, const Color<typename Pixel::DataType>& color) {
+    if constexpr (isPlanar<Pixel>) {
+      Pixel::toRaw(data, planeStride, color);
+    } else {
+      Pixel::toRaw(data, color);
+    }
+  }
+
+  /** ----- Conversion engine ----- **/
+
+  /**
+   * Describe where each channel lives inside a raw pixel, so the conversion engine can pick a
+   * dedicated row kernel at compile time. Pixel policies without a specialization are converted
+   * through the generic `fromRaw` / `toRaw` path.
+   * @tparam Pixel the Pixel type (Ex: img::PixelRGB, img::PixelBGR, img::PixelRGBA, ...)
+   */
+  template<typename Pixel>
+  struct PixelLayout {
+    static constexpr bool Known = false;
+  };
+
+  template<typename T>
+  struct PixelLayout<PixelRGB<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 0, Green = 1, Blue = 2, Alpha = -1;
+  };
+
+  template<typename T>
+  struct PixelLayout<PixelBGR<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 2, Green = 1, Blue = 0, Alpha = -1;
+  };
+
+  template<typename T>
+  struct PixelLayout<PixelRGBA<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 0, Green = 1, Blue = 2, Alpha = 3;
+  };
+
+  template<typename T>
+  struct PixelLayout<PixelBGRA<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 2, Green = 1, Blue = 0, Alpha = 3;
+  };
+
+  template<typename T>
+  struct PixelLayout<PixelGray<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = true;
+    static constexpr int Red = 0, Green = 0, Blue = 0, Alpha = -1;
+  };
+
+  // For planar pixels the indices are plane numbers.
+  template<typename T>
+  struct PixelLayout<PlanarRGB<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 0, Green = 1, Blue = 2, Alpha = -1;
+  };
+
+  template<typename T>
+  struct PixelLayout<PlanarRGBA<T>> {
+    static constexpr bool Known = true;
+    static constexpr bool Gray = false;
+    static constexpr int Red = 0, Green = 1, Blue = 2, Alpha = 3;
+  };
+
+  /**
+   * Convert a row of pixels from `SrcPixel` to `DstPixel`.
+   * The result is the same as `fromRaw`, `cross_product` on every channel then `toRaw`, but the
+   * kernel is chosen at compile time: memcpy for identical layouts, swizzle for RGB/BGR(A) pairs,
+   * expansion for gray sources and luminance for gray targets. Unused channels are never computed.
+   * Between `std::uint8_t` or `float` pixels of the same type the vectorized kernels of `ImageSimd.h`
+   * are used; see there for the rounding of the `std::uint8_t` luminance.
+   * @param src the first source pixel
+   * @param dst the first destination pixel
+   * @param count the number of pixels to convert
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convertRow(const typename SrcPixel::DataType* src, typename DstPixel::DataType* dst, const std::size_t count) {
+    using SrcT = typename SrcPixel::DataType;
+    using DstT = typename DstPixel::DataType;
+    using Src = PixelLayout<SrcPixel>;
+    using Dst = PixelLayout<DstPixel>;
+    constexpr int srcPlanes = SrcPixel::PlaneCount;
+    constexpr int dstPlanes = DstPixel::PlaneCount;
+    static_assert(!isPlanar<SrcPixel> && !isPlanar<DstPixel>, "planar pixels are converted by convertRowPlanar");
+
+    if (count == 0) return;
+
+    if constexpr (std::is_same_v<SrcPixel, DstPixel>) {
+      std::memcpy(dst, src, count * srcPlanes * sizeof(SrcT));
+    } else if constexpr (Src::Known && Dst::Known && std::is_same_v<SrcT, DstT>
+                         && (std::is_same_v<SrcT, std::uint8_t> || std::is_same_v<SrcT, float>)
+                         && !Src::Gray) {
+      constexpr bool swap = Src::Red != Dst::Red;
+      if constexpr (Dst::Gray) {
+        simd::luminance(src, dst, count, srcPlanes, Src::Red);
+      } else if constexpr (srcPlanes == dstPlanes) {
+        simd::swapRedBlue(src, dst, count, srcPlanes);
+      } else if constexpr (srcPlanes < dstPlanes) {
+        simd::addAlpha(src, dst, count, swap, DstPixel::Max);
+      } else {
+        simd::dropAlpha(src, dst, count, swap);
+      }
+    } else if constexpr (Src::Known && Dst::Known) {
+      if constexpr (Dst::Gray) {
+        // Luminance is computed in the target type, exactly like toRaw would do after cross_product.
+        for (std::size_t i = 0; i < count; ++i, src += srcPlanes, dst += dstPlanes) {
+          Color<DstT> color{};
+          color.red = cross_product<DstT>(src[Src::Red]);
+          color.green = Src::Gray ? color.red : cross_product<DstT>(src[Src::Green]);
+          color.blue = Src::Gray ? color.red : cross_product<DstT>(src[Src::Blue]);
+          DstPixel::toRaw(dst, color);
+        }
+      } else {
+        constexpr DstT opaque = cross_product<DstT>(getMaxInContext<SrcT>());
+        for (std::size_t i = 0; i < count; ++i, src += srcPlanes, dst += dstPlanes) {
+          if constexpr (Src::Gray) {
+            const DstT value = cross_product<DstT>(src[0]);
+            dst[Dst::Red] = value;
+            dst[Dst::Green] = value;
+            dst[Dst::Blue] = value;
+          } else {
+            dst[Dst::Red] = cross_product<DstT>(src[Src::Red]);
+            dst[Dst::Green] = cross_product<DstT>(src[Src::Green]);
+            dst[Dst::Blue] = cross_product<DstT>(src[Src::Blue]);
+          }
+          if constexpr (Dst::Alpha >= 0) {
+            if constexpr (Src::Alpha >= 0) {
+              dst[Dst::Alpha] = cross_product<DstT>(src[Src::Alpha]);
+            } else {
+              dst[Dst::Alpha] = opaque;
+            }
+          }
+        }
+      }
+    } else {
+      for (std::size_t i = 0; i < count; ++i, src += srcPlanes, dst += dstPlanes) {
+        Color<SrcT> srcColor{};
+        SrcPixel::fromRaw(srcColor, src);
+        const Color<DstT> dstColor {
+          cross_product<DstT>(srcColor.red),
+          cross_product<DstT>(srcColor.green),
+          cross_product<DstT>(srcColor.blue),
+          cross_product<DstT>(srcColor.alpha)
+        };
+        DstPixel::toRaw(dst, dstColor);
+      }
+    }
+  }
+
+  /**
+   * Convert a row of pixels from `SrcPixel` to `DstPixel` when one of them (or both) is planar.
+   * Between known layouts of the same `DataType` the channels are only moved from one layout to the
+   * other (interleaved <-> planar transposition): with the vectorized kernels of `ImageSimd.h` for
+   * `std::uint8_t` and `float` pixels of the same plane count, else in a plain loop. Other pairs go
+   * through `loadPixel`, `cross_product` and `storePixel`. Gray targets get the same luminance as `convertRow`.
+   * @param src the first source pixel
+   * @param srcPlaneStride the distance between two source planes (1 for interleaved pixels)
+   * @param dst the first destination pixel
+   * @param dstPlaneStride the distance between two destination planes (1 for interleaved pixels)
+   * @param count the number of pixels to convert
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convertRowPlanar(const typename SrcPixel::DataType* src, const std::size_t srcPlaneStride,
+                        typename DstPixel::DataType* dst, const std::size_t dstPlaneStride, const std::size_t count) {
+    using SrcT = typename SrcPixel::DataType;
+    using DstT = typename DstPixel::DataType;
+    using Src = PixelLayout<SrcPixel>;
+    using Dst = PixelLayout<DstPixel>;
+    constexpr std::size_t srcStep = pixelStep<SrcPixel>;
+    constexpr std::size_t dstStep = pixelStep<DstPixel>;
+
+    if constexpr (Src::Known && Dst::Known && std::is_same_v<SrcT, DstT> && !Src::Gray && !Dst::Gray
+                  && isPlanar<SrcPixel> != isPlanar<DstPixel> && SrcPixel::PlaneCount == DstPixel::PlaneCount
+                  && (std::is_same_v<SrcT, std::uint8_t> || std::is_same_v<SrcT, float>)) {
+      // Plane pointers in the order of the samples of an interleaved pixel.
+      constexpr int planes = SrcPixel::PlaneCount;
+      if constexpr (isPlanar<DstPixel>) {
+        DstT* split[4]{};
+        split[Src::Red] = dst + Dst::Red * dstPlaneStride;
+        split[Src::Green] = dst + Dst::Green * dstPlaneStride;
+        split[Src::Blue] = dst + Dst::Blue * dstPlaneStride;
+        if constexpr (planes == 4) split[Src::Alpha] = dst + Dst::Alpha * dstPlaneStride;
+        simd::deinterleave(src, split, count, planes);
+      } else {
+        const SrcT* merge[4]{};
+        merge[Dst::Red] = src + Src::Red * srcPlaneStride;
+        merge[Dst::Green] = src + Src::Green * srcPlaneStride;
+        merge[Dst::Blue] = src + Src::Blue * srcPlaneStride;
+        if constexpr (planes == 4) merge[Dst::Alpha] = src + Src::Alpha * srcPlaneStride;
+        simd::interleave(merge, dst, count, planes);
+      }
+    } else if constexpr (Src::Known && Dst::Known && std::is_same_v<SrcT, DstT> && !Src::Gray && !Dst::Gray) {
+      const SrcT* const red = src + Src::Red * srcPlaneStride;
+      const SrcT* const green = src + Src::Green * srcPlaneStride;
+      const SrcT* const blue = src + Src::Blue * srcPlaneStride;
+      DstT* const dstRed = dst + Dst::Red * dstPlaneStride;
+      DstT* const dstGreen = dst + Dst::Green * dstPlaneStride;
+      DstT* const dstBlue = dst + Dst::Blue * dstPlaneStride;
+      for (std::size_t i = 0; i < count; ++i) {
+        dstRed[i * dstStep] = red[i * srcStep];
+        dstGreen[i * dstStep] = green[i * srcStep];
+        dstBlue[i * dstStep] = blue[i * srcStep];
+      }
+      if constexpr (Dst::Alpha >= 0) {
+        DstT* const dstAlpha = dst + Dst::Alpha * dstPlaneStride;
+        if constexpr (Src::Alpha >= 0) {
+          const SrcT* const alpha = src + Src::Alpha * srcPlaneStride;
+          for (std::size_t i = 0; i < count; ++i) dstAlpha[i * dstStep] = alpha[i * srcStep];
+        } else {
+          for (std::size_t i = 0; i < count; ++i) dstAlpha[i * dstStep] = DstPixel::Max;
+        }
+      }
+    } else if constexpr (Dst::Gray && std::is_same_v<SrcT, DstT>
+                         && (std::is_same_v<SrcT, std::uint8_t> || std::is_same_v<SrcT, float>)) {
+      // The luminance formula of the vectorized kernels, so both layouts give the same gray.
+      for (std::size_t i = 0; i < count; ++i) {
+        Color<SrcT> color{};
+        loadPixel<SrcPixel>(color, src + i * srcStep, srcPlaneStride);
+        if constexpr (std::is_same_v<SrcT, std::uint8_t>) {
+          dst[i * dstStep] = simd::luma8(color.red, color.green, color.blue);
+        } else {
+          dst[i * dstStep] = simd::lumaFloat(color.red, color.green, color.blue);
+        }
+      }
+    } else {
+      for (std::size_t i = 0; i < count; ++i) {
+        Color<SrcT> srcColor{};
+        loadPixel<SrcPixel>(srcColor, src + i * srcStep, srcPlaneStride);
+        const Color<DstT> dstColor {
+          cross_product<DstT>(srcColor.red),
+          cross_product<DstT>(srcColor.green),
+          cross_product<DstT>(srcColor.blue),
+          cross_product<DstT>(srcColor.alpha)
+        };
+        storePixel<DstPixel>(dst + i * dstStep, dstPlaneStride, dstColor);
+      }
+    }
+  }
+
+  /**
+   * Convert a block of rows from `SrcPixel` to `DstPixel`, with `convertRow` or `convertRowPlanar`.
+   * Large blocks are split in chunks of rows on the global thread pool (see `parallelRows`).
+   * @param src the first source row
+   * @param srcStride the distance between two source rows, in `SrcPixel::DataType` elements
+   * @param srcPlaneStride the distance between two source planes (1 for interleaved pixels)
+   * @param dst the first destination row
+   * @param dstStride the distance between two destination rows, in `DstPixel::DataType` elements
+   * @param dstPlaneStride the distance between two destination planes (1 for interleaved pixels)
+   * @param width the number of pixels per row
+   * @param height the number of rows
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convertRows(const typename SrcPixel::DataType* src, const std::size_t srcStride, const std::size_t srcPlaneStride,
+                   typename DstPixel::DataType* dst, const std::size_t dstStride, const std::size_t dstPlaneStride,
+                   const std::size_t width, const std::size_t height) {
+    const instrumentation::Probe<instrumentation::Operation::Convert, SrcPixel, DstPixel> probe(
+      width * height, width * height * DstPixel::PlaneCount * sizeof(typename DstPixel::DataType));
+    // Tightly packed rows are converted as one long row.
+    const bool packed = srcStride == width * pixelStep<SrcPixel> && dstStride == width * pixelStep<DstPixel>;
+    parallelRows(height, width * DstPixel::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      const auto convertOne = [&](const std::size_t row, const std::size_t count) {
+        if constexpr (isPlanar<SrcPixel> || isPlanar<DstPixel>) {
+          convertRowPlanar<SrcPixel, DstPixel>(src + row * srcStride, srcPlaneStride, dst + row * dstStride, dstPlaneStride, count);
+        } else {
+          convertRow<SrcPixel, DstPixel>(src + row * srcStride, dst + row * dstStride, count);
+        }
+      };
+      if (packed) {
+        convertOne(firstRow, width * (lastRow - firstRow));
+        return;
+      }
+      for (std::size_t row = firstRow; row < lastRow; ++row) {
+        convertOne(row, width);
+      }
+    });
+  }
+
+  /**
+   * Convert a block of rows of interleaved pixels, see the overload above.
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convertRows(const typename SrcPixel::DataType* src, const std::size_t srcStride,
+                   typename DstPixel::DataType* dst, const std::size_t dstStride,
+                   const std::size_t width, const std::size_t height) {
+    static_assert(!isPlanar<SrcPixel> && !isPlanar<DstPixel>, "planar pixels need their plane strides");
+    convertRows<SrcPixel, DstPixel>(src, srcStride, 1, dst, dstStride, 1, width, height);
+  }
+
+  /**
+   * Convert a row of pixels from `SrcPixel` to `DstPixel` in place, for pixels of the same `DataType`
+   * and no more planes in the target. Works forward: each pixel is read before being written at the
+   * same or a lower address, so shrinking conversions compact the row towards its start.
+   * @param data the first pixel
+   * @param count the number of pixels to convert
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convertRowInPlace(typename SrcPixel::DataType* data, const std::size_t count) {
+    using T = typename SrcPixel::DataType;
+    using Src = PixelLayout<SrcPixel>;
+    using Dst = PixelLayout<DstPixel>;
+    static_assert(std::is_same_v<T, typename DstPixel::DataType>, "in place conversion needs the same DataType");
+    static_assert(DstPixel::PlaneCount <= SrcPixel::PlaneCount, "in place conversion cannot add planes");
+    static_assert(!isPlanar<SrcPixel> && !isPlanar<DstPixel>, "in place conversion needs interleaved pixels");
+
+    if constexpr (std::is_same_v<SrcPixel, DstPixel>) {
+      return;
+    } else if constexpr (Src::Known && Dst::Known && !Src::Gray
+                         && (std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>)) {
+      // The vectorized kernels load each block before storing it and only move data forward.
+      convertRow<SrcPixel, DstPixel>(data, data, count);
+    } else {
+      for (std::size_t i = 0; i < count; ++i) {
+        Color<T> color{};
+        SrcPixel::fromRaw(color, data + i * SrcPixel::PlaneCount);
+        DstPixel::toRaw(data + i * DstPixel::PlaneCount, color);
+      }
+    }
+  }
+
+  /**
+   * Set every pixel of a block of rows to `color`, row by row.
+   * One pixel is encoded with `toRaw`, then replicated along the first row by doubling copies,
+   * and the first row is copied to the others; all the copies are memcpy, so they run vectorized.
+   * Planar pixels fill every row of every plane with the sample of its channel.
+   * @param data the first row
+   * @param stride the distance between two rows, in `Pixel::DataType` elements
+   * @param planeStride the distance between two planes (1 for interleaved pixels)
+   * @param width the number of pixels per row
+   * @param height the number of rows
+   * @param color the color of every pixel
+   */
+  template<typename Pixel>
+  void fillRows(typename Pixel::DataType* data, const std::size_t stride, const std::size_t planeStride,
+                const std::size_t width, const std::size_t height, const Color<typename Pixel::DataType>& color) {
+    using T = typename Pixel::DataType;
+    if (width == 0 || height == 0) return;
+
+    if constexpr (isPlanar<Pixel>) {
+      T samples[Pixel::PlaneCount];
+      Pixel::toRaw(samples, 1, color);
+      parallelRows(height, width * Pixel::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+        for (int plane = 0; plane < Pixel::PlaneCount; ++plane) {
+          for (std::size_t row = firstRow; row < lastRow; ++row) {
+            std::fill_n(data + plane * planeStride + row * stride, width, samples[plane]);
+          }
+        }
+      });
+    } else {
+      const std::size_t rowSize = width * Pixel::PlaneCount;
+      Pixel::toRaw(data, color);
+      for (std::size_t filled = Pixel::PlaneCount; filled < rowSize; filled *= 2) {
+        std::memcpy(data + filled, data, std::min(filled, rowSize - filled) * sizeof(T));
+      }
+      parallelRows(height - 1, rowSize, [&](const std::size_t firstRow, const std::size_t lastRow) {
+        for (std::size_t row = firstRow + 1; row <= lastRow; ++row) {
+          std::memcpy(data + row * stride, data, rowSize * sizeof(T));
+        }
+      });
+    }
+  }
+
+  /** ----- Iterators ----- **/
+
+  /**
+   * Contiguous samples of a row (or of one plane of a row), as plain pointers: the standard
+   * algorithms run on them at raw pointer speed, and vectorize.
+   * @tparam Sample the sample type, const for read-only access
+   */
+  template<typename Sample>
+  class SampleRange {
+    Sample* first;
+    Sample* last;
+
+  public:
+    SampleRange(Sample* first, Sample* last) : first(first), last(last) {}
+
+    Sample* begin() const { return first; }
+    Sample* end() const { return last; }
+    Sample* data() const { return first; }
+
+    [[nodiscard]] std::size_t size() const
+    { return static_cast<std::size_t>(last - first); }
+
+    Sample& operator[](const std::size_t index) const
+    { return first[index]; }
+  };
+
+  /**
+   * Proxy to one pixel, what pixel iterators yield: it reads as a `Color` and writes a `Color` with the
+   * pixel policy, like `getColor` / `setColor` without the index computation.
+   * Assigning a proxy to another copies the pixel, not the reference, so `std::copy` or `std::reverse`
+   * move pixels.
+   * @tparam Pixel the Pixel type
+   * @tparam Const `true` for read-only access
+   */
+  template<typename Pixel, bool Const>
+  class PixelRef {
+  public:
+    using DataType = typename Pixel::DataType;
+    using Sample = std::conditional_t<Const, const DataType, DataType>;
+
+  private:
+    Sample* data;
+    std::size_t planeStride;
+
+  public:
+    PixelRef(Sample* data, const std::size_t planeStride) : data(data), planeStride(planeStride) {}
+
+    PixelRef(const PixelRef&) = default;
+
+    // A mutable proxy can be used where a read-only one is expected
+    template<bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+    PixelRef(const PixelRef<Pixel, OtherConst>& other) : data(other.getData()), planeStride(other.getPlaneStride()) {}
+
+    // Get the color of the pixel
+    [[nodiscard]] Color<DataType> get() const {
+      Color<DataType> color;
+      loadPixel<Pixel>(color, data, planeStride);
+      return color;
+    }
+
+    operator Color<DataType>() const
+    { return get(); }
+
+    // Set the color of the pixel
+    const PixelRef& operator=(const Color<DataType>& color) const {
+      static_assert(!Const, "img::PixelRef: the pixel is read-only");
+      storePixel<Pixel>(data, planeStride, color);
+      return *this;
+    }
+
+    // Copy the color of another pixel
+    template<bool OtherConst>
+    const PixelRef& operator=(const PixelRef<Pixel, OtherConst>& other) const
+    { return *this = other.get(); }
+
+    const PixelRef& operator=(const PixelRef& other) const
+    { return *this = other.get(); }
+
+    // Get a sample of the pixel, in the order of its planes (Ex: blue first for BGR)
+    Sample& operator[](const int plane) const
+    { return data[plane * (isPlanar<Pixel> ? planeStride : 1)]; }
+
+    // Get the pointer to the first sample of the pixel
+    Sample* getData() const
+    { return data; }
+
+    [[nodiscard]] std::size_t getPlaneStride() const
+    { return planeStride; }
+
+    friend void swap(const PixelRef& a, const PixelRef& b) {
+      const Color<DataType> color = a.get();
+      a = b.get();
+      b = color;
+    }
+  };
+
+  /**
+   * Random access iterator over the pixels of a row, one pointer advanced by a constant step.
+   * It yields `PixelRef` proxies, like `std::vector<bool>`: the standard algorithms, the parallel ones
+   * included, accept it, but `reference` is not `value_type&`.
+   * @tparam Pixel the Pixel type
+   * @tparam Const `true` for read-only access
+   */
+  template<typename Pixel, bool Const>
+  class PixelIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Color<typename Pixel::DataType>;
+    using difference_type = std::ptrdiff_t;
+    using reference = PixelRef<Pixel, Const>;
+    using pointer = void;
+    using Sample = typename reference::Sample;
+
+  private:
+    static constexpr auto step = static_cast<difference_type>(pixelStep<Pixel>);
+
+    Sample* data{nullptr};
+    std::size_t planeStride{1};
+
+  public:
+    PixelIterator() = default;
+
+    PixelIterator(Sample* data, const std::size_t planeStride) : data(data), planeStride(planeStride) {}
+
+    template<bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+    PixelIterator(const PixelIterator<Pixel, OtherConst>& other) : data(other.getData()), planeStride(other.getPlaneStride()) {}
+
+    reference operator*() const { return reference(data, planeStride); }
+    reference operator[](const difference_type n) const { return reference(data + n * step, planeStride); }
+
+    PixelIterator& operator++() { data += step; return *this; }
+    PixelIterator& operator--() { data -= step; return *this; }
+    PixelIterator operator++(int) { PixelIterator it = *this; data += step; return it; }
+    PixelIterator operator--(int) { PixelIterator it = *this; data -= step; return it; }
+    PixelIterator& operator+=(const difference_type n) { data += n * step; return *this; }
+    PixelIterator& operator-=(const difference_type n) { data -= n * step; return *this; }
+
+    friend PixelIterator operator+(PixelIterator it, const difference_type n) { return it += n; }
+    friend PixelIterator operator+(const difference_type n, PixelIterator it) { return it += n; }
+    friend PixelIterator operator-(PixelIterator it, const difference_type n) { return it -= n; }
+    friend difference_type operator-(const PixelIterator& a, const PixelIterator& b) { return (a.data - b.data) / step; }
+
+    friend bool operator==(const PixelIterator& a, const PixelIterator& b) { return a.data == b.data; }
+    friend bool operator!=(const PixelIterator& a, const PixelIterator& b) { return a.data != b.data; }
+    friend bool operator<(const PixelIterator& a, const PixelIterator& b) { return a.data < b.data; }
+    friend bool operator>(const PixelIterator& a, const PixelIterator& b) { return a.data > b.data; }
+    friend bool operator<=(const PixelIterator& a, const PixelIterator& b) { return a.data <= b.data; }
+    friend bool operator>=(const PixelIterator& a, const PixelIterator& b) { return a.data >= b.data; }
+
+    // Get the pointer to the first sample of the pixel
+    Sample* getData() const
+    { return data; }
+
+    [[nodiscard]] std::size_t getPlaneStride() const
+    { return planeStride; }
+  };
+
+  /**
+   * Random access iterator over every pixel of an image, row after row, skipping the padding of the rows.
+   * Incrementing only moves a pointer, with a jump at the end of a row; images with tightly packed
+   * rows are walked as one long row, so the jump never happens inside them. The test of that jump
+   * still keeps the loops scalar: for vectorized loops, go through `pixels()` or `row()`.
+   * @tparam Pixel the Pixel type
+   * @tparam Const `true` for read-only access
+   */
+  template<typename Pixel, bool Const>
+  class ImageIterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = Color<typename Pixel::DataType>;
+    using difference_type = std::ptrdiff_t;
+    using reference = PixelRef<Pixel, Const>;
+    using pointer = void;
+    using Sample = typename reference::Sample;
+
+  private:
+    template<typename, bool> friend class ImageIterator;
+
+    static constexpr std::size_t step = pixelStep<Pixel>;
+
+    Sample* base{nullptr};
+    Sample* pixel{nullptr};
+    std::size_t width{0}, stride{0}, planeStride{1};
+    std::size_t row{0}, col{0};
+
+    [[nodiscard]] difference_type position() const
+    { return static_cast<difference_type>(row * width + col); }
+
+  public:
+    ImageIterator() = default;
+
+    /**
+     * Iterator on a pixel of an image.
+     * @param data the first sample of the image
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param stride the distance between two rows, in `DataType` elements
+     * @param planeStride the distance between two planes (1 for interleaved pixels)
+     * @param position the index of the pixel, `width * height` for the end
+     */
+    ImageIterator(Sample* data, std::size_t width, std::size_t height, std::size_t stride,
+                  const std::size_t planeStride, const std::size_t position)
+      : base(data), planeStride(planeStride) {
+      if (stride == width * step || height == 1) {
+        width *= height;
+        stride = width * step;
+      }
+      this->width = width;
+      this->stride = stride;
+      *this += static_cast<difference_type>(position);
+    }
+
+    template<bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+    ImageIterator(const ImageIterator<Pixel, OtherConst>& other)
+      : base(other.base), pixel(other.pixel), width(other.width), stride(other.stride),
+        planeStride(other.planeStride), row(other.row), col(other.col) {}
+
+    reference operator*() const { return reference(pixel, planeStride); }
+    reference operator[](const difference_type n) const { return *(*this + n); }
+
+    ImageIterator& operator++() {
+      pixel += step;
+      if (++col == width) {
+        col = 0;
+        ++row;
+        pixel += stride - width * step;
+      }
+      return *this;
+    }
+
+    ImageIterator& operator--() {
+      if (col == 0) {
+        col = width;
+        --row;
+        pixel -= stride - width * step;
+      }
+      --col;
+      pixel -= step;
+      return *this;
+    }
+
+    ImageIterator operator++(int) { ImageIterator it = *this; ++*this; return it; }
+    ImageIterator operator--(int) { ImageIterator it = *this; --*this; return it; }
+
+    ImageIterator& operator+=(const difference_type n) {
+      if (width == 0) return *this;
+      const auto target = static_cast<std::size_t>(position() + n);
+      if (stride == width * step) {
+        // One long row, of which the end is the first pixel of the next one: no division.
+        row = target == width ? 1 : 0;
+        col = target - row * width;
+        pixel = base + target * step;
+        return *this;
+      }
+      row = target / width;
+      col = target % width;
+      pixel = base + row * stride + col * step;
+      return *this;
+    }
+
+    ImageIterator& operator-=(const difference_type n) { return *this += -n; }
+
+    friend ImageIterator operator+(ImageIterator it, const difference_type n) { return it += n; }
+    friend ImageIterator operator+(const difference_type n, ImageIterator it) { return it += n; }
+    friend ImageIterator operator-(ImageIterator it, const difference_type n) { return it -= n; }
+    friend difference_type operator-(const ImageIterator& a, const ImageIterator& b) { return a.position() - b.position(); }
+
+    friend bool operator==(const ImageIterator& a, const ImageIterator& b) { return a.pixel == b.pixel; }
+    friend bool operator!=(const ImageIterator& a, const ImageIterator& b) { return a.pixel != b.pixel; }
+    friend bool operator<(const ImageIterator& a, const ImageIterator& b) { return a.position() < b.position(); }
+    friend bool operator>(const ImageIterator& a, const ImageIterator& b) { return a.position() > b.position(); }
+    friend bool operator<=(const ImageIterator& a, const ImageIterator& b) { return a.position() <= b.position(); }
+    friend bool operator>=(const ImageIterator& a, const ImageIterator& b) { return a.position() >= b.position(); }
+  };
+
+  /**
+   * The pixels of one row: pixel iterators and proxies, or the raw samples of a plane.
+   * @tparam Pixel the Pixel type
+   * @tparam Const `true` for read-only access
+   */
+  template<typename Pixel, bool Const>
+  class RowSpan {
+  public:
+    using iterator = PixelIterator<Pixel, Const>;
+    using reference = PixelRef<Pixel, Const>;
+    using Sample = typename reference::Sample;
+
+  private:
+    Sample* first;
+    std::size_t width;
+    std::size_t planeStride;
+
+  public:
+    RowSpan(Sample* first, const std::size_t width, const std::size_t planeStride)
+      : first(first), width(width), planeStride(planeStride) {}
+
+    iterator begin() const { return iterator(first, planeStride); }
+    iterator end() const { return iterator(first + width * pixelStep<Pixel>, planeStride); }
+
+    // Get the number of pixels
+    [[nodiscard]] std::size_t size() const
+    { return width; }
+
+    reference operator[](const std::size_t col) const
+    { return reference(first + col * pixelStep<Pixel>, planeStride); }
+
+    // Get the pointer to the first sample of the row
+    Sample* data() const
+    { return first; }
+
+    /**
+     * Get the samples of the row: every sample of every pixel for interleaved pixels, the samples
+     * of one plane for planar pixels.
+     * @param plane the plane, for planar pixels
+     */
+    SampleRange<Sample> samples(const int plane = 0) const {
+      Sample* const start = first + (isPlanar<Pixel> ? plane * planeStride : 0);
+      return SampleRange<Sample>(start, start + width * pixelStep<Pixel>);
+    }
+  };
+
+  /** ----- Views ----- **/
+
+  template<typename Pixel>
+  class Image;
+
+  /**
+   * Read-only, non-owning view over pixels stored elsewhere (a decoder output, a DMA buffer, ...).
+   * Nothing is copied: the buffer must outlive the view.
+   * @tparam Pixel the Pixel type (Ex: img::PixelRGB, img::PixelBGR, img::PixelRGBA, ...)
+   */
+  template<typename Pixel>
+  class ConstImageView {
+  public:
+    using PixelType = Pixel;
+    using DataType = typename Pixel::DataType;
+    using ColorType = Color<DataType>;
+
+  protected:
+    const DataType* data{nullptr};
+    std::size_t width{0}, height{0}, stride{0}, planeStride{1};
+
+    [[nodiscard]] std::size_t index(const std::size_t col, const std::size_t row) const {
+      return row * stride + col * pixelStep<Pixel>;
+    }
+
+  public:
+    /**
+     * Empty view with width and height equal 0.
+     */
+    ConstImageView() = default;
+
+    /**
+     * Wrap a buffer.
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param data the first sample of the first row
+     * @param stride the distance between two rows, in `DataType` elements (0 for tightly packed rows)
+     * @param planeStride for planar pixels, the distance between two planes (0 for planes following each other)
+     */
+    ConstImageView(std::size_t width, std::size_t height, const DataType* data, std::size_t stride = 0, std::size_t planeStride = 0)
+      : data(data), width(width), height(height), stride(stride == 0 ? width * pixelStep<Pixel> : stride),
+        planeStride(!isPlanar<Pixel> ? 1 : planeStride == 0 ? this->stride * height : planeStride) {}
+
+    // Get image width in pixel
+    [[nodiscard]] std::size_t getWidth() const
+    { return this->width; }
+
+    // Get image height in pixel
+    [[nodiscard]] std::size_t getHeight() const
+    { return this->height; }
+
+    // Get the distance between two rows, in `DataType` elements
+    [[nodiscard]] std::size_t getStride() const
+    { return this->stride; }
+
+    // Get the distance between two planes, in `DataType` elements (1 for interleaved pixels)
+    [[nodiscard]] std::size_t getPlaneStride() const
+    { return this->planeStride; }
+
+    // Get the pointer to the raw data
+    const DataType* getData() const
+    { return data; }
+
+    // Get the pointer to the first sample of a row (of the first plane for planar pixels)
+    const DataType* getRow(std::size_t row) const
+    { return data + row * stride; }
+
+    // Get the pointer to the first sample of a plane (the first sample of a channel for interleaved pixels)
+    const DataType* getPlane(std::size_t plane) const
+    { return data + plane * planeStride; }
+
+    // Get the pointer past the last sample of the last row (of the last plane for planar pixels)
+    const DataType* getDataEnd() const {
+      if (width == 0 || height == 0) return data;
+      const std::size_t lastPlane = isPlanar<Pixel> ? Pixel::PlaneCount - 1 : 0;
+      return getPlane(lastPlane) + (height - 1) * stride + width * pixelStep<Pixel>;
+    }
+
+    /**
+     * Whether the samples of the view may lie in the memory [`first`, `last`), from the first sample of
+     * the view to the end of its last row.
+     */
+    [[nodiscard]] bool overlaps(const void* first, const void* last) const {
+      const std::less<const void*> before;
+      return data != getDataEnd() && first != last && before(data, last) && before(first, getDataEnd());
+    }
+
+    // Whether the samples of the view and of `other` may share memory
+    template<typename OtherPixel>
+    [[nodiscard]] bool overlaps(const ConstImageView<OtherPixel>& other) const
+    { return overlaps(other.getData(), other.getDataEnd()); }
+
+    // Get the color of a pixel
+    Color<DataType> getColor(std::size_t col, std::size_t row) const {
+      Color<DataType> color;
+      loadPixel<Pixel>(color, data + index(col, row), planeStride);
+      return color;
+    }
+
+    // Get the pixels of a row
+    RowSpan<Pixel, true> row(std::size_t row) const
+    { return RowSpan<Pixel, true>(getRow(row), width, planeStride); }
+
+    /**
+     * Get every pixel as one long row, for the views with tightly packed rows: the standard algorithms
+     * then walk the image with a single pointer, as fast as over the rows of `row()`.
+     * @throws std::logic_error if the rows are padded (iterate with `row()` or `begin()` instead)
+     */
+    RowSpan<Pixel, true> pixels() const {
+      if (stride != width * pixelStep<Pixel> && height > 1) {
+        throw std::logic_error("img::ConstImageView::pixels: the rows are padded");
+      }
+      return RowSpan<Pixel, true>(data, width * height, planeStride);
+    }
+
+    // Iterate over every pixel, row after row
+    ImageIterator<Pixel, true> begin() const
+    { return ImageIterator<Pixel, true>(data, width, height, stride, planeStride, 0); }
+
+    ImageIterator<Pixel, true> end() const
+    { return ImageIterator<Pixel, true>(data, width, height, stride, planeStride, width * height); }
+
+    /**
+     * Get a view over a rectangle of the pixels, sharing the buffer: the rows keep the stride of this view.
+     * @param x the first column of the rectangle
+     * @param y the first row of the rectangle
+     * @param width the width of the rectangle
+     * @param height the height of the rectangle
+     * @throws std::invalid_argument if the rectangle is not inside the view
+     */
+    ConstImageView subImage(std::size_t x, std::size_t y, std::size_t width, std::size_t height) const {
+      checkRegion(x, y, width, height);
+      return ConstImageView(width, height, data + index(x, y), stride, planeStride);
+    }
+
+    // Whether the rows (and planes) follow each other without padding, like in a packed `Image`
+    [[nodiscard]] bool isContiguous() const {
+      const std::size_t rowSamples = width * pixelStep<Pixel>;
+      return (stride == rowSamples || height <= 1) && (!isPlanar<Pixel> || planeStride == stride * height);
+    }
+
+    /**
+     * Get the pixels with tightly packed rows, copied into `storage` only when needed: a contiguous view
+     * is returned as is, still sharing its buffer. The buffer of `storage` is reused from one call to the
+     * next, so a loop over many crops allocates only when the crops grow; a view into `storage` itself
+     * is copied through a new buffer.
+     * @param storage the image receiving the copy, its rows padded as its row alignment says
+     * @return this view, or a view over `storage`
+     */
+    ConstImageView materialize(Image<Pixel>& storage) const {
+      if (isContiguous()) return *this;
+      storage = *this;
+      return storage.view();
+    }
+
+  protected:
+    void checkRegion(std::size_t x, std::size_t y, std::size_t regionWidth, std::size_t regionHeight) const {
+      if (x > width || regionWidth > width - x || y > height || regionHeight > height - y) {
+        throw std::invalid_argument("img::ImageView::subImage: the region is outside of the view");
+      }
+    }
+  };
+
+  /**
+   * Mutable, non-owning view over pixels stored elsewhere. Like a pointer, a const view still
+   * gives write access to the pixels. A mutable view can be used wherever a `ConstImageView` is expected.
+   * @tparam Pixel the Pixel type (Ex: img::PixelRGB, img::PixelBGR, img::PixelRGBA, ...)
+   */
+  template<typename Pixel>
+  class ImageView : public ConstImageView<Pixel> {
+  public:
+    using typename ConstImageView<Pixel>::DataType;
+
+    /**
+     * Empty view with width and height equal 0.
+     */
+    ImageView() = default;
+
+    /**
+     * Wrap a buffer.
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param data the first sample of the first row
+     * @param stride the distance between two rows, in `DataType` elements (0 for tightly packed rows)
+     * @param planeStride for planar pixels, the distance between two planes (0 for planes following each other)
+     */
+    ImageView(std::size_t width, std::size_t height, DataType* data, std::size_t stride = 0, std::size_t planeStride = 0)
+      : ConstImageView<Pixel>(width, height, data, stride, planeStride) {}
+
+    // Get the pointer to the raw data
+    DataType* getData() const
+    { return const_cast<DataType*>(this->data); }
+
+    // Get the pointer to the first sample of a row (of the first plane for planar pixels)
+    DataType* getRow(std::size_t row) const
+    { return getData() + row * this->stride; }
+
+    // Get the pointer to the first sample of a plane (the first sample of a channel for interleaved pixels)
+    DataType* getPlane(std::size_t plane) const
+    { return getData() + plane * this->planeStride; }
+
+    // Set the color of a pixel
+    void setColor(std::size_t col, std::size_t row, Color<DataType> color) const {
+      storePixel<Pixel>(getData() + this->index(col, row), this->planeStride, color);
+    }
+
+    // Set the color of every pixel
+    void fill(Color<DataType> color) const {
+      fillRows<Pixel>(getData(), this->stride, this->planeStride, this->width, this->height, color);
+    }
+
+    // Get the pixels of a row
+    RowSpan<Pixel, false> row(std::size_t row) const
+    { return RowSpan<Pixel, false>(getRow(row), this->width, this->planeStride); }
+
+    /**
+     * Get every pixel as one long row, for the views with tightly packed rows.
+     * @throws std::logic_error if the rows are padded (iterate with `row()` or `begin()` instead)
+     */
+    RowSpan<Pixel, false> pixels() const {
+      const RowSpan<Pixel, true> pixels = ConstImageView<Pixel>::pixels();
+      return RowSpan<Pixel, false>(getData(), pixels.size(), this->planeStride);
+    }
+
+    // Iterate over every pixel, row after row
+    ImageIterator<Pixel, false> begin() const
+    { return ImageIterator<Pixel, false>(getData(), this->width, this->height, this->stride, this->planeStride, 0); }
+
+    ImageIterator<Pixel, false> end() const {
+      return ImageIterator<Pixel, false>(getData(), this->width, this->height, this->stride, this->planeStride,
+                                         this->width * this->height);
+    }
+
+    /**
+     * Get a mutable view over a rectangle of the pixels, sharing the buffer: the rows keep the stride of this view.
+     * @throws std::invalid_argument if the rectangle is not inside the view
+     */
+    ImageView subImage(std::size_t x, std::size_t y, std::size_t width, std::size_t height) const {
+      this->checkRegion(x, y, width, height);
+      return ImageView(width, height, getData() + this->index(x, y), this->stride, this->planeStride);
+    }
+  };
+
+  /**
+   * Convert the pixels of `src` into the pixels of `dst`, with the same kernels as the converting constructor.
+   * @param src the source pixels
+   * @param dst the destination pixels, of the same size
+   * @throws std::invalid_argument if the sizes differ
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void convert(const ConstImageView<SrcPixel>& src, const ImageView<DstPixel>& dst) {
+    if (src.getWidth() != dst.getWidth() || src.getHeight() != dst.getHeight()) {
+      throw std::invalid_argument("img::convert: source and destination sizes differ");
+    }
+    convertRows<SrcPixel, DstPixel>(src.getData(), src.getStride(), src.getPlaneStride(),
+                                    dst.getData(), dst.getStride(), dst.getPlaneStride(),
+                                    src.getWidth(), src.getHeight());
+  }
+
+  /**
+   * Padding of the rows of an image buffer: tightly packed, or every row starting on a 32 or 64 byte
+   * boundary so that rows can be processed with aligned SIMD loads.
+   */
+  enum class RowAlignment : std::size_t {
+    Packed = 0,
+    Align32 = 32,
+    Align64 = 64
+  };
+
+  // Tag selecting the Image constructor that leaves the pixels uninitialized.
+  struct Uninitialized {
+    explicit Uninitialized() = default;
+  };
+  inline constexpr Uninitialized uninitialized{};
+
   template<typename Pixel>
   class Image {
+    template<typename> friend class Image;
+
     using PixelType = Pixel;
     /**
      * Return the index calculated from the column and row.
@@ -154,7 +1338,7 @@ namespace img {
      * @return std::size_t the index corresponding.
      */
     [[nodiscard]] std::size_t index(const std::size_t col, const std::size_t row) const {
-      return index(col, row, PixelType::PlaneCount);
+      return index(col, row, pixelStep<PixelType>);
     }
 
     /**
@@ -164,157 +1348,311 @@ namespace img {
      * @param planeCount the number of field characterizing a color.
      * @return a `size_t`, the index corresponding.
      */
-    [[nodiscard]] std::size_t index(const std::size_t col, const std::size_t row, const int planeCount) const {
-      return (col + row * width) * planeCount;
+    [[nodiscard]] std::size_t index(const std::size_t col, const std::size_t row, const std::size_t planeCount) const {
+      return row * stride + col * planeCount;
     }
 
-    std::size_t width{0}, height{0};
-    typename Pixel::DataType* data;
+    /**
+     * Return the distance between two rows for a width and a row alignment.
+     * @param width the width of the image
+     * @param alignment the row alignment
+     * @return the stride, in `DataType` elements.
+     */
+    static std::size_t rowStride(const std::size_t width, const RowAlignment alignment) {
+      const std::size_t packed = width * pixelStep<PixelType>;
+      const auto bytes = static_cast<std::size_t>(alignment);
+      if (bytes == 0 || packed == 0) return packed;
+      if (bytes % sizeof(typename Pixel::DataType) != 0) {
+        throw std::invalid_argument("img::Image: row alignment is not a multiple of the sample size");
+      }
+      const std::size_t samples = bytes / sizeof(typename Pixel::DataType);
+      return (packed + samples - 1) / samples * samples;
+    }
+
+    typename Pixel::DataType* allocate(const std::size_t samples) const {
+      if (samples == 0) return nullptr;
+      const instrumentation::Probe<instrumentation::Operation::Allocate, Pixel> probe;
+      probe.allocated(samples * sizeof(typename Pixel::DataType));
+      return static_cast<typename Pixel::DataType*>(
+        resource->allocate(samples * sizeof(typename Pixel::DataType), BufferAlignment));
+    }
+
+    // Reference count of a buffer shared by copy-on-write images, allocated from the same resource
+    // on its own cache line.
+    using SharedCount = std::atomic<std::size_t>;
+
+    SharedCount* newSharedCount() const {
+      return new (resource->allocate(sizeof(SharedCount), BufferAlignment)) SharedCount(1);
+    }
+
+    // Drop the buffer, freeing it unless other images still share it.
+    void release() {
+      if (data != nullptr && (shared == nullptr || shared->fetch_sub(1, std::memory_order_acq_rel) == 1)) {
+        resource->deallocate(data, capacity * sizeof(typename Pixel::DataType), BufferAlignment);
+        if (shared != nullptr) {
+          shared->~SharedCount();
+          resource->deallocate(shared, sizeof(SharedCount), BufferAlignment);
+        }
+      }
+      data = nullptr;
+      shared = nullptr;
+      capacity = 0;
+    }
+
+    // Take a reference to the buffer of a copy-on-write image.
+    void share(const Image& other) {
+      other.shared->fetch_add(1, std::memory_order_relaxed);
+      release();
+      width = other.width;
+      height = other.height;
+      stride = other.stride;
+      planeStride = other.planeStride;
+      alignment = other.alignment;
+      resource = other.resource;
+      capacity = other.capacity;
+      data = other.data;
+      shared = other.shared;
+      copyOnWrite = true;
+    }
+
+    // Give the image a private copy of its buffer before a write, if the buffer is shared.
+    void detach() {
+      if (!isShared()) return;
+      const instrumentation::Probe<instrumentation::Operation::Copy, Pixel> probe(
+        width * height, capacity * sizeof(typename Pixel::DataType));
+      auto* newData = allocate(capacity);
+      SharedCount* newShared = newSharedCount();
+      std::memcpy(newData, data, capacity * sizeof(typename Pixel::DataType));
+      const std::size_t samples = capacity;
+      release();
+      data = newData;
+      shared = newShared;
+      capacity = samples;
+    }
+
+    /**
+     * Give the image a new size, keeping its row alignment.
+     * The buffer is only reallocated when its number of samples changes, and the content is not kept.
+     * The planes of planar pixels follow each other in the buffer.
+     * @param newWidth the new width
+     * @param newHeight the new height
+     */
+    void reshape(const std::size_t newWidth, const std::size_t newHeight) {
+      const std::size_t newStride = rowStride(newWidth, alignment);
+      const std::size_t samples = newStride * newHeight * (isPlanar<PixelType> ? PixelType::PlaneCount : 1);
+      if (samples != capacity || isShared()) {
+        // A shared buffer is left to the other images, the content is overwritten anyway.
+        auto* newData = allocate(samples);
+        SharedCount* newShared = copyOnWrite && newData != nullptr ? newSharedCount() : nullptr;
+        release();
+        data = newData;
+        shared = newShared;
+        capacity = samples;
+      }
+      width = newWidth;
+      height = newHeight;
+      stride = newStride;
+      planeStride = isPlanar<PixelType> ? newStride * newHeight : 1;
+    }
+
+    // Convert the pixels of a view into this image, which already has its size
+    template<typename OtherPixel>
+    void convertFrom(const ConstImageView<OtherPixel>& other) {
+      convertRows<OtherPixel, PixelType>(other.getData(), other.getStride(), other.getPlaneStride(),
+                                         data, stride, planeStride, width, height);
+    }
+
+    std::size_t width{0}, height{0}, stride{0}, planeStride{1};
+    RowAlignment alignment{RowAlignment::Packed};
+    std::pmr::memory_resource* resource{std::pmr::get_default_resource()};
+    std::size_t capacity{0};  // number of samples allocated
+    typename Pixel::DataType* data{nullptr};
+    SharedCount* shared{nullptr};  // set when copy-on-write is enabled and there is a buffer
+    bool copyOnWrite{false};
 
   public:
     using DataType = typename Pixel::DataType;
     using ColorType = Color<DataType>;
 
+    // Alignment of every buffer, so that the first row of a padded image is aligned too.
+    static constexpr std::size_t BufferAlignment = 64;
+
     // Destructor
     ~Image() {
-      delete[] data;
+      release();
     }
 
     /**
      * Empty Image with width and height equal 0.
      */
-    Image(): data(nullptr) {}
+    Image() = default;
+
+    /**
+     * Empty Image with width and height equal 0, allocating its buffers from `resource`.
+     * @param resource the memory resource of the buffer (Ex: an img::FramePool)
+     */
+    explicit Image(std::pmr::memory_resource* resource) : resource(resource) {}
 
     /**
      * Construct a blue image.
      * @param width the width of the image
      * @param height the height of the image
+     * @param alignment the padding of the rows
+     * @param resource the memory resource of the buffer (Ex: an img::FramePool)
      */
-    Image(std::size_t width, std::size_t height) : width(width), height(height) {
-      const size_t total_size = width * height * PixelType::PlaneCount;
-      data = new DataType[total_size];
-
-      Color<DataType> color {0, 0, getMaxInContext<DataType>(), getMaxInContext<DataType>()};
-      for (int i = 0; i < width; ++i) {
-        for (int j = 0; j < height; ++j) {
-          setColor(i, j, color);
-        }
-      }
+    Image(std::size_t width, std::size_t height, RowAlignment alignment = RowAlignment::Packed,
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : alignment(alignment), resource(resource) {
+      const instrumentation::Probe<instrumentation::Operation::Construct, Pixel> probe(width * height);
+      reshape(width, height);
+
+      fill({0, 0, getMaxInContext<DataType>(), getMaxInContext<DataType>()});
+    }
+
+    /**
+     * Construct an image without initializing its pixels, for images that are overwritten right away.
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param alignment the padding of the rows
+     * @param resource the memory resource of the buffer (Ex: an img::FramePool)
+     */
+    Image(std::size_t width, std::size_t height, Uninitialized, RowAlignment alignment = RowAlignment::Packed,
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : alignment(alignment), resource(resource) {
+      const instrumentation::Probe<instrumentation::Operation::Construct, Pixel> probe(width * height);
+      reshape(width, height);
     }
 
     /**
      * Construct an image from a buffer.
      * @param width the width of the image
      * @param height the height of the image
-     * @param external_data the buffer containing the data. (Should not be verified here.)
+     * @param external_data the buffer containing the data, with tightly packed rows (and planes following each
+     * other for planar pixels). (Should not be verified here.)
+     * @param alignment the padding of the rows of the image
+     * @param resource the memory resource of the buffer (Ex: an img::FramePool)
      */
-    Image(std::size_t width, std::size_t height, const DataType* external_data) : width(width), height(height) {
-      const size_t total_size = width * height * PixelType::PlaneCount;
-      data = new DataType[total_size];
-
-      for (size_t row = 0; row < height; ++row) {
-        for (size_t col = 0; col < width; ++col) {
-          Color<DataType> color{};
-          PixelType::fromRaw(color, external_data + index(col, row));
-          setColor(col, row, color);
-        }
-      }
+    Image(std::size_t width, std::size_t height, const DataType* external_data,
+          RowAlignment alignment = RowAlignment::Packed,
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : alignment(alignment), resource(resource) {
+      const instrumentation::Probe<instrumentation::Operation::Construct, Pixel> probe(width * height);
+      reshape(width, height);
+
+      convertFrom(ConstImageView<PixelType>(width, height, external_data));
     }
 
     // Conversions
     template<typename OtherPixel>
-    Image(const Image<OtherPixel>& other) : width(other.getWidth()), height(other.getHeight())
-    {
-      const std::size_t total_size = width * height * PixelType::PlaneCount;
-      data = new DataType[total_size];
+    Image(const Image<OtherPixel>& other) : Image(other.view()) {}
 
-      for (std::size_t row = 0; row < height; ++row) {
-        for (std::size_t col = 0; col < width; ++col) {
-          Color<typename OtherPixel::DataType> srcColor = other.getColor(col, row);
-
-          Color<DataType> dstColor {
-            cross_product<DataType>(srcColor.red),
-            cross_product<DataType>(srcColor.green),
-            cross_product<DataType>(srcColor.blue),
-            cross_product<DataType>(srcColor.alpha)
-          };
+    /**
+     * Construct an image from the pixels of a view, converted to `Pixel`.
+     * @param other the source pixels, with any row stride
+     * @param alignment the padding of the rows of the image
+     * @param resource the memory resource of the buffer (Ex: an img::FramePool)
+     */
+    template<typename OtherPixel>
+    Image(const ConstImageView<OtherPixel>& other, RowAlignment alignment = RowAlignment::Packed,
+          std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : alignment(alignment), resource(resource)
+    {
+      const instrumentation::Probe<instrumentation::Operation::Construct, OtherPixel, Pixel> probe(
+        other.getWidth() * other.getHeight());
+      reshape(other.getWidth(), other.getHeight());
 
-          setColor(col, row, dstColor);
-        }
-      }
+      convertFrom(other);
     }
 
     template<typename OtherPixel>
     Image& operator=(const Image<OtherPixel>& other) {
-      width = other.getWidth();
-      height = other.getHeight();
-
-      delete[] data;
-
-      const std::size_t total_size = width * height * PixelType::PlaneCount;
-      data = new DataType[total_size];
-
-      for (std::size_t row = 0; row < height; ++row) {
-        for (std::size_t col = 0; col < width; ++col) {
-          Color<typename OtherPixel::DataType> srcColor = other.getColor(col, row);
-
-          Color<DataType> dstColor {
-            cross_product<DataType>(srcColor.red),
-            cross_product<DataType>(srcColor.green),
-            cross_product<DataType>(srcColor.blue),
-            cross_product<DataType>(srcColor.alpha)
-          };
+      return *this = other.view();
+    }
 
-          setColor(col, row, dstColor);
-        }
+    // The image keeps its own row alignment and memory resource.
+    template<typename OtherPixel>
+    Image& operator=(const ConstImageView<OtherPixel>& other) {
+      // A view into this buffer (Ex: `image = image.subImage(...)`) is converted into a new buffer first.
+      if (other.overlaps(data, data + capacity)) {
+        Image converted(other, alignment, resource);
+        converted.setCopyOnWrite(copyOnWrite);
+        return *this = std::move(converted);
       }
+      reshape(other.getWidth(), other.getHeight());
+
+      convertFrom(other);
 
       return *this;
     }
 
+    // The image keeps its own memory resource, unless `other` is copy-on-write: the buffer is then shared.
     Image& operator=(const Image& other) {
       if (this == &other)
         return *this;
 
-      width = other.width;
-      height = other.height;
-      const std::size_t total_size = width * height * PixelType::PlaneCount;
-      auto* newData = new DataType[total_size];
-      for (std::size_t i = 0; i < total_size; ++i) {
-        newData[i] = other.data[i];
+      const instrumentation::Probe<instrumentation::Operation::Copy, Pixel> probe(other.width * other.height);
+      if (other.shared != nullptr) {
+        share(other);
+        return *this;
       }
-      delete[] data;
-      data = newData;
+      alignment = other.alignment;
+      reshape(other.width, other.height);
+      convertFrom(other.view());
       return *this;
     }
 
 
-    Image(const Image& other) : width(other.width), height(other.height) {
-      const std::size_t total_size = width * height * PixelType::PlaneCount;
-      data = new DataType[total_size];
-      for (std::size_t i = 0; i < total_size; ++i) {
-        data[i] = other.data[i];
+    /**
+     * The copy allocates from the default memory resource, like the copy of a `std::pmr` container: the
+     * resource of `other` (Ex: the arena of an `ImageBatch`) may not outlive it. A copy of a copy-on-write
+     * image shares its buffer, and its resource, instead.
+     */
+    Image(const Image& other) : alignment(other.alignment), copyOnWrite(other.copyOnWrite) {
+      const instrumentation::Probe<instrumentation::Operation::Copy, Pixel> probe(other.width * other.height);
+      if (other.shared != nullptr) {
+        share(other);
+        return;
       }
+      reshape(other.width, other.height);
+      convertFrom(other.view());
     }
 
-    Image(Image&& other) noexcept : width(other.width), height(other.height), data(other.data) {
+    Image(Image&& other) noexcept
+      : width(other.width), height(other.height), stride(other.stride), planeStride(other.planeStride), alignment(other.alignment),
+        resource(other.resource), capacity(other.capacity), data(other.data), shared(other.shared), copyOnWrite(other.copyOnWrite) {
+      const instrumentation::Probe<instrumentation::Operation::Move, Pixel> probe(width * height);
       other.data = nullptr;
+      other.shared = nullptr;
       other.width = 0;
       other.height = 0;
+      other.stride = 0;
+      other.capacity = 0;
     }
 
+    // The buffer is taken along with the memory resource it comes from.
     Image& operator=(Image&& other) noexcept {
       if (this == &other) { return *this; }
 
-      delete[] data;
+      const instrumentation::Probe<instrumentation::Operation::Move, Pixel> probe(other.width * other.height);
+      release();
 
       width = other.width;
       height = other.height;
+      stride = other.stride;
+      planeStride = other.planeStride;
+      alignment = other.alignment;
+      resource = other.resource;
+      capacity = other.capacity;
       data = other.data;
+      shared = other.shared;
+      copyOnWrite = other.copyOnWrite;
 
       other.data = nullptr;
+      other.shared = nullptr;
       other.width = 0;
       other.height = 0;
+      other.stride = 0;
+      other.capacity = 0;
 
       return *this;
     }
@@ -327,23 +1665,208 @@ namespace img {
     [[nodiscard]] std::size_t getHeight() const
     { return this->height; }
 
+    // Get the distance between two rows, in `DataType` elements
+    [[nodiscard]] std::size_t getStride() const
+    { return this->stride; }
+
+    // Get the distance between two planes, in `DataType` elements (1 for interleaved pixels)
+    [[nodiscard]] std::size_t getPlaneStride() const
+    { return this->planeStride; }
+
+    // Get the padding of the rows
+    [[nodiscard]] RowAlignment getAlignment() const
+    { return this->alignment; }
+
+    // Get the memory resource of the buffer
+    [[nodiscard]] std::pmr::memory_resource* getResource() const
+    { return this->resource; }
+
+    /**
+     * Enable or disable copy-on-write. Copies of a copy-on-write image share its buffer, reference
+     * counted, instead of copying the pixels; the first write through `setColor`, `fill`, `view()`,
+     * an assignment or `convertInPlace` gives the written image a private copy if the buffer is still shared.
+     * Images sharing a buffer can be read, copied and destroyed from different threads. A mutable
+     * view taken before a copy writes to the shared buffer.
+     * @param enabled `true` to share the buffer with the next copies
+     */
+    void setCopyOnWrite(const bool enabled) {
+      if (enabled == copyOnWrite) return;
+      if (enabled) {
+        if (data != nullptr) shared = newSharedCount();
+      } else {
+        detach();
+        if (shared != nullptr) {
+          shared->~SharedCount();
+          resource->deallocate(shared, sizeof(SharedCount), BufferAlignment);
+          shared = nullptr;
+        }
+      }
+      copyOnWrite = enabled;
+    }
+
+    // Whether copies share the buffer of the image
+    [[nodiscard]] bool isCopyOnWrite() const
+    { return copyOnWrite; }
+
+    // Whether the buffer is currently shared with other images
+    [[nodiscard]] bool isShared() const
+    { return shared != nullptr && shared->load(std::memory_order_acquire) > 1; }
+
+    /**
+     * Get the size of the buffer allocated by an image of this pixel type.
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param alignment the padding of the rows
+     * @return the size in bytes, 0 for an empty image
+     */
+    static std::size_t bufferBytes(const std::size_t width, const std::size_t height,
+                                   const RowAlignment alignment = RowAlignment::Packed)
+    { return rowStride(width, alignment) * height * (isPlanar<PixelType> ? PixelType::PlaneCount : 1) * sizeof(DataType); }
+
     // Get the pointer to the raw data
     const DataType* getData() const
     { return data; }
 
+    // Get the pointer to the first sample of a row (of the first plane for planar pixels)
+    const DataType* getRow(std::size_t row) const
+    { return data + row * stride; }
+
+    // Get the pointer to the first sample of a plane (the first sample of a channel for interleaved pixels)
+    const DataType* getPlane(std::size_t plane) const
+    { return data + plane * planeStride; }
+
+    // Get a mutable view over the pixels of the image, after a private copy of a shared buffer
+    ImageView<Pixel> view() {
+      detach();
+      return ImageView<Pixel>(width, height, data, stride, planeStride);
+    }
+
+    // Get a read-only view over the pixels of the image
+    ConstImageView<Pixel> view() const
+    { return ConstImageView<Pixel>(width, height, data, stride, planeStride); }
+
+    // Images can be passed wherever a read-only view is expected
+    operator ConstImageView<Pixel>() const
+    { return view(); }
+
+    /**
+     * Get a mutable view over a rectangle of the image, after a private copy of a shared buffer. Nothing
+     * else is copied: the view uses the row stride of the image, and is valid until the image is resized.
+     * @param x the first column of the rectangle
+     * @param y the first row of the rectangle
+     * @param width the width of the rectangle
+     * @param height the height of the rectangle
+     * @throws std::invalid_argument if the rectangle is not inside the image
+     */
+    ImageView<Pixel> subImage(std::size_t x, std::size_t y, std::size_t width, std::size_t height)
+    { return view().subImage(x, y, width, height); }
+
+    // Get a read-only view over a rectangle of the image
+    ConstImageView<Pixel> subImage(std::size_t x, std::size_t y, std::size_t width, std::size_t height) const
+    { return view().subImage(x, y, width, height); }
+
+    // Get the pixels of a row, after a private copy of a shared buffer
+    RowSpan<Pixel, false> row(std::size_t row) {
+      detach();
+      return RowSpan<Pixel, false>(data + row * stride, width, planeStride);
+    }
+
+    // Get the pixels of a row
+    RowSpan<Pixel, true> row(std::size_t row) const
+    { return RowSpan<Pixel, true>(getRow(row), width, planeStride); }
+
+    /**
+     * Get every pixel as one long row, after a private copy of a shared buffer, for the images with
+     * tightly packed rows (`RowAlignment::Packed`).
+     * @throws std::logic_error if the rows are padded (iterate with `row()` or `begin()` instead)
+     */
+    RowSpan<Pixel, false> pixels()
+    { return view().pixels(); }
+
+    RowSpan<Pixel, true> pixels() const
+    { return view().pixels(); }
+
+    // Iterate over every pixel, row after row, after a private copy of a shared buffer
+    ImageIterator<Pixel, false> begin()
+    { return view().begin(); }
+
+    ImageIterator<Pixel, false> end()
+    { return view().end(); }
+
+    ImageIterator<Pixel, true> begin() const
+    { return view().begin(); }
+
+    ImageIterator<Pixel, true> end() const
+    { return view().end(); }
+
     // Get the color of a pixel
     Color<DataType> getColor(std::size_t col, std::size_t row) const {
       Color<DataType> color;
       std::size_t idx = index(col, row);
-      Pixel::fromRaw(color, data + idx);
+      loadPixel<Pixel>(color, data + idx, planeStride);
 
       return color;
     }
 
     // Set the color of a pixel
     void setColor(std::size_t col, std::size_t row, Color<DataType> color) {
+      detach();
       std::size_t idx = index(col, row);
-      Pixel::toRaw(data + idx, color);
+      storePixel<Pixel>(data + idx, planeStride, color);
+    }
+
+    // Set the color of every pixel
+    void fill(Color<DataType> color) {
+      detach();
+      fillRows<Pixel>(data, stride, planeStride, width, height, color);
+    }
+
+    /**
+     * Convert the image to `TargetPixel` inside its own buffer, without allocating.
+     * `TargetPixel` must have the same `DataType` and no more planes (Ex: RGBA -> BGRA, RGBA -> RGB, RGB -> Gray),
+     * and both pixel types must be interleaved.
+     * Packed images stay packed: the samples are compacted forward over the whole buffer. Padded
+     * images keep their stride and are converted row by row. The image is left empty, as after a move.
+     * @tparam TargetPixel the Pixel type of the result
+     * @return the converted image, owning the buffer of this one.
+     */
+    template<typename TargetPixel>
+    Image<TargetPixel> convertInPlace() {
+      static_assert(std::is_same_v<DataType, typename TargetPixel::DataType>, "in place conversion needs the same DataType");
+      static_assert(TargetPixel::PlaneCount <= PixelType::PlaneCount, "in place conversion cannot add planes");
+
+      detach();
+      const instrumentation::Probe<instrumentation::Operation::Convert, PixelType, TargetPixel> probe(
+        width * height, width * height * TargetPixel::PlaneCount * sizeof(DataType));
+      Image<TargetPixel> result(resource);
+      result.alignment = alignment;
+      result.width = width;
+      result.height = height;
+      result.capacity = capacity;
+      if (stride == width * PixelType::PlaneCount) {
+        convertRowInPlace<PixelType, TargetPixel>(data, width * height);
+        result.stride = width * TargetPixel::PlaneCount;
+      } else {
+        auto* const rows = data;
+        const std::size_t rowStride = stride;
+        parallelRows(height, width * PixelType::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+          for (std::size_t row = firstRow; row < lastRow; ++row) {
+            convertRowInPlace<PixelType, TargetPixel>(rows + row * rowStride, width);
+          }
+        });
+        result.stride = stride;
+      }
+      result.data = data;
+      result.shared = shared;
+      result.copyOnWrite = copyOnWrite;
+
+      data = nullptr;
+      shared = nullptr;
+      width = 0;
+      height = 0;
+      stride = 0;
+      capacity = 0;
+      return result;
     }
   };
 
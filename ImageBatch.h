@@ -0,0 +1,141 @@
+#ifndef IMG_IMAGE_BATCH_H
+#define IMG_IMAGE_BATCH_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  namespace detail {
+    // Sources accepted by ImageBatch: images, views, or pointers to either.
+    template<typename Pixel>
+    ConstImageView<Pixel> batchSource(const ConstImageView<Pixel>& view) { return view; }
+
+    template<typename Pixel>
+    ConstImageView<Pixel> batchSource(const Image<Pixel>& image) { return image.view(); }
+
+    template<typename Source>
+    auto batchSource(const Source* source) { return batchSource(*source); }
+  }
+
+  /**
+   * Images converted together from a range of sources, their buffers carved from one arena.
+   *
+   * The arena is sized up front for every output and taken from the upstream resource in a single
+   * allocation; the conversions then run on the global thread pool, several small images per task.
+   * The images keep the arena as their memory resource: they must not outlive the batch, nor share
+   * their buffer through copy-on-write. One reshaped to another size allocates from the arena too,
+   * which frees nothing before the batch is destroyed. Copies of the images allocate from the default
+   * resource and are independent of the batch.
+   */
+  template<typename Pixel>
+  class ImageBatch {
+    // One upstream buffer handed out by a monotonic resource.
+    struct Arena {
+      std::pmr::memory_resource* upstream;
+      std::size_t bytes;
+      void* buffer;
+      std::pmr::monotonic_buffer_resource resource;
+
+      Arena(std::pmr::memory_resource* upstream, const std::size_t bytes)
+        : upstream(upstream), bytes(bytes),
+          buffer(bytes == 0 ? nullptr : upstream->allocate(bytes, Image<Pixel>::BufferAlignment)),
+          resource(buffer, bytes, upstream) {}
+
+      Arena(const Arena&) = delete;
+      Arena& operator=(const Arena&) = delete;
+
+      ~Arena() {
+        resource.release();
+        if (buffer != nullptr) upstream->deallocate(buffer, bytes, Image<Pixel>::BufferAlignment);
+      }
+    };
+
+    std::unique_ptr<Arena> arena;      // declared first, so the images are destroyed before it
+    std::vector<Image<Pixel>> images;
+
+  public:
+    using value_type = Image<Pixel>;
+    using iterator = typename std::vector<Image<Pixel>>::iterator;
+    using const_iterator = typename std::vector<Image<Pixel>>::const_iterator;
+
+    /**
+     * Convert every image of a range to `Pixel`.
+     * @param sources a range of `Image`, `ConstImageView`, `ImageView` or pointers to them, of one source pixel type
+     * @param alignment the padding of the rows of the converted images
+     * @param upstream the memory resource of the arena
+     */
+    template<typename Range>
+    explicit ImageBatch(const Range& sources, const RowAlignment alignment = RowAlignment::Packed,
+                        std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) {
+      using std::begin;
+      using std::end;
+      using View = decltype(detail::batchSource(*begin(sources)));
+
+      std::vector<View> views;
+      std::size_t bytes = 0;
+      constexpr std::size_t bufferAlignment = Image<Pixel>::BufferAlignment;
+      for (auto it = begin(sources); it != end(sources); ++it) {
+        views.push_back(detail::batchSource(*it));
+        const std::size_t imageBytes = Image<Pixel>::bufferBytes(views.back().getWidth(), views.back().getHeight(), alignment);
+        bytes += (imageBytes + bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+      }
+
+      // Buffers are carved serially, the monotonic resource is not thread-safe.
+      arena = std::make_unique<Arena>(upstream, bytes);
+      images.reserve(views.size());
+      std::size_t samples = 0;
+      for (const auto& view : views) {
+        images.emplace_back(view.getWidth(), view.getHeight(), uninitialized, alignment, &arena->resource);
+        samples += view.getWidth() * view.getHeight() * Pixel::PlaneCount;
+      }
+
+      // Images are dealt to the pool like rows, a task gathering enough of them to be worth it.
+      parallelRows(images.size(), images.empty() ? 0 : samples / images.size(),
+                   [&](const std::size_t first, const std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+          convert(views[i], images[i].view());
+        }
+      });
+    }
+
+    ImageBatch(ImageBatch&&) noexcept = default;
+
+    // The images are replaced before the arena they were allocated from is freed.
+    ImageBatch& operator=(ImageBatch&& other) noexcept {
+      images = std::move(other.images);
+      arena = std::move(other.arena);
+      return *this;
+    }
+
+    // Get the number of images
+    [[nodiscard]] std::size_t size() const
+    { return images.size(); }
+
+    [[nodiscard]] bool empty() const
+    { return images.empty(); }
+
+    // Get the size of the arena holding the buffers of the images, in bytes
+    [[nodiscard]] std::size_t getArenaBytes() const
+    { return arena ? arena->bytes : 0; }
+
+    Image<Pixel>& operator[](const std::size_t index)
+    { return images[index]; }
+
+    const Image<Pixel>& operator[](const std::size_t index) const
+    { return images[index]; }
+
+    iterator begin() { return images.begin(); }
+    iterator end() { return images.end(); }
+    const_iterator begin() const { return images.begin(); }
+    const_iterator end() const { return images.end(); }
+  };
+}
+
+#endif // IMG_IMAGE_BATCH_H
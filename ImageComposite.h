@@ -0,0 +1,251 @@
+#ifndef IMG_IMAGE_COMPOSITE_H
+#define IMG_IMAGE_COMPOSITE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  /**
+   * Blend modes of `composite`, on samples premultiplied by their alpha (s the source, d the destination):
+   *   Over:     o = s + d (1 - as), the Porter-Duff source over destination
+   *   Add:      o = min(s + d, 1)
+   *   Multiply: o = s d + s (1 - ad) + d (1 - as), the product where both layers cover each other
+   * The alpha of the result follows the same formula.
+   */
+  enum class BlendMode { Over, Add, Multiply };
+
+  // How the color samples of the images relate to their alpha.
+  enum class AlphaMode {
+    Straight,      // independent of the alpha
+    Premultiplied  // already multiplied by the alpha
+  };
+
+  namespace detail {
+    template<typename SrcPixel, typename DstPixel>
+    void convertSpan(const typename SrcPixel::DataType* src, const std::size_t srcPlaneStride,
+                     typename DstPixel::DataType* dst, const std::size_t dstPlaneStride, const std::size_t count) {
+      if constexpr (isPlanar<SrcPixel> || isPlanar<DstPixel>) {
+        convertRowPlanar<SrcPixel, DstPixel>(src, srcPlaneStride, dst, dstPlaneStride, count);
+      } else {
+        convertRow<SrcPixel, DstPixel>(src, dst, count);
+      }
+    }
+
+    template<typename Pixel>
+    constexpr bool storesBlueFirst() {
+      if constexpr (PixelLayout<Pixel>::Known) {
+        return !PixelLayout<Pixel>::Gray && PixelLayout<Pixel>::Red == 2;
+      } else {
+        return false;
+      }
+    }
+
+    /**
+     * Pixels the blending works on for a destination: 8 bit RGBA, or BGRA for destinations stored
+     * blue first, which the SIMD kernels composite directly; RGBA in floating point for the other sample types.
+     */
+    template<typename Pixel>
+    using BlendPixel = std::conditional_t<
+      std::is_same_v<typename Pixel::DataType, std::uint8_t>,
+      std::conditional_t<storesBlueFirst<Pixel>(),
+                         PixelBGRA<std::uint8_t>, PixelRGBA<std::uint8_t>>,
+      PixelRGBA<std::conditional_t<std::is_same_v<typename Pixel::DataType, double>, double, float>>>;
+
+    // `simd::blendRowScalar` in floating point, samples in [0, 1], without rounding.
+    template<typename T>
+    void blendRowFloat(const T* src, T* dst, const std::size_t count, const BlendMode mode, const bool premultiplied) {
+      const auto blend = [mode](const T s, const T d, const T as, const T ad) {
+        switch (mode) {
+          case BlendMode::Over: return std::min<T>(s + d * (1 - as), 1);
+          case BlendMode::Add: return std::min<T>(s + d, 1);
+          default: return std::min<T>(s * d + s * (1 - ad) + d * (1 - as), 1);
+        }
+      };
+      for (std::size_t i = 0; i < count; ++i, src += 4, dst += 4) {
+        const T as = src[3], ad = dst[3];
+        const T ao = blend(as, ad, as, ad);
+        for (int channel = 0; channel < 3; ++channel) {
+          const T s = premultiplied ? src[channel] : src[channel] * as;
+          const T d = premultiplied ? dst[channel] : dst[channel] * ad;
+          const T o = blend(s, d, as, ad);
+          dst[channel] = premultiplied ? o : ao > 0 ? std::min<T>(o / ao, 1) : T{0};
+        }
+        dst[3] = ao;
+      }
+    }
+  }
+
+  /**
+   * Composite the pixels of `src` onto `dst`, the top left corner of `src` at (`x`, `y`) in `dst`:
+   * the part of `src` outside of `dst` is ignored, as are negative offsets. Any pair of pixel types
+   * works; pixels without alpha are opaque, and keep the color of the result.
+   *
+   * 8 bit destinations are blended in RGBA (or BGRA) by the SIMD kernels of `ImageSimd.h`, products
+   * divided by 255 with exact rounding; the others in floating point. Sources and destinations of
+   * another type are converted row by row through a buffer, with the conversion engine, and only the
+   * pixels the blend changes are converted back. The rows are split on the global thread pool.
+   * @param src the layer to composite
+   * @param dst the pixels to composite onto
+   * @param x the column of `dst` under the first column of `src`
+   * @param y the row of `dst` under the first row of `src`
+   * @param mode the blend mode
+   * @param alpha whether both images hold straight or premultiplied samples
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void composite(const ConstImageView<SrcPixel>& src, const ImageView<DstPixel>& dst, const std::ptrdiff_t x = 0,
+                 const std::ptrdiff_t y = 0, const BlendMode mode = BlendMode::Over, const AlphaMode alpha = AlphaMode::Straight) {
+    using Work = detail::BlendPixel<DstPixel>;
+    using WorkT = typename Work::DataType;
+    constexpr bool directSrc = std::is_same_v<SrcPixel, Work>;
+    constexpr bool directDst = std::is_same_v<DstPixel, Work>;
+
+    // Overlap of the layer and the destination, in destination coordinates.
+    const auto dstWidth = static_cast<std::ptrdiff_t>(dst.getWidth());
+    const auto dstHeight = static_cast<std::ptrdiff_t>(dst.getHeight());
+    const std::ptrdiff_t left = std::max<std::ptrdiff_t>(x, 0);
+    const std::ptrdiff_t top = std::max<std::ptrdiff_t>(y, 0);
+    const std::ptrdiff_t right = std::min(x + static_cast<std::ptrdiff_t>(src.getWidth()), dstWidth);
+    const std::ptrdiff_t bottom = std::min(y + static_cast<std::ptrdiff_t>(src.getHeight()), dstHeight);
+    if (left >= right || top >= bottom) return;
+    const auto width = static_cast<std::size_t>(right - left);
+    const auto srcCol = static_cast<std::size_t>(left - x);
+    const auto dstCol = static_cast<std::size_t>(left);
+    const bool premultiplied = alpha == AlphaMode::Premultiplied;
+
+    parallelRows(static_cast<std::size_t>(bottom - top), width * 4, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      std::vector<WorkT> srcBuffer(directSrc ? 0 : width * 4);
+      std::vector<WorkT> dstBuffer(directDst ? 0 : width * 4);
+      std::vector<WorkT> original(directDst ? 0 : width * 4);
+      for (std::size_t row = firstRow; row < lastRow; ++row) {
+        const auto* const in = src.getRow(static_cast<std::size_t>(top - y) + row) + srcCol * pixelStep<SrcPixel>;
+        auto* const out = dst.getRow(static_cast<std::size_t>(top) + row) + dstCol * pixelStep<DstPixel>;
+
+        const WorkT* layer = nullptr;
+        if constexpr (directSrc) {
+          layer = in;
+        } else {
+          detail::convertSpan<SrcPixel, Work>(in, src.getPlaneStride(), srcBuffer.data(), 1, width);
+          layer = srcBuffer.data();
+        }
+        WorkT* target = nullptr;
+        if constexpr (directDst) {
+          target = out;
+        } else {
+          detail::convertSpan<DstPixel, Work>(out, dst.getPlaneStride(), dstBuffer.data(), 1, width);
+          std::copy(dstBuffer.begin(), dstBuffer.end(), original.begin());
+          target = dstBuffer.data();
+        }
+
+        if constexpr (std::is_same_v<WorkT, std::uint8_t>) {
+          simd::blendRow(layer, target, width, static_cast<simd::Blend>(mode), premultiplied);
+        } else {
+          detail::blendRowFloat(layer, target, width, mode, premultiplied);
+        }
+
+        if constexpr (!directDst) {
+          // Only the runs of pixels the blend changed go back: the round trip is not exact for every
+          // pixel type (gray through RGBA), and pixels under a transparent layer keep their samples.
+          const auto changed = [&](const std::size_t i) {
+            return !std::equal(target + i * 4, target + i * 4 + 4, original.data() + i * 4);
+          };
+          for (std::size_t begin = 0; begin < width;) {
+            while (begin < width && !changed(begin)) ++begin;
+            std::size_t end = begin;
+            while (end < width && changed(end)) ++end;
+            if (end > begin) {
+              detail::convertSpan<Work, DstPixel>(target + begin * 4, 1, out + begin * pixelStep<DstPixel>,
+                                                  dst.getPlaneStride(), end - begin);
+            }
+            begin = end;
+          }
+        }
+      }
+    });
+  }
+
+  /**
+   * Composite an image onto another, see the overload above.
+   */
+  template<typename SrcPixel, typename DstPixel>
+  void composite(const Image<SrcPixel>& src, Image<DstPixel>& dst, const std::ptrdiff_t x = 0, const std::ptrdiff_t y = 0,
+                 const BlendMode mode = BlendMode::Over, const AlphaMode alpha = AlphaMode::Straight) {
+    composite(src.view(), dst.view(), x, y, mode, alpha);
+  }
+
+  /**
+   * Multiply the color samples of an image by its alpha, in place: 8 bit samples are rounded like the
+   * compositing kernels.
+   * @param image the pixels, with straight samples
+   */
+  template<typename Pixel>
+  void premultiply(const ImageView<Pixel>& image) {
+    using T = typename Pixel::DataType;
+    static_assert(PixelLayout<Pixel>::Known && PixelLayout<Pixel>::Alpha >= 0, "premultiply needs pixels with alpha");
+    constexpr std::size_t step = pixelStep<Pixel>;
+    constexpr int planes[3] = {PixelLayout<Pixel>::Red, PixelLayout<Pixel>::Green, PixelLayout<Pixel>::Blue};
+    const std::size_t planeStride = isPlanar<Pixel> ? image.getPlaneStride() : 1;
+    parallelRows(image.getHeight(), image.getWidth() * 4, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      for (std::size_t row = firstRow; row < lastRow; ++row) {
+        T* const data = image.getRow(row);
+        const T* const alpha = data + PixelLayout<Pixel>::Alpha * planeStride;
+        for (const int plane : planes) {
+          T* const samples = data + plane * planeStride;
+          for (std::size_t i = 0; i < image.getWidth(); ++i) {
+            if constexpr (std::is_same_v<T, std::uint8_t>) {
+              samples[i * step] = static_cast<T>(simd::div255(samples[i * step] * alpha[i * step]));
+            } else if constexpr (std::is_floating_point_v<T>) {
+              samples[i * step] *= alpha[i * step];
+            } else {
+              samples[i * step] = static_cast<T>(static_cast<double>(samples[i * step]) * alpha[i * step] / Pixel::Max + 0.5);
+            }
+          }
+        }
+      }
+    });
+  }
+
+  /**
+   * Divide the color samples of an image by its alpha, in place, the inverse of `premultiply` up to
+   * rounding. Transparent pixels become black.
+   * @param image the pixels, with premultiplied samples
+   */
+  template<typename Pixel>
+  void unpremultiply(const ImageView<Pixel>& image) {
+    using T = typename Pixel::DataType;
+    static_assert(PixelLayout<Pixel>::Known && PixelLayout<Pixel>::Alpha >= 0, "unpremultiply needs pixels with alpha");
+    constexpr std::size_t step = pixelStep<Pixel>;
+    constexpr int planes[3] = {PixelLayout<Pixel>::Red, PixelLayout<Pixel>::Green, PixelLayout<Pixel>::Blue};
+    const std::size_t planeStride = isPlanar<Pixel> ? image.getPlaneStride() : 1;
+    parallelRows(image.getHeight(), image.getWidth() * 4, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      for (std::size_t row = firstRow; row < lastRow; ++row) {
+        T* const data = image.getRow(row);
+        const T* const alpha = data + PixelLayout<Pixel>::Alpha * planeStride;
+        for (const int plane : planes) {
+          T* const samples = data + plane * planeStride;
+          for (std::size_t i = 0; i < image.getWidth(); ++i) {
+            const T a = alpha[i * step];
+            T& sample = samples[i * step];
+            if (a == 0) {
+              sample = T{0};
+            } else if constexpr (std::is_floating_point_v<T>) {
+              sample = std::min<T>(sample / a, 1);
+            } else {
+              // round(sample * max / a), like the straight results of the compositing kernels for 8 bit samples.
+              const double value = std::floor((static_cast<double>(sample) * Pixel::Max + a / 2) / a);
+              sample = static_cast<T>(std::min<double>(value, Pixel::Max));
+            }
+          }
+        }
+      }
+    });
+  }
+}
+
+#endif // IMG_IMAGE_COMPOSITE_H
@@ -0,0 +1,228 @@
+#ifndef IMG_IMAGE_EXPR_H
+#define IMG_IMAGE_EXPR_H
+
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Image.h"
+
+namespace img {
+
+  namespace detail {
+    // `cross_product` for the scalar loops of the expressions: an 8-bit source always reads its table,
+    // cheaper than the division of a floating point target when the loop is not vectorized.
+    template<typename TargetT, typename SourceT>
+    constexpr TargetT convertChannel(const SourceT value) {
+      if constexpr (std::is_integral_v<SourceT> && sizeof(SourceT) == 1 && !std::is_same_v<SourceT, TargetT>) {
+        return crossProductTable<TargetT, SourceT>.values[static_cast<int>(value) - std::numeric_limits<SourceT>::min()];
+      } else {
+        return cross_product<TargetT>(value);
+      }
+    }
+  }
+
+  /**
+   * Write a color into a pixel of another type, the way the conversion engine does when an image is
+   * converted to `Pixel`: every channel through `cross_product`, then `toRaw`. From the same
+   * `std::uint8_t` or `float` color, gray is the luminance of the vectorized kernels.
+   * @tparam Pixel the target Pixel type
+   * @param data the first sample of the pixel
+   * @param planeStride the distance between two planes, ignored by interleaved pixels
+   * @param color the color to write
+   */
+  template<typename Pixel, typename T>
+  constexpr void storeColor(typename Pixel::DataType* data, const std::size_t planeStride, const Color<T>& color) {
+    using DstT = typename Pixel::DataType;
+    if constexpr (PixelLayout<Pixel>::Known && PixelLayout<Pixel>::Gray && std::is_same_v<T, DstT>
+                  && (std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>)) {
+      if constexpr (std::is_same_v<T, std::uint8_t>) {
+        data[0] = simd::luma8(color.red, color.green, color.blue);
+      } else {
+        data[0] = simd::lumaFloat(color.red, color.green, color.blue);
+      }
+    } else {
+      storePixel<Pixel>(data, planeStride, Color<DstT>{
+        detail::convertChannel<DstT>(color.red),
+        detail::convertChannel<DstT>(color.green),
+        detail::convertChannel<DstT>(color.blue),
+        detail::convertChannel<DstT>(color.alpha)
+      });
+    }
+  }
+
+  /**
+   * Convert a color to what a pixel of type `Pixel` holds (a gray pixel keeps the luminance, a pixel
+   * without alpha makes the color opaque), with a round trip through `storeColor` and `loadPixel`.
+   * @tparam Pixel the target Pixel type
+   * @param color the color to convert
+   */
+  template<typename Pixel, typename T>
+  constexpr Color<typename Pixel::DataType> convertColor(const Color<T>& color) {
+    typename Pixel::DataType raw[Pixel::PlaneCount]{};
+    storeColor<Pixel>(raw, 1, color);
+    Color<typename Pixel::DataType> converted{};
+    loadPixel<Pixel>(converted, raw, 1);
+    return converted;
+  }
+
+  /**
+   * Base of the lazy pixel expressions: a recipe giving the color of every pixel of a `width` x `height`
+   * image, computed only when the expression is evaluated into an image. Composed expressions are
+   * plain nested objects, so the evaluation is a single loop over the pixels where every step is
+   * inlined, without intermediate images.
+   *
+   * An expression reads the images it was built from when it is evaluated: they must still exist.
+   * @tparam Derived the expression type, providing `DataType`, `getWidth()`, `getHeight()` and
+   * `Color<DataType> operator()(std::size_t col, std::size_t row) const`
+   */
+  template<typename Derived>
+  class PixelExpr {
+    [[nodiscard]] const Derived& self() const
+    { return static_cast<const Derived&>(*this); }
+
+  public:
+    /**
+     * Convert the colors to `Pixel`, like the converting constructor of `Image<Pixel>` would.
+     * @tparam Pixel the Pixel type of the step
+     */
+    template<typename Pixel>
+    auto to() const;
+
+    /**
+     * Apply a function to every color.
+     * @param function callable as `Color<U> function(const Color<DataType>&)`
+     */
+    template<typename Function>
+    auto map(Function function) const;
+
+    /**
+     * Evaluate the expression into the pixels of a view, in one pass.
+     * The rows are split on the global thread pool like the other whole-image operations.
+     * @param dst the destination, of the size of the expression
+     * @throws std::invalid_argument if the sizes differ
+     */
+    template<typename Pixel>
+    void evaluateInto(const ImageView<Pixel>& dst) const {
+      const Derived& expr = self();
+      if (expr.getWidth() != dst.getWidth() || expr.getHeight() != dst.getHeight()) {
+        throw std::invalid_argument("img::PixelExpr: the expression and the destination sizes differ");
+      }
+      const std::size_t width = dst.getWidth();
+      const std::size_t planeStride = dst.getPlaneStride();
+      parallelRows(dst.getHeight(), width * Pixel::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+        for (std::size_t row = firstRow; row < lastRow; ++row) {
+          typename Pixel::DataType* out = dst.getRow(row);
+          for (std::size_t col = 0; col < width; ++col, out += pixelStep<Pixel>) {
+            storeColor<Pixel>(out, planeStride, expr(col, row));
+          }
+        }
+      });
+    }
+
+    // Evaluate the expression into a new image: `img::Image<Pixel> image = expr;`
+    template<typename Pixel>
+    operator Image<Pixel>() const {
+      Image<Pixel> image(self().getWidth(), self().getHeight(), uninitialized);
+      evaluateInto(image.view());
+      return image;
+    }
+  };
+
+  // Leaf expression reading the pixels of a view.
+  template<typename Pixel>
+  class SourceExpr : public PixelExpr<SourceExpr<Pixel>> {
+    ConstImageView<Pixel> source;
+
+  public:
+    using DataType = typename Pixel::DataType;
+
+    explicit SourceExpr(const ConstImageView<Pixel>& source) : source(source) {}
+
+    [[nodiscard]] std::size_t getWidth() const
+    { return source.getWidth(); }
+
+    [[nodiscard]] std::size_t getHeight() const
+    { return source.getHeight(); }
+
+    Color<DataType> operator()(const std::size_t col, const std::size_t row) const {
+      Color<DataType> color{};
+      loadPixel<Pixel>(color, source.getRow(row) + col * pixelStep<Pixel>, source.getPlaneStride());
+      return color;
+    }
+  };
+
+  // Expression converting the colors of another one to `Pixel`.
+  template<typename Inner, typename Pixel>
+  class ConvertExpr : public PixelExpr<ConvertExpr<Inner, Pixel>> {
+    Inner inner;
+
+  public:
+    using DataType = typename Pixel::DataType;
+
+    explicit ConvertExpr(const Inner& inner) : inner(inner) {}
+
+    [[nodiscard]] std::size_t getWidth() const
+    { return inner.getWidth(); }
+
+    [[nodiscard]] std::size_t getHeight() const
+    { return inner.getHeight(); }
+
+    Color<DataType> operator()(const std::size_t col, const std::size_t row) const
+    { return convertColor<Pixel>(inner(col, row)); }
+  };
+
+  // Expression applying a function to the colors of another one.
+  template<typename Inner, typename Function>
+  class MapExpr : public PixelExpr<MapExpr<Inner, Function>> {
+    using Result = std::invoke_result_t<const Function&, const Color<typename Inner::DataType>&>;
+
+    Inner inner;
+    Function function;
+
+  public:
+    using DataType = decltype(std::declval<Result>().red);
+    static_assert(std::is_same_v<Result, Color<DataType>>, "img::PixelExpr::map: the function must return a Color");
+
+    MapExpr(const Inner& inner, Function function) : inner(inner), function(std::move(function)) {}
+
+    [[nodiscard]] std::size_t getWidth() const
+    { return inner.getWidth(); }
+
+    [[nodiscard]] std::size_t getHeight() const
+    { return inner.getHeight(); }
+
+    Color<DataType> operator()(const std::size_t col, const std::size_t row) const
+    { return function(inner(col, row)); }
+  };
+
+  template<typename Derived>
+  template<typename Pixel>
+  auto PixelExpr<Derived>::to() const {
+    return ConvertExpr<Derived, Pixel>(self());
+  }
+
+  template<typename Derived>
+  template<typename Function>
+  auto PixelExpr<Derived>::map(Function function) const {
+    return MapExpr<Derived, Function>(self(), std::move(function));
+  }
+
+  /**
+   * Start a lazy expression from the pixels of a view (or an image, which must outlive the expression).
+   * Ex: `img::ImageGray gray = img::lazy(rgb).to<img::PixelRGBA<float>>().map(exposure);`
+   */
+  template<typename Pixel>
+  SourceExpr<Pixel> lazy(const ConstImageView<Pixel>& source) {
+    return SourceExpr<Pixel>(source);
+  }
+
+  template<typename Pixel>
+  SourceExpr<Pixel> lazy(const Image<Pixel>& source) {
+    return SourceExpr<Pixel>(source.view());
+  }
+}
+
+#endif // IMG_IMAGE_EXPR_H
@@ -0,0 +1,561 @@
+#ifndef IMG_IMAGE_FILTER_H
+#define IMG_IMAGE_FILTER_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Image.h"
+#include "ImageResize.h"
+
+namespace img {
+
+  // Samples read outside of the image by the filters.
+  enum class Border {
+    Clamp,   // the nearest edge pixel: aaa|abc
+    Mirror,  // reflected about the edge pixel: cb|abc
+    Wrap,    // from the opposite edge, the image tiled: bc|abc
+    Zero     // zero samples
+  };
+
+  /**
+   * Weights of a convolution, `getWidth()` x `getHeight()`, centered on the pixel (`getWidth() / 2`,
+   * `getHeight() / 2`) of the kernel. Kernels built from a horizontal and a vertical factor keep them,
+   * so `convolve` runs two 1D passes instead of a 2D one.
+   */
+  class Kernel {
+  public:
+    /**
+     * A 2D kernel.
+     * @param width the number of columns
+     * @param height the number of rows
+     * @param weights the weights, row by row
+     * @throws std::invalid_argument if the kernel is empty or `weights` does not hold `width * height` weights
+     */
+    Kernel(const std::size_t width, const std::size_t height, std::vector<float> weights)
+      : width(width), height(height), weights(std::move(weights)) {
+      if (width == 0 || height == 0 || this->weights.size() != width * height) {
+        throw std::invalid_argument("img::Kernel: the weights do not match the size of the kernel");
+      }
+    }
+
+    /**
+     * A separable kernel, the product of a row and a column of weights.
+     * @param horizontal the weights of the row
+     * @param vertical the weights of the column
+     * @throws std::invalid_argument if a factor is empty
+     */
+    static Kernel separable(std::vector<float> horizontal, std::vector<float> vertical) {
+      if (horizontal.empty() || vertical.empty()) {
+        throw std::invalid_argument("img::Kernel: empty separable factor");
+      }
+      std::vector<float> weights(horizontal.size() * vertical.size());
+      for (std::size_t row = 0; row < vertical.size(); ++row) {
+        for (std::size_t col = 0; col < horizontal.size(); ++col) weights[row * horizontal.size() + col] = vertical[row] * horizontal[col];
+      }
+      Kernel kernel(horizontal.size(), vertical.size(), std::move(weights));
+      kernel.horizontal = std::move(horizontal);
+      kernel.vertical = std::move(vertical);
+      return kernel;
+    }
+
+    /**
+     * The mean of the (2 `radius` + 1)^2 pixels around each pixel.
+     */
+    static Kernel box(const std::size_t radius) {
+      const std::vector<float> factor(2 * radius + 1, 1.0f / static_cast<float>(2 * radius + 1));
+      return separable(factor, factor);
+    }
+
+    /**
+     * A sampled Gaussian, normalized to a sum of 1.
+     * @param sigma the standard deviation, in pixels
+     * @param radius the half width of the kernel, 0 for ceil(3 `sigma`)
+     * @throws std::invalid_argument if `sigma` is not positive
+     */
+    static Kernel gaussian(const double sigma, std::size_t radius = 0) {
+      if (!(sigma > 0)) {
+        throw std::invalid_argument("img::Kernel: the standard deviation of a Gaussian must be positive");
+      }
+      if (radius == 0) radius = static_cast<std::size_t>(std::ceil(3 * sigma));
+      std::vector<double> values(2 * radius + 1);
+      double total = 0;
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        const double x = static_cast<double>(i) - static_cast<double>(radius);
+        values[i] = std::exp(-x * x / (2 * sigma * sigma));
+        total += values[i];
+      }
+      std::vector<float> factor(values.size());
+      for (std::size_t i = 0; i < values.size(); ++i) factor[i] = static_cast<float>(values[i] / total);
+      return separable(factor, factor);
+    }
+
+    std::size_t getWidth() const
+    { return width; }
+
+    std::size_t getHeight() const
+    { return height; }
+
+    // The weight applied to the pixel at (`col` - `getWidth() / 2`, `row` - `getHeight() / 2`) from the output pixel.
+    float getWeight(const std::size_t col, const std::size_t row) const
+    { return weights[row * width + col]; }
+
+    bool isSeparable() const
+    { return !horizontal.empty(); }
+
+    // The factors of a separable kernel, empty otherwise.
+    const std::vector<float>& getHorizontal() const
+    { return horizontal; }
+
+    const std::vector<float>& getVertical() const
+    { return vertical; }
+
+  private:
+    std::size_t width;
+    std::size_t height;
+    std::vector<float> weights;
+    std::vector<float> horizontal;
+    std::vector<float> vertical;
+  };
+
+  namespace detail {
+    // The index read for the sample `i` of an axis of `size` samples, -1 for a zero sample.
+    inline std::ptrdiff_t borderIndex(std::ptrdiff_t i, const std::ptrdiff_t size, const Border border) {
+      if (i >= 0 && i < size) return i;
+      switch (border) {
+        case Border::Clamp:
+          return i < 0 ? 0 : size - 1;
+        case Border::Mirror: {
+          if (size == 1) return 0;
+          const std::ptrdiff_t period = 2 * (size - 1);
+          i %= period;
+          if (i < 0) i += period;
+          return i < size ? i : period - i;
+        }
+        case Border::Wrap:
+          i %= size;
+          return i < 0 ? i + size : i;
+        default:
+          return -1;
+      }
+    }
+
+    /**
+     * Fill the borders of a row of `width` pixels of `channels` samples, stored from `padded + left * channels`:
+     * `left` pixels before it and `right` after it.
+     */
+    template<typename S>
+    void padRow(S* padded, const std::size_t width, const int channels, const std::size_t left, const std::size_t right,
+                const Border border) {
+      const auto step = static_cast<std::size_t>(channels);
+      const S* const row = padded + left * step;
+      const auto size = static_cast<std::ptrdiff_t>(width);
+      const auto fill = [&](const std::ptrdiff_t col) {
+        S* const out = padded + static_cast<std::size_t>(col + static_cast<std::ptrdiff_t>(left)) * step;
+        const std::ptrdiff_t index = borderIndex(col, size, border);
+        for (std::size_t channel = 0; channel < step; ++channel) {
+          out[channel] = index < 0 ? S{} : row[static_cast<std::size_t>(index) * step + channel];
+        }
+      };
+      for (std::ptrdiff_t col = -static_cast<std::ptrdiff_t>(left); col < 0; ++col) fill(col);
+      for (std::ptrdiff_t col = size; col < size + static_cast<std::ptrdiff_t>(right); ++col) fill(col);
+    }
+
+    // The input rows read for the output row `row`, `zeros` for the rows of zero samples.
+    template<typename T>
+    void borderRows(const T* src, const std::size_t srcStride, const std::size_t height, const std::size_t row,
+                    const std::size_t taps, const std::size_t center, const Border border, const T* zeros, const T** rows) {
+      for (std::size_t k = 0; k < taps; ++k) {
+        const std::ptrdiff_t index = borderIndex(static_cast<std::ptrdiff_t>(row + k) - static_cast<std::ptrdiff_t>(center),
+                                                 static_cast<std::ptrdiff_t>(height), border);
+        rows[k] = index < 0 ? zeros : src + static_cast<std::size_t>(index) * srcStride;
+      }
+    }
+
+    /**
+     * Weights in fixed point scaled by 2^14 for the kernels of `simd::resampleColumns`, the rounding
+     * error moved to the largest weight so they keep their sum. Empty if a weight is negative or their
+     * sum in fixed point is above `maxSum`: 1 << 14 for the vertical pass, whose 8 bit rows would clamp.
+     */
+    inline std::vector<std::int16_t> fixedWeights(const std::vector<float>& weights, const long maxSum) {
+      std::vector<std::int16_t> result(weights.size());
+      double total = 0;
+      long sum = 0;
+      std::size_t largest = 0;
+      for (std::size_t k = 0; k < weights.size(); ++k) {
+        if (!(weights[k] >= 0 && weights[k] < 1.5f)) return {};
+        result[k] = static_cast<std::int16_t>(std::lround(weights[k] * (1 << 14)));
+        total += weights[k];
+        sum += result[k];
+        if (weights[k] > weights[largest]) largest = k;
+      }
+      const long target = std::lround(total * (1 << 14));
+      if (target > maxSum || result[largest] + target - sum > std::numeric_limits<std::int16_t>::max()) return {};
+      result[largest] = static_cast<std::int16_t>(result[largest] + target - sum);
+      return result;
+    }
+
+    // Separable convolution of 8 bit samples: a vertical then a horizontal pass, in fixed point with the SIMD kernels.
+    inline void convolveSeparableFixed(const std::uint8_t* src, const std::size_t srcStride, std::uint8_t* dst,
+                                       const std::size_t dstStride, const std::size_t width, const std::size_t height,
+                                       const int channels, const std::vector<std::int16_t>& horizontal,
+                                       const std::vector<std::int16_t>& vertical, const Border border) {
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t left = horizontal.size() / 2, right = horizontal.size() - 1 - left;
+      const std::size_t rowSamples = width * step;
+      parallelRows(height, rowSamples * (horizontal.size() + vertical.size()), [&](const std::size_t first, const std::size_t last) {
+        const std::vector<std::uint8_t> zeros(rowSamples);
+        std::vector<std::uint8_t> padded((left + width + right) * step);
+        std::vector<const std::uint8_t*> rows(vertical.size());
+        std::vector<const std::uint8_t*> cols(horizontal.size());
+        // The horizontal taps are the padded row shifted by one pixel each.
+        for (std::size_t k = 0; k < horizontal.size(); ++k) cols[k] = padded.data() + k * step;
+        for (std::size_t row = first; row < last; ++row) {
+          borderRows(src, srcStride, height, row, vertical.size(), vertical.size() / 2, border, zeros.data(), rows.data());
+          simd::resampleColumns(rows.data(), vertical.data(), vertical.size(), padded.data() + left * step, rowSamples);
+          padRow(padded.data(), width, channels, left, right, border);
+          simd::resampleColumns(cols.data(), horizontal.data(), horizontal.size(), dst + row * dstStride, rowSamples);
+        }
+      });
+    }
+
+    // Separable convolution in floating point, `W` the type of the sums.
+    template<typename T, typename W>
+    void convolveSeparableFloat(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                                const std::size_t width, const std::size_t height, const int channels,
+                                const std::vector<W>& horizontal, const std::vector<W>& vertical, const Border border) {
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t left = horizontal.size() / 2, right = horizontal.size() - 1 - left;
+      const std::size_t rowSamples = width * step;
+      parallelRows(height, rowSamples * (horizontal.size() + vertical.size()), [&](const std::size_t first, const std::size_t last) {
+        const std::vector<T> zeros(rowSamples);
+        std::vector<W> padded((left + width + right) * step);
+        std::vector<W> sums(rowSamples);
+        std::vector<const T*> rows(vertical.size());
+        W* const middle = padded.data() + left * step;
+        for (std::size_t row = first; row < last; ++row) {
+          borderRows(src, srcStride, height, row, vertical.size(), vertical.size() / 2, border, zeros.data(), rows.data());
+          std::fill(middle, middle + rowSamples, W{});
+          for (std::size_t k = 0; k < vertical.size(); ++k) {
+            const T* const in = rows[k];
+            const W weight = vertical[k];
+            for (std::size_t i = 0; i < rowSamples; ++i) middle[i] += weight * static_cast<W>(in[i]);
+          }
+          padRow(padded.data(), width, channels, left, right, border);
+          std::fill(sums.begin(), sums.end(), W{});
+          for (std::size_t k = 0; k < horizontal.size(); ++k) {
+            const W* const in = padded.data() + k * step;
+            const W weight = horizontal[k];
+            for (std::size_t i = 0; i < rowSamples; ++i) sums[i] += weight * in[i];
+          }
+          T* const out = dst + row * dstStride;
+          for (std::size_t i = 0; i < rowSamples; ++i) out[i] = resampleStore<T>(sums[i]);
+        }
+      });
+    }
+
+    // 2D convolution in floating point: every input row of the kernel padded once, then one pass per weight.
+    template<typename T, typename W>
+    void convolve2D(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                    const std::size_t width, const std::size_t height, const int channels, const Kernel& kernel,
+                    const Border border) {
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t left = kernel.getWidth() / 2, right = kernel.getWidth() - 1 - left;
+      const std::size_t rowSamples = width * step;
+      parallelRows(height, rowSamples * kernel.getWidth() * kernel.getHeight(), [&](const std::size_t first, const std::size_t last) {
+        std::vector<W> padded((left + width + right) * step);
+        std::vector<W> sums(rowSamples);
+        W* const middle = padded.data() + left * step;
+        for (std::size_t row = first; row < last; ++row) {
+          std::fill(sums.begin(), sums.end(), W{});
+          for (std::size_t y = 0; y < kernel.getHeight(); ++y) {
+            const std::ptrdiff_t index = borderIndex(static_cast<std::ptrdiff_t>(row + y) - static_cast<std::ptrdiff_t>(kernel.getHeight() / 2),
+                                                     static_cast<std::ptrdiff_t>(height), border);
+            if (index < 0) continue;
+            const T* const in = src + static_cast<std::size_t>(index) * srcStride;
+            for (std::size_t i = 0; i < rowSamples; ++i) middle[i] = static_cast<W>(in[i]);
+            padRow(padded.data(), width, channels, left, right, border);
+            for (std::size_t x = 0; x < kernel.getWidth(); ++x) {
+              const auto weight = static_cast<W>(kernel.getWeight(x, y));
+              if (weight == 0) continue;
+              const W* const shifted = padded.data() + x * step;
+              for (std::size_t i = 0; i < rowSamples; ++i) sums[i] += weight * shifted[i];
+            }
+          }
+          T* const out = dst + row * dstStride;
+          for (std::size_t i = 0; i < rowSamples; ++i) out[i] = resampleStore<T>(sums[i]);
+        }
+      });
+    }
+
+    template<typename T>
+    void convolveChannels(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                          const std::size_t width, const std::size_t height, const int channels, const Kernel& kernel,
+                          const Border border) {
+      using W = std::conditional_t<std::is_same_v<T, double>, double, float>;
+      if (!kernel.isSeparable()) {
+        convolve2D<T, W>(src, srcStride, dst, dstStride, width, height, channels, kernel, border);
+        return;
+      }
+      if constexpr (std::is_same_v<T, std::uint8_t>) {
+        // Only the result of the horizontal pass may saturate, like the float path does.
+        const std::vector<std::int16_t> horizontal = fixedWeights(kernel.getHorizontal(), 3 << 13);
+        const std::vector<std::int16_t> vertical = fixedWeights(kernel.getVertical(), 1 << 14);
+        if (!horizontal.empty() && !vertical.empty()) {
+          convolveSeparableFixed(src, srcStride, dst, dstStride, width, height, channels, horizontal, vertical, border);
+          return;
+        }
+      }
+      const std::vector<W> horizontal(kernel.getHorizontal().begin(), kernel.getHorizontal().end());
+      const std::vector<W> vertical(kernel.getVertical().begin(), kernel.getVertical().end());
+      convolveSeparableFloat<T, W>(src, srcStride, dst, dstStride, width, height, channels, horizontal, vertical, border);
+    }
+
+    /**
+     * Box blur in O(1) per sample: running sums of the columns over the 2 `radius` + 1 rows around the
+     * output row, updated by one row in and one out, then the prefix sums of that row (its summed-area
+     * row), the box of each output pixel the difference of two of them.
+     * @tparam Sum unsigned for integer samples, where the prefix sums may wrap but their differences are exact
+     */
+    template<typename T, typename Sum>
+    void boxBlurChannels(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                         const std::size_t width, const std::size_t height, const int channels, const std::size_t radius,
+                         const Border border) {
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t rowSamples = width * step;
+      const std::size_t window = 2 * radius + 1;
+      const double scale = 1.0 / static_cast<double>(window * window);
+      // Integer sums of signed samples are their two's complement.
+      const auto value = [](const Sum sum) {
+        if constexpr (std::is_signed_v<T> && std::is_integral_v<T>) {
+          return static_cast<double>(static_cast<std::make_signed_t<Sum>>(sum));
+        } else {
+          return static_cast<double>(sum);
+        }
+      };
+      parallelRows(height, rowSamples * 4, [&](const std::size_t first, const std::size_t last) {
+        std::vector<Sum> padded((width + 2 * radius) * step);
+        std::vector<Sum> prefix((width + window) * step);
+        Sum* const columns = padded.data() + radius * step;
+        const auto inputRow = [&](const std::ptrdiff_t row) -> const T* {
+          const std::ptrdiff_t index = borderIndex(row, static_cast<std::ptrdiff_t>(height), border);
+          return index < 0 ? nullptr : src + static_cast<std::size_t>(index) * srcStride;
+        };
+        const auto top = static_cast<std::ptrdiff_t>(first) - static_cast<std::ptrdiff_t>(radius);
+        for (std::size_t k = 0; k < window; ++k) {
+          if (const T* const in = inputRow(top + static_cast<std::ptrdiff_t>(k))) {
+            for (std::size_t i = 0; i < rowSamples; ++i) columns[i] += static_cast<Sum>(in[i]);
+          }
+        }
+
+        for (std::size_t row = first; row < last; ++row) {
+          if (row != first) {
+            // The window moves down one row: the new one in, the oldest out, in a single pass when both are read.
+            const T* const in = inputRow(static_cast<std::ptrdiff_t>(row + radius));
+            const T* const out = inputRow(static_cast<std::ptrdiff_t>(row) - static_cast<std::ptrdiff_t>(radius) - 1);
+            if (in && out) {
+              for (std::size_t i = 0; i < rowSamples; ++i) columns[i] += static_cast<Sum>(in[i]) - static_cast<Sum>(out[i]);
+            } else if (in) {
+              for (std::size_t i = 0; i < rowSamples; ++i) columns[i] += static_cast<Sum>(in[i]);
+            } else if (out) {
+              for (std::size_t i = 0; i < rowSamples; ++i) columns[i] -= static_cast<Sum>(out[i]);
+            }
+          }
+          padRow(padded.data(), width, channels, radius, radius, border);
+          // prefix[i + step] = the sum of padded[channel], padded[channel + step]... up to padded[i].
+          std::fill(prefix.begin(), prefix.begin() + static_cast<std::ptrdiff_t>(step), Sum{});
+          for (std::size_t i = 0; i < padded.size(); ++i) prefix[i + step] = prefix[i] + padded[i];
+          const Sum* const ahead = prefix.data() + window * step;
+          T* const out = dst + row * dstStride;
+          if constexpr (std::is_same_v<T, std::uint8_t> && std::is_same_v<Sum, std::uint32_t>) {
+            simd::boxMeanRow(ahead, prefix.data(), out, rowSamples, static_cast<std::uint32_t>(window * window));
+          } else {
+            for (std::size_t i = 0; i < rowSamples; ++i) out[i] = resampleStore<T>(value(ahead[i] - prefix[i]) * scale);
+          }
+        }
+      });
+    }
+
+    template<typename T>
+    void boxBlurChannels(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                         const std::size_t width, const std::size_t height, const int channels, const std::size_t radius,
+                         const Border border) {
+      if constexpr (std::is_floating_point_v<T>) {
+        boxBlurChannels<T, double>(src, srcStride, dst, dstStride, width, height, channels, radius, border);
+      } else {
+        // 32 bit sums while twice the sum of a box fits their signed range.
+        const double area = static_cast<double>(2 * radius + 1) * static_cast<double>(2 * radius + 1);
+        const double largest = static_cast<double>(std::max<long double>(std::numeric_limits<T>::max(), -static_cast<long double>(std::numeric_limits<T>::min())));
+        if (sizeof(T) <= 2 && area * largest < 1073741824.0) {
+          boxBlurChannels<T, std::uint32_t>(src, srcStride, dst, dstStride, width, height, channels, radius, border);
+        } else {
+          boxBlurChannels<T, std::uint64_t>(src, srcStride, dst, dstStride, width, height, channels, radius, border);
+        }
+      }
+    }
+
+    // Check the arguments of a filter, false if there is nothing to do.
+    template<typename Pixel>
+    bool checkFilterImages(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const char* message) {
+      if (src.getWidth() != dst.getWidth() || src.getHeight() != dst.getHeight()) {
+        throw std::invalid_argument(message);
+      }
+      if (src.getWidth() == 0 || src.getHeight() == 0) return false;
+      // Overlapping views (Ex: two sub-images of one image) would read rows already overwritten.
+      if (src.overlaps(dst)) {
+        throw std::invalid_argument("img: the filters cannot write their result over their source");
+      }
+      return true;
+    }
+
+    // Run `function(src, dst)` on the sample groups of a pixel type, see `resize`.
+    template<typename Pixel, typename Function>
+    void forEachChannelGroup(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const Function& function) {
+      constexpr int groups = isPlanar<Pixel> ? Pixel::PlaneCount : 1;
+      for (int group = 0; group < groups; ++group) {
+        function(src.getData() + (isPlanar<Pixel> ? group * src.getPlaneStride() : 0),
+                 dst.getData() + (isPlanar<Pixel> ? group * dst.getPlaneStride() : 0));
+      }
+    }
+
+    /**
+     * Radii of 3 successive box blurs whose result approximates a Gaussian of deviation `sigma`: the
+     * variance of a box of width w is (w^2 - 1) / 12, so the boxes use the two odd widths around the
+     * ideal one, as many of each as to match sigma^2.
+     */
+    inline std::array<std::size_t, 3> gaussianBoxRadii(const double sigma) {
+      const double ideal = std::sqrt(12 * sigma * sigma / 3 + 1);
+      auto lower = static_cast<long>(std::floor(ideal));
+      if (lower % 2 == 0) --lower;
+      const auto wl = static_cast<double>(lower);
+      const long smaller = std::lround((12 * sigma * sigma - 3 * wl * wl - 12 * wl - 9) / (-4 * wl - 4));
+      std::array<std::size_t, 3> radii{};
+      for (long i = 0; i < 3; ++i) radii[static_cast<std::size_t>(i)] = static_cast<std::size_t>(i < smaller ? (lower - 1) / 2 : (lower + 1) / 2);
+      return radii;
+    }
+  }
+
+  /**
+   * Convolve an image with a kernel: each output sample is the weighted sum of the samples around it,
+   * `kernel.getWeight(x, y)` applied to the pixel at (`col` + x - `kernel.getWidth() / 2`, `row` + y -
+   * `kernel.getHeight() / 2`), samples outside of the image given by `border`. The planes of a pixel are
+   * filtered independently, alpha included.
+   *
+   * Separable kernels run a vertical then a horizontal 1D pass on each row: 8 bit samples with non-negative
+   * weights, a vertical factor summing to at most 1 and a horizontal one to at most 1.5, use fixed point
+   * weights and the vectorized kernels of `ImageSimd.h`, rounding each pass to 8 bits. The other cases, and 2D kernels, sum in `float` (`double` for `double` samples); integer
+   * results are rounded and clamped. Rows are processed in chunks on the global thread pool, each with
+   * its own row buffers.
+   * @param src the source pixels
+   * @param dst the result, of the size of `src`
+   * @param kernel the weights
+   * @param border the samples outside of `src`
+   * @throws std::invalid_argument if the sizes differ or `dst` overlaps `src`
+   */
+  template<typename Pixel>
+  void convolve(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const Kernel& kernel,
+                const Border border = Border::Clamp) {
+    if (!detail::checkFilterImages(src, dst, "img::convolve: the images have different sizes")) return;
+    constexpr int channels = isPlanar<Pixel> ? 1 : Pixel::PlaneCount;
+    detail::forEachChannelGroup(src, dst, [&](const auto* in, auto* out) {
+      detail::convolveChannels(in, src.getStride(), out, dst.getStride(), src.getWidth(), src.getHeight(), channels, kernel, border);
+    });
+  }
+
+  /**
+   * Convolve an image with a kernel, see the overload above.
+   * @return the filtered image
+   */
+  template<typename Pixel>
+  Image<Pixel> convolve(const ConstImageView<Pixel>& src, const Kernel& kernel, const Border border = Border::Clamp) {
+    Image<Pixel> result(src.getWidth(), src.getHeight(), uninitialized);
+    convolve(src, result.view(), kernel, border);
+    return result;
+  }
+
+  template<typename Pixel>
+  Image<Pixel> convolve(const Image<Pixel>& src, const Kernel& kernel, const Border border = Border::Clamp) {
+    return convolve(src.view(), kernel, border);
+  }
+
+  /**
+   * Replace each pixel with the mean of the (2 `radius` + 1)^2 pixels around it, `Kernel::box(radius)`
+   * in constant time per pixel whatever the radius: running sums of the columns, then prefix sums of
+   * each row. Integer sums are exact, and the mean rounded to the nearest sample.
+   * @param src the source pixels
+   * @param dst the result, of the size of `src`
+   * @param radius the half width of the box
+   * @param border the samples outside of `src`
+   * @throws std::invalid_argument if the sizes differ or `dst` overlaps `src`
+   */
+  template<typename Pixel>
+  void boxBlur(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const std::size_t radius,
+               const Border border = Border::Clamp) {
+    if (!detail::checkFilterImages(src, dst, "img::boxBlur: the images have different sizes")) return;
+    constexpr int channels = isPlanar<Pixel> ? 1 : Pixel::PlaneCount;
+    detail::forEachChannelGroup(src, dst, [&](const auto* in, auto* out) {
+      detail::boxBlurChannels(in, src.getStride(), out, dst.getStride(), src.getWidth(), src.getHeight(), channels, radius, border);
+    });
+  }
+
+  template<typename Pixel>
+  Image<Pixel> boxBlur(const ConstImageView<Pixel>& src, const std::size_t radius, const Border border = Border::Clamp) {
+    Image<Pixel> result(src.getWidth(), src.getHeight(), uninitialized);
+    boxBlur(src, result.view(), radius, border);
+    return result;
+  }
+
+  template<typename Pixel>
+  Image<Pixel> boxBlur(const Image<Pixel>& src, const std::size_t radius, const Border border = Border::Clamp) {
+    return boxBlur(src.view(), radius, border);
+  }
+
+  /**
+   * Blur an image with a Gaussian of deviation `sigma`. Small deviations convolve with
+   * `Kernel::gaussian(sigma)`; from `sigma` = 4 its 6 `sigma` + 1 taps cost more than 3 successive box
+   * blurs of matching variance, constant time per pixel and within a few steps of the Gaussian.
+   * @param src the source pixels
+   * @param dst the result, of the size of `src`
+   * @param sigma the standard deviation, in pixels
+   * @param border the samples outside of `src`
+   * @throws std::invalid_argument if the sizes differ, `dst` overlaps `src` or `sigma` is not positive
+   */
+  template<typename Pixel>
+  void gaussianBlur(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const double sigma,
+                    const Border border = Border::Clamp) {
+    if (!(sigma > 0)) {
+      throw std::invalid_argument("img::gaussianBlur: the standard deviation must be positive");
+    }
+    if (!detail::checkFilterImages(src, dst, "img::gaussianBlur: the images have different sizes")) return;
+    if (sigma < 4) {
+      convolve(src, dst, Kernel::gaussian(sigma), border);
+      return;
+    }
+    const auto radii = detail::gaussianBoxRadii(sigma);
+    Image<Pixel> pass(src.getWidth(), src.getHeight(), uninitialized);
+    boxBlur(src, dst, radii[0], border);
+    boxBlur(dst, pass.view(), radii[1], border);
+    boxBlur(pass.view(), dst, radii[2], border);
+  }
+
+  template<typename Pixel>
+  Image<Pixel> gaussianBlur(const ConstImageView<Pixel>& src, const double sigma, const Border border = Border::Clamp) {
+    Image<Pixel> result(src.getWidth(), src.getHeight(), uninitialized);
+    gaussianBlur(src, result.view(), sigma, border);
+    return result;
+  }
+
+  template<typename Pixel>
+  Image<Pixel> gaussianBlur(const Image<Pixel>& src, const double sigma, const Border border = Border::Clamp) {
+    return gaussianBlur(src.view(), sigma, border);
+  }
+}
+
+#endif // IMG_IMAGE_FILTER_H
@@ -0,0 +1,403 @@
+#ifndef IMG_IMAGE_IO_H
+#define IMG_IMAGE_IO_H
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "Image.h"
+
+namespace img {
+
+  /**
+   * Header of a netpbm file: binary PGM (P5), binary PPM (P6) or PAM (P7).
+   * Only 8-bit samples (maxval 255) with 1 (gray), 3 (RGB) or 4 (RGB_ALPHA) planes are supported;
+   * a PAM TUPLTYPE has to agree with its DEPTH.
+   */
+  struct NetpbmHeader {
+    char format{'6'};            // '5', '6' or '7'
+    std::size_t width{0};
+    std::size_t height{0};
+    std::size_t depth{0};        // number of planes
+    std::size_t maxval{0};
+    std::size_t dataOffset{0};   // position of the first sample in the file
+
+    // Number of bytes of the pixel data
+    [[nodiscard]] std::size_t dataSize() const
+    { return width * height * depth; }
+  };
+
+  namespace detail {
+    class NetpbmParser {
+      const char* data;
+      std::size_t size;
+      std::size_t fileSize;
+      std::size_t position{0};
+
+      [[noreturn]] static void fail(const std::string& message) {
+        throw std::runtime_error("netpbm: " + message);
+      }
+
+      static bool isSpace(const char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+      }
+
+      // Skip whitespace and comments, which run from '#' to the end of the line
+      void skipSpace() {
+        while (position < size) {
+          if (data[position] == '#') {
+            while (position < size && data[position] != '\n') ++position;
+          } else if (isSpace(data[position])) {
+            ++position;
+          } else {
+            return;
+          }
+        }
+      }
+
+      std::string token() {
+        skipSpace();
+        const std::size_t begin = position;
+        while (position < size && !isSpace(data[position]) && data[position] != '#') ++position;
+        if (begin == position) fail("truncated header");
+        return std::string(data + begin, position - begin);
+      }
+
+      std::size_t number() {
+        const std::string text = token();
+        std::size_t value = 0;
+        for (const char c : text) {
+          if (c < '0' || c > '9') fail("invalid number '" + text + "'");
+          if (value > (static_cast<std::size_t>(-1) - 9) / 10) fail("number too large '" + text + "'");
+          value = value * 10 + static_cast<std::size_t>(c - '0');
+        }
+        return value;
+      }
+
+      // Skip the end of the line of a PAM header
+      void skipLine() {
+        while (position < size && data[position] != '\n') ++position;
+        if (position < size) ++position;
+      }
+
+      void parsePam(NetpbmHeader& header) {
+        std::string tupleType;
+        while (true) {
+          const std::string key = token();
+          if (key == "ENDHDR") {
+            skipLine();
+            break;
+          }
+          if (key == "WIDTH") header.width = number();
+          else if (key == "HEIGHT") header.height = number();
+          else if (key == "DEPTH") header.depth = number();
+          else if (key == "MAXVAL") header.maxval = number();
+          else if (key == "TUPLTYPE") tupleType = token();
+          else fail("unknown PAM header entry '" + key + "'");
+        }
+        if (tupleType.empty()) return;
+        // The tuple type fixes the number of planes, so it has to agree with DEPTH
+        std::size_t tupleDepth = 0;
+        if (tupleType == "GRAYSCALE") tupleDepth = 1;
+        else if (tupleType == "RGB") tupleDepth = 3;
+        else if (tupleType == "RGB_ALPHA") tupleDepth = 4;
+        else fail("unsupported tuple type '" + tupleType + "'");
+        if (header.depth != tupleDepth) {
+          fail("tuple type " + tupleType + " does not match depth " + std::to_string(header.depth));
+        }
+      }
+
+    public:
+      NetpbmParser(const void* data, const std::size_t size, const std::size_t fileSize)
+        : data(static_cast<const char*>(data)), size(size), fileSize(fileSize) {}
+
+      NetpbmHeader parse() {
+        if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6' && data[1] != '7')) {
+          fail("not a binary PGM, PPM or PAM file");
+        }
+        NetpbmHeader header;
+        header.format = data[1];
+        position = 2;
+        if (header.format == '7') {
+          parsePam(header);
+        } else {
+          header.depth = header.format == '5' ? 1 : 3;
+          header.width = number();
+          header.height = number();
+          header.maxval = number();
+          // Exactly one whitespace character separates the header from the samples
+          if (position >= size || !isSpace(data[position])) fail("truncated header");
+          ++position;
+        }
+        header.dataOffset = position;
+
+        if (header.width == 0 || header.height == 0) fail("empty image");
+        if (header.depth != 1 && header.depth != 3 && header.depth != 4) {
+          fail("unsupported depth " + std::to_string(header.depth));
+        }
+        if (header.maxval != 255) fail("only 8-bit samples (maxval 255) are supported");
+        if (header.width > static_cast<std::size_t>(-1) / header.depth / header.height) fail("image too large");
+        if (header.dataOffset > fileSize || header.dataSize() > fileSize - header.dataOffset) fail("truncated pixel data");
+        return header;
+      }
+    };
+
+    // Close a file descriptor when leaving scope
+    struct FileDescriptor {
+      int fd;
+      explicit FileDescriptor(const int fd) : fd(fd) {}
+      FileDescriptor(const FileDescriptor&) = delete;
+      FileDescriptor& operator=(const FileDescriptor&) = delete;
+      ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+    };
+
+    [[noreturn]] inline void throwErrno(const std::string& what) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    // Pixel type of the samples of a netpbm file with `depth` planes
+    template<typename Function>
+    decltype(auto) withFilePixel(const std::size_t depth, Function&& function) {
+      switch (depth) {
+        case 1: return function(PixelGray<std::uint8_t>{});
+        case 3: return function(PixelRGB<std::uint8_t>{});
+        default: return function(PixelRGBA<std::uint8_t>{});
+      }
+    }
+
+    /**
+     * Write all the buffers of `parts`, retrying on partial writes and in groups of at most IOV_MAX.
+     */
+    inline void writeAll(const int fd, std::vector<iovec>& parts, const std::string& path) {
+      std::size_t first = 0;
+      while (first < parts.size()) {
+        const int count = static_cast<int>(std::min<std::size_t>(parts.size() - first, IOV_MAX));
+        const ssize_t written = ::writev(fd, parts.data() + first, count);
+        if (written < 0) {
+          if (errno == EINTR) continue;
+          throwErrno("writev " + path);
+        }
+        auto remaining = static_cast<std::size_t>(written);
+        while (remaining > 0 && remaining >= parts[first].iov_len) {
+          remaining -= parts[first].iov_len;
+          ++first;
+        }
+        if (remaining > 0) {
+          parts[first].iov_base = static_cast<char*>(parts[first].iov_base) + remaining;
+          parts[first].iov_len -= remaining;
+        }
+        while (first < parts.size() && parts[first].iov_len == 0) ++first;
+      }
+    }
+  }
+
+  /**
+   * Read-only memory mapping of a whole file. Move only; the mapping is removed on destruction.
+   */
+  class MappedFile {
+    void* address{nullptr};
+    std::size_t size{0};
+
+  public:
+    MappedFile() = default;
+
+    /**
+     * Map a file.
+     * @param path the file to map
+     * @throws std::system_error if the file cannot be opened or mapped
+     */
+    explicit MappedFile(const std::string& path) {
+      const detail::FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+      if (file.fd < 0) detail::throwErrno("open " + path);
+      struct stat status{};
+      if (::fstat(file.fd, &status) != 0) detail::throwErrno("fstat " + path);
+      size = static_cast<std::size_t>(status.st_size);
+      if (size == 0) return;
+      address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+      if (address == MAP_FAILED) {
+        address = nullptr;
+        detail::throwErrno("mmap " + path);
+      }
+      ::madvise(address, size, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+      : address(std::exchange(other.address, nullptr)), size(std::exchange(other.size, 0)) {}
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+      if (this != &other) {
+        if (address != nullptr) ::munmap(address, size);
+        address = std::exchange(other.address, nullptr);
+        size = std::exchange(other.size, 0);
+      }
+      return *this;
+    }
+
+    ~MappedFile() {
+      if (address != nullptr) ::munmap(address, size);
+    }
+
+    // Get the first byte of the file
+    [[nodiscard]] const std::uint8_t* getData() const
+    { return static_cast<const std::uint8_t*>(address); }
+
+    // Get the size of the file in bytes
+    [[nodiscard]] std::size_t getSize() const
+    { return size; }
+  };
+
+  /**
+   * Read the header of a netpbm file held in memory.
+   * @param data the first byte of the file
+   * @param size the number of bytes available at `data`, at least the whole header
+   * @param fileSize the size of the whole file, `size` when the whole file is in memory
+   * @throws std::runtime_error if the header is invalid or unsupported, or the pixel data is truncated
+   */
+  inline NetpbmHeader parseNetpbmHeader(const void* data, const std::size_t size, const std::size_t fileSize) {
+    return detail::NetpbmParser(data, size, fileSize).parse();
+  }
+
+  // Read the header of a netpbm file held entirely in memory, see the overload above.
+  inline NetpbmHeader parseNetpbmHeader(const void* data, const std::size_t size) {
+    return parseNetpbmHeader(data, size, size);
+  }
+
+  /**
+   * Netpbm file mapped in memory, whose samples are seen in place through a view: no copy at all.
+   * The pixel type must match the file: `PixelGray<std::uint8_t>` for 1 plane, `PixelRGB<std::uint8_t>`
+   * for 3 and `PixelRGBA<std::uint8_t>` for 4. The view is valid as long as the MappedImage lives.
+   */
+  template<typename Pixel>
+  class MappedImage {
+    MappedFile file;
+    NetpbmHeader header;
+
+  public:
+    /**
+     * Map a netpbm file.
+     * @param path the file to map
+     * @throws std::runtime_error if the file cannot be read or its layout is not `Pixel`
+     */
+    explicit MappedImage(const std::string& path) : file(path) {
+      header = parseNetpbmHeader(file.getData(), file.getSize());
+      const bool matches = detail::withFilePixel(header.depth, [](auto filePixel) {
+        return std::is_same_v<decltype(filePixel), Pixel>;
+      });
+      if (!matches) {
+        throw std::runtime_error("netpbm: " + path + " has " + std::to_string(header.depth) + " planes, not the requested pixel type");
+      }
+    }
+
+    // Get the header of the file
+    [[nodiscard]] const NetpbmHeader& getHeader() const
+    { return header; }
+
+    // Get a view of the samples, inside the mapping
+    [[nodiscard]] ConstImageView<Pixel> view() const
+    { return ConstImageView<Pixel>(header.width, header.height, file.getData() + header.dataOffset); }
+
+    operator ConstImageView<Pixel>() const
+    { return view(); }
+  };
+
+  /**
+   * Load a netpbm file into an image of any pixel type: the file is mapped and converted straight
+   * into the image buffer, the only copy made.
+   * @param path the file to read
+   * @param alignment the row alignment of the image
+   * @param resource the memory resource allocating the image buffer
+   * @throws std::runtime_error if the file cannot be read or is not supported
+   */
+  template<typename Pixel>
+  Image<Pixel> loadNetpbm(const std::string& path, const RowAlignment alignment = RowAlignment::Packed,
+                          std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    const MappedFile file(path);
+    const NetpbmHeader header = parseNetpbmHeader(file.getData(), file.getSize());
+    Image<Pixel> image(header.width, header.height, uninitialized, alignment, resource);
+    detail::withFilePixel(header.depth, [&](auto filePixel) {
+      using FilePixel = decltype(filePixel);
+      convert(ConstImageView<FilePixel>(header.width, header.height, file.getData() + header.dataOffset), image.view());
+    });
+    return image;
+  }
+
+  /**
+   * Save an image as a netpbm file with 8-bit samples: PGM (P5) for 1-plane pixels, PAM (P7, RGB_ALPHA)
+   * for 4-plane pixels and PPM (P6) otherwise.
+   * 8-bit gray, RGB and RGBA rows are written in place with one `writev` call for the header and
+   * every row; other pixel types are converted in blocks of rows first.
+   * @param path the file to write, replaced if it exists
+   * @param image the image to save
+   * @throws std::runtime_error if the file cannot be written
+   */
+  template<typename Pixel>
+  void saveNetpbm(const std::string& path, const ConstImageView<Pixel>& image) {
+    using FilePixel = std::conditional_t<Pixel::PlaneCount == 1, PixelGray<std::uint8_t>,
+                      std::conditional_t<Pixel::PlaneCount == 4, PixelRGBA<std::uint8_t>, PixelRGB<std::uint8_t>>>;
+    constexpr std::size_t planes = FilePixel::PlaneCount;
+    const std::size_t width = image.getWidth(), height = image.getHeight();
+    if (width == 0 || height == 0) throw std::invalid_argument("netpbm: cannot save an empty image");
+
+    std::string header;
+    if constexpr (planes == 4) {
+      header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height)
+               + "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+    } else {
+      header = std::string(planes == 1 ? "P5\n" : "P6\n") + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    }
+
+    const detail::FileDescriptor file(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (file.fd < 0) detail::throwErrno("open " + path);
+
+    const std::size_t rowBytes = width * planes;
+    std::vector<iovec> parts;
+    parts.push_back({header.data(), header.size()});
+
+    if constexpr (std::is_same_v<Pixel, FilePixel>) {
+      if (image.getStride() == rowBytes) {
+        parts.push_back({const_cast<std::uint8_t*>(image.getData()), rowBytes * height});
+      } else {
+        for (std::size_t row = 0; row < height; ++row) {
+          parts.push_back({const_cast<std::uint8_t*>(image.getRow(row)), rowBytes});
+        }
+      }
+      detail::writeAll(file.fd, parts, path);
+    } else {
+      // About 1 MiB of converted rows per write
+      const std::size_t blockRows = std::clamp<std::size_t>((std::size_t{1} << 20) / rowBytes, 1, height);
+      std::vector<std::uint8_t> block(blockRows * rowBytes);
+      for (std::size_t firstRow = 0; firstRow < height; firstRow += blockRows) {
+        const std::size_t rows = std::min(blockRows, height - firstRow);
+        convertRows<Pixel, FilePixel>(image.getRow(firstRow), image.getStride(), image.getPlaneStride(),
+                                      block.data(), rowBytes, 1, width, rows);
+        parts.push_back({block.data(), rows * rowBytes});
+        detail::writeAll(file.fd, parts, path);
+        parts.clear();
+      }
+    }
+  }
+
+  // Save an image as a netpbm file, see the view overload.
+  template<typename Pixel>
+  void saveNetpbm(const std::string& path, const Image<Pixel>& image) {
+    saveNetpbm(path, image.view());
+  }
+}
+
+#endif // IMG_IMAGE_IO_H
@@ -0,0 +1,385 @@
+#ifndef IMG_IMAGE_INSTRUMENTATION_H
+#define IMG_IMAGE_INSTRUMENTATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Define IMG_INSTRUMENTATION to 1 (the CMake option of the same name does it) before including any
+ * header of the library to count and time the `Image` operations. Every translation unit of a program
+ * must agree on it. Without it the probes are empty and compile to nothing.
+ */
+#if !defined(IMG_INSTRUMENTATION)
+#define IMG_INSTRUMENTATION 0
+#endif
+
+#if IMG_INSTRUMENTATION
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#endif
+
+namespace img::instrumentation {
+
+  // Whether the probes of the library record anything.
+  inline constexpr bool enabled = IMG_INSTRUMENTATION != 0;
+
+  /**
+   * Operations recorded by the probes, each per pair of pixel types. Operations nest: the copy of
+   * an image is counted as a copy, and its pixels as a conversion to the same pixel type.
+   */
+  enum class Operation {
+    Construct,  // construction of an image with a size, the source type is the one converted from
+    Copy,       // copy of an image, or private copy of a shared copy-on-write buffer
+    Move,       // move of an image
+    Convert,    // run of the conversion engine, in place or not
+    Allocate    // allocation of an image buffer
+  };
+
+  inline const char* operationName(const Operation operation) {
+    switch (operation) {
+      case Operation::Construct: return "construct";
+      case Operation::Copy: return "copy";
+      case Operation::Move: return "move";
+      case Operation::Convert: return "convert";
+      default: return "allocate";
+    }
+  }
+
+  // Totals of an operation.
+  struct Counters {
+    std::uint64_t calls{0};
+    std::uint64_t bytesAllocated{0};
+    std::uint64_t bytesCopied{0};  // bytes written by copies and conversions
+    std::uint64_t pixels{0};
+    std::uint64_t nanoseconds{0};  // wall time spent in the operation, by the calling thread
+
+    Counters& operator+=(const Counters& other) {
+      calls += other.calls;
+      bytesAllocated += other.bytesAllocated;
+      bytesCopied += other.bytesCopied;
+      pixels += other.pixels;
+      nanoseconds += other.nanoseconds;
+      return *this;
+    }
+  };
+
+  namespace detail {
+    /**
+     * Name of a type without the `img::` qualifications, from the signature of this function
+     * (Ex: "PixelRGBA<unsigned char>").
+     */
+    template<typename T>
+    std::string typeName() {
+      const std::string_view signature = __PRETTY_FUNCTION__;
+      const std::size_t start = signature.find("T = ") + 4;
+      const std::size_t end = signature.find_first_of(";]", start);
+      std::string name(signature.substr(start, end - start));
+      for (std::size_t at = name.find("img::"); at != std::string::npos; at = name.find("img::", at)) {
+        name.erase(at, 5);
+      }
+      return name;
+    }
+
+    inline void appendJsonString(std::string& out, const std::string& text) {
+      out += '"';
+      for (const char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+      }
+      out += '"';
+    }
+  }
+
+  // Counters of one operation on one pair of pixel types.
+  struct Entry {
+    Operation operation;
+    std::string source;
+    std::string target;
+    Counters counters;
+  };
+
+  /**
+   * Counters of every thread at one point in time, one entry per operation and pair of pixel types
+   * seen so far, in the order they were first seen.
+   */
+  struct Snapshot {
+    std::vector<Entry> entries;
+
+    // Get the counters of an operation on a pair of pixel types, zero if it never ran
+    template<typename SourcePixel, typename TargetPixel = SourcePixel>
+    [[nodiscard]] Counters get(const Operation operation) const {
+      const std::string source = detail::typeName<SourcePixel>(), target = detail::typeName<TargetPixel>();
+      for (const Entry& entry : entries) {
+        if (entry.operation == operation && entry.source == source && entry.target == target) return entry.counters;
+      }
+      return {};
+    }
+
+    // Get the counters of an operation summed over every pair of pixel types
+    [[nodiscard]] Counters total(const Operation operation) const {
+      Counters sum;
+      for (const Entry& entry : entries) {
+        if (entry.operation == operation) sum += entry.counters;
+      }
+      return sum;
+    }
+
+    /**
+     * Export as a JSON array of objects with the keys "operation", "source", "target", "calls",
+     * "bytesAllocated", "bytesCopied", "pixels" and "nanoseconds".
+     */
+    [[nodiscard]] std::string toJson() const {
+      std::string out = "[";
+      for (const Entry& entry : entries) {
+        out += out.size() == 1 ? "\n  {" : ",\n  {";
+        out += "\"operation\": \"";
+        out += operationName(entry.operation);
+        out += "\", \"source\": ";
+        detail::appendJsonString(out, entry.source);
+        out += ", \"target\": ";
+        detail::appendJsonString(out, entry.target);
+        const Counters& c = entry.counters;
+        out += ", \"calls\": " + std::to_string(c.calls) + ", \"bytesAllocated\": " + std::to_string(c.bytesAllocated)
+             + ", \"bytesCopied\": " + std::to_string(c.bytesCopied) + ", \"pixels\": " + std::to_string(c.pixels)
+             + ", \"nanoseconds\": " + std::to_string(c.nanoseconds) + "}";
+      }
+      out += entries.empty() ? "]\n" : "\n]\n";
+      return out;
+    }
+
+    // Export as a table, one line per entry
+    [[nodiscard]] std::string toText() const {
+      std::string out = "operation  source -> target  calls  allocated B  copied B  pixels  ns\n";
+      for (const Entry& entry : entries) {
+        const Counters& c = entry.counters;
+        out += std::string(operationName(entry.operation)) + "  " + entry.source + " -> " + entry.target
+             + "  " + std::to_string(c.calls) + "  " + std::to_string(c.bytesAllocated) + "  " + std::to_string(c.bytesCopied)
+             + "  " + std::to_string(c.pixels) + "  " + std::to_string(c.nanoseconds) + "\n";
+      }
+      return out;
+    }
+  };
+
+#if IMG_INSTRUMENTATION
+
+  namespace detail {
+    // Counters of a slot, only written by their thread: plain loads and stores, read by the snapshots.
+    struct Cell {
+      std::atomic<std::uint64_t> calls{0}, bytesAllocated{0}, bytesCopied{0}, pixels{0}, nanoseconds{0};
+    };
+
+    inline void bump(std::atomic<std::uint64_t>& counter, const std::uint64_t value) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    constexpr std::size_t BlockSize = 64;
+    constexpr std::size_t BlockCount = 64;
+    // Slots past the last one all go to the last, named "(other)".
+    constexpr std::size_t MaxSlots = BlockSize * BlockCount;
+
+    class ThreadCounters;
+
+    // Names of the slots and counters of the threads, locked only when a slot or a thread comes and goes.
+    struct Registry {
+      std::mutex mutex;
+      std::vector<Entry> slots;            // counters of the threads which exited
+      std::vector<ThreadCounters*> threads;
+    };
+
+    // Never destroyed, for the threads of the pool exiting after the static destructors.
+    inline Registry& registry() {
+      static Registry* const instance = new Registry();
+      return *instance;
+    }
+
+    /**
+     * Counters of a thread, in blocks of slots allocated at their first use. The pointers to the
+     * blocks are atomic so that a snapshot can read them while the thread adds blocks.
+     */
+    class ThreadCounters {
+      using Block = std::array<Cell, BlockSize>;
+      std::array<std::atomic<Block*>, BlockCount> blocks{};
+
+    public:
+      ThreadCounters() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.threads.push_back(this);
+      }
+
+      // The counters of an exiting thread are kept in the registry.
+      ~ThreadCounters() {
+        Registry& shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        addTo(shared.slots);
+        shared.threads.erase(std::find(shared.threads.begin(), shared.threads.end(), this));
+        for (auto& block : blocks) delete block.load(std::memory_order_relaxed);
+      }
+
+      ThreadCounters(const ThreadCounters&) = delete;
+      ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+      Cell& cell(const std::size_t slot) {
+        std::atomic<Block*>& block = blocks[slot / BlockSize];
+        Block* cells = block.load(std::memory_order_relaxed);
+        if (cells == nullptr) {
+          cells = new Block();
+          block.store(cells, std::memory_order_release);
+        }
+        return (*cells)[slot % BlockSize];
+      }
+
+      // Add the counters to the slots, with the registry locked
+      void addTo(std::vector<Entry>& slots) const {
+        for (std::size_t slot = 0; slot < slots.size(); ++slot) {
+          const Block* const cells = blocks[slot / BlockSize].load(std::memory_order_acquire);
+          if (cells == nullptr) continue;
+          const Cell& cell = (*cells)[slot % BlockSize];
+          Counters& counters = slots[slot].counters;
+          counters.calls += cell.calls.load(std::memory_order_relaxed);
+          counters.bytesAllocated += cell.bytesAllocated.load(std::memory_order_relaxed);
+          counters.bytesCopied += cell.bytesCopied.load(std::memory_order_relaxed);
+          counters.pixels += cell.pixels.load(std::memory_order_relaxed);
+          counters.nanoseconds += cell.nanoseconds.load(std::memory_order_relaxed);
+        }
+      }
+
+      // Zero the counters, with the registry locked
+      void clear() {
+        for (auto& block : blocks) {
+          Block* const cells = block.load(std::memory_order_acquire);
+          if (cells == nullptr) continue;
+          for (Cell& cell : *cells) {
+            cell.calls.store(0, std::memory_order_relaxed);
+            cell.bytesAllocated.store(0, std::memory_order_relaxed);
+            cell.bytesCopied.store(0, std::memory_order_relaxed);
+            cell.pixels.store(0, std::memory_order_relaxed);
+            cell.nanoseconds.store(0, std::memory_order_relaxed);
+          }
+        }
+      }
+    };
+
+    inline ThreadCounters& threadCounters() {
+      thread_local ThreadCounters counters;
+      return counters;
+    }
+
+    inline std::size_t addSlot(const Operation operation, std::string source, std::string target) {
+      Registry& shared = registry();
+      std::lock_guard<std::mutex> lock(shared.mutex);
+      if (shared.slots.size() == MaxSlots - 1) {
+        shared.slots.push_back({operation, "(other)", "(other)", {}});
+      }
+      if (shared.slots.size() == MaxSlots) return MaxSlots - 1;
+      shared.slots.push_back({operation, std::move(source), std::move(target), {}});
+      return shared.slots.size() - 1;
+    }
+
+    // Slot of an operation on a pair of pixel types, numbered at its first use in the program
+    template<Operation operation, typename SourcePixel, typename TargetPixel>
+    std::size_t slot() {
+      static const std::size_t index = addSlot(operation, typeName<SourcePixel>(), typeName<TargetPixel>());
+      return index;
+    }
+  }
+
+  /**
+   * Probe of one operation on a pair of pixel types, placed at the start of the operation: counts a
+   * call and the pixels on construction, the time until its destruction on the calling thread.
+   * Lock-free: the counters belong to the thread. Never throws, for the `noexcept` moves: a probe
+   * failing to register its slot or thread on their first use (out of memory) counts nothing.
+   */
+  template<Operation operation, typename SourcePixel, typename TargetPixel = SourcePixel>
+  class Probe {
+    detail::Cell* cell{nullptr};
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    explicit Probe(const std::uint64_t pixels = 0, const std::uint64_t bytesCopied = 0) noexcept {
+      try {
+        cell = &detail::threadCounters().cell(detail::slot<operation, SourcePixel, TargetPixel>());
+      } catch (...) {
+        return;
+      }
+      detail::bump(cell->calls, 1);
+      detail::bump(cell->pixels, pixels);
+      detail::bump(cell->bytesCopied, bytesCopied);
+      start = std::chrono::steady_clock::now();
+    }
+
+    ~Probe() {
+      if (cell == nullptr) return;
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      detail::bump(cell->nanoseconds, static_cast<std::uint64_t>(std::chrono::nanoseconds(elapsed).count()));
+    }
+
+    Probe(const Probe&) = delete;
+    Probe& operator=(const Probe&) = delete;
+
+    // Count bytes allocated by the operation
+    void allocated(const std::uint64_t bytes) const noexcept
+    { if (cell != nullptr) detail::bump(cell->bytesAllocated, bytes); }
+
+    // Count bytes written by the operation
+    void copied(const std::uint64_t bytes) const noexcept
+    { if (cell != nullptr) detail::bump(cell->bytesCopied, bytes); }
+  };
+
+  /**
+   * Get the counters of every thread, those still running and those which exited. The counters a
+   * thread updates during the call may be partially included.
+   */
+  inline Snapshot snapshot() {
+    detail::Registry& shared = detail::registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    Snapshot result{shared.slots};
+    for (const detail::ThreadCounters* const counters : shared.threads) {
+      counters->addTo(result.entries);
+    }
+    return result;
+  }
+
+  /**
+   * Zero every counter. An update running on another thread during the call may be lost, or kept.
+   */
+  inline void reset() {
+    detail::Registry& shared = detail::registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (Entry& entry : shared.slots) entry.counters = {};
+    for (detail::ThreadCounters* const counters : shared.threads) counters->clear();
+  }
+
+#else
+
+  // Probe of a build without instrumentation: nothing to construct, nothing to count.
+  template<Operation operation, typename SourcePixel, typename TargetPixel = SourcePixel>
+  class Probe {
+  public:
+    constexpr explicit Probe(std::uint64_t = 0, std::uint64_t = 0) noexcept {}
+    Probe(const Probe&) = delete;
+    Probe& operator=(const Probe&) = delete;
+    constexpr void allocated(std::uint64_t) const noexcept {}
+    constexpr void copied(std::uint64_t) const noexcept {}
+  };
+
+  static_assert(std::is_empty_v<Probe<Operation::Move, void>>, "probes without instrumentation hold nothing");
+
+  // Get the counters, always empty without instrumentation
+  inline Snapshot snapshot()
+  { return {}; }
+
+  // Zero every counter, nothing to do without instrumentation
+  inline void reset() {}
+
+#endif
+}
+
+#endif // IMG_IMAGE_INSTRUMENTATION_H
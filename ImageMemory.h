@@ -0,0 +1,107 @@
+#ifndef IMG_IMAGE_MEMORY_H
+#define IMG_IMAGE_MEMORY_H
+
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace img {
+
+  /**
+   * Memory resource recycling image buffers: a freed buffer is kept in a bucket of its size and
+   * alignment, and handed back to the next allocation of the same size instead of going to the
+   * upstream resource. Images of the same dimensions and pixel type always hit the same bucket.
+   * Thread-safe.
+   */
+  class FramePool : public std::pmr::memory_resource {
+  public:
+    // Counters of a pool.
+    struct Stats {
+      std::size_t hits{0};       // allocations served from a cached buffer
+      std::size_t misses{0};     // allocations forwarded to the upstream resource
+      std::size_t bytesHeld{0};  // bytes of the cached buffers, waiting for an allocation
+    };
+
+  private:
+    using Bucket = std::pair<std::size_t, std::size_t>;  // bytes, alignment
+
+    std::pmr::memory_resource* upstream;
+    std::size_t maxBytesHeld;
+    mutable std::mutex mutex;
+    std::map<Bucket, std::vector<void*>> buckets;
+    Stats stats;
+
+    void* do_allocate(const std::size_t bytes, const std::size_t alignment) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto bucket = buckets.find({bytes, alignment});
+        if (bucket != buckets.end() && !bucket->second.empty()) {
+          void* buffer = bucket->second.back();
+          bucket->second.pop_back();
+          ++stats.hits;
+          stats.bytesHeld -= bytes;
+          return buffer;
+        }
+        ++stats.misses;
+      }
+      return upstream->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* buffer, const std::size_t bytes, const std::size_t alignment) override {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stats.bytesHeld + bytes <= maxBytesHeld) {
+          buckets[{bytes, alignment}].push_back(buffer);
+          stats.bytesHeld += bytes;
+          return;
+        }
+      }
+      upstream->deallocate(buffer, bytes, alignment);
+    }
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+      return this == &other;
+    }
+
+  public:
+    /**
+     * Create an empty pool.
+     * @param maxBytesHeld the most bytes kept for reuse, freed buffers beyond go back upstream
+     * @param upstream the resource allocating the buffers
+     */
+    explicit FramePool(const std::size_t maxBytesHeld = static_cast<std::size_t>(-1),
+                       std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : upstream(upstream), maxBytesHeld(maxBytesHeld) {}
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // Every buffer still allocated from the pool must be freed before the pool.
+    ~FramePool() override {
+      release();
+    }
+
+    // Get a copy of the counters
+    [[nodiscard]] Stats getStats() const {
+      std::lock_guard<std::mutex> lock(mutex);
+      return stats;
+    }
+
+    // Give every cached buffer back to the upstream resource
+    void release() {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto& [bucket, buffers] : buckets) {
+        for (void* buffer : buffers) {
+          upstream->deallocate(buffer, bucket.first, bucket.second);
+        }
+      }
+      buckets.clear();
+      stats.bytesHeld = 0;
+    }
+  };
+}
+
+#endif // IMG_IMAGE_MEMORY_H
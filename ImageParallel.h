@@ -0,0 +1,280 @@
+#ifndef IMG_IMAGE_PARALLEL_H
+#define IMG_IMAGE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace img {
+
+  /**
+   * Work-stealing pool running the row loops of whole-image operations.
+   *
+   * `parallelFor` cuts a range in fixed chunks and deals them round robin to one queue per worker.
+   * A worker takes its own chunks from the back and steals from the front of the other queues when
+   * it runs out; the calling thread steals too until the range is done. Chunks only depend on the
+   * range and the grain, never on the scheduling, so operations writing disjoint rows give the
+   * same result with any number of threads.
+   */
+  class ThreadPool {
+    struct Job {
+      std::atomic<std::size_t> remaining{0};
+      std::mutex errorMutex;
+      std::exception_ptr error;
+    };
+
+    struct Task {
+      void (*run)(const void* function, std::size_t begin, std::size_t end);
+      const void* function;
+      std::size_t begin, end;
+      Job* job;
+    };
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> nextQueue{0};
+    bool stopping{false};
+
+    /**
+     * Take a task, from the back of queue `own` first then from the front of the others.
+     * @param own the queue of the calling worker, or `queues.size()` for an outside thread
+     * @param task filled with the task taken
+     * @return `true` if a task was taken
+     */
+    bool take(const std::size_t own, Task& task) {
+      if (own < queues.size()) {
+        Queue& queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+          task = queue.tasks.back();
+          queue.tasks.pop_back();
+          return true;
+        }
+      }
+      for (std::size_t i = 0; i < queues.size(); ++i) {
+        const std::size_t victim = (own + 1 + i) % queues.size();
+        Queue& queue = *queues[victim];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+          task = queue.tasks.front();
+          queue.tasks.pop_front();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    static void execute(const Task& task) {
+      try {
+        task.run(task.function, task.begin, task.end);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(task.job->errorMutex);
+        if (!task.job->error) task.job->error = std::current_exception();
+      }
+      task.job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    bool runOne(const std::size_t own) {
+      Task task{};
+      if (!take(own, task)) return false;
+      pending.fetch_sub(1, std::memory_order_relaxed);
+      execute(task);
+      return true;
+    }
+
+    void workerLoop(const std::size_t own) {
+      while (true) {
+        if (runOne(own)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this] { return stopping || pending.load(std::memory_order_relaxed) > 0; });
+        if (stopping) return;
+      }
+    }
+
+    static std::unique_ptr<ThreadPool>& globalInstance() {
+      static std::unique_ptr<ThreadPool> instance = std::make_unique<ThreadPool>(std::thread::hardware_concurrency());
+      return instance;
+    }
+
+  public:
+    /**
+     * Start a pool.
+     * @param threadCount the number of threads working on a range, the calling thread included.
+     * 0 is treated as 1 (no worker, everything runs on the calling thread).
+     */
+    explicit ThreadPool(const std::size_t threadCount) {
+      const std::size_t workerCount = threadCount > 1 ? threadCount - 1 : 0;
+      for (std::size_t i = 0; i < workerCount; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+      }
+      for (std::size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+      }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+      }
+      wakeUp.notify_all();
+      for (auto& worker : workers) {
+        worker.join();
+      }
+    }
+
+    // Number of threads working on a range, the calling thread included.
+    [[nodiscard]] std::size_t getThreadCount() const
+    { return workers.size() + 1; }
+
+    /**
+     * Call `function(begin, end)` on consecutive chunks of `[0, count)` and wait for all of them.
+     * The first exception thrown by a chunk is rethrown once every chunk is done.
+     * @param count the size of the range
+     * @param grain the size of a chunk (the last one can be smaller)
+     * @param function callable as `function(std::size_t begin, std::size_t end)`
+     */
+    template<typename Function>
+    void parallelFor(const std::size_t count, std::size_t grain, const Function& function) {
+      if (count == 0) return;
+      grain = std::max<std::size_t>(grain, 1);
+      const std::size_t chunks = (count + grain - 1) / grain;
+      if (workers.empty() || chunks == 1) {
+        function(std::size_t{0}, count);
+        return;
+      }
+
+      Job job;
+      job.remaining.store(chunks, std::memory_order_relaxed);
+      const auto run = [](const void* erased, const std::size_t begin, const std::size_t end) {
+        (*static_cast<const Function*>(erased))(begin, end);
+      };
+      const std::size_t first = nextQueue.fetch_add(1, std::memory_order_relaxed);
+      for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        const std::size_t begin = chunk * grain;
+        Queue& queue = *queues[(first + chunk) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{run, &function, begin, std::min(begin + grain, count), &job});
+      }
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pending.fetch_add(chunks, std::memory_order_relaxed);
+      }
+      wakeUp.notify_all();
+
+      // The calling thread helps, then waits for the chunks still running on the workers.
+      while (job.remaining.load(std::memory_order_acquire) != 0) {
+        if (!runOne(queues.size())) std::this_thread::yield();
+      }
+      if (job.error) std::rethrow_exception(job.error);
+    }
+
+    // Pool used by the image operations, started with one thread per hardware thread.
+    static ThreadPool& global() {
+      return *globalInstance();
+    }
+
+    /**
+     * Replace the global pool. Must not be called while an image operation is running.
+     * @param threadCount the number of threads, the calling thread included (1 runs everything serially)
+     */
+    static void setGlobalThreadCount(const std::size_t threadCount) {
+      globalInstance() = std::make_unique<ThreadPool>(threadCount);
+    }
+  };
+
+  inline std::atomic<std::size_t>& parallelThresholdValue() {
+    static std::atomic<std::size_t> threshold{std::size_t{1} << 18};
+    return threshold;
+  }
+
+  // Number of samples below which whole-image operations run on the calling thread only.
+  inline std::size_t getParallelThreshold() {
+    return parallelThresholdValue().load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Set the number of samples below which whole-image operations stay serial.
+   * @param samples the new threshold (0 splits every operation)
+   */
+  inline void setParallelThreshold(const std::size_t samples) {
+    parallelThresholdValue().store(samples, std::memory_order_relaxed);
+  }
+
+  namespace detail {
+    // Rows per chunk of a row loop: about four chunks per thread to balance the load, but never chunks
+    // smaller than a quarter of the threshold; `height` when the loop stays on the calling thread.
+    inline std::size_t parallelRowGrain(const std::size_t height, const std::size_t rowSamples) {
+      const std::size_t threshold = getParallelThreshold();
+      const std::size_t threads = ThreadPool::global().getThreadCount();
+      if (height < 2 || threads == 1 || height * rowSamples < threshold) return std::max<std::size_t>(height, 1);
+      const std::size_t minRows = rowSamples == 0 ? height : (threshold / 4 + rowSamples - 1) / rowSamples;
+      return std::max<std::size_t>({minRows, height / (threads * 4), 1});
+    }
+  }
+
+  /**
+   * Run `function(firstRow, lastRow)` over the rows `[0, height)` on the global pool, or directly on
+   * the calling thread when the operation touches fewer samples than the parallel threshold.
+   * @param height the number of rows
+   * @param rowSamples the number of samples written per row, used to size the chunks
+   * @param function callable as `function(std::size_t firstRow, std::size_t lastRow)`
+   */
+  template<typename Function>
+  void parallelRows(const std::size_t height, const std::size_t rowSamples, const Function& function) {
+    const std::size_t grain = detail::parallelRowGrain(height, rowSamples);
+    if (grain >= height) {
+      function(std::size_t{0}, height);
+      return;
+    }
+    ThreadPool::global().parallelFor(height, grain, function);
+  }
+
+  /**
+   * Reduce the rows `[0, height)` on the global pool: each chunk of rows computes its own partial
+   * result with `function(firstRow, lastRow)`, then the partials are merged in row order with
+   * `merge(result, partial)`. The result depends on the chunks (so on the thread count), never on
+   * the scheduling.
+   * @param height the number of rows
+   * @param rowSamples the number of samples read per row, used to size the chunks
+   * @param function callable as `function(std::size_t firstRow, std::size_t lastRow)`, returning a partial result
+   * @param merge callable as `merge(Result& result, Result&& partial)`
+   * @return the partial result of all the rows
+   */
+  template<typename Function, typename Merge>
+  auto parallelReduceRows(const std::size_t height, const std::size_t rowSamples, const Function& function,
+                          const Merge& merge) {
+    using Result = std::invoke_result_t<const Function&, std::size_t, std::size_t>;
+    const std::size_t grain = detail::parallelRowGrain(height, rowSamples);
+    if (grain >= height) return function(std::size_t{0}, height);
+    std::vector<std::optional<Result>> partials((height + grain - 1) / grain);
+    ThreadPool::global().parallelFor(height, grain, [&](const std::size_t first, const std::size_t last) {
+      partials[first / grain].emplace(function(first, last));
+    });
+    Result result = std::move(*partials.front());
+    for (std::size_t chunk = 1; chunk < partials.size(); ++chunk) merge(result, std::move(*partials[chunk]));
+    return result;
+  }
+}
+
+#endif // IMG_IMAGE_PARALLEL_H
@@ -0,0 +1,397 @@
+#ifndef IMG_IMAGE_RESIZE_H
+#define IMG_IMAGE_RESIZE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  /**
+   * Resampling filter of `resize`. Downscaling widens the filters by the scale factor, so every
+   * input pixel contributes to the output (no aliasing).
+   */
+  enum class ResizeFilter {
+    Nearest,   // the input pixel under the center of the output pixel
+    Box,       // the average of the covered area
+    Bilinear,  // triangle filter, support 1
+    Bicubic,   // cubic convolution with a = -0.5, support 2
+    Lanczos3   // windowed sinc, support 3
+  };
+
+  namespace detail {
+    // Half width of a filter, in input pixels when upscaling.
+    constexpr double filterSupport(const ResizeFilter filter) {
+      switch (filter) {
+        case ResizeFilter::Box: return 0.5;
+        case ResizeFilter::Bilinear: return 1;
+        case ResizeFilter::Bicubic: return 2;
+        default: return 3;
+      }
+    }
+
+    inline double sinc(const double x) {
+      if (x == 0) return 1;
+      const double pix = x * 3.14159265358979323846;
+      return std::sin(pix) / pix;
+    }
+
+    inline double filterWeight(const ResizeFilter filter, const double x) {
+      constexpr double a = -0.5;
+      const double t = std::abs(x);
+      switch (filter) {
+        case ResizeFilter::Box:
+          return x >= -0.5 && x < 0.5 ? 1 : 0;
+        case ResizeFilter::Bilinear:
+          return t < 1 ? 1 - t : 0;
+        case ResizeFilter::Bicubic:
+          if (t < 1) return ((a + 2) * t - (a + 3)) * t * t + 1;
+          if (t < 2) return ((a * t - 5 * a) * t + 8 * a) * t - 4 * a;
+          return 0;
+        default:
+          return t < 3 ? sinc(x) * sinc(x / 3) : 0;
+      }
+    }
+
+    /**
+     * Weights of a separable resampling pass, computed once per axis. Every output sample reads
+     * `taps` consecutive input samples from `first[i]`: the windows near the borders are moved inside
+     * the input with zero weights, so the kernels never test the bounds.
+     * @tparam W the type of the weights, `std::int16_t` for weights in fixed point scaled by 2^14
+     */
+    template<typename W>
+    struct ResampleWeights {
+      std::size_t taps{0};
+      std::vector<std::size_t> first;
+      std::vector<W> weights;  // `taps` per output sample
+    };
+
+    // Number of input samples read per output sample.
+    inline std::size_t resampleTaps(const std::size_t inSize, const std::size_t outSize, const ResizeFilter filter) {
+      const double scale = static_cast<double>(inSize) / static_cast<double>(outSize);
+      const double support = filterSupport(filter) * std::max(scale, 1.0);
+      return std::min(static_cast<std::size_t>(std::ceil(support)) * 2 + 1, inSize);
+    }
+
+    // Widest filter with weights in fixed point: beyond, the weights scaled by 2^14 get too coarse (down to 0).
+    constexpr std::size_t MaxFixedPointTaps = 128;
+
+    template<typename W>
+    ResampleWeights<W> makeResampleWeights(const std::size_t inSize, const std::size_t outSize, const ResizeFilter filter) {
+      const double scale = static_cast<double>(inSize) / static_cast<double>(outSize);
+      const double filterScale = std::max(scale, 1.0);
+      const double support = filterSupport(filter) * filterScale;
+
+      ResampleWeights<W> result;
+      result.taps = resampleTaps(inSize, outSize, filter);
+      result.first.resize(outSize);
+      result.weights.assign(outSize * result.taps, W{});
+      std::vector<double> window(result.taps);
+      for (std::size_t i = 0; i < outSize; ++i) {
+        const double center = (static_cast<double>(i) + 0.5) * scale;
+        const auto low = static_cast<std::ptrdiff_t>(std::floor(center - support + 0.5));
+        const std::size_t begin = static_cast<std::size_t>(std::max<std::ptrdiff_t>(low, 0));
+        const std::size_t end = std::min(static_cast<std::size_t>(std::max<double>(std::floor(center + support + 0.5), 0)), inSize);
+        const std::size_t first = std::min(begin, inSize - result.taps);
+        result.first[i] = first;
+
+        double total = 0;
+        std::fill(window.begin(), window.end(), 0.0);
+        for (std::size_t x = begin; x < end && x < first + result.taps; ++x) {
+          const double weight = filterWeight(filter, (static_cast<double>(x) - center + 0.5) / filterScale);
+          window[x - first] = weight;
+          total += weight;
+        }
+        W* const out = result.weights.data() + i * result.taps;
+        if constexpr (std::is_same_v<W, std::int16_t>) {
+          // Rounded to 2^14 with the rounding error moved to the largest weight, so the weights sum exactly to 1.
+          int sum = 0;
+          std::size_t largest = 0;
+          for (std::size_t k = 0; k < result.taps; ++k) {
+            out[k] = static_cast<std::int16_t>(std::lround(window[k] / total * (1 << 14)));
+            sum += out[k];
+            if (window[k] > window[largest]) largest = k;
+          }
+          out[largest] = static_cast<std::int16_t>(out[largest] + (1 << 14) - sum);
+        } else {
+          for (std::size_t k = 0; k < result.taps; ++k) out[k] = static_cast<W>(window[k] / total);
+        }
+      }
+      return result;
+    }
+
+    // Store a filtered value as a sample: rounded and clamped to the range of integer samples.
+    template<typename T, typename W>
+    constexpr T resampleStore(const W value) {
+      if constexpr (std::is_unsigned_v<T>) {
+        // Clamped first, so the rounding is a truncation: no floor, the loops vectorize.
+        const W clamped = std::min(std::max(value, W(0)), static_cast<W>(std::numeric_limits<T>::max()));
+        return static_cast<T>(clamped + W(0.5));
+      } else if constexpr (std::is_integral_v<T>) {
+        const W rounded = std::floor(value + W(0.5));
+        if (rounded <= static_cast<W>(std::numeric_limits<T>::min())) return std::numeric_limits<T>::min();
+        if (rounded >= static_cast<W>(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+        return static_cast<T>(rounded);
+      } else {
+        return static_cast<T>(value);
+      }
+    }
+
+    // Horizontal pass of `count` output pixels of `channels` interleaved samples, `step` samples apart in the input.
+    template<typename T, typename W>
+    void resampleRowGeneric(const T* src, T* dst, const std::size_t count, const int channels, const std::size_t step,
+                            const ResampleWeights<W>& weights) {
+      for (std::size_t i = 0; i < count; ++i, dst += channels) {
+        const T* const in = src + weights.first[i] * step;
+        const W* const w = weights.weights.data() + i * weights.taps;
+        for (int channel = 0; channel < channels; ++channel) {
+          W sum = 0;
+          for (std::size_t k = 0; k < weights.taps; ++k) sum += w[k] * static_cast<W>(in[k * step + channel]);
+          dst[channel] = resampleStore<T>(sum);
+        }
+      }
+    }
+
+    // Vertical pass of `count` samples, accumulated row by row in `sums` so the loops vectorize.
+    template<typename T, typename W>
+    void resampleColumnsGeneric(const T* const* rows, const W* weights, const std::size_t taps, T* dst,
+                                const std::size_t count, std::vector<W>& sums) {
+      sums.assign(count, W{});
+      for (std::size_t k = 0; k < taps; ++k) {
+        const T* const row = rows[k];
+        const W weight = weights[k];
+        for (std::size_t i = 0; i < count; ++i) sums[i] += weight * static_cast<W>(row[i]);
+      }
+      for (std::size_t i = 0; i < count; ++i) dst[i] = resampleStore<T>(sums[i]);
+    }
+
+    /**
+     * Separable resampling of one group of interleaved channels (all the planes of an interleaved
+     * pixel, or one plane of a planar pixel): a horizontal pass into a buffer of the needed input
+     * rows, then a vertical pass, both on the global thread pool. An axis of unchanged size is not resampled.
+     * @param src the first sample of the group in the input
+     * @param srcStride the distance between two input rows
+     * @param dst the first sample of the group in the output
+     * @param dstStride the distance between two output rows
+     * @param channels the number of interleaved samples per pixel
+     * @tparam W the type of the weights, `std::int16_t` for the fixed point kernels of 8 bit samples
+     */
+    template<typename T, typename W>
+    void resampleChannelsWith(const T* src, const std::size_t srcStride, const std::size_t srcWidth, const std::size_t srcHeight,
+                              T* dst, const std::size_t dstStride, const std::size_t dstWidth, const std::size_t dstHeight,
+                              const int channels, const ResizeFilter filter) {
+      constexpr bool fixedPoint = std::is_same_v<W, std::int16_t>;
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t rowSamples = dstWidth * step;
+
+      // Input rows read by the vertical pass, resampled horizontally first.
+      const ResampleWeights<W> columns = makeResampleWeights<W>(srcHeight, dstHeight, filter);
+      const std::size_t firstRow = dstHeight == srcHeight ? 0 : columns.first.front();
+      const std::size_t lastRow = dstHeight == srcHeight ? srcHeight : columns.first.back() + columns.taps;
+
+      // `rows` holds the input rows from `rowsFirst` on: the source, or the buffer from `firstRow`.
+      std::vector<T> buffer;
+      const T* rows = src;
+      std::size_t rowsStride = srcStride, rowsFirst = 0;
+      if (dstWidth != srcWidth) {
+        const ResampleWeights<W> weights = makeResampleWeights<W>(srcWidth, dstWidth, filter);
+        T* out = dst;
+        std::size_t outStride = dstStride;
+        if (dstHeight != srcHeight) {
+          buffer.resize((lastRow - firstRow) * rowSamples);
+          out = buffer.data();
+          outStride = rowSamples;
+        }
+        parallelRows(lastRow - firstRow, rowSamples * weights.taps, [&](const std::size_t begin, const std::size_t end) {
+          for (std::size_t row = begin; row < end; ++row) {
+            const T* const in = src + (firstRow + row) * srcStride;
+            if constexpr (fixedPoint) {
+              simd::resampleRow(in, out + row * outStride, dstWidth, channels,
+                                weights.first.data(), weights.weights.data(), weights.taps);
+            } else {
+              resampleRowGeneric(in, out + row * outStride, dstWidth, channels, step, weights);
+            }
+          }
+        });
+        if (dstHeight == srcHeight) return;
+        rows = out;
+        rowsStride = outStride;
+        rowsFirst = firstRow;
+      }
+
+      parallelRows(dstHeight, rowSamples * columns.taps, [&](const std::size_t begin, const std::size_t end) {
+        std::vector<const T*> inputs(columns.taps);
+        std::vector<W> sums;
+        for (std::size_t row = begin; row < end; ++row) {
+          for (std::size_t k = 0; k < columns.taps; ++k) inputs[k] = rows + (columns.first[row] + k - rowsFirst) * rowsStride;
+          const W* const w = columns.weights.data() + row * columns.taps;
+          if constexpr (fixedPoint) {
+            simd::resampleColumns(inputs.data(), w, columns.taps, dst + row * dstStride, rowSamples);
+          } else {
+            resampleColumnsGeneric(inputs.data(), w, columns.taps, dst + row * dstStride, rowSamples, sums);
+          }
+        }
+      });
+    }
+
+    /**
+     * Separable resampling of one group of interleaved channels, see `resampleChannelsWith`: 8 bit
+     * samples with weights in fixed point, unless the filter is too wide for them (large downscales),
+     * the other types in `float` (for `float`) or `double`.
+     */
+    template<typename T>
+    void resampleChannels(const T* src, const std::size_t srcStride, const std::size_t srcWidth, const std::size_t srcHeight,
+                          T* dst, const std::size_t dstStride, const std::size_t dstWidth, const std::size_t dstHeight,
+                          const int channels, const ResizeFilter filter) {
+      if constexpr (std::is_same_v<T, std::uint8_t>) {
+        const std::size_t taps = std::max(resampleTaps(srcWidth, dstWidth, filter), resampleTaps(srcHeight, dstHeight, filter));
+        if (taps <= MaxFixedPointTaps) {
+          resampleChannelsWith<T, std::int16_t>(src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight, channels, filter);
+        } else {
+          resampleChannelsWith<T, float>(src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight, channels, filter);
+        }
+      } else {
+        using W = std::conditional_t<std::is_same_v<T, float>, float, double>;
+        resampleChannelsWith<T, W>(src, srcStride, srcWidth, srcHeight, dst, dstStride, dstWidth, dstHeight, channels, filter);
+      }
+    }
+
+    /**
+     * Downscale by integer factors with the average of every block of `factorX` x `factorY` pixels,
+     * in one pass: the rows of a block are summed, then the columns, then divided once with rounding.
+     */
+    template<typename T>
+    void boxDownscale(const T* src, const std::size_t srcStride, T* dst, const std::size_t dstStride,
+                      const std::size_t dstWidth, const std::size_t dstHeight, const int channels,
+                      const std::size_t factorX, const std::size_t factorY) {
+      using Sum = std::conditional_t<std::is_floating_point_v<T>, double,
+                                     std::conditional_t<(sizeof(T) <= 2), std::uint32_t, long long>>;
+      const auto step = static_cast<std::size_t>(channels);
+      const std::size_t srcSamples = dstWidth * factorX * step;
+      const auto area = static_cast<Sum>(factorX * factorY);
+      parallelRows(dstHeight, srcSamples * factorY, [&](const std::size_t begin, const std::size_t end) {
+        std::vector<Sum> sums(srcSamples);
+        for (std::size_t row = begin; row < end; ++row) {
+          std::fill(sums.begin(), sums.end(), Sum{});
+          for (std::size_t y = 0; y < factorY; ++y) {
+            const T* const in = src + (row * factorY + y) * srcStride;
+            for (std::size_t i = 0; i < srcSamples; ++i) sums[i] += static_cast<Sum>(in[i]);
+          }
+          T* const out = dst + row * dstStride;
+          for (std::size_t col = 0; col < dstWidth; ++col) {
+            for (std::size_t channel = 0; channel < step; ++channel) {
+              Sum sum{};
+              for (std::size_t x = 0; x < factorX; ++x) sum += sums[(col * factorX + x) * step + channel];
+              if constexpr (std::is_floating_point_v<T>) {
+                out[col * step + channel] = static_cast<T>(sum / area);
+              } else if constexpr (std::is_unsigned_v<Sum>) {
+                out[col * step + channel] = static_cast<T>((sum + area / 2) / area);
+              } else {
+                out[col * step + channel] = static_cast<T>(std::floor(static_cast<double>(sum) / static_cast<double>(area) + 0.5));
+              }
+            }
+          }
+        }
+      });
+    }
+  }
+
+  /**
+   * Resample the pixels of `src` to the size of `dst`, for every pixel type: each plane of planar
+   * pixels, all the samples of interleaved ones (alpha included, not premultiplied).
+   *
+   * The filters are separable, with weights computed once per axis: a horizontal then a vertical
+   * pass, split on the global thread pool. `std::uint8_t` samples use weights in fixed point and the
+   * vectorized kernels of `ImageSimd.h`, or `float` weights for the filters too wide for fixed point
+   * (downscales by large factors); the other types are filtered in `float` (for `float`) or
+   * `double`, integer results being rounded and clamped. `Box` with integer factors (the power of two
+   * thumbnails) is a single pass of block averages.
+   * @param src the source pixels
+   * @param dst the destination pixels, of the target size
+   * @param filter the resampling filter
+   * @throws std::invalid_argument if only one of the images is empty
+   */
+  template<typename Pixel>
+  void resize(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const ResizeFilter filter = ResizeFilter::Bilinear) {
+    using T = typename Pixel::DataType;
+    const std::size_t srcWidth = src.getWidth(), srcHeight = src.getHeight();
+    const std::size_t dstWidth = dst.getWidth(), dstHeight = dst.getHeight();
+    if (dstWidth == 0 || dstHeight == 0) return;
+    if (srcWidth == 0 || srcHeight == 0) {
+      throw std::invalid_argument("img::resize: the source image is empty");
+    }
+
+    // Interleaved pixels are one group of `PlaneCount` channels, planar ones `PlaneCount` groups of one.
+    constexpr int groups = isPlanar<Pixel> ? Pixel::PlaneCount : 1;
+    constexpr int channels = isPlanar<Pixel> ? 1 : Pixel::PlaneCount;
+
+    if (filter == ResizeFilter::Nearest) {
+      std::vector<std::size_t> cols(dstWidth);
+      for (std::size_t col = 0; col < dstWidth; ++col) {
+        cols[col] = std::min(static_cast<std::size_t>((static_cast<double>(col) + 0.5) * srcWidth / dstWidth), srcWidth - 1);
+      }
+      parallelRows(dstHeight, dstWidth * Pixel::PlaneCount, [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t row = begin; row < end; ++row) {
+          const std::size_t srcRow = std::min(static_cast<std::size_t>((static_cast<double>(row) + 0.5) * srcHeight / dstHeight), srcHeight - 1);
+          for (int group = 0; group < groups; ++group) {
+            const T* const in = src.getRow(srcRow) + group * src.getPlaneStride() * isPlanar<Pixel>;
+            T* const out = dst.getRow(row) + group * dst.getPlaneStride() * isPlanar<Pixel>;
+            for (std::size_t col = 0; col < dstWidth; ++col) {
+              std::memcpy(out + col * channels, in + cols[col] * channels, channels * sizeof(T));
+            }
+          }
+        }
+      });
+      return;
+    }
+
+    const bool boxFactors = filter == ResizeFilter::Box && srcWidth % dstWidth == 0 && srcHeight % dstHeight == 0;
+    for (int group = 0; group < groups; ++group) {
+      const T* const in = src.getData() + (isPlanar<Pixel> ? group * src.getPlaneStride() : 0);
+      T* const out = dst.getData() + (isPlanar<Pixel> ? group * dst.getPlaneStride() : 0);
+      if (boxFactors && (srcWidth != dstWidth || srcHeight != dstHeight)) {
+        detail::boxDownscale(in, src.getStride(), out, dst.getStride(), dstWidth, dstHeight, channels,
+                             srcWidth / dstWidth, srcHeight / dstHeight);
+      } else if (srcWidth == dstWidth && srcHeight == dstHeight) {
+        for (std::size_t row = 0; row < dstHeight; ++row) {
+          std::memcpy(out + row * dst.getStride(), in + row * src.getStride(), dstWidth * channels * sizeof(T));
+        }
+      } else {
+        detail::resampleChannels(in, src.getStride(), srcWidth, srcHeight, out, dst.getStride(), dstWidth, dstHeight,
+                                 channels, filter);
+      }
+    }
+  }
+
+  /**
+   * Resample an image to a new size, see the overload above.
+   * @param src the source pixels
+   * @param width the width of the result
+   * @param height the height of the result
+   * @param filter the resampling filter
+   * @return the resized image
+   */
+  template<typename Pixel>
+  Image<Pixel> resize(const ConstImageView<Pixel>& src, const std::size_t width, const std::size_t height,
+                      const ResizeFilter filter = ResizeFilter::Bilinear) {
+    Image<Pixel> result(width, height, uninitialized);
+    resize(src, result.view(), filter);
+    return result;
+  }
+
+  template<typename Pixel>
+  Image<Pixel> resize(const Image<Pixel>& src, const std::size_t width, const std::size_t height,
+                      const ResizeFilter filter = ResizeFilter::Bilinear) {
+    return resize(src.view(), width, height, filter);
+  }
+}
+
+#endif // IMG_IMAGE_RESIZE_H
@@ -0,0 +1,1759 @@
+#ifndef IMG_IMAGE_SIMD_H
+#define IMG_IMAGE_SIMD_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define IMG_SIMD_X86 1
+#include <immintrin.h>
+#define IMG_SIMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define IMG_SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__ARM_NEON)
+#define IMG_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+/**
+ * Vectorized row kernels used by the conversion engine for `std::uint8_t` and `float` samples.
+ *
+ * Every kernel has a scalar version and the best implementation for the running CPU is picked at
+ * runtime (AVX2, then SSE4.1 on x86, NEON on ARM). All kernels give the same result whatever the
+ * level, and every kernel except the `std::uint8_t` luminance gives exactly the samples of the
+ * scalar `fromRaw` / `toRaw` definitions.
+ *
+ * `std::uint8_t` luminance is computed in fixed point as the exact `floor((299 r + 587 g + 114 b) / 1000)`.
+ * `PixelGray::toRaw` evaluates the same formula in double precision, where the sum of the three
+ * rounded products can land just below an integer: in that case (3464 inputs out of 2^24) the
+ * kernel gives one more than `toRaw`. The result is never lower and never more than one above.
+ */
+namespace img::simd {
+
+  // Instruction sets the kernels can use, ordered from the slowest to the fastest.
+  enum class Level { Scalar, SSE41, AVX2, NEON };
+
+  // Best level supported by the running CPU.
+  inline Level detectLevel() {
+#if defined(IMG_SIMD_X86)
+    if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Level::SSE41;
+    return Level::Scalar;
+#elif defined(IMG_SIMD_NEON)
+    return Level::NEON;
+#else
+    return Level::Scalar;
+#endif
+  }
+
+  inline std::atomic<Level>& activeLevel() {
+    static std::atomic<Level> level{detectLevel()};
+    return level;
+  }
+
+  // Level currently used by the kernels.
+  inline Level level() {
+    return activeLevel().load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Lower the level used by the kernels, to compare implementations in tests and benchmarks.
+   * A level the CPU does not support is clamped to the detected one.
+   * @param requested the wanted level
+   */
+  inline void setLevel(const Level requested) {
+    const Level detected = detectLevel();
+    const bool supported = requested == Level::Scalar || requested == detected
+      || (detected == Level::AVX2 && requested == Level::SSE41);
+    activeLevel().store(supported ? requested : detected, std::memory_order_relaxed);
+  }
+
+  /** ----- Scalar kernels ----- **/
+
+  // floor((299 r + 587 g + 114 b) / 1000), computed as ((n >> 3) * 33555) >> 22 which is exact for every 8 bit input.
+  constexpr std::uint8_t luma8(const unsigned red, const unsigned green, const unsigned blue) {
+    const unsigned n = 299u * red + 587u * green + 114u * blue;
+    return static_cast<std::uint8_t>(((n >> 3) * 33555u) >> 22);
+  }
+
+  // Same operations, in the same order, as `PixelGray<float>::toRaw`.
+  constexpr float lumaFloat(const float red, const float green, const float blue) {
+    return static_cast<float>(0.299 * red + 0.587 * green + 0.114 * blue);
+  }
+
+  template<typename T>
+  void swapRedBlueScalar(const T* src, T* dst, const std::size_t count, const int planes) {
+    for (std::size_t i = 0; i < count; ++i, src += planes, dst += planes) {
+      const T red = src[0];
+      const T blue = src[2];
+      dst[0] = blue;
+      dst[1] = src[1];
+      dst[2] = red;
+      if (planes == 4) dst[3] = src[3];
+    }
+  }
+
+  template<typename T>
+  void addAlphaScalar(const T* src, T* dst, const std::size_t count, const bool swap, const T alpha) {
+    for (std::size_t i = 0; i < count; ++i, src += 3, dst += 4) {
+      const T red = src[swap ? 2 : 0];
+      const T green = src[1];
+      const T blue = src[swap ? 0 : 2];
+      dst[0] = red;
+      dst[1] = green;
+      dst[2] = blue;
+      dst[3] = alpha;
+    }
+  }
+
+  // Forward only: `dst` may alias `src`.
+  template<typename T>
+  void dropAlphaScalar(const T* src, T* dst, const std::size_t count, const bool swap) {
+    for (std::size_t i = 0; i < count; ++i, src += 4, dst += 3) {
+      const T red = src[swap ? 2 : 0];
+      const T green = src[1];
+      const T blue = src[swap ? 0 : 2];
+      dst[0] = red;
+      dst[1] = green;
+      dst[2] = blue;
+    }
+  }
+
+  inline void luminanceScalar(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                              const int planes, const int redIndex) {
+    for (std::size_t i = 0; i < count; ++i, src += planes) {
+      dst[i] = luma8(src[redIndex], src[1], src[2 - redIndex]);
+    }
+  }
+
+  inline void luminanceScalar(const float* src, float* dst, const std::size_t count,
+                              const int planes, const int redIndex) {
+    for (std::size_t i = 0; i < count; ++i, src += planes) {
+      dst[i] = lumaFloat(src[redIndex], src[1], src[2 - redIndex]);
+    }
+  }
+
+  // `dst[plane][i]` receives the sample `plane` of the pixel `i`.
+  template<typename T>
+  void deinterleaveScalar(const T* src, T* const* dst, const std::size_t count, const int planes) {
+    for (std::size_t i = 0; i < count; ++i, src += planes) {
+      for (int plane = 0; plane < planes; ++plane) dst[plane][i] = src[plane];
+    }
+  }
+
+  // The sample `plane` of the pixel `i` is read from `src[plane][i]`.
+  template<typename T>
+  void interleaveScalar(const T* const* src, T* dst, const std::size_t count, const int planes) {
+    for (std::size_t i = 0; i < count; ++i, dst += planes) {
+      for (int plane = 0; plane < planes; ++plane) dst[plane] = src[plane][i];
+    }
+  }
+
+  // Clamp to the range of a `std::uint8_t`.
+  constexpr std::uint8_t clamp8(const int value) {
+    return static_cast<std::uint8_t>(value < 0 ? 0 : value > 255 ? 255 : value);
+  }
+
+  /**
+   * Horizontal resampling of a row of 8 bit pixels, with weights in fixed point scaled by 2^14:
+   * the output pixel `i` is `sum(weights[i * taps + k] * src[first[i] + k]) >> 14` for every channel,
+   * rounded and clamped to [0, 255].
+   * @param planes the number of interleaved channels, 1, 3 or 4
+   */
+  inline void resampleRowScalar(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const int planes,
+                                const std::size_t* first, const std::int16_t* weights, const std::size_t taps) {
+    for (std::size_t i = 0; i < count; ++i, dst += planes, weights += taps) {
+      const std::uint8_t* const in = src + first[i] * planes;
+      for (int channel = 0; channel < planes; ++channel) {
+        int sum = 1 << 13;
+        for (std::size_t k = 0; k < taps; ++k) sum += weights[k] * in[k * planes + channel];
+        dst[channel] = clamp8(sum >> 14);
+      }
+    }
+  }
+
+  // Vertical resampling of `count` samples: `dst[i] = sum(weights[k] * rows[k][i]) >> 14`, rounded and clamped.
+  inline void resampleColumnsScalar(const std::uint8_t* const* rows, const std::int16_t* weights, const std::size_t taps,
+                                    std::uint8_t* dst, const std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      int sum = 1 << 13;
+      for (std::size_t k = 0; k < taps; ++k) sum += weights[k] * rows[k][i];
+      dst[i] = clamp8(sum >> 14);
+    }
+  }
+
+  /**
+   * Transpose a block of `rows` x `cols` elements of `bytes` bytes: the element `c` of the source row `r`
+   * becomes the element `r` of the destination row `c`. The strides are in bytes and may be negative.
+   * @tparam Bytes `bytes` as a constant, or 0 for the sizes without a specialized copy
+   */
+  template<std::size_t Bytes>
+  void transposeBlockScalar(const std::uint8_t* src, const std::ptrdiff_t srcStride, std::uint8_t* dst,
+                            const std::ptrdiff_t dstStride, const std::size_t rows, const std::size_t cols,
+                            const std::size_t bytes) {
+    const std::size_t size = Bytes != 0 ? Bytes : bytes;
+    for (std::size_t col = 0; col < cols; ++col) {
+      std::uint8_t* const out = dst + static_cast<std::ptrdiff_t>(col) * dstStride;
+      for (std::size_t row = 0; row < rows; ++row) {
+        std::memcpy(out + row * size, src + static_cast<std::ptrdiff_t>(row) * srcStride + col * size, size);
+      }
+    }
+  }
+
+  // Reverse the order of `count` elements of `bytes` bytes. `dst` may be `src`.
+  template<std::size_t Bytes>
+  void reverseElementsScalar(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const std::size_t bytes) {
+    const std::size_t size = Bytes != 0 ? Bytes : bytes;
+    for (std::size_t i = 0; i < count / 2; ++i) {
+      const std::size_t j = count - 1 - i;
+      if constexpr (Bytes != 0) {
+        std::uint8_t front[Bytes], back[Bytes];
+        std::memcpy(front, src + i * Bytes, Bytes);
+        std::memcpy(back, src + j * Bytes, Bytes);
+        std::memcpy(dst + i * Bytes, back, Bytes);
+        std::memcpy(dst + j * Bytes, front, Bytes);
+      } else {
+        for (std::size_t b = 0; b < size; ++b) {
+          const std::uint8_t front = src[i * size + b];
+          dst[i * size + b] = src[j * size + b];
+          dst[j * size + b] = front;
+        }
+      }
+    }
+    if (count % 2 != 0 && src != dst) std::memcpy(dst + count / 2 * size, src + count / 2 * size, size);
+  }
+
+  // Blend operations of the compositing kernels, on samples premultiplied by their alpha.
+  enum class Blend { Over, Add, Multiply };
+
+  // round(x / 255) for every x in [0, 255 * 255], without a divide.
+  constexpr int div255(const int x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+  }
+
+  // Blend a premultiplied sample `s` of alpha `as` with `d` of alpha `ad`; the alpha itself with s = as, d = ad.
+  constexpr int blendSample(const Blend op, const int s, const int d, const int as, const int ad) {
+    switch (op) {
+      case Blend::Over: {
+        const int sum = s + div255(d * (255 - as));
+        return sum < 255 ? sum : 255;
+      }
+      case Blend::Add:
+        return s + d < 255 ? s + d : 255;
+      default: {
+        const int sum = s * d + s * (255 - ad) + d * (255 - as);
+        return div255(sum < 255 * 255 ? sum : 255 * 255);
+      }
+    }
+  }
+
+  /**
+   * Composite a row of 8 bit pixels of 4 channels, alpha last (RGBA or BGRA), onto another:
+   *   over:     o = s + d (1 - as)
+   *   add:      o = min(s + d, 1)
+   *   multiply: o = s d + s (1 - ad) + d (1 - as)
+   * on premultiplied samples, the alpha included, every product divided by 255 with rounding.
+   * Straight samples are premultiplied first (rounded), and the result divided back by its alpha
+   * (rounded, 0 for a transparent result).
+   */
+  inline void blendRowScalar(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const Blend op,
+                             const bool premultiplied) {
+    for (std::size_t i = 0; i < count; ++i, src += 4, dst += 4) {
+      const int as = src[3], ad = dst[3];
+      const int ao = blendSample(op, as, ad, as, ad);
+      for (int channel = 0; channel < 3; ++channel) {
+        int s = src[channel], d = dst[channel];
+        if (!premultiplied) {
+          s = div255(s * as);
+          d = div255(d * ad);
+        }
+        int o = blendSample(op, s, d, as, ad);
+        if (!premultiplied) {
+          o = ao == 0 ? 0 : (o * 255 + ao / 2) / ao;
+          o = o < 255 ? o : 255;
+        }
+        dst[channel] = static_cast<std::uint8_t>(o);
+      }
+      dst[3] = static_cast<std::uint8_t>(ao);
+    }
+  }
+
+  /**
+   * Means of boxes of `area` samples from their sums, `dst[i] = round((ahead[i] - behind[i]) / area)`:
+   * the sums are differences of prefix sums, which may wrap. `area` is odd, and twice a sum fits 31 bits.
+   */
+  inline void boxMeanRowScalar(const std::uint32_t* ahead, const std::uint32_t* behind, std::uint8_t* dst,
+                               const std::size_t count, const std::uint32_t area) {
+    for (std::size_t i = 0; i < count; ++i) {
+      dst[i] = static_cast<std::uint8_t>((2 * (ahead[i] - behind[i]) + area) / (2 * area));
+    }
+  }
+
+  /**
+   * Accumulate the statistics of `count` 8 bit samples of `channels` interleaved channels, `count` a
+   * multiple of `channels`: per channel the minimum, maximum, sum and sum of squares.
+   */
+  inline void sampleStatsScalar(const std::uint8_t* src, const std::size_t count, const int channels, std::uint8_t* min,
+                                std::uint8_t* max, std::uint64_t* sum, std::uint64_t* squares) {
+    const auto step = static_cast<std::size_t>(channels);
+    for (std::size_t i = 0; i + step <= count; i += step) {
+      for (std::size_t channel = 0; channel < step; ++channel) {
+        const std::uint8_t value = src[i + channel];
+        min[channel] = std::min(min[channel], value);
+        max[channel] = std::max(max[channel], value);
+        sum[channel] += value;
+        squares[channel] += static_cast<std::uint32_t>(value) * value;
+      }
+    }
+  }
+
+  /**
+   * Fixed point coefficients of a conversion between 8 bit YUV and RGB, scaled by 2^13.
+   * Decoding, with c = Y - yOffset, d = U - 128 and e = V - 128:
+   *   R = (yScale c + rV e + 4096) >> 13, G = (yScale c + gU d + gV e + 4096) >> 13, B = (yScale c + bU d + 4096) >> 13
+   * Encoding: Y = ((yR R + yG G + yB B + 4096) >> 13) + yOffset, U and V alike plus 128, from the
+   * rounded average of a block of 2x2 pixels. Every result is clamped to [0, 255].
+   */
+  struct YUVCoefficients {
+    int yOffset;
+    std::int16_t yScale, rV, gU, gV, bU;
+    std::int16_t yR, yG, yB, uR, uG, uB, vR, vG, vB;
+  };
+
+  // `rgb[channel][i]` receives the red, green then blue of the pixel `i`, which reads the chroma sample `i / 2`.
+  inline void yuvToRgbScalar(const std::uint8_t* y, const std::uint8_t* u, const std::uint8_t* v, const std::size_t chromaStep,
+                             std::uint8_t* const* rgb, const std::size_t count, const YUVCoefficients& k) {
+    for (std::size_t i = 0; i < count; ++i) {
+      const int luma = (y[i] - k.yOffset) * k.yScale + 4096;
+      const int d = u[(i >> 1) * chromaStep] - 128;
+      const int e = v[(i >> 1) * chromaStep] - 128;
+      rgb[0][i] = clamp8((luma + k.rV * e) >> 13);
+      rgb[1][i] = clamp8((luma + k.gU * d + k.gV * e) >> 13);
+      rgb[2][i] = clamp8((luma + k.bU * d) >> 13);
+    }
+  }
+
+  inline void rgbToLumaScalar(const std::uint8_t* const* rgb, std::uint8_t* y, const std::size_t count, const YUVCoefficients& k) {
+    for (std::size_t i = 0; i < count; ++i) {
+      y[i] = clamp8(((k.yR * rgb[0][i] + k.yG * rgb[1][i] + k.yB * rgb[2][i] + 4096) >> 13) + k.yOffset);
+    }
+  }
+
+  // One chroma sample per block of 2x2 pixels of the rows `top` and `bottom`; an odd last column is paired with itself.
+  inline void rgbToChromaScalar(const std::uint8_t* const* top, const std::uint8_t* const* bottom,
+                                std::uint8_t* u, std::uint8_t* v, const std::size_t chromaStep,
+                                const std::size_t count, const YUVCoefficients& k) {
+    for (std::size_t i = 0; i < count; i += 2) {
+      const std::size_t next = i + 1 < count ? i + 1 : i;
+      int average[3];
+      for (int channel = 0; channel < 3; ++channel) {
+        average[channel] = (top[channel][i] + top[channel][next] + bottom[channel][i] + bottom[channel][next] + 2) >> 2;
+      }
+      u[(i >> 1) * chromaStep] = clamp8(((k.uR * average[0] + k.uG * average[1] + k.uB * average[2] + 4096) >> 13) + 128);
+      v[(i >> 1) * chromaStep] = clamp8(((k.vR * average[0] + k.vG * average[1] + k.vB * average[2] + 4096) >> 13) + 128);
+    }
+  }
+
+#if defined(IMG_SIMD_X86)
+
+  /** ----- SSE4.1 kernels ----- **/
+
+  // Luminance of 4 pixels laid out as 16 bytes of RGBA (or BGRA with the matching weights).
+  IMG_SIMD_TARGET_SSE41 inline __m128i luma4SSE41(const __m128i pixels, const __m128i weights) {
+    const __m128i lo = _mm_cvtepu8_epi16(pixels);
+    const __m128i hi = _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8));
+    const __m128i n = _mm_hadd_epi32(_mm_madd_epi16(lo, weights), _mm_madd_epi16(hi, weights));
+    return _mm_srli_epi32(_mm_mullo_epi32(_mm_srli_epi32(n, 3), _mm_set1_epi32(33555)), 22);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void luminanceSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                   const int planes, const int redIndex) {
+    const __m128i weights = redIndex == 0
+      ? _mm_setr_epi16(299, 587, 114, 0, 299, 587, 114, 0)
+      : _mm_setr_epi16(114, 587, 299, 0, 114, 587, 299, 0);
+    const __m128i expand = _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    // The second 16 byte load of a 3 plane block reads 4 bytes past the 8 pixels.
+    const std::size_t margin = planes == 3 ? 2 : 0;
+    std::size_t i = 0;
+    for (; i + 8 + margin <= count; i += 8) {
+      __m128i a, b;
+      if (planes == 4) {
+        a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16));
+      } else {
+        a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3)), expand);
+        b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12)), expand);
+      }
+      const __m128i words = _mm_packus_epi32(luma4SSE41(a, weights), luma4SSE41(b, weights));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+    }
+    luminanceScalar(src + i * planes, dst + i, count - i, planes, redIndex);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void luminanceSSE41(const float* src, float* dst, const std::size_t count,
+                                                   const int planes, const int redIndex) {
+    const __m128d wRed = _mm_set1_pd(0.299);
+    const __m128d wGreen = _mm_set1_pd(0.587);
+    const __m128d wBlue = _mm_set1_pd(0.114);
+    // The last 3 plane pixel is read with a 4 float load.
+    const std::size_t margin = planes == 3 ? 1 : 0;
+    std::size_t i = 0;
+    for (; i + 4 + margin <= count; i += 4) {
+      const float* p = src + i * planes;
+      __m128 c0 = _mm_loadu_ps(p);
+      __m128 c1 = _mm_loadu_ps(p + planes);
+      __m128 c2 = _mm_loadu_ps(p + 2 * planes);
+      __m128 c3 = _mm_loadu_ps(p + 3 * planes);
+      _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+      const __m128 red = redIndex == 0 ? c0 : c2;
+      const __m128 blue = redIndex == 0 ? c2 : c0;
+      // Same products and additions as the scalar double precision formula.
+      const __m128d lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(wRed, _mm_cvtps_pd(red)), _mm_mul_pd(wGreen, _mm_cvtps_pd(c1))),
+                                    _mm_mul_pd(wBlue, _mm_cvtps_pd(blue)));
+      const __m128d hi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(wRed, _mm_cvtps_pd(_mm_movehl_ps(red, red))),
+                                               _mm_mul_pd(wGreen, _mm_cvtps_pd(_mm_movehl_ps(c1, c1)))),
+                                    _mm_mul_pd(wBlue, _mm_cvtps_pd(_mm_movehl_ps(blue, blue))));
+      _mm_storeu_ps(dst + i, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+    }
+    luminanceScalar(src + i * planes, dst + i, count - i, planes, redIndex);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void swapRedBlueSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                     const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+      for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(v, mask));
+      }
+    } else {
+      // 5 pixels per 16 byte block. The last byte is stored unchanged and rewritten by the next block.
+      const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+      for (; i + 6 <= count; i += 5) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm_shuffle_epi8(v, mask));
+      }
+    }
+    swapRedBlueScalar(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void swapRedBlueSSE41(const float* src, float* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i < count; ++i) {
+        const __m128 v = _mm_loadu_ps(src + i * 4);
+        _mm_storeu_ps(dst + i * 4, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)));
+      }
+    }
+    swapRedBlueScalar(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void addAlphaSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                  const bool swap, const std::uint8_t alpha) {
+    const __m128i mask = swap
+      ? _mm_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128)
+      : _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    const __m128i alphaBytes = _mm_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(alpha) << 24));
+    std::size_t i = 0;
+    for (; i + 6 <= count; i += 4) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(v, mask), alphaBytes));
+    }
+    addAlphaScalar(src + i * 3, dst + i * 4, count - i, swap, alpha);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void addAlphaSSE41(const float* src, float* dst, const std::size_t count,
+                                                  const bool swap, const float alpha) {
+    const __m128 alphas = _mm_set1_ps(alpha);
+    std::size_t i = 0;
+    for (; i + 2 <= count; ++i) {
+      __m128 v = _mm_loadu_ps(src + i * 3);
+      if (swap) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      _mm_storeu_ps(dst + i * 4, _mm_blend_ps(v, alphas, 0x8));
+    }
+    addAlphaScalar(src + i * 3, dst + i * 4, count - i, swap, alpha);
+  }
+
+  // Forward only: `dst` may alias `src`, each store ends before the next unread source byte.
+  IMG_SIMD_TARGET_SSE41 inline void dropAlphaSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                   const bool swap) {
+    const __m128i mask = swap
+      ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -128, -128, -128, -128)
+      : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+    std::size_t i = 0;
+    for (; i + 6 <= count; i += 4) {
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm_shuffle_epi8(v, mask));
+    }
+    dropAlphaScalar(src + i * 4, dst + i * 3, count - i, swap);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void dropAlphaSSE41(const float* src, float* dst, const std::size_t count, const bool swap) {
+    std::size_t i = 0;
+    for (; i + 2 <= count; ++i) {
+      __m128 v = _mm_loadu_ps(src + i * 4);
+      if (swap) v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+      _mm_storeu_ps(dst + i * 3, v);
+    }
+    dropAlphaScalar(src + i * 4, dst + i * 3, count - i, swap);
+  }
+
+  // pshufb masks moving 16 pixels of 3 bytes between 3 interleaved vectors and 3 planes.
+  struct Shuffle3Masks {
+    alignas(16) std::int8_t split[3][3][16];  // [plane][source vector]
+    alignas(16) std::int8_t merge[3][3][16];  // [destination vector][plane]
+  };
+
+  constexpr Shuffle3Masks makeShuffle3Masks() {
+    Shuffle3Masks masks{};
+    for (int a = 0; a < 3; ++a) {
+      for (int b = 0; b < 3; ++b) {
+        for (int i = 0; i < 16; ++i) {
+          const int position = 3 * i + a - 16 * b;  // sample `a` of pixel `i` inside vector `b`
+          masks.split[a][b][i] = static_cast<std::int8_t>(position >= 0 && position < 16 ? position : -128);
+          const int sample = 16 * a + i;             // byte `i` of vector `a` is the sample `sample % 3` of the pixel `sample / 3`
+          masks.merge[a][b][i] = static_cast<std::int8_t>(sample % 3 == b ? sample / 3 : -128);
+        }
+      }
+    }
+    return masks;
+  }
+
+  inline constexpr Shuffle3Masks shuffle3Masks = makeShuffle3Masks();
+
+  IMG_SIMD_TARGET_SSE41 inline __m128i loadMask(const std::int8_t* mask) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void deinterleaveSSE41(const std::uint8_t* src, std::uint8_t* const* dst,
+                                                      const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      // Group the samples of 4 pixels by plane in each vector, then transpose the 4x4 blocks of 32 bits.
+      const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+      for (; i + 16 <= count; i += 16) {
+        __m128i v[4];
+        for (int k = 0; k < 4; ++k) {
+          v[k] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4 + 16 * k)), group);
+        }
+        const __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+        const __m128i t1 = _mm_unpackhi_epi32(v[0], v[1]);
+        const __m128i t2 = _mm_unpacklo_epi32(v[2], v[3]);
+        const __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0] + i), _mm_unpacklo_epi64(t0, t2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1] + i), _mm_unpackhi_epi64(t0, t2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[2] + i), _mm_unpacklo_epi64(t1, t3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[3] + i), _mm_unpackhi_epi64(t1, t3));
+      }
+    } else {
+      for (; i + 16 <= count; i += 16) {
+        __m128i v[3];
+        for (int k = 0; k < 3; ++k) {
+          v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 16 * k));
+        }
+        for (int plane = 0; plane < 3; ++plane) {
+          const __m128i samples = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(v[0], loadMask(shuffle3Masks.split[plane][0])),
+                         _mm_shuffle_epi8(v[1], loadMask(shuffle3Masks.split[plane][1]))),
+            _mm_shuffle_epi8(v[2], loadMask(shuffle3Masks.split[plane][2])));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(dst[plane] + i), samples);
+        }
+      }
+    }
+    std::uint8_t* const rest[4] = {dst[0] + i, dst[1] + i, dst[2] + i, planes == 4 ? dst[3] + i : nullptr};
+    deinterleaveScalar(src + i * planes, rest, count - i, planes);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void interleaveSSE41(const std::uint8_t* const* src, std::uint8_t* dst,
+                                                    const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 16 <= count; i += 16) {
+        const __m128i red = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0] + i));
+        const __m128i green = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1] + i));
+        const __m128i blue = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[2] + i));
+        const __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[3] + i));
+        const __m128i redGreenLo = _mm_unpacklo_epi8(red, green);
+        const __m128i redGreenHi = _mm_unpackhi_epi8(red, green);
+        const __m128i blueAlphaLo = _mm_unpacklo_epi8(blue, alpha);
+        const __m128i blueAlphaHi = _mm_unpackhi_epi8(blue, alpha);
+        auto* out = reinterpret_cast<__m128i*>(dst + i * 4);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(redGreenLo, blueAlphaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(redGreenLo, blueAlphaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(redGreenHi, blueAlphaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(redGreenHi, blueAlphaHi));
+      }
+    } else {
+      for (; i + 16 <= count; i += 16) {
+        __m128i v[3];
+        for (int plane = 0; plane < 3; ++plane) {
+          v[plane] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src[plane] + i));
+        }
+        for (int k = 0; k < 3; ++k) {
+          const __m128i bytes = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(v[0], loadMask(shuffle3Masks.merge[k][0])),
+                         _mm_shuffle_epi8(v[1], loadMask(shuffle3Masks.merge[k][1]))),
+            _mm_shuffle_epi8(v[2], loadMask(shuffle3Masks.merge[k][2])));
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 16 * k), bytes);
+        }
+      }
+    }
+    const std::uint8_t* const rest[4] = {src[0] + i, src[1] + i, src[2] + i, planes == 4 ? src[3] + i : nullptr};
+    interleaveScalar(rest, dst + i * planes, count - i, planes);
+  }
+
+  // 4 planes only, 3 planes are left to the scalar loop.
+  IMG_SIMD_TARGET_SSE41 inline void deinterleaveSSE41(const float* src, float* const* dst, const std::size_t count,
+                                                      const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 4 <= count; i += 4) {
+        __m128 v0 = _mm_loadu_ps(src + i * 4);
+        __m128 v1 = _mm_loadu_ps(src + i * 4 + 4);
+        __m128 v2 = _mm_loadu_ps(src + i * 4 + 8);
+        __m128 v3 = _mm_loadu_ps(src + i * 4 + 12);
+        _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+        _mm_storeu_ps(dst[0] + i, v0);
+        _mm_storeu_ps(dst[1] + i, v1);
+        _mm_storeu_ps(dst[2] + i, v2);
+        _mm_storeu_ps(dst[3] + i, v3);
+      }
+    }
+    float* const rest[4] = {dst[0] + i, dst[1] + i, dst[2] + i, planes == 4 ? dst[3] + i : nullptr};
+    deinterleaveScalar(src + i * planes, rest, count - i, planes);
+  }
+
+  // 4 planes only, 3 planes are left to the scalar loop.
+  IMG_SIMD_TARGET_SSE41 inline void interleaveSSE41(const float* const* src, float* dst, const std::size_t count,
+                                                    const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 4 <= count; i += 4) {
+        __m128 v0 = _mm_loadu_ps(src[0] + i);
+        __m128 v1 = _mm_loadu_ps(src[1] + i);
+        __m128 v2 = _mm_loadu_ps(src[2] + i);
+        __m128 v3 = _mm_loadu_ps(src[3] + i);
+        _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+        _mm_storeu_ps(dst + i * 4, v0);
+        _mm_storeu_ps(dst + i * 4 + 4, v1);
+        _mm_storeu_ps(dst + i * 4 + 8, v2);
+        _mm_storeu_ps(dst + i * 4 + 12, v3);
+      }
+    }
+    const float* const rest[4] = {src[0] + i, src[1] + i, src[2] + i, planes == 4 ? src[3] + i : nullptr};
+    interleaveScalar(rest, dst + i * planes, count - i, planes);
+  }
+
+  // Weights of `_mm_madd_epi16` for the pairs (a, b) of `_mm_unpack*_epi16(a, b)`.
+  inline int weightPair(const std::int16_t a, const std::int16_t b) {
+    return static_cast<int>((static_cast<std::uint32_t>(static_cast<std::uint16_t>(b)) << 16) | static_cast<std::uint16_t>(a));
+  }
+
+  // (sum + chroma . weights) >> 13 for 8 pixels, as 16 bit lanes.
+  IMG_SIMD_TARGET_SSE41 inline __m128i yuvChannelSSE41(const __m128i lumaLo, const __m128i lumaHi,
+                                                       const __m128i chromaLo, const __m128i chromaHi, const __m128i weights) {
+    const __m128i lo = _mm_srai_epi32(_mm_add_epi32(lumaLo, _mm_madd_epi16(chromaLo, weights)), 13);
+    const __m128i hi = _mm_srai_epi32(_mm_add_epi32(lumaHi, _mm_madd_epi16(chromaHi, weights)), 13);
+    return _mm_packs_epi32(lo, hi);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void yuvToRgbSSE41(const std::uint8_t* y, const std::uint8_t* u, const std::uint8_t* v,
+                                                  const std::size_t chromaStep, std::uint8_t* const* rgb,
+                                                  const std::size_t count, const YUVCoefficients& k) {
+    const __m128i yOffset = _mm_set1_epi16(static_cast<short>(k.yOffset));
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i lumaWeights = _mm_set1_epi32(weightPair(k.yScale, 4096));
+    const __m128i weights[3] = {
+      _mm_set1_epi32(weightPair(0, k.rV)), _mm_set1_epi32(weightPair(k.gU, k.gV)), _mm_set1_epi32(weightPair(k.bU, 0))
+    };
+    const __m128i even = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i odd = _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i uBytes, vBytes;
+      if (chromaStep == 2) {
+        const __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i));
+        uBytes = _mm_shuffle_epi8(uv, even);
+        vBytes = _mm_shuffle_epi8(uv, odd);
+      } else {
+        uBytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + i / 2));
+        vBytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + i / 2));
+      }
+      // Each chroma sample serves two pixels.
+      uBytes = _mm_unpacklo_epi8(uBytes, uBytes);
+      vBytes = _mm_unpacklo_epi8(vBytes, vBytes);
+      const __m128i luma = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + i));
+
+      __m128i channels[3][2];
+      for (int half = 0; half < 2; ++half) {
+        const __m128i c = _mm_sub_epi16(_mm_cvtepu8_epi16(half ? _mm_srli_si128(luma, 8) : luma), yOffset);
+        const __m128i d = _mm_sub_epi16(_mm_cvtepu8_epi16(half ? _mm_srli_si128(uBytes, 8) : uBytes), bias);
+        const __m128i e = _mm_sub_epi16(_mm_cvtepu8_epi16(half ? _mm_srli_si128(vBytes, 8) : vBytes), bias);
+        const __m128i lumaLo = _mm_madd_epi16(_mm_unpacklo_epi16(c, ones), lumaWeights);
+        const __m128i lumaHi = _mm_madd_epi16(_mm_unpackhi_epi16(c, ones), lumaWeights);
+        const __m128i chromaLo = _mm_unpacklo_epi16(d, e);
+        const __m128i chromaHi = _mm_unpackhi_epi16(d, e);
+        for (int channel = 0; channel < 3; ++channel) {
+          channels[channel][half] = yuvChannelSSE41(lumaLo, lumaHi, chromaLo, chromaHi, weights[channel]);
+        }
+      }
+      for (int channel = 0; channel < 3; ++channel) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb[channel] + i), _mm_packus_epi16(channels[channel][0], channels[channel][1]));
+      }
+    }
+    const std::size_t chroma = (i >> 1) * chromaStep;
+    std::uint8_t* const rest[3] = {rgb[0] + i, rgb[1] + i, rgb[2] + i};
+    yuvToRgbScalar(y + i, u + chroma, v + chroma, chromaStep, rest, count - i, k);
+  }
+
+  // ((a.x + b.y + 4096) >> 13) + offset for 16 pixels given as pairs of 16 bit lanes, packed to bytes.
+  IMG_SIMD_TARGET_SSE41 inline __m128i rgbWeightedSSE41(const __m128i* first, const __m128i* second, const __m128i* third,
+                                                        const __m128i firstWeights, const __m128i thirdWeights,
+                                                        const __m128i offset, const int halves) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i packed[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+    for (int half = 0; half < halves; ++half) {
+      const __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(first[half], second[half]), firstWeights),
+                                       _mm_madd_epi16(_mm_unpacklo_epi16(third[half], ones), thirdWeights));
+      const __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(first[half], second[half]), firstWeights),
+                                       _mm_madd_epi16(_mm_unpackhi_epi16(third[half], ones), thirdWeights));
+      packed[half] = _mm_add_epi16(_mm_packs_epi32(_mm_srai_epi32(lo, 13), _mm_srai_epi32(hi, 13)), offset);
+    }
+    return _mm_packus_epi16(packed[0], packed[1]);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void rgbToLumaSSE41(const std::uint8_t* const* rgb, std::uint8_t* y, const std::size_t count,
+                                                   const YUVCoefficients& k) {
+    const __m128i rgWeights = _mm_set1_epi32(weightPair(k.yR, k.yG));
+    const __m128i bWeights = _mm_set1_epi32(weightPair(k.yB, 4096));
+    const __m128i offset = _mm_set1_epi16(static_cast<short>(k.yOffset));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i channels[3][2];
+      for (int channel = 0; channel < 3; ++channel) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb[channel] + i));
+        channels[channel][0] = _mm_cvtepu8_epi16(bytes);
+        channels[channel][1] = _mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8));
+      }
+      const __m128i luma = rgbWeightedSSE41(channels[0], channels[1], channels[2], rgWeights, bWeights, offset, 2);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), luma);
+    }
+    const std::uint8_t* const rest[3] = {rgb[0] + i, rgb[1] + i, rgb[2] + i};
+    rgbToLumaScalar(rest, y + i, count - i, k);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void rgbToChromaSSE41(const std::uint8_t* const* top, const std::uint8_t* const* bottom,
+                                                     std::uint8_t* u, std::uint8_t* v, const std::size_t chromaStep,
+                                                     const std::size_t count, const YUVCoefficients& k) {
+    const __m128i uRG = _mm_set1_epi32(weightPair(k.uR, k.uG));
+    const __m128i uB = _mm_set1_epi32(weightPair(k.uB, 4096));
+    const __m128i vRG = _mm_set1_epi32(weightPair(k.vR, k.vG));
+    const __m128i vB = _mm_set1_epi32(weightPair(k.vB, 4096));
+    const __m128i offset = _mm_set1_epi16(128);
+    const __m128i pairs = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi16(2);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      // Sums of the horizontal pairs of both rows, rounded to the average of the 2x2 blocks.
+      __m128i average[3];
+      for (int channel = 0; channel < 3; ++channel) {
+        const __m128i upper = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top[channel] + i)), pairs);
+        const __m128i lower = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom[channel] + i)), pairs);
+        average[channel] = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(upper, lower), two), 2);
+      }
+      const __m128i uBytes = rgbWeightedSSE41(&average[0], &average[1], &average[2], uRG, uB, offset, 1);
+      const __m128i vBytes = rgbWeightedSSE41(&average[0], &average[1], &average[2], vRG, vB, offset, 1);
+      if (chromaStep == 2) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + i), _mm_unpacklo_epi8(uBytes, vBytes));
+      } else {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(u + i / 2), uBytes);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(v + i / 2), vBytes);
+      }
+    }
+    const std::size_t chroma = (i >> 1) * chromaStep;
+    const std::uint8_t* const restTop[3] = {top[0] + i, top[1] + i, top[2] + i};
+    const std::uint8_t* const restBottom[3] = {bottom[0] + i, bottom[1] + i, bottom[2] + i};
+    rgbToChromaScalar(restTop, restBottom, u + chroma, v + chroma, chromaStep, count - i, k);
+  }
+
+  // Round, shift back from 2^14 and clamp 4 sums of 32 bits, packed to 4 bytes in the low lanes.
+  IMG_SIMD_TARGET_SSE41 inline __m128i resampleFinishSSE41(const __m128i sum) {
+    const __m128i shifted = _mm_srai_epi32(sum, 14);
+    return _mm_packus_epi16(_mm_packs_epi32(shifted, shifted), _mm_setzero_si128());
+  }
+
+  // Load the samples of 2 pixels of 3 or 4 channels in the low bytes, without reading past them.
+  template<int Planes>
+  IMG_SIMD_TARGET_SSE41 inline __m128i loadPixelPairSSE41(const std::uint8_t* src) {
+    if constexpr (Planes == 4) {
+      return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+    } else {
+      // Two loads instead of a copy of 6 bytes to reload as 8, which would stall the store forwarding.
+      std::int32_t low;
+      std::uint16_t high;
+      std::memcpy(&low, src, sizeof(low));
+      std::memcpy(&high, src + 4, sizeof(high));
+      return _mm_insert_epi16(_mm_cvtsi32_si128(low), high, 2);
+    }
+  }
+
+  // Horizontal resampling of pixels of 3 or 4 channels, 2 taps per step: the samples of two pixels are
+  // paired by channel for `_mm_madd_epi16`.
+  template<int Planes>
+  IMG_SIMD_TARGET_SSE41 inline void resamplePairsSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                       const std::size_t* first, const std::int16_t* weights,
+                                                       const std::size_t taps) {
+    const __m128i round = _mm_set1_epi32(1 << 13);
+    const __m128i pairs = Planes == 4
+      ? _mm_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15)
+      : _mm_setr_epi8(0, 1, 6, 7, 2, 3, 8, 9, 4, 5, 10, 11, -1, -1, -1, -1);
+    for (std::size_t i = 0; i < count; ++i, dst += Planes, weights += taps) {
+      const std::uint8_t* const in = src + first[i] * Planes;
+      __m128i sum = round;
+      std::size_t k = 0;
+      for (; k + 2 <= taps; k += 2) {
+        const __m128i samples = _mm_cvtepu8_epi16(loadPixelPairSSE41<Planes>(in + k * Planes));
+        std::int32_t weightPairBits;
+        std::memcpy(&weightPairBits, weights + k, sizeof(weightPairBits));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_shuffle_epi8(samples, pairs), _mm_set1_epi32(weightPairBits)));
+      }
+      if (k < taps) {
+        std::int32_t pixelBits = 0;
+        std::memcpy(&pixelBits, in + k * Planes, Planes);
+        const __m128i samples = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixelBits));
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(samples, _mm_set1_epi32(weights[k])));
+      }
+      const int packed = _mm_cvtsi128_si32(resampleFinishSSE41(sum));
+      std::memcpy(dst, &packed, Planes);
+    }
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void resampleRowSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                     const int planes, const std::size_t* first,
+                                                     const std::int16_t* weights, const std::size_t taps) {
+    if (planes == 1) {
+      // 8 taps per step, summed across the lanes at the end.
+      for (std::size_t i = 0; i < count; ++i, weights += taps) {
+        const std::uint8_t* const in = src + first[i];
+        __m128i sum = _mm_setzero_si128();
+        std::size_t k = 0;
+        for (; k + 8 <= taps; k += 8) {
+          const __m128i samples = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + k)));
+          sum = _mm_add_epi32(sum, _mm_madd_epi16(samples, _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + k))));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        int total = _mm_cvtsi128_si32(sum) + (1 << 13);
+        for (; k < taps; ++k) total += weights[k] * in[k];
+        dst[i] = clamp8(total >> 14);
+      }
+      return;
+    }
+
+    if (planes == 4) return resamplePairsSSE41<4>(src, dst, count, first, weights, taps);
+    resamplePairsSSE41<3>(src, dst, count, first, weights, taps);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void resampleColumnsSSE41(const std::uint8_t* const* rows, const std::int16_t* weights,
+                                                         const std::size_t taps, std::uint8_t* dst, const std::size_t count) {
+    const __m128i round = _mm_set1_epi32(1 << 13);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i sums[4] = {round, round, round, round};
+      for (std::size_t k = 0; k < taps; k += 2) {
+        // Samples of two rows interleaved, times their pair of weights (the second is 0 past the last row).
+        const __m128i upper = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+        const __m128i lower = k + 1 < taps ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i)) : zero;
+        const __m128i weightPairs = _mm_set1_epi32(weightPair(weights[k], k + 1 < taps ? weights[k + 1] : 0));
+        const __m128i lo = _mm_unpacklo_epi8(upper, lower);
+        const __m128i hi = _mm_unpackhi_epi8(upper, lower);
+        sums[0] = _mm_add_epi32(sums[0], _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), weightPairs));
+        sums[1] = _mm_add_epi32(sums[1], _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), weightPairs));
+        sums[2] = _mm_add_epi32(sums[2], _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), weightPairs));
+        sums[3] = _mm_add_epi32(sums[3], _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), weightPairs));
+      }
+      const __m128i low = _mm_packs_epi32(_mm_srai_epi32(sums[0], 14), _mm_srai_epi32(sums[1], 14));
+      const __m128i high = _mm_packs_epi32(_mm_srai_epi32(sums[2], 14), _mm_srai_epi32(sums[3], 14));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+    }
+    for (; i < count; ++i) {
+      int sum = 1 << 13;
+      for (std::size_t k = 0; k < taps; ++k) sum += weights[k] * rows[k][i];
+      dst[i] = clamp8(sum >> 14);
+    }
+  }
+
+  // Transpose 16x16 bytes in 4 rounds of unpacks; the round `n` interleaves units of 2^n bytes.
+  IMG_SIMD_TARGET_SSE41 inline void transpose16x16SSE41(const std::uint8_t* src, const std::ptrdiff_t srcStride,
+                                                        std::uint8_t* dst, const std::ptrdiff_t dstStride) {
+    __m128i v[16], t[16];
+    for (int row = 0; row < 16; ++row) v[row] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + row * srcStride));
+    for (int i = 0; i < 8; ++i) {
+      t[i] = _mm_unpacklo_epi8(v[2 * i], v[2 * i + 1]);
+      t[i + 8] = _mm_unpackhi_epi8(v[2 * i], v[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      v[i] = _mm_unpacklo_epi16(t[2 * i], t[2 * i + 1]);
+      v[i + 8] = _mm_unpackhi_epi16(t[2 * i], t[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      t[i] = _mm_unpacklo_epi32(v[2 * i], v[2 * i + 1]);
+      t[i + 8] = _mm_unpackhi_epi32(v[2 * i], v[2 * i + 1]);
+    }
+    for (int i = 0; i < 8; ++i) {
+      v[i] = _mm_unpacklo_epi64(t[2 * i], t[2 * i + 1]);
+      v[i + 8] = _mm_unpackhi_epi64(t[2 * i], t[2 * i + 1]);
+    }
+    // The rounds leave the column `c` in the register of index the 4 bits of `c` reversed.
+    constexpr int columns[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    for (int i = 0; i < 16; ++i) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + columns[i] * dstStride), v[i]);
+  }
+
+  // Transpose 4x4 elements of 4 bytes, held in 4 registers.
+  IMG_SIMD_TARGET_SSE41 inline void transpose4x4SSE41(__m128i* v) {
+    const __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+    const __m128i t1 = _mm_unpackhi_epi32(v[0], v[1]);
+    const __m128i t2 = _mm_unpacklo_epi32(v[2], v[3]);
+    const __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+    v[0] = _mm_unpacklo_epi64(t0, t2);
+    v[1] = _mm_unpackhi_epi64(t0, t2);
+    v[2] = _mm_unpacklo_epi64(t1, t3);
+    v[3] = _mm_unpackhi_epi64(t1, t3);
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void transpose4x4x32SSE41(const std::uint8_t* src, const std::ptrdiff_t srcStride,
+                                                         std::uint8_t* dst, const std::ptrdiff_t dstStride) {
+    __m128i v[4];
+    for (int row = 0; row < 4; ++row) v[row] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + row * srcStride));
+    transpose4x4SSE41(v);
+    for (int col = 0; col < 4; ++col) _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col * dstStride), v[col]);
+  }
+
+  // 4x4 pixels of 3 bytes: each row of 12 bytes is spread to 4 bytes per pixel, transposed, then packed back.
+  IMG_SIMD_TARGET_SSE41 inline void transpose4x4x24SSE41(const std::uint8_t* src, const std::ptrdiff_t srcStride,
+                                                         std::uint8_t* dst, const std::ptrdiff_t dstStride) {
+    const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m128i v[4];
+    for (int row = 0; row < 4; ++row) {
+      const std::uint8_t* const in = src + row * srcStride;
+      std::int32_t last;
+      std::memcpy(&last, in + 8, sizeof(last));
+      const __m128i bytes = _mm_insert_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in)), last, 2);
+      v[row] = _mm_shuffle_epi8(bytes, spread);
+    }
+    transpose4x4SSE41(v);
+    for (int col = 0; col < 4; ++col) {
+      std::uint8_t* const out = dst + col * dstStride;
+      const __m128i bytes = _mm_shuffle_epi8(v[col], pack);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), bytes);
+      const std::int32_t last = _mm_extract_epi32(bytes, 2);
+      std::memcpy(out + 8, &last, sizeof(last));
+    }
+  }
+
+  // Blocks of 16x16 elements of 1 byte or 4x4 elements of 3 or 4 bytes, the borders with the scalar kernel.
+  template<std::size_t Bytes>
+  IMG_SIMD_TARGET_SSE41 inline void transposeBlockSSE41(const std::uint8_t* src, const std::ptrdiff_t srcStride,
+                                                        std::uint8_t* dst, const std::ptrdiff_t dstStride,
+                                                        const std::size_t rows, const std::size_t cols) {
+    constexpr std::size_t edge = Bytes == 1 ? 16 : 4;
+    const std::size_t fullRows = rows / edge * edge, fullCols = cols / edge * edge;
+    for (std::size_t row = 0; row < fullRows; row += edge) {
+      const std::uint8_t* const in = src + static_cast<std::ptrdiff_t>(row) * srcStride;
+      for (std::size_t col = 0; col < fullCols; col += edge) {
+        std::uint8_t* const out = dst + static_cast<std::ptrdiff_t>(col) * dstStride + row * Bytes;
+        if constexpr (Bytes == 1) {
+          transpose16x16SSE41(in + col, srcStride, out, dstStride);
+        } else if constexpr (Bytes == 3) {
+          transpose4x4x24SSE41(in + col * 3, srcStride, out, dstStride);
+        } else {
+          transpose4x4x32SSE41(in + col * 4, srcStride, out, dstStride);
+        }
+      }
+    }
+    transposeBlockScalar<Bytes>(src + fullCols * Bytes, srcStride, dst + static_cast<std::ptrdiff_t>(fullCols) * dstStride,
+                                dstStride, rows, cols - fullCols, Bytes);
+    transposeBlockScalar<Bytes>(src + static_cast<std::ptrdiff_t>(fullRows) * srcStride, srcStride, dst + fullRows * Bytes,
+                                dstStride, rows - fullRows, fullCols, Bytes);
+  }
+
+  template<std::size_t Bytes>
+  IMG_SIMD_TARGET_SSE41 inline __m128i reverse16SSE41(const __m128i v) {
+    if constexpr (Bytes == 1) {
+      return _mm_shuffle_epi8(v, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    } else {
+      return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+  }
+
+  // Reverse 16 bytes, or 4 elements of 4 bytes, from both ends at once; the middle with the scalar kernel.
+  template<std::size_t Bytes>
+  IMG_SIMD_TARGET_SSE41 inline void reverseElementsSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count) {
+    constexpr std::size_t step = 16 / Bytes;
+    std::size_t i = 0;
+    for (; 2 * (i + step) <= count; i += step) {
+      const std::size_t j = count - i - step;
+      const __m128i front = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * Bytes));
+      const __m128i back = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j * Bytes));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * Bytes), reverse16SSE41<Bytes>(back));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + j * Bytes), reverse16SSE41<Bytes>(front));
+    }
+    reverseElementsScalar<Bytes>(src + i * Bytes, dst + i * Bytes, count - 2 * i, Bytes);
+  }
+
+  // round(x / 255) on 16 bit lanes, x <= 255 * 255: the sums stay below 2^16 in unsigned arithmetic.
+  IMG_SIMD_TARGET_SSE41 inline __m128i div255SSE41(const __m128i x) {
+    const __m128i biased = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(biased, _mm_srli_epi16(biased, 8)), 8);
+  }
+
+  // `blendSample` on 2 pixels of 16 bit lanes, `as` and `ad` the alpha of each pixel in its 4 lanes.
+  template<Blend Op>
+  IMG_SIMD_TARGET_SSE41 inline __m128i blendSSE41(const __m128i s, const __m128i d, const __m128i as, const __m128i ad) {
+    const __m128i max = _mm_set1_epi16(255);
+    if constexpr (Op == Blend::Over) {
+      return _mm_min_epi16(_mm_add_epi16(s, div255SSE41(_mm_mullo_epi16(d, _mm_sub_epi16(max, as)))), max);
+    } else if constexpr (Op == Blend::Add) {
+      return _mm_min_epi16(_mm_add_epi16(s, d), max);
+    } else {
+      // Every product fits 16 bits, the sums saturate and are clamped to 255 * 255 like the scalar kernel.
+      const __m128i sum = _mm_adds_epu16(_mm_adds_epu16(_mm_mullo_epi16(s, d), _mm_mullo_epi16(s, _mm_sub_epi16(max, ad))),
+                                         _mm_mullo_epi16(d, _mm_sub_epi16(max, as)));
+      return div255SSE41(_mm_min_epu16(sum, _mm_set1_epi16(static_cast<short>(255 * 255))));
+    }
+  }
+
+  // (o * 255 + ao / 2) / ao on 4 lanes of 32 bits: the float quotient of these integers truncates to the exact one.
+  IMG_SIMD_TARGET_SSE41 inline __m128i unpremultiplySSE41(const __m128i o, const __m128i ao) {
+    const __m128i numerator = _mm_add_epi32(_mm_mullo_epi32(o, _mm_set1_epi32(255)), _mm_srli_epi32(ao, 1));
+    const __m128 quotient = _mm_div_ps(_mm_cvtepi32_ps(numerator), _mm_cvtepi32_ps(_mm_max_epi32(ao, _mm_set1_epi32(1))));
+    return _mm_cvttps_epi32(quotient);
+  }
+
+  // Composite 2 pixels held in 16 bit lanes, see `blendRowScalar`.
+  template<Blend Op, bool Premultiplied>
+  IMG_SIMD_TARGET_SSE41 inline __m128i blendPixelsSSE41(__m128i s, __m128i d) {
+    const __m128i alphas = _mm_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+    const __m128i as = _mm_shuffle_epi8(s, alphas);
+    const __m128i ad = _mm_shuffle_epi8(d, alphas);
+    if constexpr (Premultiplied) {
+      return blendSSE41<Op>(s, d, as, ad);
+    } else {
+      // Alpha lanes (3 and 7) kept as they are.
+      s = _mm_blend_epi16(div255SSE41(_mm_mullo_epi16(s, as)), s, 0x88);
+      d = _mm_blend_epi16(div255SSE41(_mm_mullo_epi16(d, ad)), d, 0x88);
+      const __m128i o = blendSSE41<Op>(s, d, as, ad);
+      const __m128i ao = _mm_shuffle_epi8(o, alphas);
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i low = unpremultiplySSE41(_mm_cvtepu16_epi32(o), _mm_cvtepu16_epi32(ao));
+      const __m128i high = unpremultiplySSE41(_mm_unpackhi_epi16(o, zero), _mm_unpackhi_epi16(ao, zero));
+      return _mm_blend_epi16(_mm_min_epi16(_mm_packus_epi32(low, high), _mm_set1_epi16(255)), o, 0x88);
+    }
+  }
+
+  template<Blend Op, bool Premultiplied>
+  IMG_SIMD_TARGET_SSE41 inline void blendRowSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+      const __m128i low = blendPixelsSSE41<Op, Premultiplied>(_mm_cvtepu8_epi16(s), _mm_cvtepu8_epi16(d));
+      const __m128i high = blendPixelsSSE41<Op, Premultiplied>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(low, high));
+    }
+    blendRowScalar(src + i * 4, dst + i * 4, count - i, Op, Premultiplied);
+  }
+
+  // The blend mode and alpha representation resolved once per row, the kernels specialized on both.
+  template<bool Premultiplied>
+  IMG_SIMD_TARGET_SSE41 inline void blendRowSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                  const Blend op) {
+    switch (op) {
+      case Blend::Over: blendRowSSE41<Blend::Over, Premultiplied>(src, dst, count); break;
+      case Blend::Add: blendRowSSE41<Blend::Add, Premultiplied>(src, dst, count); break;
+      default: blendRowSSE41<Blend::Multiply, Premultiplied>(src, dst, count); break;
+    }
+  }
+
+  IMG_SIMD_TARGET_SSE41 inline void blendRowSSE41(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                  const Blend op, const bool premultiplied) {
+    if (premultiplied) {
+      blendRowSSE41<true>(src, dst, count, op);
+    } else {
+      blendRowSSE41<false>(src, dst, count, op);
+    }
+  }
+
+  // `boxMeanRowScalar` on 16 sums per step: a float estimate of the mean, corrected by the exact remainder test.
+  IMG_SIMD_TARGET_SSE41 inline void boxMeanRowSSE41(const std::uint32_t* ahead, const std::uint32_t* behind, std::uint8_t* dst,
+                                                    const std::size_t count, const std::uint32_t area) {
+    const __m128 reciprocal = _mm_set1_ps(1.0f / static_cast<float>(area));
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i odd = _mm_set1_epi32(static_cast<int>(area));
+    const __m128i twice = _mm_set1_epi32(static_cast<int>(2 * area));
+    const __m128i limit = _mm_set1_epi32(static_cast<int>(2 * area - 1));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      __m128i means[4];
+      for (std::size_t k = 0; k < 4; ++k) {
+        const __m128i sum = _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ahead + i + k * 4)),
+                                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(behind + i + k * 4)));
+        __m128i mean = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum), reciprocal), half));
+        // 2 sum + area - 2 mean area lies in [0, 2 area) for the exact mean.
+        const __m128i error = _mm_sub_epi32(_mm_add_epi32(_mm_slli_epi32(sum, 1), odd), _mm_mullo_epi32(mean, twice));
+        mean = _mm_sub_epi32(mean, _mm_cmpgt_epi32(error, limit));
+        means[k] = _mm_add_epi32(mean, _mm_cmplt_epi32(error, _mm_setzero_si128()));
+      }
+      const __m128i low = _mm_packus_epi32(means[0], means[1]);
+      const __m128i high = _mm_packus_epi32(means[2], means[3]);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+    }
+    boxMeanRowScalar(ahead + i, behind + i, dst + i, count - i, area);
+  }
+
+  /**
+   * `sampleStatsScalar` on blocks of `Vectors` x 16 samples, each byte of a block always of the same
+   * channel (16 for 1, 2 or 4 channels, 48 for 3). The sums are kept per pair of 16 bit lanes: `madd`
+   * with (1, 0) or (0, 1) weights splits the even and odd samples, with the sample masked the same
+   * way it squares them.
+   */
+  template<int Vectors>
+  IMG_SIMD_TARGET_SSE41 inline void sampleStatsSSE41(const std::uint8_t* src, const std::size_t count, const int channels,
+                                                     std::uint8_t* min, std::uint8_t* max, std::uint64_t* sum,
+                                                     std::uint64_t* squares) {
+    constexpr std::size_t block = 16 * Vectors;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i evenMask = _mm_set1_epi32(0xFFFF);
+    const __m128i evenOnes = _mm_set1_epi32(1);
+    const __m128i oddOnes = _mm_set1_epi32(1 << 16);
+    std::size_t i = 0;
+    while (i + block <= count) {
+      // The 32 bit lanes of squares take 66051 blocks: flushed every 2^16.
+      const std::size_t blocks = std::min<std::size_t>((count - i) / block, std::size_t{1} << 16);
+      __m128i low[Vectors], high[Vectors], sums[Vectors][4], squareSums[Vectors][4];
+      for (int v = 0; v < Vectors; ++v) {
+        low[v] = _mm_set1_epi8(-1);
+        high[v] = zero;
+        for (int k = 0; k < 4; ++k) sums[v][k] = squareSums[v][k] = zero;
+      }
+      for (std::size_t b = 0; b < blocks; ++b, i += block) {
+        for (int v = 0; v < Vectors; ++v) {
+          const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16 * v));
+          low[v] = _mm_min_epu8(low[v], x);
+          high[v] = _mm_max_epu8(high[v], x);
+          const __m128i halves[2] = {_mm_cvtepu8_epi16(x), _mm_unpackhi_epi8(x, zero)};
+          for (int h = 0; h < 2; ++h) {
+            const __m128i even = _mm_and_si128(halves[h], evenMask);
+            sums[v][2 * h] = _mm_add_epi32(sums[v][2 * h], _mm_madd_epi16(halves[h], evenOnes));
+            sums[v][2 * h + 1] = _mm_add_epi32(sums[v][2 * h + 1], _mm_madd_epi16(halves[h], oddOnes));
+            squareSums[v][2 * h] = _mm_add_epi32(squareSums[v][2 * h], _mm_madd_epi16(halves[h], even));
+            squareSums[v][2 * h + 1] = _mm_add_epi32(squareSums[v][2 * h + 1], _mm_madd_epi16(halves[h], _mm_xor_si128(halves[h], even)));
+          }
+        }
+      }
+      // Back to the channels: byte p of vector v is the channel (16 v + p) % channels.
+      for (int v = 0; v < Vectors; ++v) {
+        alignas(16) std::uint8_t lows[16], highs[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lows), low[v]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(highs), high[v]);
+        for (int p = 0; p < 16; ++p) {
+          const int channel = (16 * v + p) % channels;
+          min[channel] = std::min(min[channel], lows[p]);
+          max[channel] = std::max(max[channel], highs[p]);
+        }
+        for (int k = 0; k < 4; ++k) {
+          alignas(16) std::uint32_t lanes[4], squareLanes[4];
+          _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums[v][k]);
+          _mm_store_si128(reinterpret_cast<__m128i*>(squareLanes), squareSums[v][k]);
+          for (int j = 0; j < 4; ++j) {
+            // Lane j of the half k / 2 holds the sample 2 j (k even) or 2 j + 1 (k odd) of that half.
+            const int channel = (16 * v + 8 * (k / 2) + 2 * j + k % 2) % channels;
+            sum[channel] += lanes[j];
+            squares[channel] += squareLanes[j];
+          }
+        }
+      }
+    }
+    sampleStatsScalar(src + i, count - i, channels, min, max, sum, squares);
+  }
+
+  /** ----- AVX2 kernels ----- **/
+
+  // Luminance of 8 pixels laid out as 32 bytes of RGBA (or BGRA with the matching weights), in pixel order.
+  IMG_SIMD_TARGET_AVX2 inline __m256i luma8AVX2(const __m256i pixels, const __m256i weights) {
+    const __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels));
+    const __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1));
+    // hadd interleaves the 128 bit lanes: [p0 p1 p4 p5 | p2 p3 p6 p7].
+    const __m256i n = _mm256_hadd_epi32(_mm256_madd_epi16(lo, weights), _mm256_madd_epi16(hi, weights));
+    const __m256i q = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(n, 3), _mm256_set1_epi32(33555)), 22);
+    return _mm256_permutevar8x32_epi32(q, _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7));
+  }
+
+  // Load 8 pixels of 3 planes (24 bytes, reading 28) as 32 bytes of 4 planes with a zero fourth plane.
+  IMG_SIMD_TARGET_AVX2 inline __m256i expand8AVX2(const std::uint8_t* src) {
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+                                            0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    const __m256i v = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+    return _mm256_shuffle_epi8(v, expand);
+  }
+
+  IMG_SIMD_TARGET_AVX2 inline void luminanceAVX2(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                 const int planes, const int redIndex) {
+    const __m256i weights = redIndex == 0
+      ? _mm256_setr_epi16(299, 587, 114, 0, 299, 587, 114, 0, 299, 587, 114, 0, 299, 587, 114, 0)
+      : _mm256_setr_epi16(114, 587, 299, 0, 114, 587, 299, 0, 114, 587, 299, 0, 114, 587, 299, 0);
+    const std::size_t margin = planes == 3 ? 2 : 0;
+    std::size_t i = 0;
+    for (; i + 16 + margin <= count; i += 16) {
+      __m256i a, b;
+      if (planes == 4) {
+        a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4 + 32));
+      } else {
+        a = expand8AVX2(src + i * 3);
+        b = expand8AVX2(src + i * 3 + 24);
+      }
+      const __m256i qa = luma8AVX2(a, weights);
+      const __m256i qb = luma8AVX2(b, weights);
+      const __m128i wa = _mm_packus_epi32(_mm256_castsi256_si128(qa), _mm256_extracti128_si256(qa, 1));
+      const __m128i wb = _mm_packus_epi32(_mm256_castsi256_si128(qb), _mm256_extracti128_si256(qb, 1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(wa, wb));
+    }
+    luminanceSSE41(src + i * planes, dst + i, count - i, planes, redIndex);
+  }
+
+  IMG_SIMD_TARGET_AVX2 inline void swapRedBlueAVX2(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                   const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+      for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, mask));
+      }
+    }
+    swapRedBlueSSE41(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  IMG_SIMD_TARGET_AVX2 inline void swapRedBlueAVX2(const float* src, float* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 2 <= count; i += 2) {
+        const __m256 v = _mm256_loadu_ps(src + i * 4);
+        _mm256_storeu_ps(dst + i * 4, _mm256_permute_ps(v, _MM_SHUFFLE(3, 0, 1, 2)));
+      }
+    }
+    swapRedBlueSSE41(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  IMG_SIMD_TARGET_AVX2 inline void addAlphaAVX2(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                const bool swap, const std::uint8_t alpha) {
+    const __m256i mask = swap
+      ? _mm256_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128,
+                         2, 1, 0, -128, 5, 4, 3, -128, 8, 7, 6, -128, 11, 10, 9, -128)
+      : _mm256_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128,
+                         0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+    const __m256i alphaBytes = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(alpha) << 24));
+    std::size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+      const __m256i v = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12)), 1);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alphaBytes));
+    }
+    addAlphaSSE41(src + i * 3, dst + i * 4, count - i, swap, alpha);
+  }
+
+  // Forward only: `dst` may alias `src`.
+  IMG_SIMD_TARGET_AVX2 inline void dropAlphaAVX2(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                                                 const bool swap) {
+    const __m256i mask = swap
+      ? _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -128, -128, -128, -128,
+                         2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -128, -128, -128, -128)
+      : _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128,
+                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+    std::size_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+      const __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4)), mask);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm256_castsi256_si128(v));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3 + 12), _mm256_extracti128_si256(v, 1));
+    }
+    dropAlphaSSE41(src + i * 4, dst + i * 3, count - i, swap);
+  }
+
+#elif defined(IMG_SIMD_NEON)
+
+  /** ----- NEON kernels ----- **/
+
+  inline void luminanceNEON(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                            const int planes, const int redIndex) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      uint8x16_t red, green, blue;
+      if (planes == 4) {
+        const uint8x16x4_t v = vld4q_u8(src + i * 4);
+        red = v.val[redIndex];
+        green = v.val[1];
+        blue = v.val[2 - redIndex];
+      } else {
+        const uint8x16x3_t v = vld3q_u8(src + i * 3);
+        red = v.val[redIndex];
+        green = v.val[1];
+        blue = v.val[2 - redIndex];
+      }
+      const uint16x8_t r16[2] = {vmovl_u8(vget_low_u8(red)), vmovl_u8(vget_high_u8(red))};
+      const uint16x8_t g16[2] = {vmovl_u8(vget_low_u8(green)), vmovl_u8(vget_high_u8(green))};
+      const uint16x8_t b16[2] = {vmovl_u8(vget_low_u8(blue)), vmovl_u8(vget_high_u8(blue))};
+      uint16x8_t words[2];
+      for (int half = 0; half < 2; ++half) {
+        uint32x4_t lo = vmull_n_u16(vget_low_u16(r16[half]), 299);
+        lo = vmlal_n_u16(lo, vget_low_u16(g16[half]), 587);
+        lo = vmlal_n_u16(lo, vget_low_u16(b16[half]), 114);
+        uint32x4_t hi = vmull_n_u16(vget_high_u16(r16[half]), 299);
+        hi = vmlal_n_u16(hi, vget_high_u16(g16[half]), 587);
+        hi = vmlal_n_u16(hi, vget_high_u16(b16[half]), 114);
+        lo = vshrq_n_u32(vmulq_n_u32(vshrq_n_u32(lo, 3), 33555), 22);
+        hi = vshrq_n_u32(vmulq_n_u32(vshrq_n_u32(hi, 3), 33555), 22);
+        words[half] = vcombine_u16(vmovn_u32(lo), vmovn_u32(hi));
+      }
+      vst1q_u8(dst + i, vcombine_u8(vmovn_u16(words[0]), vmovn_u16(words[1])));
+    }
+    luminanceScalar(src + i * planes, dst + i, count - i, planes, redIndex);
+  }
+
+  inline void swapRedBlueNEON(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        const uint8x16_t red = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = red;
+        vst4q_u8(dst + i * 4, v);
+      }
+    } else {
+      for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t v = vld3q_u8(src + i * 3);
+        const uint8x16_t red = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = red;
+        vst3q_u8(dst + i * 3, v);
+      }
+    }
+    swapRedBlueScalar(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  inline void swapRedBlueNEON(const float* src, float* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    if (planes == 4) {
+      for (; i + 4 <= count; i += 4) {
+        float32x4x4_t v = vld4q_f32(src + i * 4);
+        const float32x4_t red = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = red;
+        vst4q_f32(dst + i * 4, v);
+      }
+    }
+    swapRedBlueScalar(src + i * planes, dst + i * planes, count - i, planes);
+  }
+
+  inline void addAlphaNEON(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count,
+                           const bool swap, const std::uint8_t alpha) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      const uint8x16x3_t v = vld3q_u8(src + i * 3);
+      const uint8x16x4_t out = {{v.val[swap ? 2 : 0], v.val[1], v.val[swap ? 0 : 2], vdupq_n_u8(alpha)}};
+      vst4q_u8(dst + i * 4, out);
+    }
+    addAlphaScalar(src + i * 3, dst + i * 4, count - i, swap, alpha);
+  }
+
+  inline void addAlphaNEON(const float* src, float* dst, const std::size_t count, const bool swap, const float alpha) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const float32x4x3_t v = vld3q_f32(src + i * 3);
+      const float32x4x4_t out = {{v.val[swap ? 2 : 0], v.val[1], v.val[swap ? 0 : 2], vdupq_n_f32(alpha)}};
+      vst4q_f32(dst + i * 4, out);
+    }
+    addAlphaScalar(src + i * 3, dst + i * 4, count - i, swap, alpha);
+  }
+
+  // Forward only: `dst` may alias `src`.
+  inline void dropAlphaNEON(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const bool swap) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      const uint8x16x4_t v = vld4q_u8(src + i * 4);
+      const uint8x16x3_t out = {{v.val[swap ? 2 : 0], v.val[1], v.val[swap ? 0 : 2]}};
+      vst3q_u8(dst + i * 3, out);
+    }
+    dropAlphaScalar(src + i * 4, dst + i * 3, count - i, swap);
+  }
+
+  inline void dropAlphaNEON(const float* src, float* dst, const std::size_t count, const bool swap) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      const float32x4x4_t v = vld4q_f32(src + i * 4);
+      const float32x4x3_t out = {{v.val[swap ? 2 : 0], v.val[1], v.val[swap ? 0 : 2]}};
+      vst3q_f32(dst + i * 3, out);
+    }
+    dropAlphaScalar(src + i * 4, dst + i * 3, count - i, swap);
+  }
+
+  inline void deinterleaveNEON(const std::uint8_t* src, std::uint8_t* const* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      if (planes == 4) {
+        const uint8x16x4_t v = vld4q_u8(src + i * 4);
+        for (int plane = 0; plane < 4; ++plane) vst1q_u8(dst[plane] + i, v.val[plane]);
+      } else {
+        const uint8x16x3_t v = vld3q_u8(src + i * 3);
+        for (int plane = 0; plane < 3; ++plane) vst1q_u8(dst[plane] + i, v.val[plane]);
+      }
+    }
+    std::uint8_t* const rest[4] = {dst[0] + i, dst[1] + i, dst[2] + i, planes == 4 ? dst[3] + i : nullptr};
+    deinterleaveScalar(src + i * planes, rest, count - i, planes);
+  }
+
+  inline void interleaveNEON(const std::uint8_t* const* src, std::uint8_t* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+      if (planes == 4) {
+        const uint8x16x4_t v = {{vld1q_u8(src[0] + i), vld1q_u8(src[1] + i), vld1q_u8(src[2] + i), vld1q_u8(src[3] + i)}};
+        vst4q_u8(dst + i * 4, v);
+      } else {
+        const uint8x16x3_t v = {{vld1q_u8(src[0] + i), vld1q_u8(src[1] + i), vld1q_u8(src[2] + i)}};
+        vst3q_u8(dst + i * 3, v);
+      }
+    }
+    const std::uint8_t* const rest[4] = {src[0] + i, src[1] + i, src[2] + i, planes == 4 ? src[3] + i : nullptr};
+    interleaveScalar(rest, dst + i * planes, count - i, planes);
+  }
+
+  inline void deinterleaveNEON(const float* src, float* const* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      if (planes == 4) {
+        const float32x4x4_t v = vld4q_f32(src + i * 4);
+        for (int plane = 0; plane < 4; ++plane) vst1q_f32(dst[plane] + i, v.val[plane]);
+      } else {
+        const float32x4x3_t v = vld3q_f32(src + i * 3);
+        for (int plane = 0; plane < 3; ++plane) vst1q_f32(dst[plane] + i, v.val[plane]);
+      }
+    }
+    float* const rest[4] = {dst[0] + i, dst[1] + i, dst[2] + i, planes == 4 ? dst[3] + i : nullptr};
+    deinterleaveScalar(src + i * planes, rest, count - i, planes);
+  }
+
+  inline void interleaveNEON(const float* const* src, float* dst, const std::size_t count, const int planes) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+      if (planes == 4) {
+        const float32x4x4_t v = {{vld1q_f32(src[0] + i), vld1q_f32(src[1] + i), vld1q_f32(src[2] + i), vld1q_f32(src[3] + i)}};
+        vst4q_f32(dst + i * 4, v);
+      } else {
+        const float32x4x3_t v = {{vld1q_f32(src[0] + i), vld1q_f32(src[1] + i), vld1q_f32(src[2] + i)}};
+        vst3q_f32(dst + i * 3, v);
+      }
+    }
+    const float* const rest[4] = {src[0] + i, src[1] + i, src[2] + i, planes == 4 ? src[3] + i : nullptr};
+    interleaveScalar(rest, dst + i * planes, count - i, planes);
+  }
+
+#endif
+
+  /** ----- Dispatch ----- **/
+
+  /**
+   * Gray level of `count` RGB, BGR, RGBA or BGRA pixels.
+   * @param planes 3 or 4
+   * @param redIndex 0 for RGB(A), 2 for BGR(A)
+   */
+  template<typename T>
+  void luminance(const T* src, T* dst, const std::size_t count, const int planes, const int redIndex) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    const Level current = level();
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+      if (current == Level::AVX2) return luminanceAVX2(src, dst, count, planes, redIndex);
+    }
+    if (current != Level::Scalar) return luminanceSSE41(src, dst, count, planes, redIndex);
+#elif defined(IMG_SIMD_NEON)
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+      if (level() == Level::NEON) return luminanceNEON(src, dst, count, planes, redIndex);
+    }
+#endif
+    luminanceScalar(src, dst, count, planes, redIndex);
+  }
+
+  /**
+   * Exchange the red and blue samples of `count` pixels (RGB <-> BGR, RGBA <-> BGRA).
+   * `dst` may be equal to `src`.
+   * @param planes 3 or 4
+   */
+  template<typename T>
+  void swapRedBlue(const T* src, T* dst, const std::size_t count, const int planes) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    const Level current = level();
+    if (current == Level::AVX2) return swapRedBlueAVX2(src, dst, count, planes);
+    if (current == Level::SSE41) return swapRedBlueSSE41(src, dst, count, planes);
+#elif defined(IMG_SIMD_NEON)
+    if (level() == Level::NEON) return swapRedBlueNEON(src, dst, count, planes);
+#endif
+    swapRedBlueScalar(src, dst, count, planes);
+  }
+
+  /**
+   * Append an alpha sample to `count` pixels of 3 planes (RGB -> RGBA, optionally swapping red and blue).
+   * @param swap exchange red and blue on the way
+   * @param alpha the value of the new alpha sample
+   */
+  template<typename T>
+  void addAlpha(const T* src, T* dst, const std::size_t count, const bool swap, const T alpha) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    const Level current = level();
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+      if (current == Level::AVX2) return addAlphaAVX2(src, dst, count, swap, alpha);
+    }
+    if (current != Level::Scalar) return addAlphaSSE41(src, dst, count, swap, alpha);
+#elif defined(IMG_SIMD_NEON)
+    if (level() == Level::NEON) return addAlphaNEON(src, dst, count, swap, alpha);
+#endif
+    addAlphaScalar(src, dst, count, swap, alpha);
+  }
+
+  /**
+   * Remove the alpha sample of `count` pixels of 4 planes (RGBA -> RGB, optionally swapping red and blue).
+   * Works forward, so `dst` may be equal to `src` to compact a buffer in place.
+   * @param swap exchange red and blue on the way
+   */
+  template<typename T>
+  void dropAlpha(const T* src, T* dst, const std::size_t count, const bool swap) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    const Level current = level();
+    if constexpr (std::is_same_v<T, std::uint8_t>) {
+      if (current == Level::AVX2) return dropAlphaAVX2(src, dst, count, swap);
+    }
+    if (current != Level::Scalar) return dropAlphaSSE41(src, dst, count, swap);
+#elif defined(IMG_SIMD_NEON)
+    if (level() == Level::NEON) return dropAlphaNEON(src, dst, count, swap);
+#endif
+    dropAlphaScalar(src, dst, count, swap);
+  }
+
+  /**
+   * Split `count` interleaved pixels into planes (RGB -> planar RGB, ...): `dst[plane][i]` receives
+   * the sample `plane` of the pixel `i`. The AVX2 level uses the SSE4.1 kernels.
+   * @param dst one pointer per plane, to the sample of the first pixel
+   * @param planes 3 or 4
+   */
+  template<typename T>
+  void deinterleave(const T* src, T* const* dst, const std::size_t count, const int planes) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return deinterleaveSSE41(src, dst, count, planes);
+#elif defined(IMG_SIMD_NEON)
+    if (level() == Level::NEON) return deinterleaveNEON(src, dst, count, planes);
+#endif
+    deinterleaveScalar(src, dst, count, planes);
+  }
+
+  /**
+   * Merge planes into `count` interleaved pixels (planar RGB -> RGB, ...): the sample `plane` of the
+   * pixel `i` is read from `src[plane][i]`. The AVX2 level uses the SSE4.1 kernels.
+   * @param src one pointer per plane, to the sample of the first pixel
+   * @param planes 3 or 4
+   */
+  template<typename T>
+  void interleave(const T* const* src, T* dst, const std::size_t count, const int planes) {
+    static_assert(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, float>, "no vectorized kernel for this type");
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return interleaveSSE41(src, dst, count, planes);
+#elif defined(IMG_SIMD_NEON)
+    if (level() == Level::NEON) return interleaveNEON(src, dst, count, planes);
+#endif
+    interleaveScalar(src, dst, count, planes);
+  }
+
+  /**
+   * Resample a row of 8 bit pixels horizontally, see `resampleRowScalar`. The AVX2 level uses the
+   * SSE4.1 kernel, NEON the scalar one.
+   * @param count the number of output pixels
+   * @param planes the number of interleaved channels, 1, 3 or 4
+   * @param first the first input pixel of every output pixel
+   * @param weights `taps` weights per output pixel, scaled by 2^14
+   */
+  inline void resampleRow(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const int planes,
+                          const std::size_t* first, const std::int16_t* weights, const std::size_t taps) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return resampleRowSSE41(src, dst, count, planes, first, weights, taps);
+#endif
+    resampleRowScalar(src, dst, count, planes, first, weights, taps);
+  }
+
+  /**
+   * Resample `count` samples vertically: `dst[i]` is the weighted sum of `rows[k][i]`, see `resampleColumnsScalar`.
+   * @param rows `taps` input rows
+   * @param weights `taps` weights, scaled by 2^14
+   */
+  inline void resampleColumns(const std::uint8_t* const* rows, const std::int16_t* weights, const std::size_t taps,
+                              std::uint8_t* dst, const std::size_t count) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return resampleColumnsSSE41(rows, weights, taps, dst, count);
+#endif
+    resampleColumnsScalar(rows, weights, taps, dst, count);
+  }
+
+  /**
+   * Transpose a block of `rows` x `cols` elements of `bytes` bytes, see `transposeBlockScalar`.
+   * Elements of 1, 3 and 4 bytes are transposed in registers by the SSE4.1 kernel (used by the AVX2
+   * level too), the other sizes and the NEON level copy them one by one.
+   * @param srcStride the distance between two source rows in bytes, may be negative
+   * @param dstStride the distance between two destination rows in bytes, may be negative
+   */
+  inline void transposeBlock(const std::uint8_t* src, const std::ptrdiff_t srcStride, std::uint8_t* dst,
+                             const std::ptrdiff_t dstStride, const std::size_t rows, const std::size_t cols,
+                             const std::size_t bytes) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) {
+      switch (bytes) {
+        case 1: return transposeBlockSSE41<1>(src, srcStride, dst, dstStride, rows, cols);
+        case 3: return transposeBlockSSE41<3>(src, srcStride, dst, dstStride, rows, cols);
+        case 4: return transposeBlockSSE41<4>(src, srcStride, dst, dstStride, rows, cols);
+        default: break;
+      }
+    }
+#endif
+    switch (bytes) {
+      case 1: return transposeBlockScalar<1>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 2: return transposeBlockScalar<2>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 3: return transposeBlockScalar<3>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 4: return transposeBlockScalar<4>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 6: return transposeBlockScalar<6>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 8: return transposeBlockScalar<8>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 12: return transposeBlockScalar<12>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      case 16: return transposeBlockScalar<16>(src, srcStride, dst, dstStride, rows, cols, bytes);
+      default: return transposeBlockScalar<0>(src, srcStride, dst, dstStride, rows, cols, bytes);
+    }
+  }
+
+  /**
+   * Reverse the order of `count` elements of `bytes` bytes, in place when `dst` is `src`. Elements of
+   * 1 and 4 bytes use the SSE4.1 kernel (AVX2 level included), the others are swapped one by one.
+   */
+  inline void reverseElements(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const std::size_t bytes) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) {
+      if (bytes == 1) return reverseElementsSSE41<1>(src, dst, count);
+      if (bytes == 4) return reverseElementsSSE41<4>(src, dst, count);
+    }
+#endif
+    switch (bytes) {
+      case 1: return reverseElementsScalar<1>(src, dst, count, bytes);
+      case 2: return reverseElementsScalar<2>(src, dst, count, bytes);
+      case 3: return reverseElementsScalar<3>(src, dst, count, bytes);
+      case 4: return reverseElementsScalar<4>(src, dst, count, bytes);
+      case 6: return reverseElementsScalar<6>(src, dst, count, bytes);
+      case 8: return reverseElementsScalar<8>(src, dst, count, bytes);
+      case 12: return reverseElementsScalar<12>(src, dst, count, bytes);
+      case 16: return reverseElementsScalar<16>(src, dst, count, bytes);
+      default: return reverseElementsScalar<0>(src, dst, count, bytes);
+    }
+  }
+
+  /**
+   * Composite a row of 8 bit RGBA or BGRA pixels onto another, see `blendRowScalar`. The AVX2 level
+   * uses the SSE4.1 kernel, NEON the scalar one.
+   * @param premultiplied whether both rows hold premultiplied samples, else straight ones
+   */
+  inline void blendRow(const std::uint8_t* src, std::uint8_t* dst, const std::size_t count, const Blend op,
+                       const bool premultiplied) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return blendRowSSE41(src, dst, count, op, premultiplied);
+#endif
+    blendRowScalar(src, dst, count, op, premultiplied);
+  }
+
+  /**
+   * Means of boxes of 8 bit samples from their sums, see `boxMeanRowScalar`. The AVX2 level uses the
+   * SSE4.1 kernel, NEON the scalar one.
+   */
+  inline void boxMeanRow(const std::uint32_t* ahead, const std::uint32_t* behind, std::uint8_t* dst,
+                         const std::size_t count, const std::uint32_t area) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return boxMeanRowSSE41(ahead, behind, dst, count, area);
+#endif
+    boxMeanRowScalar(ahead, behind, dst, count, area);
+  }
+
+  /**
+   * Accumulate the minimum, maximum, sum and sum of squares of each channel of interleaved 8 bit
+   * samples, see `sampleStatsScalar`. The AVX2 level uses the SSE4.1 kernel, NEON the scalar one.
+   */
+  inline void sampleStats(const std::uint8_t* src, const std::size_t count, const int channels, std::uint8_t* min,
+                          std::uint8_t* max, std::uint64_t* sum, std::uint64_t* squares) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) {
+      return channels == 3 ? sampleStatsSSE41<3>(src, count, channels, min, max, sum, squares)
+                           : sampleStatsSSE41<1>(src, count, channels, min, max, sum, squares);
+    }
+#endif
+    sampleStatsScalar(src, count, channels, min, max, sum, squares);
+  }
+
+  /**
+   * Decode a row of 4:2:0 YUV into planes of red, green and blue. The chroma samples of the row are
+   * `chromaStep` apart: 1 for separate U and V planes (I420), 2 for interleaved ones (NV12, `v = u + 1`).
+   * The AVX2 level uses the SSE4.1 kernel, NEON the scalar one.
+   * @param rgb the red, green and blue planes, `count` samples each
+   */
+  inline void yuvToRgb(const std::uint8_t* y, const std::uint8_t* u, const std::uint8_t* v, const std::size_t chromaStep,
+                       std::uint8_t* const* rgb, const std::size_t count, const YUVCoefficients& coefficients) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return yuvToRgbSSE41(y, u, v, chromaStep, rgb, count, coefficients);
+#endif
+    yuvToRgbScalar(y, u, v, chromaStep, rgb, count, coefficients);
+  }
+
+  /**
+   * Encode the luma of a row given as planes of red, green and blue.
+   * @param rgb the red, green and blue planes, `count` samples each
+   */
+  inline void rgbToLuma(const std::uint8_t* const* rgb, std::uint8_t* y, const std::size_t count,
+                        const YUVCoefficients& coefficients) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return rgbToLumaSSE41(rgb, y, count, coefficients);
+#endif
+    rgbToLumaScalar(rgb, y, count, coefficients);
+  }
+
+  /**
+   * Encode the chroma of two rows given as planes of red, green and blue: one U and one V sample per
+   * block of 2x2 pixels, `chromaStep` apart (see `yuvToRgb`).
+   * @param top the planes of the upper row, `count` samples each
+   * @param bottom the planes of the lower row (the upper one again for the last row of an odd height)
+   */
+  inline void rgbToChroma(const std::uint8_t* const* top, const std::uint8_t* const* bottom,
+                          std::uint8_t* u, std::uint8_t* v, const std::size_t chromaStep,
+                          const std::size_t count, const YUVCoefficients& coefficients) {
+#if defined(IMG_SIMD_X86)
+    if (level() != Level::Scalar) return rgbToChromaSSE41(top, bottom, u, v, chromaStep, count, coefficients);
+#endif
+    rgbToChromaScalar(top, bottom, u, v, chromaStep, count, coefficients);
+  }
+}
+
+#endif // IMG_IMAGE_SIMD_H
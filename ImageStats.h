@@ -0,0 +1,323 @@
+#ifndef IMG_IMAGE_STATS_H
+#define IMG_IMAGE_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  // Statistics computed by `computeStatistics`, combined with `|`.
+  enum class Statistic : unsigned {
+    MinMax = 1,
+    Mean = 2,
+    Variance = 4,   // computes the mean too
+    Histogram = 8,
+    All = 15
+  };
+
+  constexpr Statistic operator|(const Statistic a, const Statistic b) {
+    return static_cast<Statistic>(static_cast<unsigned>(a) | static_cast<unsigned>(b));
+  }
+
+  constexpr bool operator&(const Statistic a, const Statistic b) {
+    return (static_cast<unsigned>(a) & static_cast<unsigned>(b)) != 0;
+  }
+
+  // Statistics of the samples of one channel, the fields not requested left at their default.
+  template<typename T>
+  struct ChannelStatistics {
+    T min{};
+    T max{};
+    double mean{0};
+    double variance{0};  // of the population
+    std::vector<std::uint64_t> histogram;  // bins of equal width over [0, Max], the last one holding Max
+  };
+
+  /**
+   * Statistics of an image, per channel in the order of the planes of its pixels (blue first for
+   * BGR pixels), for `count` pixels.
+   */
+  template<typename Pixel>
+  struct ImageStatistics {
+    std::size_t count{0};
+    std::array<ChannelStatistics<typename Pixel::DataType>, Pixel::PlaneCount> channels;
+  };
+
+  namespace detail {
+    // Running statistics of a chunk of rows, merged in row order by `computeStatistics`.
+    template<typename T>
+    struct StatisticsPartial {
+      // Exact sums of integer samples up to 32 bit, and of their squares up to 16 bit; `double` beyond.
+      template<std::size_t MaxBytes>
+      using Accumulator = std::conditional_t<std::is_floating_point_v<T> || (sizeof(T) > MaxBytes), double,
+                                             std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t>>;
+      using Sum = Accumulator<4>;
+      using Square = Accumulator<2>;
+
+      std::vector<T> min, max;
+      std::vector<Sum> sum;
+      std::vector<Square> squares;
+      std::vector<std::uint64_t> histogram;  // `bins` per channel, channel after channel
+
+      StatisticsPartial(const int channels, const std::size_t bins)
+        : min(static_cast<std::size_t>(channels), std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max()),
+          max(static_cast<std::size_t>(channels), std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest()),
+          sum(static_cast<std::size_t>(channels)), squares(static_cast<std::size_t>(channels)),
+          histogram(static_cast<std::size_t>(channels) * bins) {}
+
+      void merge(const StatisticsPartial& other) {
+        for (std::size_t channel = 0; channel < min.size(); ++channel) {
+          min[channel] = std::min(min[channel], other.min[channel]);
+          max[channel] = std::max(max[channel], other.max[channel]);
+          sum[channel] += other.sum[channel];
+          squares[channel] += other.squares[channel];
+        }
+        for (std::size_t i = 0; i < histogram.size(); ++i) histogram[i] += other.histogram[i];
+      }
+    };
+
+    /**
+     * Histogram of rows of 8 bit samples, one bin per value, in a single pass from which the other
+     * statistics follow. Consecutive pixels count in two copies of the bins, so that runs of equal
+     * samples do not wait on the same counter; the 32 bit counters are flushed before they can wrap.
+     */
+    class SampleHistogram8 {
+    public:
+      explicit SampleHistogram8(const int channels)
+        : channels(static_cast<std::size_t>(channels)), counts(2 * this->channels * 256), totals(this->channels * 256) {}
+
+      void add(const std::uint8_t* row, const std::size_t width) {
+        if (pending + width >= std::numeric_limits<std::uint32_t>::max()) flush();
+        pending += width;
+        std::uint32_t* const first = counts.data();
+        std::uint32_t* const second = counts.data() + channels * 256;
+        std::size_t col = 0;
+        for (; col + 2 <= width; col += 2, row += 2 * channels) {
+          for (std::size_t channel = 0; channel < channels; ++channel) {
+            ++first[channel * 256 + row[channel]];
+            ++second[channel * 256 + row[channels + channel]];
+          }
+        }
+        if (col < width) {
+          for (std::size_t channel = 0; channel < channels; ++channel) ++first[channel * 256 + row[channel]];
+        }
+      }
+
+      // The counts per channel, 256 bins each.
+      const std::vector<std::uint64_t>& finish() {
+        flush();
+        return totals;
+      }
+
+    private:
+      void flush() {
+        const std::size_t bins = channels * 256;
+        for (std::size_t i = 0; i < bins; ++i) {
+          totals[i] += static_cast<std::uint64_t>(counts[i]) + counts[bins + i];
+          counts[i] = counts[bins + i] = 0;
+        }
+        pending = 0;
+      }
+
+      std::size_t channels;
+      std::vector<std::uint32_t> counts;
+      std::vector<std::uint64_t> totals;
+      std::size_t pending{0};
+    };
+
+    /**
+     * Minimum, maximum, sum and sum of squares of interleaved samples in `Lanes` independent lanes,
+     * the lane `i` always of the channel `i % Channels`: the compiler vectorizes the lanes without
+     * reordering any sum. Floating point rows are summed in `T` and added to the totals once per row.
+     */
+    template<typename T, int Channels>
+    void accumulateStatistics(const T* row, const std::size_t count, T* min, T* max, typename StatisticsPartial<T>::Sum* sum,
+                              typename StatisticsPartial<T>::Square* squareSum) {
+      using Sum = typename StatisticsPartial<T>::Sum;
+      using Square = typename StatisticsPartial<T>::Square;
+      using Lane = std::conditional_t<std::is_floating_point_v<T>, T, Sum>;
+      using SquareLane = std::conditional_t<std::is_floating_point_v<T>, T, Square>;
+      constexpr std::size_t Lanes = Channels == 3 ? 12 : 16;
+      T low[Lanes], high[Lanes];
+      Lane sums[Lanes] = {};
+      SquareLane squares[Lanes] = {};
+      for (std::size_t lane = 0; lane < Lanes; ++lane) {
+        low[lane] = min[lane % Channels];
+        high[lane] = max[lane % Channels];
+      }
+      std::size_t i = 0;
+      for (; i + Lanes <= count; i += Lanes) {
+        for (std::size_t lane = 0; lane < Lanes; ++lane) {
+          const T value = row[i + lane];
+          low[lane] = value < low[lane] ? value : low[lane];
+          high[lane] = value > high[lane] ? value : high[lane];
+          sums[lane] += static_cast<Lane>(value);
+          squares[lane] += static_cast<SquareLane>(value) * static_cast<SquareLane>(value);
+        }
+      }
+      for (std::size_t lane = 0; i + lane < count; ++lane) {
+        const T value = row[i + lane];
+        low[lane] = std::min(low[lane], value);
+        high[lane] = std::max(high[lane], value);
+        sums[lane] += static_cast<Lane>(value);
+        squares[lane] += static_cast<SquareLane>(value) * static_cast<SquareLane>(value);
+      }
+      for (std::size_t lane = 0; lane < Lanes; ++lane) {
+        const std::size_t channel = lane % Channels;
+        min[channel] = std::min(min[channel], low[lane]);
+        max[channel] = std::max(max[channel], high[lane]);
+        sum[channel] += static_cast<Sum>(sums[lane]);
+        squareSum[channel] += static_cast<Square>(squares[lane]);
+      }
+    }
+
+    // Bin of a sample among `bins` over [0, max], values outside going to the end bins.
+    template<typename T>
+    std::size_t histogramBin(const T value, const double scale, const std::size_t bins) {
+      const double position = static_cast<double>(value) * scale;
+      if (!(position > 0)) return 0;
+      return std::min(static_cast<std::size_t>(position), bins - 1);
+    }
+  }
+
+  /**
+   * Compute statistics of every channel of an image in one sweep over its samples: the rows are split
+   * on the global thread pool, each chunk with its own privatized accumulators and histogram,
+   * merged once at the end in row order.
+   *
+   * 8 bit samples either count a histogram with one bin per value, from which the minimum, maximum,
+   * mean and variance follow exactly; or, without histogram, run the vectorized kernels of
+   * `ImageSimd.h`. Other types keep vectorizable lanes of minimum, maximum and sums, or one loop with
+   * the histogram. Sums of integer samples up to 32 bit are exact, as are their squares up to 16 bit;
+   * wider ones, and floating point ones, are summed in `double` (per row first for floating point).
+   * @param image the pixels
+   * @param statistics the statistics to compute
+   * @param bins the number of bins of the histograms, of equal width over [0, `Pixel::Max`]
+   * @return the statistics, those not requested left at their default
+   * @throws std::invalid_argument if a histogram is requested with 0 bins
+   */
+  template<typename Pixel>
+  ImageStatistics<Pixel> computeStatistics(const ConstImageView<Pixel>& image, const Statistic statistics = Statistic::All,
+                                           const std::size_t bins = 256) {
+    using T = typename Pixel::DataType;
+    using Partial = detail::StatisticsPartial<T>;
+    constexpr int channels = Pixel::PlaneCount;
+    constexpr bool bytes = std::is_same_v<T, std::uint8_t>;
+    const bool histogram = statistics & Statistic::Histogram;
+    if (histogram && bins == 0) {
+      throw std::invalid_argument("img::computeStatistics: a histogram needs at least one bin");
+    }
+
+    ImageStatistics<Pixel> result;
+    result.count = image.getWidth() * image.getHeight();
+    if (result.count == 0) {
+      if (histogram) {
+        for (auto& channel : result.channels) channel.histogram.assign(bins, 0);
+      }
+      return result;
+    }
+
+    // Planar pixels are read as their planes, one after the other, each a single channel.
+    constexpr int groups = isPlanar<Pixel> ? channels : 1;
+    constexpr int interleaved = isPlanar<Pixel> ? 1 : channels;
+    const std::size_t rowSamples = image.getWidth() * static_cast<std::size_t>(interleaved);
+    const std::size_t partialBins = bytes ? 256 : histogram ? bins : 0;
+    const double scale = static_cast<double>(bins) / static_cast<double>(Pixel::Max);
+
+    const auto reduceRows = [&](const std::size_t first, const std::size_t last) {
+      Partial partial(channels, partialBins);
+      for (int group = 0; group < groups; ++group) {
+        const std::size_t plane = isPlanar<Pixel> ? static_cast<std::size_t>(group) : 0;
+        const T* const base = image.getData() + plane * image.getPlaneStride();
+        if constexpr (bytes) {
+          if (histogram) {
+            detail::SampleHistogram8 counter(interleaved);
+            for (std::size_t row = first; row < last; ++row) counter.add(base + row * image.getStride(), image.getWidth());
+            const std::vector<std::uint64_t>& counts = counter.finish();
+            std::copy(counts.begin(), counts.end(), partial.histogram.begin() + static_cast<std::ptrdiff_t>(plane * 256));
+            continue;
+          }
+          for (std::size_t row = first; row < last; ++row) {
+            simd::sampleStats(base + row * image.getStride(), rowSamples, interleaved, partial.min.data() + plane,
+                              partial.max.data() + plane, partial.sum.data() + plane, partial.squares.data() + plane);
+          }
+        } else {
+          for (std::size_t row = first; row < last; ++row) {
+            const T* const samples = base + row * image.getStride();
+            if (!histogram) {
+              detail::accumulateStatistics<T, interleaved>(samples, rowSamples, partial.min.data() + plane, partial.max.data() + plane,
+                                                           partial.sum.data() + plane, partial.squares.data() + plane);
+              continue;
+            }
+            for (std::size_t col = 0; col < image.getWidth(); ++col) {
+              for (int sample = 0; sample < interleaved; ++sample) {
+                const std::size_t channel = plane + static_cast<std::size_t>(sample);
+                const T value = samples[col * static_cast<std::size_t>(interleaved) + static_cast<std::size_t>(sample)];
+                partial.min[channel] = std::min(partial.min[channel], value);
+                partial.max[channel] = std::max(partial.max[channel], value);
+                partial.sum[channel] += static_cast<typename Partial::Sum>(value);
+                partial.squares[channel] += static_cast<typename Partial::Square>(value) * static_cast<typename Partial::Square>(value);
+                ++partial.histogram[channel * bins + detail::histogramBin(value, scale, bins)];
+              }
+            }
+          }
+        }
+      }
+      return partial;
+    };
+    Partial total = parallelReduceRows(image.getHeight(), rowSamples * groups, reduceRows,
+                                       [](Partial& merged, Partial&& partial) { merged.merge(partial); });
+
+    const auto count = static_cast<double>(result.count);
+    for (std::size_t channel = 0; channel < static_cast<std::size_t>(channels); ++channel) {
+      auto& out = result.channels[channel];
+      if constexpr (bytes) {
+        if (histogram) {
+          // Everything from the bins: exact sums of value x count.
+          const std::uint64_t* const counts = total.histogram.data() + channel * 256;
+          int lowest = 0, highest = 255;
+          while (counts[lowest] == 0) ++lowest;
+          while (counts[highest] == 0) --highest;
+          total.min[channel] = static_cast<T>(lowest);
+          total.max[channel] = static_cast<T>(highest);
+          for (int value = lowest; value <= highest; ++value) {
+            total.sum[channel] += counts[value] * static_cast<std::uint64_t>(value);
+            total.squares[channel] += counts[value] * static_cast<std::uint64_t>(value * value);
+          }
+          out.histogram.assign(bins, 0);
+          for (std::size_t value = 0; value < 256; ++value) out.histogram[detail::histogramBin(value, scale, bins)] += counts[value];
+        }
+      } else if (histogram) {
+        out.histogram.assign(total.histogram.begin() + static_cast<std::ptrdiff_t>(channel * bins),
+                             total.histogram.begin() + static_cast<std::ptrdiff_t>((channel + 1) * bins));
+      }
+      if (statistics & Statistic::MinMax) {
+        out.min = total.min[channel];
+        out.max = total.max[channel];
+      }
+      if (statistics & (Statistic::Mean | Statistic::Variance)) {
+        out.mean = static_cast<double>(total.sum[channel]) / count;
+      }
+      if (statistics & Statistic::Variance) {
+        out.variance = std::max(static_cast<double>(total.squares[channel]) / count - out.mean * out.mean, 0.0);
+      }
+    }
+    return result;
+  }
+
+  template<typename Pixel>
+  ImageStatistics<Pixel> computeStatistics(const Image<Pixel>& image, const Statistic statistics = Statistic::All,
+                                           const std::size_t bins = 256) {
+    return computeStatistics(image.view(), statistics, bins);
+  }
+}
+
+#endif // IMG_IMAGE_STATS_H
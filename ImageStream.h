@@ -0,0 +1,326 @@
+#ifndef IMG_IMAGE_STREAM_H
+#define IMG_IMAGE_STREAM_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Image.h"
+#include "ImageIO.h"
+
+namespace img {
+
+  namespace detail {
+    // Read exactly `size` bytes at `offset`, retrying on short reads
+    inline void readAt(const int fd, void* buffer, std::size_t size, off_t offset, const std::string& path) {
+      auto* bytes = static_cast<char*>(buffer);
+      while (size > 0) {
+        const ssize_t got = ::pread(fd, bytes, size, offset);
+        if (got < 0) {
+          if (errno == EINTR) continue;
+          throwErrno("pread " + path);
+        }
+        if (got == 0) throw std::runtime_error("stream: unexpected end of file " + path);
+        bytes += got;
+        size -= static_cast<std::size_t>(got);
+        offset += got;
+      }
+    }
+
+    // Write exactly `size` bytes at `offset`, retrying on short writes
+    inline void writeAt(const int fd, const void* buffer, std::size_t size, off_t offset, const std::string& path) {
+      const auto* bytes = static_cast<const char*>(buffer);
+      while (size > 0) {
+        const ssize_t written = ::pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+          if (errno == EINTR) continue;
+          throwErrno("pwrite " + path);
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+        offset += written;
+      }
+    }
+  }
+
+  /**
+   * Source of rows read from a file of tightly packed `Pixel` samples, in the machine byte order,
+   * starting at a given offset. Only the rows asked for are read; the file can be larger than memory.
+   */
+  template<typename Pixel>
+  class RawFileReader {
+  public:
+    using PixelType = Pixel;
+    using DataType = typename Pixel::DataType;
+    static_assert(!isPlanar<Pixel>, "raw files hold interleaved pixels");
+
+  private:
+    std::string path;
+    detail::FileDescriptor file;
+    std::size_t width, height;
+    std::size_t dataOffset;
+
+  public:
+    /**
+     * Open a file.
+     * @param path the file to read
+     * @param width the width of the image in pixel
+     * @param height the height of the image in pixel
+     * @param dataOffset the position of the first sample in the file
+     * @throws std::runtime_error if the file cannot be opened or is too small
+     */
+    RawFileReader(const std::string& path, const std::size_t width, const std::size_t height, const std::size_t dataOffset = 0)
+      : path(path), file(::open(path.c_str(), O_RDONLY | O_CLOEXEC)), width(width), height(height), dataOffset(dataOffset) {
+      if (file.fd < 0) detail::throwErrno("open " + path);
+      struct stat status{};
+      if (::fstat(file.fd, &status) != 0) detail::throwErrno("fstat " + path);
+      if (static_cast<std::size_t>(status.st_size) < dataOffset + width * height * Pixel::PlaneCount * sizeof(DataType)) {
+        throw std::runtime_error("stream: " + path + " is smaller than a " + std::to_string(width) + "x" + std::to_string(height) + " image");
+      }
+    }
+
+    // Get image width in pixel
+    [[nodiscard]] std::size_t getWidth() const
+    { return width; }
+
+    // Get image height in pixel
+    [[nodiscard]] std::size_t getHeight() const
+    { return height; }
+
+    /**
+     * Read the rows `[firstRow, firstRow + strip.getHeight())` into `strip`.
+     * @throws std::invalid_argument if the strip does not fit in the image, std::runtime_error on a read error
+     */
+    void read(const std::size_t firstRow, const ImageView<Pixel>& strip) const {
+      if (strip.getWidth() != width || firstRow + strip.getHeight() > height) {
+        throw std::invalid_argument("stream: strip out of the image");
+      }
+      const std::size_t rowBytes = width * Pixel::PlaneCount * sizeof(DataType);
+      const auto offset = static_cast<off_t>(dataOffset + firstRow * rowBytes);
+      if (strip.getStride() == width * Pixel::PlaneCount) {
+        detail::readAt(file.fd, strip.getData(), rowBytes * strip.getHeight(), offset, path);
+      } else {
+        for (std::size_t row = 0; row < strip.getHeight(); ++row) {
+          detail::readAt(file.fd, strip.getRow(row), rowBytes, offset + static_cast<off_t>(row * rowBytes), path);
+        }
+      }
+    }
+  };
+
+  /**
+   * Sink of rows written to a file of tightly packed `Pixel` samples, in the machine byte order,
+   * starting at a given offset. Strips can be written in any order.
+   */
+  template<typename Pixel>
+  class RawFileWriter {
+  public:
+    using PixelType = Pixel;
+    using DataType = typename Pixel::DataType;
+    static_assert(!isPlanar<Pixel>, "raw files hold interleaved pixels");
+
+  private:
+    std::string path;
+    detail::FileDescriptor file;
+    std::size_t width, height;
+    std::size_t dataOffset;
+
+  protected:
+    // Write `size` bytes at the start of the file, used for headers
+    void writePrefix(const void* data, const std::size_t size) const {
+      detail::writeAt(file.fd, data, size, 0, path);
+    }
+
+  public:
+    /**
+     * Create or truncate a file.
+     * @param path the file to write
+     * @param width the width of the image in pixel
+     * @param height the height of the image in pixel
+     * @param dataOffset the position of the first sample in the file
+     * @throws std::runtime_error if the file cannot be created
+     */
+    RawFileWriter(const std::string& path, const std::size_t width, const std::size_t height, const std::size_t dataOffset = 0)
+      : path(path), file(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)),
+        width(width), height(height), dataOffset(dataOffset) {
+      if (file.fd < 0) detail::throwErrno("open " + path);
+    }
+
+    // Get image width in pixel
+    [[nodiscard]] std::size_t getWidth() const
+    { return width; }
+
+    // Get image height in pixel
+    [[nodiscard]] std::size_t getHeight() const
+    { return height; }
+
+    /**
+     * Write `strip` as the rows `[firstRow, firstRow + strip.getHeight())`.
+     * @throws std::invalid_argument if the strip does not fit in the image, std::runtime_error on a write error
+     */
+    void write(const std::size_t firstRow, const ConstImageView<Pixel>& strip) const {
+      if (strip.getWidth() != width || firstRow + strip.getHeight() > height) {
+        throw std::invalid_argument("stream: strip out of the image");
+      }
+      const std::size_t rowBytes = width * Pixel::PlaneCount * sizeof(DataType);
+      const auto offset = static_cast<off_t>(dataOffset + firstRow * rowBytes);
+      if (strip.getStride() == width * Pixel::PlaneCount) {
+        detail::writeAt(file.fd, strip.getData(), rowBytes * strip.getHeight(), offset, path);
+      } else {
+        for (std::size_t row = 0; row < strip.getHeight(); ++row) {
+          detail::writeAt(file.fd, strip.getRow(row), rowBytes, offset + static_cast<off_t>(row * rowBytes), path);
+        }
+      }
+    }
+  };
+
+  /**
+   * Source of rows read from a netpbm file, whose layout must be `Pixel` (see `MappedImage`).
+   */
+  template<typename Pixel>
+  class NetpbmReader : public RawFileReader<Pixel> {
+    static NetpbmHeader readHeader(const std::string& path) {
+      const detail::FileDescriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+      if (file.fd < 0) detail::throwErrno("open " + path);
+      struct stat status{};
+      if (::fstat(file.fd, &status) != 0) detail::throwErrno("fstat " + path);
+      const auto fileSize = static_cast<std::size_t>(status.st_size);
+      // Headers are short, only comments can make them longer than this
+      std::string start(std::min<std::size_t>(fileSize, 64 * 1024), '\0');
+      detail::readAt(file.fd, start.data(), start.size(), 0, path);
+      const NetpbmHeader header = parseNetpbmHeader(start.data(), start.size(), fileSize);
+      const bool matches = detail::withFilePixel(header.depth, [](auto filePixel) {
+        return std::is_same_v<decltype(filePixel), Pixel>;
+      });
+      if (!matches) {
+        throw std::runtime_error("netpbm: " + path + " has " + std::to_string(header.depth) + " planes, not the requested pixel type");
+      }
+      return header;
+    }
+
+    NetpbmReader(const std::string& path, const NetpbmHeader& header)
+      : RawFileReader<Pixel>(path, header.width, header.height, header.dataOffset) {}
+
+  public:
+    /**
+     * Open a netpbm file and read its header.
+     * @throws std::runtime_error if the file cannot be read or its layout is not `Pixel`
+     */
+    explicit NetpbmReader(const std::string& path) : NetpbmReader(path, readHeader(path)) {}
+  };
+
+  /**
+   * Sink of rows written to a netpbm file: PGM for `PixelGray<std::uint8_t>`, PPM for
+   * `PixelRGB<std::uint8_t>` and PAM for `PixelRGBA<std::uint8_t>`. The header is written first.
+   */
+  template<typename Pixel>
+  class NetpbmWriter : public RawFileWriter<Pixel> {
+    static_assert(std::is_same_v<Pixel, PixelGray<std::uint8_t>> || std::is_same_v<Pixel, PixelRGB<std::uint8_t>>
+                  || std::is_same_v<Pixel, PixelRGBA<std::uint8_t>>, "netpbm stores 8-bit gray, RGB or RGBA pixels");
+
+    static std::string makeHeader(const std::size_t width, const std::size_t height) {
+      if constexpr (Pixel::PlaneCount == 4) {
+        return "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height)
+               + "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+      } else {
+        return std::string(Pixel::PlaneCount == 1 ? "P5\n" : "P6\n") + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+      }
+    }
+
+    NetpbmWriter(const std::string& path, const std::size_t width, const std::size_t height, const std::string& header)
+      : RawFileWriter<Pixel>(path, width, height, header.size()) {
+      this->writePrefix(header.data(), header.size());
+    }
+
+  public:
+    /**
+     * Create or truncate a netpbm file and write its header.
+     * @throws std::runtime_error if the file cannot be written
+     */
+    NetpbmWriter(const std::string& path, const std::size_t width, const std::size_t height)
+      : NetpbmWriter(path, width, height, makeHeader(width, height)) {}
+  };
+
+  // Counters of a streamed conversion.
+  struct StreamStats {
+    std::size_t strips{0};       // number of strips converted
+    std::size_t stripRows{0};    // rows per strip (the last one can be shorter)
+    std::size_t bufferBytes{0};  // bytes of all the strip buffers, the peak memory of the conversion
+  };
+
+  /**
+   * Convert an image from `source` to `sink` strip by strip, never holding more than two source strips
+   * and two converted strips. While a strip is converted, the next one is read and the previous one is
+   * written on other threads; the conversion itself runs on the row pool.
+   *
+   * `Source` provides `PixelType`, `getWidth()`, `getHeight()` and `read(firstRow, const ImageView<PixelType>&)`,
+   * `Sink` provides `PixelType`, `getWidth()`, `getHeight()` and `write(firstRow, const ConstImageView<PixelType>&)`,
+   * like `RawFileReader` and `RawFileWriter`. `read` and `write` are called from other threads, one call at a time.
+   * @param source where the rows come from
+   * @param sink where the converted rows go
+   * @param stripRows the number of rows per strip, 0 for strips of about 4 MiB of source samples
+   * @param resource the memory resource allocating the strips
+   * @throws std::invalid_argument if the source and the sink sizes differ, or the first error of a read or a write
+   */
+  template<typename Source, typename Sink>
+  StreamStats streamConvert(Source& source, Sink& sink, std::size_t stripRows = 0,
+                            std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+    using SrcPixel = typename Source::PixelType;
+    using DstPixel = typename Sink::PixelType;
+    const std::size_t width = source.getWidth(), height = source.getHeight();
+    if (sink.getWidth() != width || sink.getHeight() != height) {
+      throw std::invalid_argument("stream: source and destination must have the same size");
+    }
+    StreamStats stats;
+    if (width == 0 || height == 0) return stats;
+
+    const std::size_t srcRowBytes = width * SrcPixel::PlaneCount * sizeof(typename SrcPixel::DataType);
+    const std::size_t dstRowBytes = width * DstPixel::PlaneCount * sizeof(typename DstPixel::DataType);
+    if (stripRows == 0) stripRows = std::max<std::size_t>((std::size_t{4} << 20) / srcRowBytes, 1);
+    stripRows = std::min(stripRows, height);
+    stats.stripRows = stripRows;
+    stats.strips = (height + stripRows - 1) / stripRows;
+    stats.bufferBytes = 2 * stripRows * (srcRowBytes + dstRowBytes);
+
+    Image<SrcPixel> input[2] = {{width, stripRows, uninitialized, RowAlignment::Packed, resource},
+                                {width, stripRows, uninitialized, RowAlignment::Packed, resource}};
+    Image<DstPixel> output[2] = {{width, stripRows, uninitialized, RowAlignment::Packed, resource},
+                                 {width, stripRows, uninitialized, RowAlignment::Packed, resource}};
+    const auto rowsOf = [&](const std::size_t strip) { return std::min(stripRows, height - strip * stripRows); };
+    const auto inputView = [&](const std::size_t strip) {
+      return ImageView<SrcPixel>(width, rowsOf(strip), input[strip % 2].view().getData());
+    };
+    const auto outputView = [&](const std::size_t strip) {
+      return ImageView<DstPixel>(width, rowsOf(strip), output[strip % 2].view().getData());
+    };
+
+    // Declared after the buffers: on an exception the pending reads and writes finish before the buffers go.
+    std::future<void> reading, writing;
+    source.read(0, inputView(0));
+    for (std::size_t strip = 0; strip < stats.strips; ++strip) {
+      if (strip + 1 < stats.strips) {
+        reading = std::async(std::launch::async, [&source, &inputView, &stripRows, strip] {
+          source.read((strip + 1) * stripRows, inputView(strip + 1));
+        });
+      }
+      convert(ConstImageView<SrcPixel>(inputView(strip)), outputView(strip));
+      if (writing.valid()) writing.get();
+      writing = std::async(std::launch::async, [&sink, &outputView, &stripRows, strip] {
+        sink.write(strip * stripRows, outputView(strip));
+      });
+      if (reading.valid()) reading.get();
+    }
+    writing.get();
+    return stats;
+  }
+}
+
+#endif // IMG_IMAGE_STREAM_H
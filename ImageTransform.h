@@ -0,0 +1,237 @@
+#ifndef IMG_IMAGE_TRANSFORM_H
+#define IMG_IMAGE_TRANSFORM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  /**
+   * Orientation of an image, numbered like the EXIF orientation tag: the operation that displays
+   * upright an image stored with that tag. The rotations are clockwise.
+   */
+  enum class Orientation {
+    Identity = 1,
+    FlipHorizontal = 2,  // mirror the columns
+    Rotate180 = 3,
+    FlipVertical = 4,    // mirror the rows
+    Transpose = 5,       // mirror along the main diagonal: the pixel (x, y) moves to (y, x)
+    Rotate90 = 6,
+    Transverse = 7,      // mirror along the other diagonal
+    Rotate270 = 8
+  };
+
+  // Whether an orientation exchanges the width and the height of the image.
+  constexpr bool swapsAxes(const Orientation orientation) {
+    return static_cast<int>(orientation) >= static_cast<int>(Orientation::Transpose);
+  }
+
+  namespace detail {
+    // Side of the square tiles transposed at once, in elements: a tile row is about one cache line, so
+    // the rows of a tile stay in L1 even when the stride of the image maps them to the same cache set.
+    constexpr std::size_t transposeTile(const std::size_t bytes) {
+      return bytes <= 1 ? 64 : bytes <= 2 ? 32 : bytes <= 4 ? 16 : 8;
+    }
+
+    /**
+     * Transpose `width` x `height` elements tile by tile, the bands of tiles of a destination row on the
+     * global thread pool. Both strides may be negative, which turns the transposition into the rotations.
+     */
+    inline void transposeTiled(const std::uint8_t* src, const std::ptrdiff_t srcStride, std::uint8_t* dst,
+                               const std::ptrdiff_t dstStride, const std::size_t width, const std::size_t height,
+                               const std::size_t bytes) {
+      const std::size_t tile = transposeTile(bytes);
+      const std::size_t bands = (width + tile - 1) / tile;
+      parallelRows(bands, tile * height, [&](const std::size_t firstBand, const std::size_t lastBand) {
+        for (std::size_t band = firstBand; band < lastBand; ++band) {
+          const std::size_t col = band * tile;
+          const std::size_t cols = std::min(tile, width - col);
+          for (std::size_t row = 0; row < height; row += tile) {
+            simd::transposeBlock(src + static_cast<std::ptrdiff_t>(row) * srcStride + col * bytes, srcStride,
+                                 dst + static_cast<std::ptrdiff_t>(col) * dstStride + row * bytes, dstStride,
+                                 std::min(tile, height - row), cols, bytes);
+          }
+        }
+      });
+    }
+
+    // Transpose a square of `size` x `size` elements in place, swapping the tiles on both sides of the diagonal.
+    inline void transposeSquareInPlace(std::uint8_t* data, const std::ptrdiff_t stride, const std::size_t size,
+                                       const std::size_t bytes) {
+      const std::size_t tile = transposeTile(bytes);
+      const std::size_t bands = (size + tile - 1) / tile;
+      parallelRows(bands, tile * size, [&](const std::size_t firstBand, const std::size_t lastBand) {
+        std::vector<std::uint8_t> buffer(tile * tile * bytes);
+        const auto tileStride = static_cast<std::ptrdiff_t>(tile * bytes);
+        for (std::size_t band = firstBand; band < lastBand; ++band) {
+          // The tiles (band, other) and (other, band) for other >= band, the diagonal one on its own.
+          const std::size_t row = band * tile;
+          const std::size_t rows = std::min(tile, size - row);
+          for (std::size_t col = row; col < size; col += tile) {
+            const std::size_t cols = std::min(tile, size - col);
+            std::uint8_t* const upper = data + static_cast<std::ptrdiff_t>(row) * stride + col * bytes;
+            std::uint8_t* const lower = data + static_cast<std::ptrdiff_t>(col) * stride + row * bytes;
+            simd::transposeBlock(upper, stride, buffer.data(), tileStride, rows, cols, bytes);
+            if (col != row) simd::transposeBlock(lower, stride, upper, stride, cols, rows, bytes);
+            for (std::size_t r = 0; r < cols; ++r) {
+              std::memcpy(lower + static_cast<std::ptrdiff_t>(r) * stride, buffer.data() + r * tile * bytes, rows * bytes);
+            }
+          }
+        }
+      });
+    }
+
+    /**
+     * Orient a grid of `width` x `height` elements of `bytes` bytes: the pixels of interleaved images,
+     * the samples of one plane of planar ones. The strides are in bytes.
+     */
+    inline void orientElements(const std::uint8_t* src, const std::ptrdiff_t srcStride, std::uint8_t* dst,
+                               const std::ptrdiff_t dstStride, const std::size_t width, const std::size_t height,
+                               const std::size_t bytes, const Orientation orientation) {
+      if (width == 0 || height == 0) return;
+      const auto lastSrcRow = static_cast<std::ptrdiff_t>(height - 1) * srcStride;
+      const auto lastDstRow = static_cast<std::ptrdiff_t>(width - 1) * dstStride;
+      switch (orientation) {
+        case Orientation::Transpose:
+          return transposeTiled(src, srcStride, dst, dstStride, width, height, bytes);
+        case Orientation::Rotate90:
+          return transposeTiled(src + lastSrcRow, -srcStride, dst, dstStride, width, height, bytes);
+        case Orientation::Rotate270:
+          return transposeTiled(src, srcStride, dst + lastDstRow, -dstStride, width, height, bytes);
+        case Orientation::Transverse:
+          return transposeTiled(src + lastSrcRow, -srcStride, dst + lastDstRow, -dstStride, width, height, bytes);
+        default:
+          break;
+      }
+
+      // The other orientations keep the rows: a copy or a reversal of each, from the same or the mirrored row.
+      const bool mirrorRows = orientation == Orientation::FlipVertical || orientation == Orientation::Rotate180;
+      const bool reverse = orientation == Orientation::FlipHorizontal || orientation == Orientation::Rotate180;
+      parallelRows(height, width * bytes, [&](const std::size_t firstRow, const std::size_t lastRow) {
+        for (std::size_t row = firstRow; row < lastRow; ++row) {
+          const std::uint8_t* const in = src + static_cast<std::ptrdiff_t>(mirrorRows ? height - 1 - row : row) * srcStride;
+          std::uint8_t* const out = dst + static_cast<std::ptrdiff_t>(row) * dstStride;
+          if (reverse) {
+            simd::reverseElements(in, out, width, bytes);
+          } else {
+            std::memcpy(out, in, width * bytes);
+          }
+        }
+      });
+    }
+
+    // Orient a square grid of elements, or any grid for the orientations that keep the axes, in place.
+    inline void orientElementsInPlace(std::uint8_t* data, const std::ptrdiff_t stride, const std::size_t width,
+                                      const std::size_t height, const std::size_t bytes, const Orientation orientation) {
+      if (width == 0 || height == 0) return;
+      if (swapsAxes(orientation)) {
+        // Transpose, then mirror what is left: the rotations and the transverse are a transposition and a flip.
+        transposeSquareInPlace(data, stride, width, bytes);
+        const Orientation rest = orientation == Orientation::Rotate90 ? Orientation::FlipHorizontal
+          : orientation == Orientation::Rotate270 ? Orientation::FlipVertical
+          : orientation == Orientation::Transverse ? Orientation::Rotate180 : Orientation::Identity;
+        return orientElementsInPlace(data, stride, width, height, bytes, rest);
+      }
+
+      const bool mirrorRows = orientation == Orientation::FlipVertical || orientation == Orientation::Rotate180;
+      const bool reverse = orientation == Orientation::FlipHorizontal || orientation == Orientation::Rotate180;
+      const std::size_t rowBytes = width * bytes;
+      // Mirrored rows are handled in pairs, the top one driving; the middle row of an odd height pairs with itself.
+      const std::size_t rows = mirrorRows ? (height + 1) / 2 : height;
+      parallelRows(rows, width * bytes * (mirrorRows ? 2 : 1), [&](const std::size_t firstRow, const std::size_t lastRow) {
+        for (std::size_t row = firstRow; row < lastRow; ++row) {
+          std::uint8_t* const top = data + static_cast<std::ptrdiff_t>(row) * stride;
+          std::uint8_t* const bottom = data + static_cast<std::ptrdiff_t>(mirrorRows ? height - 1 - row : row) * stride;
+          if (top != bottom) std::swap_ranges(top, top + rowBytes, bottom);
+          if (reverse) {
+            simd::reverseElements(top, top, width, bytes);
+            if (top != bottom) simd::reverseElements(bottom, bottom, width, bytes);
+          }
+        }
+      });
+    }
+
+    // Size in bytes of the elements oriented together: a pixel of interleaved images, a sample of planar ones.
+    template<typename Pixel>
+    constexpr std::size_t orientedBytes = pixelStep<Pixel> * sizeof(typename Pixel::DataType);
+  }
+
+  /**
+   * Orient the pixels of `src` into `dst`, which has the size of the result: the size of `src`, with
+   * the width and the height exchanged for the orientations that swap the axes.
+   *
+   * The transpositions and the rotations by 90 and 270 degrees go through square tiles small enough
+   * for the L1 cache, each transposed in registers by the SIMD kernels for pixels of 1, 3 and 4 bytes
+   * (`Gray8`, `RGB8` and `RGBA8`, planar 8 bit samples); the bands of tiles are split on the global
+   * thread pool. The flips and the half turn copy or reverse whole rows.
+   * @param src the source pixels
+   * @param dst the destination pixels, which must not overlap the source
+   * @param orientation the operation to apply
+   * @throws std::invalid_argument if `dst` does not have the size of the result
+   */
+  template<typename Pixel>
+  void orient(const ConstImageView<Pixel>& src, const ImageView<Pixel>& dst, const Orientation orientation) {
+    const bool swap = swapsAxes(orientation);
+    if (dst.getWidth() != (swap ? src.getHeight() : src.getWidth()) || dst.getHeight() != (swap ? src.getWidth() : src.getHeight())) {
+      throw std::invalid_argument("img::orient: the destination does not have the size of the oriented image");
+    }
+    using T = typename Pixel::DataType;
+    constexpr int planes = isPlanar<Pixel> ? Pixel::PlaneCount : 1;
+    for (int plane = 0; plane < planes; ++plane) {
+      detail::orientElements(reinterpret_cast<const std::uint8_t*>(src.getData() + plane * src.getPlaneStride() * isPlanar<Pixel>),
+                             static_cast<std::ptrdiff_t>(src.getStride() * sizeof(T)),
+                             reinterpret_cast<std::uint8_t*>(dst.getData() + plane * dst.getPlaneStride() * isPlanar<Pixel>),
+                             static_cast<std::ptrdiff_t>(dst.getStride() * sizeof(T)),
+                             src.getWidth(), src.getHeight(), detail::orientedBytes<Pixel>, orientation);
+    }
+  }
+
+  /**
+   * Orient an image, see the overload above.
+   * @param src the source pixels
+   * @param orientation the operation to apply
+   * @return the oriented image
+   */
+  template<typename Pixel>
+  Image<Pixel> orient(const ConstImageView<Pixel>& src, const Orientation orientation) {
+    const bool swap = swapsAxes(orientation);
+    Image<Pixel> result(swap ? src.getHeight() : src.getWidth(), swap ? src.getWidth() : src.getHeight(), uninitialized);
+    orient(src, result.view(), orientation);
+    return result;
+  }
+
+  template<typename Pixel>
+  Image<Pixel> orient(const Image<Pixel>& src, const Orientation orientation) {
+    return orient(src.view(), orientation);
+  }
+
+  /**
+   * Orient the pixels of a view in place, without a second image: the flips and the half turn for
+   * every size, the orientations that swap the axes only for square images, as a tiled transposition
+   * followed by a flip.
+   * @param image the pixels to orient
+   * @param orientation the operation to apply
+   * @throws std::invalid_argument if `orientation` swaps the axes of an image that is not square
+   */
+  template<typename Pixel>
+  void orientInPlace(const ImageView<Pixel>& image, const Orientation orientation) {
+    if (swapsAxes(orientation) && image.getWidth() != image.getHeight()) {
+      throw std::invalid_argument("img::orientInPlace: only square images can swap their axes in place");
+    }
+    using T = typename Pixel::DataType;
+    constexpr int planes = isPlanar<Pixel> ? Pixel::PlaneCount : 1;
+    for (int plane = 0; plane < planes; ++plane) {
+      detail::orientElementsInPlace(reinterpret_cast<std::uint8_t*>(image.getData() + plane * image.getPlaneStride() * isPlanar<Pixel>),
+                                    static_cast<std::ptrdiff_t>(image.getStride() * sizeof(T)),
+                                    image.getWidth(), image.getHeight(), detail::orientedBytes<Pixel>, orientation);
+    }
+  }
+}
+
+#endif // IMG_IMAGE_TRANSFORM_H
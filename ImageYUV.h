@@ -0,0 +1,442 @@
+#ifndef IMG_IMAGE_YUV_H
+#define IMG_IMAGE_YUV_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Image.h"
+
+namespace img {
+
+  // Matrix of a YUV color space: ITU-R BT.601 (SD video, JPEG) or BT.709 (HD video).
+  enum class YUVMatrix { BT601, BT709 };
+
+  // Range of the samples: limited to Y in [16, 235] and U, V in [16, 240] (video), or full [0, 255] (JPEG).
+  enum class YUVRange { Limited, Full };
+
+  // Color space of a YUV frame.
+  struct YUVSpace {
+    YUVMatrix matrix{YUVMatrix::BT601};
+    YUVRange range{YUVRange::Limited};
+  };
+
+  /**
+   * NV12: a plane of luma, then one plane of interleaved U and V samples of half the width and half
+   * the height (4:2:0). The output of most hardware video decoders.
+   */
+  struct NV12 {
+    static constexpr std::size_t ChromaStep = 2;
+  };
+
+  /**
+   * I420: a plane of luma, then a plane of U and a plane of V samples of half the width and half the
+   * height (4:2:0). The output of most software video decoders.
+   */
+  struct I420 {
+    static constexpr std::size_t ChromaStep = 1;
+  };
+
+  namespace detail {
+    constexpr std::int16_t fixed13(const double value) {
+      return static_cast<std::int16_t>(value * 8192 + (value < 0 ? -0.5 : 0.5));
+    }
+
+    // Fixed point coefficients of the kernels of `ImageSimd.h` for a color space.
+    constexpr simd::YUVCoefficients makeYUVCoefficients(const YUVSpace space) {
+      const double kr = space.matrix == YUVMatrix::BT601 ? 0.299 : 0.2126;
+      const double kb = space.matrix == YUVMatrix::BT601 ? 0.114 : 0.0722;
+      const double kg = 1 - kr - kb;
+      const bool limited = space.range == YUVRange::Limited;
+      const double lumaScale = limited ? 219.0 / 255 : 1;
+      const double chromaScale = limited ? 224.0 / 255 : 1;
+
+      simd::YUVCoefficients k{};
+      k.yOffset = limited ? 16 : 0;
+      k.yScale = fixed13(1 / lumaScale);
+      k.rV = fixed13(2 * (1 - kr) / chromaScale);
+      k.gU = fixed13(-2 * kb * (1 - kb) / kg / chromaScale);
+      k.gV = fixed13(-2 * kr * (1 - kr) / kg / chromaScale);
+      k.bU = fixed13(2 * (1 - kb) / chromaScale);
+      // The weights of a channel sum exactly to its scale: white stays white, gray has no chroma.
+      k.yR = fixed13(kr * lumaScale);
+      k.yB = fixed13(kb * lumaScale);
+      k.yG = static_cast<std::int16_t>(fixed13(lumaScale) - k.yR - k.yB);
+      k.uR = fixed13(-kr / (2 * (1 - kb)) * chromaScale);
+      k.uB = fixed13(0.5 * chromaScale);
+      k.uG = static_cast<std::int16_t>(-k.uR - k.uB);
+      k.vR = fixed13(0.5 * chromaScale);
+      k.vB = fixed13(-kb / (2 * (1 - kr)) * chromaScale);
+      k.vG = static_cast<std::int16_t>(-k.vR - k.vB);
+      return k;
+    }
+
+    // Pixels converted per step, through planes small enough to stay in the L1 cache.
+    inline constexpr std::size_t yuvChunk = 512;
+
+    // Planar layout the kernels read or write for a pixel type: with alpha when the pixel has one,
+    // so that the transposition to an interleaved layout is vectorized.
+    template<typename Pixel>
+    using YUVPlanes = std::conditional_t<!PixelLayout<Pixel>::Known || PixelLayout<Pixel>::Alpha >= 0,
+                                         PlanarRGBA<std::uint8_t>, PlanarRGB<std::uint8_t>>;
+  }
+
+  /**
+   * Read-only, non-owning view over a 4:2:0 YUV frame of 8 bit samples stored elsewhere (a decoder
+   * output, ...). The chroma planes have `(width + 1) / 2` samples per row and `(height + 1) / 2` rows.
+   * @tparam Format img::NV12 or img::I420
+   */
+  template<typename Format>
+  class ConstYUVView {
+  protected:
+    const std::uint8_t* luma{nullptr};
+    const std::uint8_t* chroma[2]{nullptr, nullptr};  // the first U and the first V sample
+    std::size_t width{0}, height{0}, lumaStride{0}, chromaStride{0};
+    YUVSpace space{};
+
+  public:
+    using FormatType = Format;
+
+    /**
+     * Empty view with width and height equal 0.
+     */
+    ConstYUVView() = default;
+
+    /**
+     * Wrap a frame stored in one buffer: the luma plane then the chroma plane(s), with tightly packed rows.
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @param data the first luma sample
+     * @param space the color space of the samples
+     */
+    ConstYUVView(const std::size_t width, const std::size_t height, const std::uint8_t* data, const YUVSpace space = {})
+      : ConstYUVView(width, height, data, width, data + width * height,
+                     Format::ChromaStep == 2 ? nullptr : data + width * height + chromaWidth(width) * chromaHeight(height),
+                     chromaWidth(width) * Format::ChromaStep, space) {}
+
+    /**
+     * Wrap a NV12 frame of two planes.
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @param luma the first luma sample
+     * @param lumaStride the distance between two luma rows (0 for tightly packed rows)
+     * @param uv the first U sample, followed by the first V sample
+     * @param uvStride the distance between two chroma rows (0 for tightly packed rows)
+     * @param space the color space of the samples
+     */
+    ConstYUVView(const std::size_t width, const std::size_t height, const std::uint8_t* luma, const std::size_t lumaStride,
+                 const std::uint8_t* uv, const std::size_t uvStride, const YUVSpace space = {})
+      : ConstYUVView(width, height, luma, lumaStride, uv, uv + 1, uvStride, space) {
+      static_assert(Format::ChromaStep == 2, "img::ConstYUVView: separate U and V planes need the I420 constructor");
+    }
+
+    /**
+     * Wrap a I420 frame of three planes.
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @param luma the first luma sample
+     * @param lumaStride the distance between two luma rows (0 for tightly packed rows)
+     * @param u the first U sample
+     * @param v the first V sample
+     * @param chromaStride the distance between two rows of the U and the V planes (0 for tightly packed rows)
+     * @param space the color space of the samples
+     */
+    ConstYUVView(const std::size_t width, const std::size_t height, const std::uint8_t* luma, const std::size_t lumaStride,
+                 const std::uint8_t* u, const std::uint8_t* v, const std::size_t chromaStride, const YUVSpace space = {})
+      : luma(luma), chroma{u, Format::ChromaStep == 2 ? u + 1 : v}, width(width), height(height),
+        lumaStride(lumaStride == 0 ? width : lumaStride),
+        chromaStride(chromaStride == 0 ? chromaWidth(width) * Format::ChromaStep : chromaStride), space(space) {}
+
+    // Get the number of chroma samples per row for a width
+    static constexpr std::size_t chromaWidth(const std::size_t width)
+    { return (width + 1) / 2; }
+
+    // Get the number of chroma rows for a height
+    static constexpr std::size_t chromaHeight(const std::size_t height)
+    { return (height + 1) / 2; }
+
+    // Get frame width in pixel
+    [[nodiscard]] std::size_t getWidth() const
+    { return width; }
+
+    // Get frame height in pixel
+    [[nodiscard]] std::size_t getHeight() const
+    { return height; }
+
+    // Get the color space of the samples
+    [[nodiscard]] YUVSpace getSpace() const
+    { return space; }
+
+    // Get the distance between two luma rows
+    [[nodiscard]] std::size_t getLumaStride() const
+    { return lumaStride; }
+
+    // Get the distance between two chroma rows
+    [[nodiscard]] std::size_t getChromaStride() const
+    { return chromaStride; }
+
+    // Get the first luma sample of a row
+    const std::uint8_t* getLumaRow(const std::size_t row) const
+    { return luma + row * lumaStride; }
+
+    // Get the first U sample of a chroma row (the V samples follow them in NV12)
+    const std::uint8_t* getURow(const std::size_t chromaRow) const
+    { return chroma[0] + chromaRow * chromaStride; }
+
+    // Get the first V sample of a chroma row
+    const std::uint8_t* getVRow(const std::size_t chromaRow) const
+    { return chroma[1] + chromaRow * chromaStride; }
+
+    // Decode the frame into a new image: `img::ImageBGRA frame = nv12;`
+    template<typename Pixel>
+    operator Image<Pixel>() const;
+  };
+
+  /**
+   * Mutable, non-owning view over a 4:2:0 YUV frame, see `ConstYUVView`.
+   * @tparam Format img::NV12 or img::I420
+   */
+  template<typename Format>
+  class YUVView : public ConstYUVView<Format> {
+  public:
+    /**
+     * Empty view with width and height equal 0.
+     */
+    YUVView() = default;
+
+    // Wrap a frame stored in one buffer, see `ConstYUVView`
+    YUVView(const std::size_t width, const std::size_t height, std::uint8_t* data, const YUVSpace space = {})
+      : ConstYUVView<Format>(width, height, data, space) {}
+
+    // Wrap a NV12 frame of two planes, see `ConstYUVView`
+    YUVView(const std::size_t width, const std::size_t height, std::uint8_t* luma, const std::size_t lumaStride,
+            std::uint8_t* uv, const std::size_t uvStride, const YUVSpace space = {})
+      : ConstYUVView<Format>(width, height, luma, lumaStride, uv, uvStride, space) {}
+
+    // Wrap a I420 frame of three planes, see `ConstYUVView`
+    YUVView(const std::size_t width, const std::size_t height, std::uint8_t* luma, const std::size_t lumaStride,
+            std::uint8_t* u, std::uint8_t* v, const std::size_t chromaStride, const YUVSpace space = {})
+      : ConstYUVView<Format>(width, height, luma, lumaStride, u, v, chromaStride, space) {}
+
+    std::uint8_t* getLumaRow(const std::size_t row) const
+    { return const_cast<std::uint8_t*>(ConstYUVView<Format>::getLumaRow(row)); }
+
+    std::uint8_t* getURow(const std::size_t chromaRow) const
+    { return const_cast<std::uint8_t*>(ConstYUVView<Format>::getURow(chromaRow)); }
+
+    std::uint8_t* getVRow(const std::size_t chromaRow) const
+    { return const_cast<std::uint8_t*>(ConstYUVView<Format>::getVRow(chromaRow)); }
+  };
+
+  /**
+   * Decode a YUV frame into the pixels of an image, with the vectorized kernels of `ImageSimd.h`.
+   * Every pixel takes the chroma of its block of 2x2 pixels. The rows are split on the global
+   * thread pool; other pixel types than 8 bit RGB(A) go through the conversion engine from 8 bit RGB(A).
+   * @param src the frame
+   * @param dst the destination pixels, of the same size
+   * @throws std::invalid_argument if the sizes differ
+   */
+  template<typename Format, typename Pixel>
+  void convert(const ConstYUVView<Format>& src, const ImageView<Pixel>& dst) {
+    if (src.getWidth() != dst.getWidth() || src.getHeight() != dst.getHeight()) {
+      throw std::invalid_argument("img::convert: source and destination sizes differ");
+    }
+    using Planes = detail::YUVPlanes<Pixel>;
+    constexpr std::size_t step = Format::ChromaStep;
+    constexpr std::size_t chunk = detail::yuvChunk;
+    const simd::YUVCoefficients coefficients = detail::makeYUVCoefficients(src.getSpace());
+    const std::size_t width = src.getWidth();
+    const std::size_t planeStride = dst.getPlaneStride();
+
+    parallelRows(src.getHeight(), width * Pixel::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      std::uint8_t planes[4][chunk];
+      std::fill_n(planes[3], chunk, std::uint8_t{255});
+      for (std::size_t row = firstRow; row < lastRow; ++row) {
+        const std::uint8_t* const luma = src.getLumaRow(row);
+        const std::uint8_t* const u = src.getURow(row / 2);
+        const std::uint8_t* const v = src.getVRow(row / 2);
+        typename Pixel::DataType* const out = dst.getRow(row);
+        for (std::size_t col = 0; col < width; col += chunk) {
+          const std::size_t count = std::min(chunk, width - col);
+          if constexpr (std::is_same_v<Pixel, Planes>) {
+            // Decoded straight into the planes of the image.
+            std::uint8_t* const rgb[3] = {out + col, out + planeStride + col, out + 2 * planeStride + col};
+            simd::yuvToRgb(luma + col, u + col / 2 * step, v + col / 2 * step, step, rgb, count, coefficients);
+            if constexpr (Pixel::PlaneCount == 4) std::fill_n(out + 3 * planeStride + col, count, std::uint8_t{255});
+          } else {
+            std::uint8_t* const rgb[3] = {planes[0], planes[1], planes[2]};
+            simd::yuvToRgb(luma + col, u + col / 2 * step, v + col / 2 * step, step, rgb, count, coefficients);
+            convertRowPlanar<Planes, Pixel>(planes[0], chunk, out + col * pixelStep<Pixel>, planeStride, count);
+          }
+        }
+      }
+    });
+  }
+
+  /**
+   * Encode the pixels of an image into a YUV frame, with the vectorized kernels of `ImageSimd.h`.
+   * The chroma of a block of 2x2 pixels is the one of their average color (the last column or row of
+   * an odd size is averaged with itself). Pairs of rows are split on the global thread pool.
+   * @param src the source pixels
+   * @param dst the frame, of the same size
+   * @throws std::invalid_argument if the sizes differ
+   */
+  template<typename Pixel, typename Format>
+  void convert(const ConstImageView<Pixel>& src, const YUVView<Format>& dst) {
+    if (src.getWidth() != dst.getWidth() || src.getHeight() != dst.getHeight()) {
+      throw std::invalid_argument("img::convert: source and destination sizes differ");
+    }
+    using Planes = detail::YUVPlanes<Pixel>;
+    constexpr std::size_t step = Format::ChromaStep;
+    constexpr std::size_t chunk = detail::yuvChunk;
+    const simd::YUVCoefficients coefficients = detail::makeYUVCoefficients(dst.getSpace());
+    const std::size_t width = src.getWidth();
+    const std::size_t height = src.getHeight();
+    const std::size_t planeStride = src.getPlaneStride();
+
+    const std::size_t chromaRows = ConstYUVView<Format>::chromaHeight(height);
+    parallelRows(chromaRows, 2 * width * Pixel::PlaneCount, [&](const std::size_t firstRow, const std::size_t lastRow) {
+      std::uint8_t planes[2][4][chunk];
+      for (std::size_t chromaRow = firstRow; chromaRow < lastRow; ++chromaRow) {
+        const std::size_t rows[2] = {2 * chromaRow, std::min(2 * chromaRow + 1, height - 1)};
+        for (std::size_t col = 0; col < width; col += chunk) {
+          const std::size_t count = std::min(chunk, width - col);
+          const std::uint8_t* rgb[2][3];
+          for (int i = 0; i < 2; ++i) {
+            const typename Pixel::DataType* const in = src.getRow(rows[i]) + col * pixelStep<Pixel>;
+            if constexpr (std::is_same_v<Pixel, Planes>) {
+              for (int channel = 0; channel < 3; ++channel) rgb[i][channel] = in + channel * planeStride;
+            } else {
+              if (i == 0 || rows[1] != rows[0]) {
+                convertRowPlanar<Pixel, Planes>(in, planeStride, planes[i][0], chunk, count);
+              }
+              for (int channel = 0; channel < 3; ++channel) rgb[i][channel] = planes[rows[1] != rows[0] ? i : 0][channel];
+            }
+          }
+          simd::rgbToLuma(rgb[0], dst.getLumaRow(rows[0]) + col, count, coefficients);
+          if (rows[1] != rows[0]) simd::rgbToLuma(rgb[1], dst.getLumaRow(rows[1]) + col, count, coefficients);
+          simd::rgbToChroma(rgb[0], rgb[1], dst.getURow(chromaRow) + col / 2 * step, dst.getVRow(chromaRow) + col / 2 * step,
+                            step, count, coefficients);
+        }
+      }
+    });
+  }
+
+  template<typename Format>
+  template<typename Pixel>
+  ConstYUVView<Format>::operator Image<Pixel>() const {
+    Image<Pixel> image(width, height, uninitialized);
+    convert(*this, image.view());
+    return image;
+  }
+
+  /**
+   * A 4:2:0 YUV frame of 8 bit samples owning its buffer: the luma plane then the chroma plane(s),
+   * with tightly packed rows, as decoders and encoders exchange them.
+   *
+   * Frames are encoded from images by their constructor, and decoded into images by the conversion
+   * to `Image`: `img::NV12Image frame(rgb); img::ImageBGRA bgra = frame;`
+   * @tparam Format img::NV12 or img::I420
+   */
+  template<typename Format>
+  class YUVImage {
+    std::size_t width{0}, height{0};
+    YUVSpace space{};
+    std::pmr::vector<std::uint8_t> buffer;
+
+  public:
+    using FormatType = Format;
+
+    /**
+     * Empty frame with width and height equal 0.
+     */
+    YUVImage() = default;
+
+    /**
+     * Construct a black frame.
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @param space the color space of the samples
+     * @param resource the memory resource of the buffer
+     */
+    YUVImage(const std::size_t width, const std::size_t height, const YUVSpace space = {},
+             std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : width(width), height(height), space(space), buffer(frameBytes(width, height), 128, resource) {
+      std::fill_n(buffer.begin(), width * height, static_cast<std::uint8_t>(space.range == YUVRange::Limited ? 16 : 0));
+    }
+
+    /**
+     * Encode the pixels of a view.
+     * @param other the source pixels
+     * @param space the color space of the samples
+     * @param resource the memory resource of the buffer
+     */
+    template<typename Pixel>
+    explicit YUVImage(const ConstImageView<Pixel>& other, const YUVSpace space = {},
+                      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : width(other.getWidth()), height(other.getHeight()), space(space), buffer(frameBytes(width, height), resource) {
+      convert(other, view());
+    }
+
+    template<typename Pixel>
+    explicit YUVImage(const Image<Pixel>& other, const YUVSpace space = {},
+                      std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+      : YUVImage(other.view(), space, resource) {}
+
+    /**
+     * Get the size of the buffer of a frame.
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @return the size in bytes
+     */
+    static std::size_t frameBytes(const std::size_t width, const std::size_t height) {
+      return width * height + 2 * ConstYUVView<Format>::chromaWidth(width) * ConstYUVView<Format>::chromaHeight(height);
+    }
+
+    // Get frame width in pixel
+    [[nodiscard]] std::size_t getWidth() const
+    { return width; }
+
+    // Get frame height in pixel
+    [[nodiscard]] std::size_t getHeight() const
+    { return height; }
+
+    // Get the color space of the samples
+    [[nodiscard]] YUVSpace getSpace() const
+    { return space; }
+
+    // Get the pointer to the buffer
+    const std::uint8_t* getData() const
+    { return buffer.data(); }
+
+    std::uint8_t* getData()
+    { return buffer.data(); }
+
+    // Get a mutable view over the samples of the frame
+    YUVView<Format> view()
+    { return YUVView<Format>(width, height, buffer.data(), space); }
+
+    // Get a read-only view over the samples of the frame
+    ConstYUVView<Format> view() const
+    { return ConstYUVView<Format>(width, height, buffer.data(), space); }
+
+    // Frames can be passed wherever a read-only view is expected
+    operator ConstYUVView<Format>() const
+    { return view(); }
+
+    // Decode the frame into a new image
+    template<typename Pixel>
+    operator Image<Pixel>() const
+    { return view(); }
+  };
+
+  // Some pretty aliases
+  using NV12Image = YUVImage<NV12>;
+  using I420Image = YUVImage<I420>;
+}
+
+#endif // IMG_IMAGE_YUV_H
@@ -0,0 +1,1273 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <execution>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Image.h"
+#include "ImageBatch.h"
+#include "ImageComposite.h"
+#include "ImageExpr.h"
+#include "ImageFilter.h"
+#include "ImageIO.h"
+#include "ImageInstrumentation.h"
+#include "ImageResize.h"
+#include "ImageStats.h"
+#include "ImageStream.h"
+#include "ImageTransform.h"
+#include "ImageYUV.h"
+
+/** ----- Conversion engine ----- **/
+
+constexpr std::size_t benchWidth = 1920;
+constexpr std::size_t benchHeight = 1080;
+
+/**
+ * Build a 1080p image filled with a non uniform pattern.
+ * @tparam Pixel the Pixel type of the image
+ */
+template<typename Pixel>
+img::Image<Pixel> makeBenchImage(const std::size_t width = benchWidth, const std::size_t height = benchHeight) {
+  using T = typename Pixel::DataType;
+  std::vector<T> raw(width * height * Pixel::PlaneCount);
+  for (std::size_t i = 0; i < raw.size(); ++i) {
+    if constexpr (std::is_floating_point_v<T>) {
+      raw[i] = static_cast<T>(i % 256) / static_cast<T>(255);
+    } else {
+      raw[i] = static_cast<T>(i % 256);
+    }
+  }
+  return img::Image<Pixel>(width, height, raw.data());
+}
+
+/**
+ * Bytes read and written by a conversion of a whole image, used for the GB/s counter.
+ */
+template<typename PixelSrc, typename PixelDst>
+constexpr std::size_t conversionBytes(const std::size_t width, const std::size_t height) {
+  return width * height * (PixelSrc::PlaneCount * sizeof(typename PixelSrc::DataType)
+                           + PixelDst::PlaneCount * sizeof(typename PixelDst::DataType));
+}
+
+// Conversion through the compile-time selected row kernels.
+template<typename PixelSrc, typename PixelDst>
+void BM_Convert(benchmark::State& state) {
+  const auto src = makeBenchImage<PixelSrc>();
+  img::Image<PixelDst> dst(benchWidth, benchHeight);
+  for (auto _ : state) {
+    dst = src;
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(benchWidth, benchHeight)));
+}
+
+// Per pixel getColor / cross_product / setColor loop, the way conversions were written before the row kernels.
+template<typename PixelSrc, typename PixelDst>
+void BM_ConvertPerPixel(benchmark::State& state) {
+  using T_dst = typename PixelDst::DataType;
+  const auto src = makeBenchImage<PixelSrc>();
+  img::Image<PixelDst> dst(benchWidth, benchHeight);
+  for (auto _ : state) {
+    for (std::size_t row = 0; row < benchHeight; ++row) {
+      for (std::size_t col = 0; col < benchWidth; ++col) {
+        const auto srcColor = src.getColor(col, row);
+        dst.setColor(col, row, {
+          img::cross_product<T_dst>(srcColor.red),
+          img::cross_product<T_dst>(srcColor.green),
+          img::cross_product<T_dst>(srcColor.blue),
+          img::cross_product<T_dst>(srcColor.alpha)
+        });
+      }
+    }
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(benchWidth, benchHeight)));
+}
+
+#define IMG_BENCH_CONVERT(Src, Dst) \
+  BENCHMARK_TEMPLATE(BM_Convert, Src, Dst); \
+  BENCHMARK_TEMPLATE(BM_ConvertPerPixel, Src, Dst)
+
+using RGB8 = img::PixelRGB<std::uint8_t>;
+using BGR8 = img::PixelBGR<std::uint8_t>;
+using RGBA8 = img::PixelRGBA<std::uint8_t>;
+using BGRA8 = img::PixelBGRA<std::uint8_t>;
+using Gray8 = img::PixelGray<std::uint8_t>;
+using RGBf = img::PixelRGB<float>;
+
+IMG_BENCH_CONVERT(RGB8, BGR8);
+IMG_BENCH_CONVERT(BGR8, RGBA8);
+IMG_BENCH_CONVERT(RGB8, RGBA8);
+IMG_BENCH_CONVERT(RGBA8, BGRA8);
+IMG_BENCH_CONVERT(RGBA8, RGB8);
+IMG_BENCH_CONVERT(Gray8, RGBA8);
+IMG_BENCH_CONVERT(RGB8, Gray8);
+IMG_BENCH_CONVERT(RGB8, RGBf);
+IMG_BENCH_CONVERT(RGBf, RGB8);
+
+/** ----- SIMD kernels ----- **/
+
+// 4K conversion with the kernels forced to one SIMD level (0 scalar, 1 SSE4.1, 2 AVX2, 3 NEON).
+template<typename PixelSrc, typename PixelDst>
+void BM_ConvertSimdLevel(benchmark::State& state) {
+  const auto requested = static_cast<img::simd::Level>(state.range(0));
+  img::simd::setLevel(requested);
+  if (img::simd::level() != requested) {
+    img::simd::setLevel(img::simd::detectLevel());
+    state.SkipWithError("SIMD level not supported by this CPU");
+    return;
+  }
+  constexpr std::size_t width = 3840, height = 2160;
+  const auto src = makeBenchImage<PixelSrc>(width, height);
+  img::Image<PixelDst> dst(width, height);
+  for (auto _ : state) {
+    dst = src;
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(width, height)));
+}
+
+#define IMG_BENCH_SIMD(Src, Dst) \
+  BENCHMARK_TEMPLATE(BM_ConvertSimdLevel, Src, Dst)->DenseRange(0, 3)
+
+using Grayf = img::PixelGray<float>;
+using RGBAf = img::PixelRGBA<float>;
+using BGRAf = img::PixelBGRA<float>;
+
+IMG_BENCH_SIMD(RGB8, Gray8);
+IMG_BENCH_SIMD(RGBA8, Gray8);
+IMG_BENCH_SIMD(RGB8, BGR8);
+IMG_BENCH_SIMD(RGBA8, BGRA8);
+IMG_BENCH_SIMD(RGB8, RGBA8);
+IMG_BENCH_SIMD(RGBA8, RGB8);
+IMG_BENCH_SIMD(RGBf, Grayf);
+IMG_BENCH_SIMD(RGBAf, BGRAf);
+IMG_BENCH_SIMD(RGBf, RGBAf);
+
+/** ----- Views ----- **/
+
+// A 1080p BGR frame arriving in an external buffer, turned into RGBA.
+void BM_ExternalFrameThroughBufferConstructor(benchmark::State& state) {
+  const auto frame = makeBenchImage<BGR8>();
+  for (auto _ : state) {
+    const img::ImageBGR copy(benchWidth, benchHeight, frame.getData());
+    const img::ImageRGBA rgba(copy);
+    benchmark::DoNotOptimize(rgba.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<BGR8, RGBA8>(benchWidth, benchHeight)));
+}
+BENCHMARK(BM_ExternalFrameThroughBufferConstructor);
+
+void BM_ExternalFrameThroughView(benchmark::State& state) {
+  const auto frame = makeBenchImage<BGR8>();
+  for (auto _ : state) {
+    const img::ConstImageView<BGR8> view(benchWidth, benchHeight, frame.getData());
+    const img::ImageRGBA rgba(view);
+    benchmark::DoNotOptimize(rgba.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<BGR8, RGBA8>(benchWidth, benchHeight)));
+}
+BENCHMARK(BM_ExternalFrameThroughView);
+
+/** ----- Row stride ----- **/
+
+// Row by row conversion of an odd-width 4K image, source and destination rows packed (0) or padded to 32 / 64 bytes.
+template<typename PixelSrc, typename PixelDst>
+void BM_RowAlignment(benchmark::State& state) {
+  const auto alignment = static_cast<img::RowAlignment>(state.range(0));
+  constexpr std::size_t width = 3837, height = 2160;
+  const img::Image<PixelSrc> src(makeBenchImage<PixelSrc>(width, height).view(), alignment);
+  img::Image<PixelDst> dst(width, height, alignment);
+  for (auto _ : state) {
+    img::convert(src.view(), dst.view());
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(width, height)));
+}
+
+BENCHMARK_TEMPLATE(BM_RowAlignment, RGBA8, BGRA8)->Arg(0)->Arg(32)->Arg(64);
+BENCHMARK_TEMPLATE(BM_RowAlignment, RGBA8, Gray8)->Arg(0)->Arg(32)->Arg(64);
+BENCHMARK_TEMPLATE(BM_RowAlignment, RGBAf, BGRAf)->Arg(0)->Arg(32)->Arg(64);
+
+/** ----- Fill ----- **/
+
+// Build a 4K RGBA frame and overwrite it with a converted source:
+// 0 = column-major setColor blue fill (the old constructor), 1 = blue constructor, 2 = uninitialized constructor.
+void BM_ConstructAndOverwrite(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  const auto src = makeBenchImage<BGR8>(width, height);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      img::ImageRGBA frame(width, height, img::uninitialized);
+      const img::ImageRGBA::ColorType blue{0, 0, 255, 255};
+      for (std::size_t col = 0; col < width; ++col) {
+        for (std::size_t row = 0; row < height; ++row) {
+          frame.setColor(col, row, blue);
+        }
+      }
+      img::convert(src.view(), frame.view());
+      benchmark::DoNotOptimize(frame.getData());
+    } else if (state.range(0) == 1) {
+      img::ImageRGBA frame(width, height);
+      img::convert(src.view(), frame.view());
+      benchmark::DoNotOptimize(frame.getData());
+    } else {
+      img::ImageRGBA frame(width, height, img::uninitialized);
+      img::convert(src.view(), frame.view());
+      benchmark::DoNotOptimize(frame.getData());
+    }
+  }
+}
+BENCHMARK(BM_ConstructAndOverwrite)->DenseRange(0, 2);
+
+// Fill of a 4K image with one color.
+template<typename Pixel>
+void BM_Fill(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  img::Image<Pixel> image(width, height, img::uninitialized);
+  for (auto _ : state) {
+    image.fill({Pixel::Max, 0, Pixel::Max, Pixel::Max});
+    benchmark::DoNotOptimize(image.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * width * height * Pixel::PlaneCount * sizeof(typename Pixel::DataType)));
+}
+BENCHMARK_TEMPLATE(BM_Fill, RGB8);
+BENCHMARK_TEMPLATE(BM_Fill, RGBA8);
+BENCHMARK_TEMPLATE(BM_Fill, RGBf);
+
+/** ----- In place conversion ----- **/
+
+// Swap red and blue of a 4K RGBA frame back and forth: 0 = converting constructor, 1 = convertInPlace.
+void BM_SwizzleInPlace(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  auto rgba = makeBenchImage<RGBA8>(width, height);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      const img::ImageBGRA bgra(rgba);
+      rgba = img::ImageRGBA(bgra);
+    } else {
+      img::ImageBGRA bgra = rgba.convertInPlace<BGRA8>();
+      rgba = bgra.convertInPlace<RGBA8>();
+    }
+    benchmark::DoNotOptimize(rgba.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2 * conversionBytes<RGBA8, BGRA8>(width, height)));
+}
+BENCHMARK(BM_SwizzleInPlace)->DenseRange(0, 2);
+
+// Drop the alpha of a 4K RGBA frame: 0 = converting constructor, 1 = convertInPlace (the source is rebuilt untimed).
+void BM_DropAlphaInPlace(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  const auto source = makeBenchImage<RGBA8>(width, height);
+  for (auto _ : state) {
+    state.PauseTiming();
+    img::ImageRGBA rgba(source);
+    state.ResumeTiming();
+    if (state.range(0) == 0) {
+      const img::ImageRGB rgb(rgba);
+      benchmark::DoNotOptimize(rgb.getData());
+    } else {
+      const img::ImageRGB rgb = rgba.convertInPlace<RGB8>();
+      benchmark::DoNotOptimize(rgb.getData());
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<RGBA8, RGB8>(width, height)));
+}
+BENCHMARK(BM_DropAlphaInPlace)->DenseRange(0, 2);
+
+/** ----- Netpbm I/O ----- **/
+
+// 4K PPM written once in the temporary directory, read back from the page cache.
+const std::string& benchPpmPath() {
+  static const std::string path = [] {
+    const char* directory = std::getenv("TMPDIR");
+    std::string file = std::string(directory != nullptr ? directory : "/tmp") + "/benchImage.ppm";
+    img::saveNetpbm(file, makeBenchImage<RGB8>(3840, 2160));
+    return file;
+  }();
+  return path;
+}
+
+// Load a 4K PPM: 0 = read() into a buffer then the buffer constructor, 1 = loadNetpbm (mmap, one copy).
+void BM_LoadPpm(benchmark::State& state) {
+  const std::string& path = benchPpmPath();
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      const int fd = ::open(path.c_str(), O_RDONLY);
+      std::vector<char> content(static_cast<std::size_t>(::lseek(fd, 0, SEEK_END)));
+      ::lseek(fd, 0, SEEK_SET);
+      for (std::size_t done = 0; done < content.size();) {
+        const ssize_t got = ::read(fd, content.data() + done, content.size() - done);
+        if (got <= 0) break;
+        done += static_cast<std::size_t>(got);
+      }
+      ::close(fd);
+      const img::NetpbmHeader header = img::parseNetpbmHeader(content.data(), content.size());
+      const img::ImageRGB image(header.width, header.height, reinterpret_cast<const std::uint8_t*>(content.data() + header.dataOffset));
+      benchmark::DoNotOptimize(image.getData());
+    } else {
+      const auto image = img::loadNetpbm<RGB8>(path);
+      benchmark::DoNotOptimize(image.getData());
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 3840 * 2160 * 3));
+}
+BENCHMARK(BM_LoadPpm)->DenseRange(0, 1)->UseRealTime();
+
+// Save a 4K RGB image with 64-byte aligned rows: 0 = rows copied into one buffer then write(), 1 = saveNetpbm (writev).
+void BM_SavePpm(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  const img::ImageRGB image(makeBenchImage<RGB8>(width, height).view(), img::RowAlignment::Align64);
+  const std::string path = benchPpmPath() + ".out";
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      const std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+      std::vector<std::uint8_t> content(header.size() + width * height * 3);
+      std::copy(header.begin(), header.end(), content.begin());
+      for (std::size_t row = 0; row < height; ++row) {
+        std::copy_n(image.getRow(row), width * 3, content.data() + header.size() + row * width * 3);
+      }
+      const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      for (std::size_t done = 0; done < content.size();) {
+        const ssize_t written = ::write(fd, content.data() + done, content.size() - done);
+        if (written <= 0) break;
+        done += static_cast<std::size_t>(written);
+      }
+      ::close(fd);
+    } else {
+      img::saveNetpbm(path, image);
+    }
+  }
+  ::unlink(path.c_str());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * width * height * 3));
+}
+BENCHMARK(BM_SavePpm)->DenseRange(0, 1)->UseRealTime();
+
+/** ----- Streaming ----- **/
+
+// Convert an 8192x4096 PPM to a PGM: 0 = whole image (one RGB and one gray buffer), 1 = streamed in 4 MiB strips.
+// The bufferBytes counter is the memory holding samples during the conversion.
+void BM_StreamConvert(benchmark::State& state) {
+  constexpr std::size_t width = 8192, height = 4096;
+  const char* directory = std::getenv("TMPDIR");
+  const std::string input = std::string(directory != nullptr ? directory : "/tmp") + "/benchStream.ppm";
+  const std::string output = input + ".pgm";
+  img::saveNetpbm(input, makeBenchImage<RGB8>(width, height));
+  std::size_t bufferBytes = 0;
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      const img::NetpbmReader<RGB8> reader(input);
+      img::ImageRGB rgb(width, height, img::uninitialized);
+      reader.read(0, rgb.view());
+      img::saveNetpbm(output, img::ImageGray(rgb));
+      bufferBytes = width * height * (RGB8::PlaneCount + Gray8::PlaneCount);
+    } else {
+      img::NetpbmReader<RGB8> reader(input);
+      img::NetpbmWriter<Gray8> writer(output, width, height);
+      bufferBytes = img::streamConvert(reader, writer).bufferBytes;
+    }
+  }
+  ::unlink(output.c_str());
+  ::unlink(input.c_str());
+  state.counters["bufferBytes"] = static_cast<double>(bufferBytes);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<RGB8, Gray8>(width, height)));
+}
+BENCHMARK(BM_StreamConvert)->DenseRange(0, 1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/** ----- Planar layout ----- **/
+
+using PlanarRGB8 = img::PlanarRGB<std::uint8_t>;
+using PlanarRGBA8 = img::PlanarRGBA<std::uint8_t>;
+using PlanarRGBf = img::PlanarRGB<float>;
+
+// Interleaved <-> planar transposition.
+IMG_BENCH_CONVERT(RGB8, PlanarRGB8);
+IMG_BENCH_CONVERT(PlanarRGB8, RGB8);
+IMG_BENCH_CONVERT(BGRA8, PlanarRGBA8);
+IMG_BENCH_CONVERT(PlanarRGBA8, BGRA8);
+IMG_BENCH_CONVERT(RGBf, PlanarRGBf);
+IMG_BENCH_CONVERT(PlanarRGBf, RGBf);
+
+// Per-channel gain on a 4K float RGB image, channel by channel: strided samples when interleaved,
+// contiguous rows of one plane when planar.
+template<typename Pixel>
+void BM_ChannelGain(benchmark::State& state) {
+  constexpr std::size_t width = 3840, height = 2160;
+  constexpr float gains[3] = {1.25f, 0.5f, 0.75f};
+  auto image = makeBenchImage<Pixel>(width, height);
+  const img::ImageView<Pixel> view = image.view();
+  for (auto _ : state) {
+    for (int channel = 0; channel < 3; ++channel) {
+      float* const plane = view.getPlane(channel);
+      const float gain = gains[channel];
+      for (std::size_t row = 0; row < height; ++row) {
+        float* const samples = plane + row * view.getStride();
+        for (std::size_t col = 0; col < width; ++col) {
+          samples[col * img::pixelStep<Pixel>] *= gain;
+        }
+      }
+    }
+    benchmark::DoNotOptimize(image.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * width * height * 3 * sizeof(float) * 2));
+}
+BENCHMARK_TEMPLATE(BM_ChannelGain, RGBf);
+BENCHMARK_TEMPLATE(BM_ChannelGain, PlanarRGBf);
+
+/** ----- Depth conversion ----- **/
+
+// The original `src * targetMax / sourceMax`, as a baseline.
+template<typename TargetT, typename SourceT>
+TargetT legacyCrossProduct(const SourceT src) {
+  const TargetT targetMaxValue = img::getMaxInContext<TargetT>();
+  const SourceT sourceMaxValue = img::getMaxInContext<SourceT>();
+  return static_cast<TargetT>(src * targetMaxValue / sourceMaxValue);
+}
+
+// Rescale 1080p worth of RGB samples with the original formula (0), cross_product (1) or cross_product
+// without its lookup tables (2).
+template<typename SourceT, typename TargetT>
+void BM_DepthConvert(benchmark::State& state) {
+  const std::size_t count = benchWidth * benchHeight * 3;
+  std::vector<SourceT> src(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    src[i] = legacyCrossProduct<SourceT>(static_cast<std::uint8_t>(i % 256));
+  }
+  std::vector<TargetT> dst(count);
+  for (auto _ : state) {
+    if (state.range(0) == 2) {
+      std::transform(src.begin(), src.end(), dst.begin(), [](const SourceT value) { return img::detail::crossProductCompute<TargetT>(value); });
+    } else if (state.range(0) == 1) {
+      std::transform(src.begin(), src.end(), dst.begin(), [](const SourceT value) { return img::cross_product<TargetT>(value); });
+    } else {
+      std::transform(src.begin(), src.end(), dst.begin(), [](const SourceT value) { return legacyCrossProduct<TargetT>(value); });
+    }
+    benchmark::DoNotOptimize(dst.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * count * (sizeof(SourceT) + sizeof(TargetT))));
+}
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint8_t, float)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint8_t, int)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint8_t, double)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint8_t, long long)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint16_t, std::uint8_t)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint16_t, int)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint16_t, float)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::uint16_t, long long)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, int, std::uint8_t)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, long long, int)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, std::size_t, std::uint8_t)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, float, std::uint8_t)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_DepthConvert, int, float)->DenseRange(0, 2);
+
+/** ----- Batch conversion ----- **/
+
+// Memory resource counting the allocations it forwards to the default resource.
+class CountingResource : public std::pmr::memory_resource {
+  void* do_allocate(const std::size_t bytes, const std::size_t alignment) override {
+    ++allocations;
+    bytesAllocated += bytes;
+    return std::pmr::get_default_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* buffer, const std::size_t bytes, const std::size_t alignment) override {
+    std::pmr::get_default_resource()->deallocate(buffer, bytes, alignment);
+  }
+  [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+  std::size_t allocations{0}, bytesAllocated{0};
+};
+
+// Convert 256 thumbnails of 96x96 one image at a time (0) or as one ImageBatch (1).
+void BM_ConvertThumbnails(benchmark::State& state) {
+  constexpr std::size_t count = 256, side = 96;
+  std::vector<img::ImageRGB> thumbnails;
+  for (std::size_t i = 0; i < count; ++i) {
+    thumbnails.push_back(makeBenchImage<RGB8>(side, side));
+  }
+  CountingResource resource;
+  for (auto _ : state) {
+    if (state.range(0) == 1) {
+      const img::ImageBatch<RGBA8> batch(thumbnails, img::RowAlignment::Packed, &resource);
+      benchmark::DoNotOptimize(batch[0].getData());
+    } else {
+      std::vector<img::ImageRGBA> converted;
+      converted.reserve(count);
+      for (const auto& thumbnail : thumbnails) {
+        converted.emplace_back(thumbnail.view(), img::RowAlignment::Packed, &resource);
+      }
+      benchmark::DoNotOptimize(converted[0].getData());
+    }
+  }
+  state.counters["allocations"] = benchmark::Counter(static_cast<double>(resource.allocations), benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * count));
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * count * conversionBytes<RGB8, RGBA8>(side, side)));
+}
+BENCHMARK(BM_ConvertThumbnails)->DenseRange(0, 1)->UseRealTime();
+
+/** ----- Lazy expressions ----- **/
+
+// RGB -> RGBA -> RGBA float -> gray float at 1080p, through intermediate images (0) or one fused expression (1).
+void BM_ChainConvert(benchmark::State& state) {
+  const auto src = makeBenchImage<RGB8>();
+  img::Image<RGBA8> rgba(benchWidth, benchHeight);
+  img::Image<RGBAf> rgbaFloat(benchWidth, benchHeight);
+  img::Image<Grayf> gray(benchWidth, benchHeight);
+  for (auto _ : state) {
+    if (state.range(0) == 1) {
+      img::lazy(src).to<RGBA8>().to<RGBAf>().evaluateInto(gray.view());
+    } else {
+      rgba = src;
+      rgbaFloat = rgba;
+      gray = rgbaFloat;
+    }
+    benchmark::DoNotOptimize(gray.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * benchWidth * benchHeight));
+}
+BENCHMARK(BM_ChainConvert)->DenseRange(0, 1);
+
+/** ----- Copy-on-write ----- **/
+
+// A stage reading an image it receives by value.
+__attribute__((noinline)) std::uint8_t readStage(const img::ImageRGBA image) {
+  return image.getColor(image.getWidth() / 2, image.getHeight() / 2).green;
+}
+
+// Pass a 1080p frame by value through 8 read-only stages, with deep copies (0) or copy-on-write (1).
+void BM_CopyThroughStages(benchmark::State& state) {
+  CountingResource resource;
+  const img::ImageRGBA frame(makeBenchImage<BGR8>().view(), img::RowAlignment::Packed, &resource);
+  img::ImageRGBA shared(frame);
+  shared.setCopyOnWrite(state.range(0) == 1);
+  const std::size_t before = resource.bytesAllocated;
+  for (auto _ : state) {
+    unsigned sum = 0;
+    for (int stage = 0; stage < 8; ++stage) {
+      sum += readStage(shared);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.counters["bytesCopied"] = benchmark::Counter(static_cast<double>(resource.bytesAllocated - before),
+                                                     benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_CopyThroughStages)->DenseRange(0, 1);
+
+/** ----- Iterators ----- **/
+
+// Invert a 1080p RGB frame with getColor/setColor (0), the whole-image iterators (1), the pixel
+// iterators of each row (2), the raw samples of each row (3), the image as one row (4), or
+// std::for_each(par_unseq) over the image as one row (5).
+void BM_InvertPixels(benchmark::State& state) {
+  img::ImageRGB image = makeBenchImage<RGB8>();
+  const auto invert = [](const img::Color<std::uint8_t>& color) {
+    return img::Color<std::uint8_t>{std::uint8_t(255 - color.red), std::uint8_t(255 - color.green),
+                                    std::uint8_t(255 - color.blue), color.alpha};
+  };
+  for (auto _ : state) {
+    switch (state.range(0)) {
+      case 0:
+        for (std::size_t row = 0; row < image.getHeight(); ++row) {
+          for (std::size_t col = 0; col < image.getWidth(); ++col) {
+            image.setColor(col, row, invert(image.getColor(col, row)));
+          }
+        }
+        break;
+      case 1:
+        std::transform(image.begin(), image.end(), image.begin(), invert);
+        break;
+      case 2:
+        for (std::size_t row = 0; row < image.getHeight(); ++row) {
+          const auto pixels = image.row(row);
+          std::transform(pixels.begin(), pixels.end(), pixels.begin(), invert);
+        }
+        break;
+      case 3:
+        for (std::size_t row = 0; row < image.getHeight(); ++row) {
+          const auto samples = image.row(row).samples();
+          std::transform(samples.begin(), samples.end(), samples.begin(), [](std::uint8_t v) { return std::uint8_t(255 - v); });
+        }
+        break;
+      case 4: {
+        const auto pixels = image.pixels();
+        std::transform(pixels.begin(), pixels.end(), pixels.begin(), invert);
+        break;
+      }
+      default: {
+        const auto pixels = image.pixels();
+        std::for_each(std::execution::par_unseq, pixels.begin(), pixels.end(), [&](const auto pixel) { pixel = invert(pixel); });
+      }
+    }
+    benchmark::DoNotOptimize(image.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * benchWidth * benchHeight);
+}
+BENCHMARK(BM_InvertPixels)->DenseRange(0, 5);
+
+/** ----- YUV ----- **/
+
+// A frame with a non uniform pattern in every plane.
+template<typename Format>
+img::YUVImage<Format> makeBenchFrame(const std::size_t width, const std::size_t height) {
+  img::YUVImage<Format> frame(width, height);
+  std::uint8_t* data = frame.getData();
+  for (std::size_t i = 0; i < img::YUVImage<Format>::frameBytes(width, height); ++i) data[i] = static_cast<std::uint8_t>(i * 37);
+  return frame;
+}
+
+// Per-pixel double precision decoding, the way frames were converted outside of the library.
+void decodeNV12PerPixel(const img::ConstYUVView<img::NV12>& frame, img::ImageBGRA& image) {
+  for (std::size_t row = 0; row < frame.getHeight(); ++row) {
+    for (std::size_t col = 0; col < frame.getWidth(); ++col) {
+      const double y = 1.164 * (frame.getLumaRow(row)[col] - 16);
+      const double u = frame.getURow(row / 2)[col / 2 * 2] - 128;
+      const double v = frame.getVRow(row / 2)[col / 2 * 2] - 128;
+      const auto clamp = [](const double value) { return static_cast<std::uint8_t>(std::clamp(value, 0.0, 255.0)); };
+      image.setColor(col, row, {clamp(y + 1.596 * v), clamp(y - 0.392 * u - 0.813 * v), clamp(y + 2.017 * u), 255});
+    }
+  }
+}
+
+// Decode a NV12 frame to BGRA: per pixel (0), with the scalar kernels (1) or the vectorized ones (2).
+void BM_DecodeNV12(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(1));
+  const auto height = static_cast<std::size_t>(state.range(2));
+  const auto frame = makeBenchFrame<img::NV12>(width, height);
+  img::ImageBGRA image(width, height);
+  img::simd::setLevel(state.range(0) == 1 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      decodeNV12PerPixel(frame.view(), image);
+    } else {
+      img::convert(frame.view(), image.view());
+    }
+    benchmark::DoNotOptimize(image.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations());  // frames
+  state.SetBytesProcessed(state.iterations() * (img::NV12Image::frameBytes(width, height) + width * height * 4));
+}
+BENCHMARK(BM_DecodeNV12)->ArgNames({"mode", "width", "height"})
+  ->ArgsProduct({{0, 1, 2}, {1920}, {1080}})->ArgsProduct({{0, 1, 2}, {3840}, {2160}})->UseRealTime();
+
+// Decode a frame of `Format` into an image of `Pixel`.
+template<typename Format, typename Pixel>
+void BM_DecodeYUV(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0));
+  const auto height = static_cast<std::size_t>(state.range(1));
+  const auto frame = makeBenchFrame<Format>(width, height);
+  img::Image<Pixel> image(width, height);
+  for (auto _ : state) {
+    img::convert(frame.view(), image.view());
+    benchmark::DoNotOptimize(image.getData());
+  }
+  state.SetItemsProcessed(state.iterations());  // frames
+  state.SetBytesProcessed(state.iterations() * (img::YUVImage<Format>::frameBytes(width, height)
+                                                + img::Image<Pixel>::bufferBytes(width, height)));
+}
+BENCHMARK_TEMPLATE(BM_DecodeYUV, img::NV12, RGB8)->ArgNames({"width", "height"})->Args({1920, 1080})->Args({3840, 2160})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_DecodeYUV, img::I420, RGB8)->ArgNames({"width", "height"})->Args({1920, 1080})->Args({3840, 2160})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_DecodeYUV, img::I420, BGRA8)->ArgNames({"width", "height"})->Args({1920, 1080})->Args({3840, 2160})->UseRealTime();
+
+// Encode an image of `Pixel` into a frame of `Format`, with the scalar kernels (0) or the vectorized ones (1).
+template<typename Pixel, typename Format>
+void BM_EncodeYUV(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(1));
+  const auto height = static_cast<std::size_t>(state.range(2));
+  const auto image = makeBenchImage<Pixel>(width, height);
+  img::YUVImage<Format> frame(width, height);
+  img::simd::setLevel(state.range(0) == 0 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    img::convert(image.view(), frame.view());
+    benchmark::DoNotOptimize(frame.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations());  // frames
+  state.SetBytesProcessed(state.iterations() * (img::YUVImage<Format>::frameBytes(width, height)
+                                                + img::Image<Pixel>::bufferBytes(width, height)));
+}
+BENCHMARK_TEMPLATE(BM_EncodeYUV, RGB8, img::NV12)->ArgNames({"simd", "width", "height"})
+  ->ArgsProduct({{0, 1}, {1920}, {1080}})->ArgsProduct({{0, 1}, {3840}, {2160}})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_EncodeYUV, BGRA8, img::I420)->ArgNames({"simd", "width", "height"})
+  ->ArgsProduct({{0, 1}, {1920}, {1080}})->ArgsProduct({{0, 1}, {3840}, {2160}})->UseRealTime();
+
+/** ----- Resize ----- **/
+
+// 4K thumbnails: resize a 3840x2160 image with the filter `range(1)`, with the scalar kernels (0) or the vectorized ones (1).
+template<typename Pixel>
+void BM_Thumbnail(benchmark::State& state) {
+  const auto filter = static_cast<img::ResizeFilter>(state.range(1));
+  const auto width = static_cast<std::size_t>(state.range(2));
+  const auto height = static_cast<std::size_t>(state.range(3));
+  const auto image = makeBenchImage<Pixel>(3840, 2160);
+  img::Image<Pixel> thumbnail(width, height);
+  img::simd::setLevel(state.range(0) == 0 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    img::resize(image.view(), thumbnail.view(), filter);
+    benchmark::DoNotOptimize(thumbnail.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);  // input pixels
+  state.SetBytesProcessed(state.iterations() * img::Image<Pixel>::bufferBytes(3840, 2160));
+}
+// Filters: 0 nearest, 1 box, 2 bilinear, 3 bicubic, 4 lanczos3. Box takes the block average path for the integer
+// factors of 256x144 (15) and 240x135 (16), and the separable filters for 250x140.
+BENCHMARK_TEMPLATE(BM_Thumbnail, RGB8)->ArgNames({"simd", "filter", "width", "height"})
+  ->ArgsProduct({{0, 1}, {0, 1, 2, 3, 4}, {256}, {144}})->ArgsProduct({{1}, {1}, {240}, {135}})
+  ->ArgsProduct({{0, 1}, {1}, {250}, {140}})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Thumbnail, RGBA8)->ArgNames({"simd", "filter", "width", "height"})
+  ->ArgsProduct({{0, 1}, {2, 4}, {256}, {144}})->ArgsProduct({{1}, {1}, {240}, {135}})->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Thumbnail, RGBf)->ArgNames({"simd", "filter", "width", "height"})
+  ->ArgsProduct({{1}, {2}, {256}, {144}})->UseRealTime();
+
+// Upscale 1080p to 4K, where the filters are narrow and the output dominates.
+void BM_Upscale(benchmark::State& state) {
+  const auto filter = static_cast<img::ResizeFilter>(state.range(1));
+  const auto image = makeBenchImage<RGBA8>(1920, 1080);
+  img::Image<RGBA8> large(3840, 2160);
+  img::simd::setLevel(state.range(0) == 0 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    img::resize(image.view(), large.view(), filter);
+    benchmark::DoNotOptimize(large.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);  // output pixels
+}
+BENCHMARK(BM_Upscale)->ArgNames({"simd", "filter"})->ArgsProduct({{0, 1}, {2, 3}})->UseRealTime();
+
+/** ----- Orientation ----- **/
+
+constexpr std::size_t photoWidth = 15360;  // 16K UHD
+constexpr std::size_t photoHeight = 8640;
+
+// Orient a 16K image with getColor/setColor (0), the tiled scalar kernels (1) or the tiled SIMD kernels (2).
+template<typename Pixel>
+void BM_Orient(benchmark::State& state) {
+  const auto orientation = static_cast<img::Orientation>(state.range(1));
+  const bool swap = img::swapsAxes(orientation);
+  const auto image = makeBenchImage<Pixel>(photoWidth, photoHeight);
+  img::Image<Pixel> oriented(swap ? photoHeight : photoWidth, swap ? photoWidth : photoHeight);
+  img::simd::setLevel(state.range(0) == 1 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      // Source order: the writes of the rotations go down the columns of the result.
+      for (std::size_t row = 0; row < photoHeight; ++row) {
+        for (std::size_t col = 0; col < photoWidth; ++col) {
+          const auto color = image.getColor(col, row);
+          switch (orientation) {
+            case img::Orientation::Rotate90: oriented.setColor(photoHeight - 1 - row, col, color); break;
+            case img::Orientation::Rotate270: oriented.setColor(row, photoWidth - 1 - col, color); break;
+            case img::Orientation::Rotate180: oriented.setColor(photoWidth - 1 - col, photoHeight - 1 - row, color); break;
+            default: oriented.setColor(photoWidth - 1 - col, row, color);
+          }
+        }
+      }
+    } else {
+      img::orient(image.view(), oriented.view(), orientation);
+    }
+    benchmark::DoNotOptimize(oriented.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations() * photoWidth * photoHeight);
+  state.SetBytesProcessed(state.iterations() * 2 * img::Image<Pixel>::bufferBytes(photoWidth, photoHeight));
+}
+// Orientations: 2 flip horizontal, 3 rotate 180, 5 transpose, 6 rotate 90, 8 rotate 270.
+BENCHMARK_TEMPLATE(BM_Orient, RGBA8)->ArgNames({"mode", "orientation"})
+  ->ArgsProduct({{0, 1, 2}, {2, 6}})->ArgsProduct({{1, 2}, {3, 5, 8}})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Orient, RGB8)->ArgNames({"mode", "orientation"})
+  ->ArgsProduct({{0, 1, 2}, {6}})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Orient, Gray8)->ArgNames({"mode", "orientation"})
+  ->ArgsProduct({{0, 1, 2}, {6}})->ArgsProduct({{1, 2}, {2}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Rotate a square 8K image by 90 degrees in place, against a rotated copy.
+void BM_OrientInPlace(benchmark::State& state) {
+  constexpr std::size_t size = 8192;
+  img::Image<RGBA8> image = makeBenchImage<RGBA8>(size, size);
+  img::Image<RGBA8> oriented(size, size);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      img::orient(std::as_const(image).view(), oriented.view(), img::Orientation::Rotate90);
+      benchmark::DoNotOptimize(oriented.getData());
+    } else {
+      img::orientInPlace(image.view(), img::Orientation::Rotate90);
+      benchmark::DoNotOptimize(image.getData());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * size * size);
+}
+BENCHMARK(BM_OrientInPlace)->ArgNames({"inPlace"})->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/** ----- Compositing ----- **/
+
+// Composite a 4K RGBA layer onto a 4K RGBA frame with getColor/setColor and the blend in floating
+// point (0), the scalar kernels (1) or the vectorized ones (2); `range(1)` the blend mode, `range(2)` premultiplied.
+void BM_Composite(benchmark::State& state) {
+  const auto mode = static_cast<img::BlendMode>(state.range(1));
+  const auto alpha = state.range(2) == 0 ? img::AlphaMode::Straight : img::AlphaMode::Premultiplied;
+  const auto layer = makeBenchImage<RGBA8>(3840, 2160);
+  const auto frame = makeBenchImage<RGBA8>(3840, 2160);
+  img::simd::setLevel(state.range(0) == 1 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    state.PauseTiming();
+    img::Image<RGBA8> result(frame);
+    state.ResumeTiming();
+    if (state.range(0) == 0) {
+      for (std::size_t row = 0; row < 2160; ++row) {
+        for (std::size_t col = 0; col < 3840; ++col) {
+          const auto s = layer.getColor(col, row), d = result.getColor(col, row);
+          const float as = s.alpha / 255.0f;
+          const auto over = [as](const std::uint8_t source, const std::uint8_t dest) {
+            return static_cast<std::uint8_t>(source * as + dest * (1 - as) + 0.5f);
+          };
+          result.setColor(col, row, {over(s.red, d.red), over(s.green, d.green), over(s.blue, d.blue),
+                                     static_cast<std::uint8_t>(s.alpha + d.alpha * (1 - as) + 0.5f)});
+        }
+      }
+    } else {
+      img::composite(layer.view(), result.view(), 0, 0, mode, alpha);
+    }
+    benchmark::DoNotOptimize(result.getData());
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);
+}
+// The per-pixel loop only composites over with straight alpha, for an opaque frame.
+BENCHMARK(BM_Composite)->ArgNames({"mode", "blend", "premultiplied"})
+  ->Args({0, 0, 0})->ArgsProduct({{1, 2}, {0, 1, 2}, {0, 1}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Composite a 4K RGBA layer onto frames of other pixel types, through the conversion buffers.
+template<typename Pixel>
+void BM_CompositeOnto(benchmark::State& state) {
+  const auto layer = makeBenchImage<RGBA8>(3840, 2160);
+  img::Image<Pixel> frame = makeBenchImage<Pixel>(3840, 2160);
+  for (auto _ : state) {
+    img::composite(layer.view(), frame.view());
+    benchmark::DoNotOptimize(frame.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);
+}
+BENCHMARK_TEMPLATE(BM_CompositeOnto, BGRA8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CompositeOnto, RGB8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CompositeOnto, RGBAf)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A 512x256 watermark composited onto a 4K frame, the per-call cost of small layers.
+void BM_Watermark(benchmark::State& state) {
+  const auto mark = makeBenchImage<RGBA8>(512, 256);
+  img::Image<RGBA8> frame = makeBenchImage<RGBA8>(3840, 2160);
+  for (auto _ : state) {
+    img::composite(mark.view(), frame.view(), 3840 - 512 - 64, 2160 - 256 - 64);
+    benchmark::DoNotOptimize(frame.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * 512 * 256);
+}
+BENCHMARK(BM_Watermark)->UseRealTime();
+
+/** ----- Filters ----- **/
+
+// 3x3 sharpening of a 4K frame with getColor/setColor (0) or `convolve` (1).
+void BM_Sharpen(benchmark::State& state) {
+  const auto image = makeBenchImage<RGBA8>(3840, 2160);
+  const img::Kernel kernel(3, 3, {0, -1, 0, -1, 5, -1, 0, -1, 0});
+  img::Image<RGBA8> result(3840, 2160);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      for (std::size_t row = 0; row < 2160; ++row) {
+        for (std::size_t col = 0; col < 3840; ++col) {
+          float sums[4] = {};
+          for (std::size_t y = 0; y < 3; ++y) {
+            for (std::size_t x = 0; x < 3; ++x) {
+              const auto c = image.getColor(std::clamp<std::size_t>(col + x, 1, 3840) - 1, std::clamp<std::size_t>(row + y, 1, 2160) - 1);
+              const float weight = kernel.getWeight(x, y);
+              sums[0] += weight * c.red;
+              sums[1] += weight * c.green;
+              sums[2] += weight * c.blue;
+              sums[3] += weight * c.alpha;
+            }
+          }
+          const auto sample = [](const float value) { return static_cast<std::uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f)); };
+          result.setColor(col, row, {sample(sums[0]), sample(sums[1]), sample(sums[2]), sample(sums[3])});
+        }
+      }
+    } else {
+      img::convolve(image.view(), result.view(), kernel);
+    }
+    benchmark::DoNotOptimize(result.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);
+}
+BENCHMARK(BM_Sharpen)->ArgName("mode")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Box blur of a 4K frame by `radius`, with the separable kernel (0) or the running sums (1).
+template<typename Pixel>
+void BM_BoxBlur(benchmark::State& state) {
+  const auto image = makeBenchImage<Pixel>(3840, 2160);
+  const auto radius = static_cast<std::size_t>(state.range(1));
+  img::Image<Pixel> result(3840, 2160);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      img::convolve(image.view(), result.view(), img::Kernel::box(radius));
+    } else {
+      img::boxBlur(image.view(), result.view(), radius);
+    }
+    benchmark::DoNotOptimize(result.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);
+}
+BENCHMARK_TEMPLATE(BM_BoxBlur, RGBA8)->ArgNames({"mode", "radius"})
+  ->ArgsProduct({{0, 1}, {1, 4, 16}})->Args({1, 64})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BoxBlur, RGBAf)->ArgNames({"mode", "radius"})
+  ->ArgsProduct({{0, 1}, {4}})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Gaussian blur of a 4K frame, the deviation in tenths of pixel.
+void BM_GaussianBlur(benchmark::State& state) {
+  const auto image = makeBenchImage<RGBA8>(3840, 2160);
+  const double sigma = static_cast<double>(state.range(0)) / 10;
+  img::Image<RGBA8> result(3840, 2160);
+  for (auto _ : state) {
+    img::gaussianBlur(image.view(), result.view(), sigma);
+    benchmark::DoNotOptimize(result.getData());
+  }
+  state.SetItemsProcessed(state.iterations() * 3840 * 2160);
+}
+BENCHMARK(BM_GaussianBlur)->ArgName("sigma10")->Arg(10)->Arg(20)->Arg(39)->Arg(40)->Arg(80)->Arg(320)
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/** ----- Statistics ----- **/
+
+// Min/max, mean, variance and a 256 bin histogram of every channel of a 4K frame: one loop per
+// statistic over the samples (0), `computeStatistics` with all of them (1), without the histogram (2),
+// and without the histogram on the scalar kernels (3).
+template<typename Pixel>
+void BM_Statistics(benchmark::State& state) {
+  using T = typename Pixel::DataType;
+  constexpr std::size_t channels = Pixel::PlaneCount;
+  const auto image = makeBenchImage<Pixel>(3840, 2160);
+  const T* const data = image.getData();
+  const std::size_t count = 3840 * 2160;
+  img::simd::setLevel(state.range(0) == 3 ? img::simd::Level::Scalar : img::simd::detectLevel());
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      for (std::size_t channel = 0; channel < channels; ++channel) {
+        T low = data[channel], high = data[channel];
+        for (std::size_t i = 0; i < count; ++i) {
+          low = std::min(low, data[i * channels + channel]);
+          high = std::max(high, data[i * channels + channel]);
+        }
+        double sum = 0;
+        for (std::size_t i = 0; i < count; ++i) sum += data[i * channels + channel];
+        const double mean = sum / count;
+        double deviations = 0;
+        for (std::size_t i = 0; i < count; ++i) deviations += (data[i * channels + channel] - mean) * (data[i * channels + channel] - mean);
+        std::vector<std::uint64_t> histogram(256);
+        for (std::size_t i = 0; i < count; ++i) {
+          ++histogram[std::min<std::size_t>(static_cast<std::size_t>(data[i * channels + channel] * (256.0 / Pixel::Max)), 255)];
+        }
+        benchmark::DoNotOptimize(low);
+        benchmark::DoNotOptimize(high);
+        benchmark::DoNotOptimize(deviations);
+        benchmark::DoNotOptimize(histogram.data());
+      }
+    } else {
+      const auto statistics = state.range(0) == 1 ? img::Statistic::All : img::Statistic::MinMax | img::Statistic::Variance;
+      benchmark::DoNotOptimize(img::computeStatistics(image.view(), statistics));
+    }
+  }
+  img::simd::setLevel(img::simd::detectLevel());
+  state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK_TEMPLATE(BM_Statistics, RGBA8)->ArgName("mode")->DenseRange(0, 3)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Statistics, RGB8)->ArgName("mode")->DenseRange(0, 3)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Statistics, RGBAf)->ArgName("mode")->DenseRange(0, 2)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/** ----- Sub-images ----- **/
+
+// 1000 square crops of a 1080p RGBA frame converted to RGB, like the inputs of a detector: copied
+// pixel by pixel into a new image with `setColor`, then converted (0), converted straight from a
+// `subImage` view into a new image (1), or into one image reused for every crop (2).
+void BM_CropConvert(benchmark::State& state) {
+  const auto frame = makeBenchImage<RGBA8>();
+  const auto size = static_cast<std::size_t>(state.range(1));
+  constexpr std::size_t crops = 1000;
+  img::Image<RGB8> reused;
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < crops; ++i) {
+      const std::size_t x = (i * 97) % (benchWidth - size);
+      const std::size_t y = (i * 61) % (benchHeight - size);
+      if (state.range(0) == 0) {
+        img::Image<RGBA8> copy(size, size, img::uninitialized);
+        for (std::size_t row = 0; row < size; ++row) {
+          for (std::size_t col = 0; col < size; ++col) {
+            copy.setColor(col, row, frame.getColor(x + col, y + row));
+          }
+        }
+        const img::Image<RGB8> rgb(copy);
+        benchmark::DoNotOptimize(rgb.getData());
+      } else if (state.range(0) == 1) {
+        const img::Image<RGB8> rgb(frame.subImage(x, y, size, size));
+        benchmark::DoNotOptimize(rgb.getData());
+      } else {
+        reused = frame.subImage(x, y, size, size);
+        benchmark::DoNotOptimize(reused.getData());
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * crops * size * size);
+}
+BENCHMARK(BM_CropConvert)->ArgNames({"mode", "size"})->ArgsProduct({{0, 1, 2}, {32, 128}})
+  ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/** ----- Instrumentation ----- **/
+
+// Operations on 8x8 images, where the probes of an IMG_INSTRUMENTATION build cost the most: an
+// allocation, a construction, a conversion, a copy and two moves per iteration. Compare the builds
+// with and without the CMake option.
+void BM_SmallImageOperations(benchmark::State& state) {
+  const auto tile = makeBenchImage<RGBA8>(8, 8);
+  for (auto _ : state) {
+    img::Image<RGB8> rgb(tile);
+    img::Image<RGB8> copy(rgb);
+    img::Image<RGB8> moved(std::move(copy));
+    rgb = std::move(moved);
+    benchmark::DoNotOptimize(rgb.getData());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SmallImageOperations);
+
+/** ----- Memory resource ----- **/
+
+// Create, convert into and destroy 1080p frames, allocating from the default resource (0) or from a FramePool (1).
+void BM_FrameChurn(benchmark::State& state) {
+  img::FramePool pool;
+  std::pmr::memory_resource* resource = state.range(0) == 1 ? &pool : std::pmr::get_default_resource();
+  const auto src = makeBenchImage<BGR8>();
+  for (auto _ : state) {
+    const img::ImageRGBA frame(src.view(), img::RowAlignment::Packed, resource);
+    benchmark::DoNotOptimize(frame.getData());
+  }
+  const auto stats = pool.getStats();
+  state.counters["hits"] = static_cast<double>(stats.hits);
+  state.counters["misses"] = static_cast<double>(stats.misses);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<BGR8, RGBA8>(benchWidth, benchHeight)));
+}
+BENCHMARK(BM_FrameChurn)->Arg(0)->Arg(1);
+
+/** ----- Parallel execution ----- **/
+
+// 8K conversion and copy on a global pool of `state.range(0)` threads.
+template<typename PixelSrc, typename PixelDst>
+void BM_ParallelConvert(benchmark::State& state) {
+  img::ThreadPool::setGlobalThreadCount(static_cast<std::size_t>(state.range(0)));
+  constexpr std::size_t width = 7680, height = 4320;
+  const auto src = makeBenchImage<PixelSrc>(width, height);
+  img::Image<PixelDst> dst(width, height);
+  for (auto _ : state) {
+    dst = src;
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  img::ThreadPool::setGlobalThreadCount(std::thread::hardware_concurrency());
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(width, height)));
+  state.counters["threads"] = static_cast<double>(state.range(0));
+}
+
+// Thread counts from 1 to the number of hardware threads, doubling.
+void threadCounts(benchmark::internal::Benchmark* bench) {
+  const auto hardware = std::max<int64_t>(std::thread::hardware_concurrency(), 1);
+  for (int64_t threads = 1; threads < hardware; threads *= 2) {
+    bench->Arg(threads);
+  }
+  bench->Arg(hardware);
+}
+
+BENCHMARK_TEMPLATE(BM_ParallelConvert, RGB8, RGBA8)->Apply(threadCounts)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelConvert, RGB8, Gray8)->Apply(threadCounts)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelConvert, RGB8, RGBf)->Apply(threadCounts)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ParallelConvert, RGBA8, RGBA8)->Apply(threadCounts)->UseRealTime();
+
+/** ----- Regression suite ----- **/
+
+// Every operation below runs at 256x256, 1080p and 4K, plus 16K when IMG_BENCH_16K is set
+// (about 2 GB per float RGBA image). Compare two runs with compareBench.py.
+void suiteSizes(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"width", "height"});
+  benchmark->Args({256, 256});
+  benchmark->Args({1920, 1080});
+  benchmark->Args({3840, 2160});
+  if (std::getenv("IMG_BENCH_16K") != nullptr) {
+    benchmark->Args({15360, 8640});
+  }
+}
+
+template<typename Pixel>
+std::size_t imageBytes(const std::size_t width, const std::size_t height) {
+  return width * height * Pixel::PlaneCount * sizeof(typename Pixel::DataType);
+}
+
+template<typename Pixel>
+void BM_SuiteConstruct(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  for (auto _ : state) {
+    const img::Image<Pixel> image(width, height);
+    benchmark::DoNotOptimize(image.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * imageBytes<Pixel>(width, height)));
+}
+
+template<typename Pixel>
+void BM_SuiteFromBuffer(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  const std::vector<typename Pixel::DataType> raw(width * height * Pixel::PlaneCount);
+  for (auto _ : state) {
+    const img::Image<Pixel> image(width, height, raw.data());
+    benchmark::DoNotOptimize(image.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2 * imageBytes<Pixel>(width, height)));
+}
+
+template<typename Pixel>
+void BM_SuiteFill(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  img::Image<Pixel> image(width, height, img::uninitialized);
+  for (auto _ : state) {
+    image.fill({Pixel::Max, 0, Pixel::Max, Pixel::Max});
+    benchmark::DoNotOptimize(image.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * imageBytes<Pixel>(width, height)));
+}
+
+template<typename Pixel>
+void BM_SuiteGetColor(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  const auto image = makeBenchImage<Pixel>(width, height);
+  for (auto _ : state) {
+    typename Pixel::DataType sum{};
+    for (std::size_t row = 0; row < height; ++row) {
+      for (std::size_t col = 0; col < width; ++col) {
+        sum += image.getColor(col, row).green;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * width * height));
+}
+
+template<typename Pixel>
+void BM_SuiteSetColor(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  img::Image<Pixel> image(width, height, img::uninitialized);
+  for (auto _ : state) {
+    for (std::size_t row = 0; row < height; ++row) {
+      for (std::size_t col = 0; col < width; ++col) {
+        image.setColor(col, row, {Pixel::Max, 0, static_cast<typename Pixel::DataType>(col), Pixel::Max});
+      }
+    }
+    benchmark::DoNotOptimize(image.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * width * height));
+}
+
+template<typename Pixel>
+void BM_SuiteCopy(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  const auto image = makeBenchImage<Pixel>(width, height);
+  for (auto _ : state) {
+    const img::Image<Pixel> copy(image);
+    benchmark::DoNotOptimize(copy.getData());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * 2 * imageBytes<Pixel>(width, height)));
+}
+
+template<typename Pixel>
+void BM_SuiteMove(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  auto image = makeBenchImage<Pixel>(width, height);
+  for (auto _ : state) {
+    img::Image<Pixel> moved(std::move(image));
+    image = std::move(moved);
+    benchmark::DoNotOptimize(image.getData());
+  }
+}
+
+template<typename PixelSrc, typename PixelDst>
+void BM_SuiteConvert(benchmark::State& state) {
+  const auto width = static_cast<std::size_t>(state.range(0)), height = static_cast<std::size_t>(state.range(1));
+  const auto src = makeBenchImage<PixelSrc>(width, height);
+  img::Image<PixelDst> dst(width, height, img::uninitialized);
+  for (auto _ : state) {
+    dst = src;
+    benchmark::DoNotOptimize(dst.getData());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * conversionBytes<PixelSrc, PixelDst>(width, height)));
+}
+
+using BGRf = img::PixelBGR<float>;
+
+template<typename Pixel>
+struct PixelName;
+
+#define IMG_BENCH_PIXEL_NAME(Alias) \
+  template<> struct PixelName<Alias> { static constexpr const char* value = #Alias; }
+
+IMG_BENCH_PIXEL_NAME(RGB8);
+IMG_BENCH_PIXEL_NAME(BGR8);
+IMG_BENCH_PIXEL_NAME(RGBA8);
+IMG_BENCH_PIXEL_NAME(BGRA8);
+IMG_BENCH_PIXEL_NAME(Gray8);
+IMG_BENCH_PIXEL_NAME(RGBf);
+IMG_BENCH_PIXEL_NAME(BGRf);
+IMG_BENCH_PIXEL_NAME(RGBAf);
+IMG_BENCH_PIXEL_NAME(BGRAf);
+IMG_BENCH_PIXEL_NAME(Grayf);
+
+template<typename... Pixels>
+struct PixelList {};
+
+template<typename Pixel>
+void registerSuiteOperations() {
+  const std::string suffix = std::string("<") + PixelName<Pixel>::value + ">";
+  benchmark::RegisterBenchmark(("BM_SuiteConstruct" + suffix).c_str(), BM_SuiteConstruct<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteFromBuffer" + suffix).c_str(), BM_SuiteFromBuffer<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteFill" + suffix).c_str(), BM_SuiteFill<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteGetColor" + suffix).c_str(), BM_SuiteGetColor<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteSetColor" + suffix).c_str(), BM_SuiteSetColor<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteCopy" + suffix).c_str(), BM_SuiteCopy<Pixel>)->Apply(suiteSizes);
+  benchmark::RegisterBenchmark(("BM_SuiteMove" + suffix).c_str(), BM_SuiteMove<Pixel>)->Apply(suiteSizes);
+}
+
+template<typename PixelSrc, typename... Pixels>
+void registerSuiteConversionsFrom(PixelList<Pixels...>) {
+  (benchmark::RegisterBenchmark((std::string("BM_SuiteConvert<") + PixelName<PixelSrc>::value + ", " + PixelName<Pixels>::value + ">").c_str(),
+                                BM_SuiteConvert<PixelSrc, Pixels>)->Apply(suiteSizes), ...);
+}
+
+// Every operation for every pixel type, every conversion between pixel types of the same DataType.
+template<typename... Pixels>
+bool registerSuite(PixelList<Pixels...> pixels) {
+  (registerSuiteOperations<Pixels>(), ...);
+  (registerSuiteConversionsFrom<Pixels>(pixels), ...);
+  return true;
+}
+
+const bool suiteUint8 = registerSuite(PixelList<RGB8, BGR8, RGBA8, BGRA8, Gray8>{});
+const bool suiteFloat = registerSuite(PixelList<RGBf, BGRf, RGBAf, BGRAf, Grayf>{});
+
+BENCHMARK_MAIN();
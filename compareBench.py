@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Compare two Google Benchmark JSON results of benchImage and flag the regressions.
+
+    python3 compareBench.py baseline.json current.json [--threshold 0.10] [--metric auto]
+
+Runs with repetitions are compared on their median, other runs on the mean of their iterations.
+By default the benchmarks registered with UseRealTime() (their names end in /real_time), most of which
+run on the thread pool, are compared on their wall time, the others on the CPU time of the main thread.
+The exit status is 1 when a benchmark got slower than the threshold, so the script can gate a CI job.
+"""
+
+import argparse
+import json
+import re
+import statistics
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path, metric):
+    """Return {benchmark name: time in ns} for one result file."""
+    with open(path) as file:
+        benchmarks = json.load(file)["benchmarks"]
+
+    medians, iterations = {}, {}
+    for entry in benchmarks:
+        if entry.get("error_occurred"):
+            continue
+        name = entry.get("run_name", entry["name"])
+        key = metric
+        if metric == "auto":
+            key = "real_time" if name.endswith("/real_time") else "cpu_time"
+        time = entry[key] * TIME_UNITS[entry.get("time_unit", "ns")]
+        if entry.get("run_type") == "aggregate":
+            if entry.get("aggregate_name") == "median":
+                medians[name] = time
+        else:
+            iterations.setdefault(name, []).append(time)
+
+    times = {name: statistics.mean(values) for name, values in iterations.items()}
+    times.update(medians)
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline", help="stored results (benchImage --benchmark_out=... --benchmark_out_format=json)")
+    parser.add_argument("current", help="results to check")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown reported as a regression (default: 0.10)")
+    parser.add_argument("--metric", choices=("auto", "cpu_time", "real_time"), default="auto",
+                        help="time compared (default: real_time for the UseRealTime() runs, cpu_time for the others)")
+    parser.add_argument("--filter", default="", help="only compare the benchmarks matching this regex")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+    pattern = re.compile(args.filter)
+
+    regressions, improvements = [], []
+    for name in sorted(set(baseline) & set(current)):
+        if not pattern.search(name) or baseline[name] <= 0:
+            continue
+        change = current[name] / baseline[name] - 1
+        if change > args.threshold:
+            regressions.append((name, baseline[name], current[name], change))
+        elif change < -args.threshold:
+            improvements.append((name, baseline[name], current[name], change))
+
+    def report(title, rows):
+        if not rows:
+            return
+        print(f"{title} ({len(rows)}):")
+        width = max(len(name) for name, *_ in rows)
+        for name, before, after, change in sorted(rows, key=lambda row: -abs(row[3])):
+            print(f"  {name:<{width}}  {before:14.0f} ns -> {after:14.0f} ns  {change:+7.1%}")
+
+    report("Regressions", regressions)
+    report("Improvements", improvements)
+    missing = sorted(name for name in set(baseline) - set(current) if pattern.search(name))
+    added = sorted(name for name in set(current) - set(baseline) if pattern.search(name))
+    if missing:
+        print(f"Missing from the current results: {len(missing)}")
+    if added:
+        print(f"Not in the baseline: {len(added)}")
+
+    compared = sum(1 for name in set(baseline) & set(current) if pattern.search(name))
+    print(f"{compared} benchmarks compared, {len(regressions)} slower and {len(improvements)} faster "
+          f"than the baseline by more than {args.threshold:.0%} ({args.metric}).")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
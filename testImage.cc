@@ -1,6 +1,29 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <execution>
+#include <fstream>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
 #include "Image.h"
+#include "ImageBatch.h"
+#include "ImageComposite.h"
+#include "ImageExpr.h"
+#include "ImageFilter.h"
+#include "ImageIO.h"
+#include "ImageInstrumentation.h"
+#include "ImageResize.h"
+#include "ImageStats.h"
+#include "ImageStream.h"
+#include "ImageTransform.h"
+#include "ImageYUV.h"
 
 int main(int argc, char* argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -497,3 +520,2446 @@ TEST(BufferConstructor, Initialization) {
   EXPECT_EQ(c11.blue, 120);
   EXPECT_EQ(c11.alpha, 1);
 }
+
+/** ----- Conversion engine Check ----- **/
+
+/**
+ * Convert a pixel the way the Image converting constructor originally did: fromRaw, cross_product on
+ * the four channels, then toRaw. Used as the reference for the specialized row kernels.
+ */
+template<typename PixelSrc, typename PixelDst>
+void referenceConvert(const typename PixelSrc::DataType* src, typename PixelDst::DataType* dst) {
+  using T_dst = typename PixelDst::DataType;
+  img::Color<typename PixelSrc::DataType> srcColor{};
+  PixelSrc::fromRaw(srcColor, src);
+  const img::Color<T_dst> dstColor {
+    img::cross_product<T_dst>(srcColor.red),
+    img::cross_product<T_dst>(srcColor.green),
+    img::cross_product<T_dst>(srcColor.blue),
+    img::cross_product<T_dst>(srcColor.alpha)
+  };
+  PixelDst::toRaw(dst, dstColor);
+}
+
+/**
+ * Fill a buffer with a deterministic pattern covering the whole range of the type.
+ */
+template<typename T>
+void fillPattern(T* data, const std::size_t size) {
+  for (std::size_t i = 0; i < size; ++i) {
+    if constexpr (std::is_floating_point_v<T>) {
+      data[i] = static_cast<T>((i * 37) % 256) / static_cast<T>(255);
+    } else {
+      data[i] = static_cast<T>((i * 37) % 256);
+    }
+  }
+}
+
+/**
+ * Check that the row kernel picked for a pair of pixel types gives the same samples as the reference.
+ * Identical pixel types are a plain copy (the gray round trip through the luminance is not exact).
+ */
+template<typename PixelSrc, typename PixelDst>
+void checkRowKernel() {
+  using T_src = typename PixelSrc::DataType;
+  using T_dst = typename PixelDst::DataType;
+  constexpr std::size_t width = 37, height = 5;
+
+  std::vector<T_src> raw(width * height * PixelSrc::PlaneCount);
+  fillPattern(raw.data(), raw.size());
+  const img::Image<PixelSrc> src(width, height, raw.data());
+  const img::Image<PixelDst> dst(src);
+
+  T_dst expected[PixelDst::PlaneCount];
+  for (std::size_t i = 0; i < width * height; ++i) {
+    if constexpr (std::is_same_v<PixelSrc, PixelDst>) {
+      std::copy_n(src.getData() + i * PixelSrc::PlaneCount, PixelSrc::PlaneCount, expected);
+    } else {
+      referenceConvert<PixelSrc, PixelDst>(src.getData() + i * PixelSrc::PlaneCount, expected);
+    }
+    for (int plane = 0; plane < PixelDst::PlaneCount; ++plane) {
+      EXPECT_EQ(dst.getData()[i * PixelDst::PlaneCount + plane], expected[plane]);
+    }
+  }
+}
+
+template<typename T_src, typename T_dst, template<typename> class PixelSrc>
+void checkRowKernelFrom() {
+  checkRowKernel<PixelSrc<T_src>, img::PixelRGB<T_dst>>();
+  checkRowKernel<PixelSrc<T_src>, img::PixelBGR<T_dst>>();
+  checkRowKernel<PixelSrc<T_src>, img::PixelRGBA<T_dst>>();
+  checkRowKernel<PixelSrc<T_src>, img::PixelBGRA<T_dst>>();
+  checkRowKernel<PixelSrc<T_src>, img::PixelGray<T_dst>>();
+}
+
+template<typename T_src, typename T_dst>
+void checkRowKernelEveryPixelType() {
+  checkRowKernelFrom<T_src, T_dst, img::PixelRGB>();
+  checkRowKernelFrom<T_src, T_dst, img::PixelBGR>();
+  checkRowKernelFrom<T_src, T_dst, img::PixelRGBA>();
+  checkRowKernelFrom<T_src, T_dst, img::PixelBGRA>();
+  checkRowKernelFrom<T_src, T_dst, img::PixelGray>();
+}
+
+TEST(ConversionEngine, uint8_t) { checkRowKernelEveryPixelType<uint8_t, uint8_t>(); }
+TEST(ConversionEngine, float) { checkRowKernelEveryPixelType<float, float>(); }
+TEST(ConversionEngine, uint8_t_to_float) { checkRowKernelEveryPixelType<uint8_t, float>(); }
+TEST(ConversionEngine, float_to_uint8_t) { checkRowKernelEveryPixelType<float, uint8_t>(); }
+TEST(ConversionEngine, double) { checkRowKernelEveryPixelType<double, double>(); }
+
+TEST(ConversionEngine, AssignmentReusesSize) {
+  img::ImageBGR imageBGR(4, 3);
+  const img::ImageRGB imageRGB(imageBGR);
+  img::ImageRGBA imageRGBA(2, 2);
+  imageRGBA = imageRGB;
+  EXPECT_EQ(imageRGBA.getWidth(), 4u);
+  EXPECT_EQ(imageRGBA.getHeight(), 3u);
+  const auto [red, green, blue, alpha] = imageRGBA.getColor(3, 2);
+  EXPECT_EQ(red, 0);
+  EXPECT_EQ(green, 0);
+  EXPECT_EQ(blue, 255);
+  EXPECT_EQ(alpha, 255);
+
+  img::ImageRGBA empty;
+  imageRGBA = img::ImageRGB();
+  EXPECT_EQ(imageRGBA.getWidth(), 0u);
+  empty = imageRGBA;
+  EXPECT_EQ(empty.getHeight(), 0u);
+}
+
+/** ----- SIMD kernels Check ----- **/
+
+/**
+ * Run `check` once for every SIMD level the CPU supports, then restore the detected level.
+ */
+template<typename Check>
+void forEachSimdLevel(Check check) {
+  const img::simd::Level detected = img::simd::detectLevel();
+  for (const auto level : {img::simd::Level::Scalar, img::simd::Level::SSE41, img::simd::Level::AVX2, img::simd::Level::NEON}) {
+    img::simd::setLevel(level);
+    if (img::simd::level() != level) continue;
+    check();
+  }
+  img::simd::setLevel(detected);
+}
+
+/**
+ * Compare a conversion kernel against the reference on every row length up to 70 pixels, so every
+ * vector body and scalar tail is exercised.
+ */
+template<typename PixelSrc, typename PixelDst>
+void checkSimdKernel() {
+  using T_src = typename PixelSrc::DataType;
+  using T_dst = typename PixelDst::DataType;
+  forEachSimdLevel([] {
+    for (std::size_t count = 0; count <= 70; ++count) {
+      std::vector<T_src> src(count * PixelSrc::PlaneCount);
+      fillPattern(src.data(), src.size());
+      std::vector<T_dst> dst(count * PixelDst::PlaneCount);
+      img::convertRow<PixelSrc, PixelDst>(src.data(), dst.data(), count);
+
+      T_dst expected[PixelDst::PlaneCount];
+      for (std::size_t i = 0; i < count; ++i) {
+        referenceConvert<PixelSrc, PixelDst>(src.data() + i * PixelSrc::PlaneCount, expected);
+        for (int plane = 0; plane < PixelDst::PlaneCount; ++plane) {
+          EXPECT_EQ(dst[i * PixelDst::PlaneCount + plane], expected[plane]);
+        }
+      }
+    }
+  });
+}
+
+template<typename T>
+void checkSimdKernelEveryPixelType() {
+  checkSimdKernel<img::PixelRGB<T>, img::PixelBGR<T>>();
+  checkSimdKernel<img::PixelRGBA<T>, img::PixelBGRA<T>>();
+  checkSimdKernel<img::PixelRGB<T>, img::PixelRGBA<T>>();
+  checkSimdKernel<img::PixelRGB<T>, img::PixelBGRA<T>>();
+  checkSimdKernel<img::PixelBGR<T>, img::PixelRGBA<T>>();
+  checkSimdKernel<img::PixelRGBA<T>, img::PixelRGB<T>>();
+  checkSimdKernel<img::PixelRGBA<T>, img::PixelBGR<T>>();
+  checkSimdKernel<img::PixelBGRA<T>, img::PixelBGR<T>>();
+}
+
+TEST(SimdKernels, uint8_t) { checkSimdKernelEveryPixelType<uint8_t>(); }
+TEST(SimdKernels, float) { checkSimdKernelEveryPixelType<float>(); }
+
+TEST(SimdKernels, FloatLuminanceIsExact) {
+  checkSimdKernel<img::PixelRGB<float>, img::PixelGray<float>>();
+  checkSimdKernel<img::PixelBGR<float>, img::PixelGray<float>>();
+  checkSimdKernel<img::PixelRGBA<float>, img::PixelGray<float>>();
+  checkSimdKernel<img::PixelBGRA<float>, img::PixelGray<float>>();
+}
+
+/**
+ * The fixed-point luminance is the exact floor((299 r + 587 g + 114 b) / 1000): at most one above
+ * the double precision PixelGray::toRaw, never below. Every 8 bit input is checked on the scalar
+ * formula, and every SIMD level must give the same bytes as the scalar formula.
+ */
+TEST(SimdKernels, Uint8LuminanceTolerance) {
+  std::size_t above = 0;
+  for (unsigned red = 0; red < 256; ++red) {
+    for (unsigned green = 0; green < 256; ++green) {
+      for (unsigned blue = 0; blue < 256; ++blue) {
+        const uint8_t fixed = img::simd::luma8(red, green, blue);
+        ASSERT_EQ(fixed, (299 * red + 587 * green + 114 * blue) / 1000);
+        uint8_t scalar;
+        img::PixelGray<uint8_t>::toRaw(&scalar, {uint8_t(red), uint8_t(green), uint8_t(blue), 255});
+        ASSERT_TRUE(fixed == scalar || fixed == scalar + 1);
+        above += fixed != scalar;
+      }
+    }
+  }
+  EXPECT_EQ(above, 3464u);
+
+  forEachSimdLevel([] {
+    std::vector<uint8_t> src(256 * 256 * 3);
+    std::vector<uint8_t> dst(256 * 256);
+    for (unsigned red = 0; red < 256; red += 15) {
+      for (std::size_t i = 0; i < 256 * 256; ++i) {
+        src[i * 3] = static_cast<uint8_t>(red);
+        src[i * 3 + 1] = static_cast<uint8_t>(i >> 8);
+        src[i * 3 + 2] = static_cast<uint8_t>(i & 0xFF);
+      }
+      img::convertRow<img::PixelRGB<uint8_t>, img::PixelGray<uint8_t>>(src.data(), dst.data(), 256 * 256);
+      for (std::size_t i = 0; i < 256 * 256; ++i) {
+        ASSERT_EQ(dst[i], img::simd::luma8(red, src[i * 3 + 1], src[i * 3 + 2]));
+      }
+    }
+  });
+}
+
+TEST(SimdKernels, InPlace) {
+  forEachSimdLevel([] {
+    constexpr std::size_t count = 67;
+    std::vector<uint8_t> data(count * 4);
+    fillPattern(data.data(), data.size());
+    const std::vector<uint8_t> original = data;
+
+    img::simd::swapRedBlue(data.data(), data.data(), count, 4);
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(data[i * 4], original[i * 4 + 2]);
+      EXPECT_EQ(data[i * 4 + 2], original[i * 4]);
+    }
+
+    data = original;
+    img::simd::dropAlpha(data.data(), data.data(), count, false);
+    for (std::size_t i = 0; i < count; ++i) {
+      EXPECT_EQ(data[i * 3], original[i * 4]);
+      EXPECT_EQ(data[i * 3 + 1], original[i * 4 + 1]);
+      EXPECT_EQ(data[i * 3 + 2], original[i * 4 + 2]);
+    }
+  });
+}
+
+/** ----- Parallel execution Check ----- **/
+
+TEST(Parallel, ParallelForCoversRangeOnce) {
+  img::ThreadPool pool(4);
+  EXPECT_EQ(pool.getThreadCount(), 4u);
+  std::vector<int> hits(1000, 0);
+  pool.parallelFor(hits.size(), 7, [&](const std::size_t begin, const std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) ++hits[i];
+  });
+  for (const int hit : hits) EXPECT_EQ(hit, 1);
+
+  pool.parallelFor(0, 7, [&](std::size_t, std::size_t) { FAIL(); });
+}
+
+TEST(Parallel, ExceptionIsRethrown) {
+  img::ThreadPool pool(3);
+  EXPECT_THROW(pool.parallelFor(100, 1, [](const std::size_t begin, std::size_t) {
+    if (begin == 42) throw std::runtime_error("row 42");
+  }), std::runtime_error);
+}
+
+/**
+ * Every whole-image operation gives the same samples with 1 thread and with several threads
+ * splitting the rows in small chunks.
+ */
+TEST(Parallel, DeterministicAcrossThreadCounts) {
+  constexpr std::size_t width = 61, height = 47;
+  std::vector<uint8_t> raw(width * height * 3);
+  fillPattern(raw.data(), raw.size());
+
+  const auto run = [&] {
+    const img::ImageRGB rgb(width, height, raw.data());
+    const img::ImageBGRA bgra(rgb);
+    const img::ImageGray gray(bgra);
+    img::Image<img::PixelRGBA<float>> rgbaFloat(width, height);
+    rgbaFloat = gray;
+    const img::ImageRGB copy(rgb);
+    return std::make_tuple(std::vector<uint8_t>(bgra.getData(), bgra.getData() + width * height * 4),
+                           std::vector<uint8_t>(gray.getData(), gray.getData() + width * height),
+                           std::vector<float>(rgbaFloat.getData(), rgbaFloat.getData() + width * height * 4),
+                           std::vector<uint8_t>(copy.getData(), copy.getData() + width * height * 3));
+  };
+
+  const std::size_t threshold = img::getParallelThreshold();
+  img::ThreadPool::setGlobalThreadCount(1);
+  const auto serial = run();
+  img::ThreadPool::setGlobalThreadCount(4);
+  img::setParallelThreshold(0);
+  const auto parallel = run();
+  img::setParallelThreshold(threshold);
+  img::ThreadPool::setGlobalThreadCount(std::thread::hardware_concurrency());
+
+  EXPECT_EQ(serial, parallel);
+  EXPECT_EQ(std::get<3>(parallel), raw);
+}
+
+/** ----- ImageView Check ----- **/
+
+TEST(ImageView, WrapsWithoutCopy) {
+  constexpr std::size_t width = 3, height = 2;
+  std::uint8_t raw[width * height * 3];
+  fillPattern(raw, sizeof(raw));
+
+  const img::ImageView<img::PixelRGB<uint8_t>> view(width, height, raw);
+  EXPECT_EQ(view.getWidth(), width);
+  EXPECT_EQ(view.getHeight(), height);
+  EXPECT_EQ(view.getStride(), width * 3);
+  EXPECT_EQ(view.getData(), raw);
+
+  view.setColor(1, 1, {1, 2, 3, 255});
+  EXPECT_EQ(raw[(1 * width + 1) * 3], 1);
+  EXPECT_EQ(raw[(1 * width + 1) * 3 + 2], 3);
+
+  const img::ConstImageView<img::PixelRGB<uint8_t>> constView = view;
+  const auto [red, green, blue, alpha] = constView.getColor(1, 1);
+  EXPECT_EQ(red, 1);
+  EXPECT_EQ(green, 2);
+  EXPECT_EQ(blue, 3);
+  EXPECT_EQ(alpha, 255);
+}
+
+TEST(ImageView, StridedSourceAndDestination) {
+  // 2x2 BGR pixels, rows padded to 8 bytes.
+  constexpr std::size_t stride = 8;
+  const std::uint8_t bgr[2 * stride] = {
+    1, 2, 3, 4, 5, 6, 0xEE, 0xEE,
+    7, 8, 9, 10, 11, 12, 0xEE, 0xEE
+  };
+  const img::ConstImageView<img::PixelBGR<uint8_t>> src(2, 2, bgr, stride);
+
+  const img::ImageRGBA rgba(src);
+  const auto c11 = rgba.getColor(1, 1);
+  EXPECT_EQ(c11.red, 12);
+  EXPECT_EQ(c11.green, 11);
+  EXPECT_EQ(c11.blue, 10);
+  EXPECT_EQ(c11.alpha, 255);
+
+  // Destination rows padded to 10 bytes: the padding is left untouched.
+  std::uint8_t rgb[2 * 10];
+  std::fill(std::begin(rgb), std::end(rgb), 0xAA);
+  img::convert(src, img::ImageView<img::PixelRGB<uint8_t>>(2, 2, rgb, 10));
+  const std::uint8_t expected[2 * 10] = {
+    3, 2, 1, 6, 5, 4, 0xAA, 0xAA, 0xAA, 0xAA,
+    9, 8, 7, 12, 11, 10, 0xAA, 0xAA, 0xAA, 0xAA
+  };
+  EXPECT_TRUE(std::equal(std::begin(rgb), std::end(rgb), std::begin(expected)));
+
+  img::ImageGray gray;
+  gray = src;
+  EXPECT_EQ(gray.getWidth(), 2u);
+  EXPECT_EQ(gray.getColor(0, 0).red, img::simd::luma8(3, 2, 1));
+}
+
+TEST(ImageView, ImageViewsAndSizeCheck) {
+  img::ImageRGB image(4, 4);
+  const auto view = image.view();
+  EXPECT_EQ(view.getData(), image.getData());
+  view.setColor(2, 3, {9, 8, 7, 255});
+  EXPECT_EQ(image.getColor(2, 3).green, 8);
+
+  img::ImageBGRA bgra(4, 4);
+  img::convert(image.view(), bgra.view());
+  EXPECT_EQ(bgra.getColor(2, 3).red, 9);
+
+  img::ImageBGRA small(2, 2);
+  EXPECT_THROW(img::convert(image.view(), small.view()), std::invalid_argument);
+}
+
+/** ----- Row stride Check ----- **/
+
+TEST(RowStride, PaddedRowsAreAligned) {
+  const img::ImageRGB packed(5, 3);
+  EXPECT_EQ(packed.getStride(), 15u);
+  EXPECT_EQ(packed.getAlignment(), img::RowAlignment::Packed);
+
+  const img::ImageRGB padded(5, 3, img::RowAlignment::Align64);
+  EXPECT_EQ(padded.getStride(), 64u);
+  const img::Image<img::PixelRGBA<float>> paddedFloat(5, 3, img::RowAlignment::Align32);
+  EXPECT_EQ(paddedFloat.getStride(), 24u);
+  const img::Image<img::PixelRGB<double>> exact(4, 2, img::RowAlignment::Align32);
+  EXPECT_EQ(exact.getStride(), 12u);
+
+  for (std::size_t row = 0; row < padded.getHeight(); ++row) {
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(padded.getRow(row)) % 64, 0u);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(paddedFloat.getRow(row)) % 32, 0u);
+  }
+  const auto [red, green, blue, alpha] = padded.getColor(4, 2);
+  EXPECT_EQ(red, 0);
+  EXPECT_EQ(green, 0);
+  EXPECT_EQ(blue, 255);
+  EXPECT_EQ(alpha, 255);
+}
+
+TEST(RowStride, ConversionsBetweenStrides) {
+  constexpr std::size_t width = 7, height = 5;
+  std::vector<uint8_t> raw(width * height * 3);
+  fillPattern(raw.data(), raw.size());
+
+  const img::ImageRGB packed(width, height, raw.data());
+  const img::ImageRGB padded(width, height, raw.data(), img::RowAlignment::Align32);
+  EXPECT_EQ(padded.getStride(), 32u);
+  for (std::size_t row = 0; row < height; ++row) {
+    EXPECT_TRUE(std::equal(packed.getRow(row), packed.getRow(row) + width * 3, padded.getRow(row)));
+  }
+
+  const img::ImageBGRA fromPacked(packed);
+  const img::ImageBGRA fromPadded(padded.view(), img::RowAlignment::Align64);
+  EXPECT_EQ(fromPadded.getStride(), 64u);
+  img::ImageGray gray(1, 1, img::RowAlignment::Align32);
+  gray = padded;
+  EXPECT_EQ(gray.getStride(), 32u);
+  for (std::size_t row = 0; row < height; ++row) {
+    for (std::size_t col = 0; col < width; ++col) {
+      const auto a = fromPacked.getColor(col, row);
+      const auto b = fromPadded.getColor(col, row);
+      EXPECT_EQ(a.red, b.red);
+      EXPECT_EQ(a.green, b.green);
+      EXPECT_EQ(a.blue, b.blue);
+      EXPECT_EQ(gray.getColor(col, row).red, img::ImageGray(packed).getColor(col, row).red);
+    }
+  }
+
+  // Copies keep the row alignment, moves take the buffer.
+  img::ImageRGB copy(padded);
+  EXPECT_EQ(copy.getStride(), 32u);
+  img::ImageRGB assigned;
+  assigned = padded;
+  EXPECT_EQ(assigned.getAlignment(), img::RowAlignment::Align32);
+  EXPECT_EQ(assigned.getColor(6, 4).red, packed.getColor(6, 4).red);
+  const img::ImageRGB moved(std::move(copy));
+  EXPECT_EQ(moved.getStride(), 32u);
+  EXPECT_EQ(copy.getStride(), 0u);
+}
+
+/** ----- Memory resource Check ----- **/
+
+/**
+ * Memory resource counting the allocations it forwards to the default resource.
+ */
+class CountingResource : public std::pmr::memory_resource {
+  void* do_allocate(const std::size_t bytes, const std::size_t alignment) override {
+    ++allocations;
+    bytesAllocated += bytes;
+    EXPECT_EQ(alignment, 64u);
+    return std::pmr::get_default_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* buffer, const std::size_t bytes, const std::size_t alignment) override {
+    ++deallocations;
+    std::pmr::get_default_resource()->deallocate(buffer, bytes, alignment);
+  }
+  [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override { return this == &other; }
+
+public:
+  std::size_t allocations{0}, deallocations{0}, bytesAllocated{0};
+};
+
+TEST(MemoryResource, ImagesAllocateFromTheirResource) {
+  CountingResource resource;
+  {
+    img::ImageRGBA image(10, 10, img::RowAlignment::Packed, &resource);
+    EXPECT_EQ(image.getResource(), &resource);
+    EXPECT_EQ(resource.allocations, 1u);
+    EXPECT_EQ(resource.bytesAllocated, 400u);
+
+    const img::ImageRGBA copy(image);  // the default resource, like std::pmr containers
+    EXPECT_EQ(copy.getResource(), std::pmr::get_default_resource());
+    img::ImageRGBA other;
+    other = image;                     // keeps the default resource
+    EXPECT_EQ(other.getResource(), std::pmr::get_default_resource());
+    EXPECT_EQ(resource.allocations, 1u);
+
+    img::ImageRGBA moved(std::move(image));
+    EXPECT_EQ(moved.getResource(), &resource);
+    other = std::move(moved);          // the buffer goes with its resource
+    EXPECT_EQ(other.getResource(), &resource);
+
+    img::ImageGray gray(&resource);
+    gray = copy;
+    const img::ImageRGB converted(copy.view(), img::RowAlignment::Packed, &resource);
+    EXPECT_EQ(resource.allocations, 3u);
+  }
+  EXPECT_EQ(resource.deallocations, resource.allocations);
+}
+
+TEST(MemoryResource, FramePoolRecyclesBuffers) {
+  img::FramePool pool;
+  const void* first;
+  {
+    const img::ImageRGB frame(64, 32, img::RowAlignment::Packed, &pool);
+    first = frame.getData();
+  }
+  EXPECT_EQ(pool.getStats().misses, 1u);
+  EXPECT_EQ(pool.getStats().bytesHeld, 64u * 32 * 3);
+
+  for (int i = 0; i < 5; ++i) {
+    const img::ImageRGB frame(64, 32, img::RowAlignment::Packed, &pool);
+    EXPECT_EQ(frame.getData(), first);
+    EXPECT_EQ(pool.getStats().bytesHeld, 0u);
+  }
+  {
+    const img::ImageRGB other(32, 32, img::RowAlignment::Packed, &pool);  // another size
+    const img::ImageRGB same(64, 32, img::RowAlignment::Packed, &pool);
+  }
+  const auto stats = pool.getStats();
+  EXPECT_EQ(stats.hits, 6u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.bytesHeld, 64u * 32 * 3 + 32 * 32 * 3);
+
+  pool.release();
+  EXPECT_EQ(pool.getStats().bytesHeld, 0u);
+}
+
+TEST(MemoryResource, FramePoolLimit) {
+  CountingResource upstream;
+  {
+    img::FramePool pool(100, &upstream);
+    { const img::ImageGray a(10, 10, img::RowAlignment::Packed, &pool); }
+    { const img::ImageGray a(10, 10, img::RowAlignment::Packed, &pool), b(10, 10, img::RowAlignment::Packed, &pool); }
+    EXPECT_EQ(pool.getStats().bytesHeld, 100u);
+    EXPECT_EQ(upstream.allocations, 2u);
+    EXPECT_EQ(upstream.deallocations, 1u);
+  }
+  EXPECT_EQ(upstream.deallocations, 2u);
+}
+
+/** ----- Fill Check ----- **/
+
+template<typename Pixel>
+void checkFill(const std::size_t width, const std::size_t height, const img::RowAlignment alignment) {
+  using DataType = typename Pixel::DataType;
+  img::Image<Pixel> image(width, height, img::uninitialized, alignment);
+  EXPECT_EQ(image.getWidth(), width);
+  EXPECT_EQ(image.getHeight(), height);
+
+  const img::Color<DataType> color{Pixel::Max, 0, Pixel::Max, Pixel::Max};
+  image.fill(color);
+  DataType expected[Pixel::PlaneCount];
+  Pixel::toRaw(expected, color);
+  for (std::size_t row = 0; row < height; ++row) {
+    for (std::size_t col = 0; col < width; ++col) {
+      for (int plane = 0; plane < Pixel::PlaneCount; ++plane) {
+        EXPECT_EQ(image.getRow(row)[col * Pixel::PlaneCount + plane], expected[plane]);
+      }
+    }
+  }
+}
+
+template<typename T>
+void checkFillEveryPixelType() {
+  for (const auto alignment : {img::RowAlignment::Packed, img::RowAlignment::Align64}) {
+    checkFill<img::PixelRGB<T>>(37, 5, alignment);
+    checkFill<img::PixelBGRA<T>>(1, 3, alignment);
+    checkFill<img::PixelGray<T>>(64, 2, alignment);
+  }
+  checkFill<img::PixelRGBA<T>>(0, 0, img::RowAlignment::Packed);
+}
+
+TEST(Fill, uint8_t) { checkFillEveryPixelType<uint8_t>(); }
+TEST(Fill, float) { checkFillEveryPixelType<float>(); }
+TEST(Fill, long_double) { checkFillEveryPixelType<long double>(); }
+
+TEST(Fill, ViewAndDefaultBlue) {
+  img::ImageRGB image(8, 8);
+  for (std::size_t row = 0; row < 8; ++row) {
+    for (std::size_t col = 0; col < 8; ++col) {
+      const auto [red, green, blue, alpha] = image.getColor(col, row);
+      EXPECT_EQ(red, 0);
+      EXPECT_EQ(green, 0);
+      EXPECT_EQ(blue, 255);
+    }
+  }
+
+  // Only the pixels of the view are written.
+  std::uint8_t raw[3 * 8];
+  std::fill(std::begin(raw), std::end(raw), 7);
+  img::ImageView<img::PixelRGB<uint8_t>>(2, 3, raw, 8).fill({1, 2, 3, 255});
+  const std::uint8_t expected[3 * 8] = {
+    1, 2, 3, 1, 2, 3, 7, 7,
+    1, 2, 3, 1, 2, 3, 7, 7,
+    1, 2, 3, 1, 2, 3, 7, 7
+  };
+  EXPECT_TRUE(std::equal(std::begin(raw), std::end(raw), std::begin(expected)));
+}
+
+/** ----- In place conversion Check ----- **/
+
+/**
+ * Convert in place and compare with the converting constructor; the buffer must be reused.
+ */
+template<typename PixelSrc, typename PixelDst>
+void checkConvertInPlace(const img::RowAlignment alignment) {
+  using T = typename PixelSrc::DataType;
+  constexpr std::size_t width = 23, height = 7;
+  std::vector<T> raw(width * height * PixelSrc::PlaneCount);
+  fillPattern(raw.data(), raw.size());
+
+  img::Image<PixelSrc> src(width, height, raw.data(), alignment);
+  const img::Image<PixelDst> expected(src);
+  const T* buffer = src.getData();
+
+  const img::Image<PixelDst> converted = src.template convertInPlace<PixelDst>();
+  EXPECT_EQ(converted.getData(), buffer);
+  EXPECT_EQ(src.getData(), nullptr);
+  EXPECT_EQ(src.getWidth(), 0u);
+  EXPECT_EQ(converted.getWidth(), width);
+  EXPECT_EQ(converted.getHeight(), height);
+  if (alignment == img::RowAlignment::Packed) {
+    EXPECT_EQ(converted.getStride(), width * PixelDst::PlaneCount);
+  }
+  for (std::size_t row = 0; row < height; ++row) {
+    EXPECT_TRUE(std::equal(expected.getRow(row), expected.getRow(row) + width * PixelDst::PlaneCount, converted.getRow(row)));
+  }
+}
+
+template<typename T>
+void checkConvertInPlaceEveryPixelType() {
+  for (const auto alignment : {img::RowAlignment::Packed, img::RowAlignment::Align64}) {
+    checkConvertInPlace<img::PixelRGBA<T>, img::PixelBGRA<T>>(alignment);
+    checkConvertInPlace<img::PixelRGB<T>, img::PixelBGR<T>>(alignment);
+    checkConvertInPlace<img::PixelRGBA<T>, img::PixelRGB<T>>(alignment);
+    checkConvertInPlace<img::PixelBGRA<T>, img::PixelRGB<T>>(alignment);
+    checkConvertInPlace<img::PixelRGB<T>, img::PixelGray<T>>(alignment);
+    checkConvertInPlace<img::PixelBGRA<T>, img::PixelGray<T>>(alignment);
+    checkConvertInPlace<img::PixelRGB<T>, img::PixelRGB<T>>(alignment);
+  }
+}
+
+TEST(ConvertInPlace, uint8_t) { checkConvertInPlaceEveryPixelType<uint8_t>(); }
+TEST(ConvertInPlace, float) { checkConvertInPlaceEveryPixelType<float>(); }
+TEST(ConvertInPlace, double) { checkConvertInPlaceEveryPixelType<double>(); }
+TEST(ConvertInPlace, int) { checkConvertInPlaceEveryPixelType<int>(); }
+
+TEST(ConvertInPlace, KeepsResourceAndFreesOnce) {
+  CountingResource resource;
+  {
+    img::ImageRGBA rgba(64, 64, img::RowAlignment::Packed, &resource);
+    img::ImageRGB rgb = rgba.convertInPlace<img::PixelRGB<uint8_t>>();
+    EXPECT_EQ(rgb.getResource(), &resource);
+    const auto [red, green, blue, alpha] = rgb.getColor(63, 63);
+    EXPECT_EQ(red, 0);
+    EXPECT_EQ(green, 0);
+    EXPECT_EQ(blue, 255);
+    EXPECT_EQ(resource.allocations, 1u);
+  }
+  EXPECT_EQ(resource.deallocations, 1u);  // the reused buffer goes back to its resource once
+}
+
+/** ----- Netpbm I/O Check ----- **/
+
+// Path of a scratch file, removed when leaving scope
+struct TempFile {
+  std::string path;
+  explicit TempFile(const std::string& name) : path(::testing::TempDir() + name) {}
+  ~TempFile() { std::remove(path.c_str()); }
+};
+
+void writeFile(const std::string& path, const std::string& content) {
+  std::ofstream(path, std::ios::binary) << content;
+}
+
+template<typename Pixel>
+img::Image<Pixel> makePatternImage(const std::size_t width, const std::size_t height, const img::RowAlignment alignment = img::RowAlignment::Packed) {
+  std::vector<typename Pixel::DataType> raw(width * height * Pixel::PlaneCount);
+  fillPattern(raw.data(), raw.size());
+  return img::Image<Pixel>(width, height, raw.data(), alignment);
+}
+
+template<typename Pixel>
+void checkSameImage(const img::ConstImageView<Pixel>& expected, const img::ConstImageView<Pixel>& actual) {
+  ASSERT_EQ(expected.getWidth(), actual.getWidth());
+  ASSERT_EQ(expected.getHeight(), actual.getHeight());
+  for (std::size_t row = 0; row < expected.getHeight(); ++row) {
+    EXPECT_TRUE(std::equal(expected.getRow(row), expected.getRow(row) + expected.getWidth() * Pixel::PlaneCount, actual.getRow(row)));
+  }
+}
+
+template<typename Pixel>
+void checkRoundTrip(const img::RowAlignment alignment) {
+  const TempFile file("roundtrip.pnm");
+  const auto image = makePatternImage<Pixel>(31, 9, alignment);
+  img::saveNetpbm(file.path, image);
+
+  const img::MappedImage<Pixel> mapped(file.path);
+  checkSameImage<Pixel>(image.view(), mapped.view());
+  const auto loaded = img::loadNetpbm<Pixel>(file.path);
+  checkSameImage<Pixel>(image.view(), loaded.view());
+}
+
+TEST(NetpbmIO, RoundTrip) {
+  for (const auto alignment : {img::RowAlignment::Packed, img::RowAlignment::Align64}) {
+    checkRoundTrip<img::PixelGray<uint8_t>>(alignment);
+    checkRoundTrip<img::PixelRGB<uint8_t>>(alignment);
+    checkRoundTrip<img::PixelRGBA<uint8_t>>(alignment);
+  }
+}
+
+TEST(NetpbmIO, ConvertsOtherPixelTypes) {
+  const TempFile file("convert.pnm");
+  const auto bgra = makePatternImage<img::PixelBGRA<float>>(17, 5);
+  img::saveNetpbm(file.path, bgra);
+  EXPECT_EQ(img::MappedImage<img::PixelRGBA<uint8_t>>(file.path).getHeader().format, '7');
+
+  const img::ImageRGBA expected(bgra);
+  checkSameImage<img::PixelRGBA<uint8_t>>(expected.view(), img::loadNetpbm<img::PixelRGBA<uint8_t>>(file.path).view());
+  const img::ImageBGR bgr(expected);
+  checkSameImage<img::PixelBGR<uint8_t>>(bgr.view(), img::loadNetpbm<img::PixelBGR<uint8_t>>(file.path).view());
+}
+
+TEST(NetpbmIO, ParsesCommentsAndPamHeaders) {
+  const TempFile file("header.pnm");
+  writeFile(file.path, std::string("P6 # comment\n2 # width\n1\n255\n") + "\x01\x02\x03\x04\x05\x06");
+  const img::MappedImage<img::PixelRGB<uint8_t>> ppm(file.path);
+  EXPECT_EQ(ppm.view().getWidth(), 2u);
+  const auto [red, green, blue, alpha] = ppm.view().getColor(1, 0);
+  EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(4, 5, 6, 255));
+
+  writeFile(file.path, std::string("P7\nWIDTH 1\nHEIGHT 2\nDEPTH 1\nMAXVAL 255\nTUPLTYPE GRAYSCALE\nENDHDR\n") + "\x07\x08");
+  const img::MappedImage<img::PixelGray<uint8_t>> pam(file.path);
+  EXPECT_EQ(pam.view().getHeight(), 2u);
+  EXPECT_EQ(pam.view().getRow(1)[0], 8);
+}
+
+TEST(NetpbmIO, Errors) {
+  const TempFile file("errors.pnm");
+  EXPECT_THROW(img::MappedImage<img::PixelRGB<uint8_t>>(file.path + ".missing"), std::runtime_error);
+
+  writeFile(file.path, "P6\n4 4\n255\n\x01\x02");
+  EXPECT_THROW(img::loadNetpbm<img::PixelRGB<uint8_t>>(file.path), std::runtime_error);
+  writeFile(file.path, "P6\n1 1\n65535\n\x01\x02\x03\x04\x05\x06");
+  EXPECT_THROW(img::loadNetpbm<img::PixelRGB<uint8_t>>(file.path), std::runtime_error);
+  writeFile(file.path, "P3\n1 1\n255\n1 2 3\n");
+  EXPECT_THROW(img::loadNetpbm<img::PixelRGB<uint8_t>>(file.path), std::runtime_error);
+  writeFile(file.path, "P5\n1 1\n255\n\x01");
+  EXPECT_THROW(img::MappedImage<img::PixelRGB<uint8_t>>(file.path), std::runtime_error);
+  EXPECT_NO_THROW(img::MappedImage<img::PixelGray<uint8_t>>(file.path));
+
+  // A PAM tuple type has to agree with the depth of the file
+  writeFile(file.path, "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 3\nMAXVAL 255\nTUPLTYPE GRAYSCALE\nENDHDR\n\x01\x02\x03");
+  EXPECT_THROW(img::MappedImage<img::PixelGray<uint8_t>>(file.path), std::runtime_error);
+  EXPECT_THROW(img::MappedImage<img::PixelRGB<uint8_t>>(file.path), std::runtime_error);
+  writeFile(file.path, "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n\x01\x02\x03\x04");
+  EXPECT_THROW(img::loadNetpbm<img::PixelRGBA<uint8_t>>(file.path), std::runtime_error);
+  writeFile(file.path, "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n\x01\x02\x03\x04");
+  EXPECT_NO_THROW(img::MappedImage<img::PixelRGBA<uint8_t>>(file.path));
+}
+
+/** ----- Streaming Check ----- **/
+
+// Read back a raw file into an image
+template<typename Pixel>
+img::Image<Pixel> readRaw(const std::string& path, const std::size_t width, const std::size_t height) {
+  img::Image<Pixel> image(width, height, img::uninitialized);
+  img::RawFileReader<Pixel>(path, width, height).read(0, image.view());
+  return image;
+}
+
+TEST(Streaming, NetpbmToRawInStrips) {
+  const TempFile input("stream.ppm"), output("stream.raw");
+  const auto image = makePatternImage<img::PixelRGB<uint8_t>>(37, 11);
+  img::saveNetpbm(input.path, image);
+  const img::Image<img::PixelBGRA<float>> expected(image);
+
+  for (const std::size_t stripRows : {std::size_t{0}, std::size_t{1}, std::size_t{4}, std::size_t{11}, std::size_t{50}}) {
+    img::NetpbmReader<img::PixelRGB<uint8_t>> reader(input.path);
+    img::RawFileWriter<img::PixelBGRA<float>> writer(output.path, 37, 11);
+    const img::StreamStats stats = img::streamConvert(reader, writer, stripRows);
+    const std::size_t rows = stripRows == 0 || stripRows > 11 ? 11 : stripRows;
+    EXPECT_EQ(stats.stripRows, rows);
+    EXPECT_EQ(stats.strips, (11 + rows - 1) / rows);
+    EXPECT_EQ(stats.bufferBytes, 2 * rows * 37 * (3 + 4 * sizeof(float)));
+    checkSameImage<img::PixelBGRA<float>>(expected.view(), readRaw<img::PixelBGRA<float>>(output.path, 37, 11).view());
+  }
+}
+
+TEST(Streaming, RawToNetpbm) {
+  const TempFile input("stream.raw"), output("stream.pgm");
+  const auto image = makePatternImage<img::PixelRGBA<double>>(13, 9);
+  img::RawFileWriter<img::PixelRGBA<double>>(input.path, 13, 9).write(0, image.view());
+
+  img::RawFileReader<img::PixelRGBA<double>> reader(input.path, 13, 9);
+  img::NetpbmWriter<img::PixelGray<uint8_t>> writer(output.path, 13, 9);
+  img::streamConvert(reader, writer, 2);
+  const img::ImageGray expected(image);
+  checkSameImage<img::PixelGray<uint8_t>>(expected.view(), img::MappedImage<img::PixelGray<uint8_t>>(output.path).view());
+}
+
+// Source failing on its third strip
+struct FailingSource {
+  using PixelType = img::PixelRGB<uint8_t>;
+  std::size_t getWidth() const { return 4; }
+  std::size_t getHeight() const { return 10; }
+  void read(const std::size_t firstRow, const img::ImageView<PixelType>& strip) const {
+    if (firstRow >= 4) throw std::runtime_error("read failed");
+    strip.fill({1, 2, 3, 255});
+  }
+};
+
+TEST(Streaming, Errors) {
+  const TempFile output("stream.raw");
+  FailingSource source;
+  img::RawFileWriter<img::PixelGray<uint8_t>> writer(output.path, 4, 10);
+  EXPECT_THROW(img::streamConvert(source, writer, 2), std::runtime_error);
+  img::RawFileWriter<img::PixelGray<uint8_t>> smaller(output.path, 4, 9);
+  EXPECT_THROW(img::streamConvert(source, smaller), std::invalid_argument);
+  EXPECT_THROW(img::RawFileReader<img::PixelGray<uint8_t>>(output.path, 4, 100), std::runtime_error);
+  EXPECT_THROW(img::NetpbmReader<img::PixelGray<uint8_t>>(output.path + ".missing"), std::runtime_error);
+}
+
+/** ----- Planar layout Check ----- **/
+
+template<typename... Pixels, typename Function>
+void forEachPixelType(const Function& function) {
+  (function(Pixels{}), ...);
+}
+
+template<typename PixelA, typename PixelB>
+void checkSameColors(const img::ConstImageView<PixelA>& a, const img::ConstImageView<PixelB>& b) {
+  ASSERT_EQ(a.getWidth(), b.getWidth());
+  ASSERT_EQ(a.getHeight(), b.getHeight());
+  for (std::size_t row = 0; row < a.getHeight(); ++row) {
+    for (std::size_t col = 0; col < a.getWidth(); ++col) {
+      const auto [red, green, blue, alpha] = a.getColor(col, row);
+      const auto [otherRed, otherGreen, otherBlue, otherAlpha] = b.getColor(col, row);
+      EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(otherRed, otherGreen, otherBlue, otherAlpha))
+        << "pixel " << col << ", " << row;
+    }
+  }
+}
+
+/**
+ * A planar image must hold the same colors as its interleaved counterpart built from any source,
+ * and convert to any target exactly like it.
+ */
+template<typename Planar, typename Interleaved>
+void checkPlanarLikeInterleaved(const img::RowAlignment alignment) {
+  using T = typename Planar::DataType;
+  forEachPixelType<img::PixelRGB<T>, img::PixelBGRA<T>, img::PixelGray<T>, img::PixelBGR<T>, img::PixelRGBA<double>>([&](auto source) {
+    const auto src = makePatternImage<decltype(source)>(19, 6);
+    const img::Image<Planar> planar(src.view(), alignment);
+    const img::Image<Interleaved> interleaved(src);
+    checkSameColors<Planar, Interleaved>(planar, interleaved);
+
+    forEachPixelType<img::PixelRGB<T>, img::PixelBGRA<T>, img::PixelGray<T>, img::PixelRGBA<float>,
+                     img::PlanarRGB<T>, img::PlanarRGBA<uint8_t>>([&](auto target) {
+      using Target = decltype(target);
+      checkSameColors<Target, Target>(img::Image<Target>(planar), img::Image<Target>(interleaved));
+    });
+  });
+}
+
+template<typename T>
+void checkPlanarEveryPixelType() {
+  for (const auto alignment : {img::RowAlignment::Packed, img::RowAlignment::Align64}) {
+    checkPlanarLikeInterleaved<img::PlanarRGB<T>, img::PixelRGB<T>>(alignment);
+    checkPlanarLikeInterleaved<img::PlanarRGBA<T>, img::PixelRGBA<T>>(alignment);
+  }
+}
+
+TEST(PlanarLayout, uint8_t) { checkPlanarEveryPixelType<uint8_t>(); }
+TEST(PlanarLayout, float) { checkPlanarEveryPixelType<float>(); }
+TEST(PlanarLayout, double) { checkPlanarEveryPixelType<double>(); }
+TEST(PlanarLayout, int) { checkPlanarEveryPixelType<int>(); }
+
+TEST(PlanarLayout, PlanesFollowEachOther) {
+  img::Image<img::PlanarRGBA<uint8_t>> image(5, 3, img::RowAlignment::Align32);
+  EXPECT_EQ(image.getStride(), 32u);
+  EXPECT_EQ(image.getPlaneStride(), 32u * 3);
+  image.fill({1, 2, 3, 4});
+  image.setColor(4, 2, {10, 20, 30, 40});
+  for (int plane = 0; plane < 4; ++plane) {
+    const uint8_t* samples = image.getPlane(plane);
+    EXPECT_EQ(samples[0], plane + 1);
+    EXPECT_EQ(samples[2 * 32 + 3], plane + 1);
+    EXPECT_EQ(samples[2 * 32 + 4], (plane + 1) * 10);
+  }
+}
+
+TEST(PlanarLayout, ViewOverExternalPlanes) {
+  // Three planes of 2x2 samples, 8 samples apart
+  std::vector<uint8_t> buffer(24, 0);
+  const img::ImageView<img::PlanarRGB<uint8_t>> view(2, 2, buffer.data(), 0, 8);
+  EXPECT_EQ(view.getStride(), 2u);
+  view.setColor(1, 1, {7, 8, 9, 255});
+  EXPECT_EQ(buffer[3], 7);
+  EXPECT_EQ(buffer[11], 8);
+  EXPECT_EQ(buffer[19], 9);
+
+  const img::ImageRGB rgb(view);
+  const auto [red, green, blue, alpha] = rgb.getColor(1, 1);
+  EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(7, 8, 9, 255));
+}
+
+/**
+ * Split interleaved pixels into planes and merge them back on every row length up to 70 pixels, at every SIMD level.
+ */
+template<typename T>
+void checkTransposeKernels() {
+  forEachSimdLevel([] {
+    for (const int planes : {3, 4}) {
+      for (std::size_t count = 0; count <= 70; ++count) {
+        std::vector<T> interleaved(count * planes);
+        fillPattern(interleaved.data(), interleaved.size());
+        std::vector<T> planar(count * planes);
+        T* split[4] = {planar.data(), planar.data() + count, planar.data() + 2 * count, planar.data() + 3 * count};
+        img::simd::deinterleave(interleaved.data(), split, count, planes);
+        for (std::size_t i = 0; i < count; ++i) {
+          for (int plane = 0; plane < planes; ++plane) {
+            EXPECT_EQ(split[plane][i], interleaved[i * planes + plane]);
+          }
+        }
+
+        std::vector<T> merged(count * planes);
+        const T* merge[4] = {split[0], split[1], split[2], split[3]};
+        img::simd::interleave(merge, merged.data(), count, planes);
+        EXPECT_EQ(merged, interleaved);
+      }
+    }
+  });
+}
+
+TEST(PlanarLayout, TransposeKernels) {
+  checkTransposeKernels<uint8_t>();
+  checkTransposeKernels<float>();
+}
+
+/** ----- Depth conversion Check ----- **/
+
+/**
+ * `src * targetMax / sourceMax` computed exactly on 128 bits, truncated toward zero.
+ */
+template<typename T_dst, typename T_src>
+T_dst exactCrossProduct(const T_src src) {
+  using Wide = img::detail::UInt128;
+  if (src < 0) {
+    if (std::is_unsigned_v<T_dst>) return 0;
+    const Wide magnitude = static_cast<Wide>(-(static_cast<long long>(src) + 1)) + 1;
+    return static_cast<T_dst>(-static_cast<T_dst>(magnitude * getMax<T_dst>() / static_cast<Wide>(getMax<T_src>())));
+  }
+  return static_cast<T_dst>(static_cast<Wide>(src) * getMax<T_dst>() / static_cast<Wide>(getMax<T_src>()));
+}
+
+template<typename T_dst, typename T_src>
+void checkIntegerCrossProduct(const std::vector<T_src>& samples) {
+  for (const T_src src : samples) {
+    EXPECT_EQ(img::cross_product<T_dst>(src), exactCrossProduct<T_dst>(src)) << "source " << +src;
+    EXPECT_EQ(img::detail::crossProductCompute<T_dst>(src), exactCrossProduct<T_dst>(src)) << "source " << +src;
+  }
+}
+
+// Every value of the small types, the edges and a spread of values of the wide ones.
+template<typename T_src>
+std::vector<T_src> crossProductSamples() {
+  std::vector<T_src> samples;
+  if constexpr (sizeof(T_src) <= 2) {
+    for (long long value = std::numeric_limits<T_src>::min(); value <= std::numeric_limits<T_src>::max(); ++value) {
+      samples.push_back(static_cast<T_src>(value));
+    }
+  } else {
+    const T_src max = std::numeric_limits<T_src>::max();
+    for (const T_src value : {T_src{0}, T_src{1}, T_src{2}, T_src(max / 2), T_src(max / 2 + 1), T_src(max - 1), max}) {
+      samples.push_back(value);
+    }
+    std::uint64_t state = 0x9E3779B97F4A7C15u;
+    for (int i = 0; i < 4096; ++i) {
+      state = state * 6364136223846793005u + 1442695040888963407u;
+      samples.push_back(static_cast<T_src>(static_cast<T_src>(state >> (i % 40)) & max));
+    }
+  }
+  return samples;
+}
+
+template<typename T_src>
+void checkIntegerCrossProductFrom() {
+  const auto samples = crossProductSamples<T_src>();
+  checkIntegerCrossProduct<uint8_t>(samples);
+  checkIntegerCrossProduct<uint16_t>(samples);
+  checkIntegerCrossProduct<int>(samples);
+  checkIntegerCrossProduct<long long>(samples);
+  checkIntegerCrossProduct<size_t>(samples);
+}
+
+TEST(DepthConversion, SmallIntegersAreExact) {
+  checkIntegerCrossProductFrom<uint8_t>();
+  checkIntegerCrossProductFrom<uint16_t>();
+  checkIntegerCrossProductFrom<int16_t>();
+}
+
+TEST(DepthConversion, IntegerFixedPointIsExact) {
+  checkIntegerCrossProductFrom<int>();
+  checkIntegerCrossProductFrom<long long>();
+  checkIntegerCrossProductFrom<size_t>();
+}
+
+TEST(DepthConversion, NegativeSamples) {
+  EXPECT_EQ(img::cross_product<uint8_t>(-5), 0);
+  EXPECT_EQ(img::cross_product<long long>(-1), -exactCrossProduct<long long>(1));
+  EXPECT_EQ(img::cross_product<int>(-std::numeric_limits<int>::max()), -std::numeric_limits<int>::max());
+  EXPECT_FLOAT_EQ(img::cross_product<float>(int16_t{-32767}), -1.0f);
+}
+
+template<typename T_dst, typename T_src>
+void checkFloatCrossProduct() {
+  for (const T_src src : crossProductSamples<T_src>()) {
+    // The original formula, exact for these pairs.
+    const T_dst expected = static_cast<T_dst>(src * getMax<T_dst>() / getMax<T_src>());
+    EXPECT_EQ(img::cross_product<T_dst>(src), expected) << "source " << +src;
+  }
+}
+
+TEST(DepthConversion, IntegerToFloatingPoint) {
+  checkFloatCrossProduct<float, uint8_t>();
+  checkFloatCrossProduct<double, uint8_t>();
+  checkFloatCrossProduct<long double, uint8_t>();
+  checkFloatCrossProduct<float, uint16_t>();
+  checkFloatCrossProduct<float, int>();
+  checkFloatCrossProduct<double, int>();
+  checkFloatCrossProduct<double, long long>();
+  checkFloatCrossProduct<double, size_t>();
+  checkFloatCrossProduct<long double, size_t>();
+  EXPECT_EQ(img::cross_product<float>(std::numeric_limits<size_t>::max()), 1.0f);
+  EXPECT_EQ(img::cross_product<double>(std::numeric_limits<long long>::max()), 1.0);
+}
+
+TEST(DepthConversion, FloatingPointToInteger) {
+  EXPECT_EQ(img::cross_product<uint8_t>(1.0f), 255);
+  EXPECT_EQ(img::cross_product<uint8_t>(0.5f), 127);
+  EXPECT_EQ(img::cross_product<uint8_t>(0.0f), 0);
+  EXPECT_EQ(img::cross_product<int>(-1.0), -std::numeric_limits<int>::max());
+  // The maximum of size_t and long long rounds up in float and double, the top of the range saturates.
+  EXPECT_EQ(img::cross_product<size_t>(1.0f), std::numeric_limits<size_t>::max());
+  EXPECT_EQ(img::cross_product<size_t>(0.25), std::numeric_limits<size_t>::max() / 4 + 1);
+  EXPECT_EQ(img::cross_product<long long>(1.0), std::numeric_limits<long long>::max());
+  EXPECT_EQ(img::cross_product<long long>(-1.0L), -std::numeric_limits<long long>::max());
+}
+
+TEST(DepthConversion, CompileTime) {
+  static_assert(img::cross_product<int>(uint8_t{255}) == std::numeric_limits<int>::max());
+  static_assert(img::cross_product<size_t>(uint8_t{255}) == std::numeric_limits<size_t>::max());
+  static_assert(img::cross_product<uint8_t>(std::numeric_limits<long long>::max()) == 255);
+  static_assert(img::cross_product<float>(uint8_t{0}) == 0.0f);
+}
+
+TEST(DepthConversion, RowKernelToWiderIntegers) {
+  checkRowKernelEveryPixelType<uint8_t, int>();
+  checkRowKernelEveryPixelType<int, uint8_t>();
+  checkRowKernelEveryPixelType<uint8_t, size_t>();
+}
+
+/** ----- Batch conversion Check ----- **/
+
+std::vector<img::ImageRGB> makeThumbnails() {
+  std::vector<img::ImageRGB> thumbnails;
+  for (const auto& [width, height] : {std::pair{16, 16}, {33, 7}, {0, 0}, {1, 1}, {64, 48}, {5, 0}}) {
+    thumbnails.push_back(makePatternImage<img::PixelRGB<uint8_t>>(width, height));
+  }
+  return thumbnails;
+}
+
+TEST(BatchConversion, SameAsOneImageAtATime) {
+  const auto thumbnails = makeThumbnails();
+  CountingResource resource;
+  {
+    const img::ImageBatch<img::PixelBGRA<uint8_t>> batch(thumbnails, img::RowAlignment::Packed, &resource);
+    ASSERT_EQ(batch.size(), thumbnails.size());
+    EXPECT_EQ(resource.allocations, 1u);
+    EXPECT_EQ(resource.bytesAllocated, batch.getArenaBytes());
+    for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+      checkSameImage<img::PixelBGRA<uint8_t>>(img::ImageBGRA(thumbnails[i]).view(), batch[i].view());
+    }
+  }
+  EXPECT_EQ(resource.deallocations, 1u);
+}
+
+TEST(BatchConversion, BuffersShareTheArena) {
+  const auto thumbnails = makeThumbnails();
+  const img::ImageBatch<img::PixelRGBA<float>> batch(thumbnails, img::RowAlignment::Align64);
+  std::size_t bytes = 0;
+  for (const auto& image : batch) {
+    const std::size_t imageBytes = img::Image<img::PixelRGBA<float>>::bufferBytes(image.getWidth(), image.getHeight(),
+                                                                                  img::RowAlignment::Align64);
+    EXPECT_EQ(imageBytes, image.getStride() * image.getHeight() * sizeof(float));
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(image.getData()) % 64, 0u);
+    bytes += (imageBytes + 63) / 64 * 64;
+  }
+  EXPECT_EQ(batch.getArenaBytes(), bytes);
+  EXPECT_EQ(batch[1].getData(), batch[0].getData() + batch[0].getStride() * batch[0].getHeight());
+}
+
+TEST(BatchConversion, ViewsAndPointers) {
+  const auto thumbnails = makeThumbnails();
+  std::vector<img::ConstImageView<img::PixelRGB<uint8_t>>> views(thumbnails.begin(), thumbnails.end());
+  std::vector<const img::ImageRGB*> pointers;
+  for (const auto& thumbnail : thumbnails) pointers.push_back(&thumbnail);
+
+  img::ImageBatch<img::PixelGray<uint8_t>> fromViews(views);
+  const img::ImageBatch<img::PixelGray<uint8_t>> fromPointers(pointers);
+  for (std::size_t i = 0; i < thumbnails.size(); ++i) {
+    checkSameImage<img::PixelGray<uint8_t>>(img::ImageGray(thumbnails[i]).view(), fromViews[i].view());
+    checkSameImage<img::PixelGray<uint8_t>>(fromViews[i].view(), fromPointers[i].view());
+  }
+
+  fromViews = img::ImageBatch<img::PixelGray<uint8_t>>(std::vector<img::ImageRGB>{});
+  EXPECT_TRUE(fromViews.empty());
+  EXPECT_EQ(fromViews.getArenaBytes(), 0u);
+}
+
+TEST(BatchConversion, CopiesOutliveTheBatch) {
+  const auto thumbnails = makeThumbnails();
+  std::vector<img::ImageRGBA> copies;
+  {
+    const img::ImageBatch<img::PixelRGBA<uint8_t>> batch(thumbnails);
+    copies.push_back(*batch.begin());
+    copies.push_back(batch[1]);
+    EXPECT_EQ(copies[0].getResource(), std::pmr::get_default_resource());
+  }
+  for (std::size_t i = 0; i < copies.size(); ++i) {
+    checkSameImage<img::PixelRGBA<uint8_t>>(img::ImageRGBA(thumbnails[i]).view(), copies[i].view());
+  }
+  EXPECT_EQ(copies[0].getColor(0, 0).alpha, 255);
+}
+
+TEST(BatchConversion, DeterministicAcrossThreadCounts) {
+  std::vector<img::ImageRGB> images;
+  for (std::size_t i = 0; i < 40; ++i) {
+    images.push_back(makePatternImage<img::PixelRGB<uint8_t>>(8 + i, 3 + i % 5));
+  }
+  const img::ImageBatch<img::PixelRGBA<uint8_t>> serial(images);
+
+  const std::size_t threshold = img::getParallelThreshold();
+  img::ThreadPool::setGlobalThreadCount(4);
+  img::setParallelThreshold(0);
+  const img::ImageBatch<img::PixelRGBA<uint8_t>> parallel(images);
+  img::setParallelThreshold(threshold);
+  img::ThreadPool::setGlobalThreadCount(std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < images.size(); ++i) {
+    checkSameImage<img::PixelRGBA<uint8_t>>(serial[i].view(), parallel[i].view());
+  }
+}
+
+/** ----- Lazy expression Check ----- **/
+
+TEST(LazyExpression, FusedChainLikeIntermediateImages) {
+  const auto rgb = makePatternImage<img::PixelRGB<uint8_t>>(37, 11);
+
+  const img::ImageRGBA rgba(rgb);
+  const img::Image<img::PixelRGBA<float>> rgbaFloat(rgba);
+  const img::Image<img::PixelGray<float>> expected(rgbaFloat);
+  const img::Image<img::PixelGray<float>> fused = img::lazy(rgb).to<img::PixelRGBA<uint8_t>>().to<img::PixelRGBA<float>>();
+  checkSameImage<img::PixelGray<float>>(expected.view(), fused.view());
+
+  const img::ImageGray expectedGray(rgba);
+  const img::ImageGray fusedGray = img::lazy(rgb).to<img::PixelRGBA<uint8_t>>();
+  checkSameImage<img::PixelGray<uint8_t>>(expectedGray.view(), fusedGray.view());
+
+  const img::ImageGray gray(rgb);
+  const img::Image<img::PixelRGB<double>> rgbDouble(gray);
+  const img::ImageBGR expectedBGR(rgbDouble);
+  const img::ImageBGR fusedBGR = img::lazy(rgb).to<img::PixelGray<uint8_t>>().to<img::PixelRGB<double>>();
+  checkSameImage<img::PixelBGR<uint8_t>>(expectedBGR.view(), fusedBGR.view());
+}
+
+TEST(LazyExpression, MapAndEvaluateInto) {
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(9, 5);
+  const auto halve = [](const img::Color<float>& color) {
+    return img::Color<float>{color.red / 2, color.green / 2, color.blue / 2, color.alpha};
+  };
+  const auto expr = img::lazy(rgba).to<img::PixelRGBA<float>>().map(halve);
+
+  img::Image<img::PlanarRGBA<float>> planar(9, 5, img::RowAlignment::Align64);
+  expr.evaluateInto(planar.view());
+  for (std::size_t row = 0; row < 5; ++row) {
+    for (std::size_t col = 0; col < 9; ++col) {
+      const auto [red, green, blue, alpha] = rgba.getColor(col, row);
+      const auto [fRed, fGreen, fBlue, fAlpha] = planar.getColor(col, row);
+      EXPECT_EQ(fRed, img::cross_product<float>(red) / 2);
+      EXPECT_EQ(fGreen, img::cross_product<float>(green) / 2);
+      EXPECT_EQ(fBlue, img::cross_product<float>(blue) / 2);
+      EXPECT_EQ(fAlpha, img::cross_product<float>(alpha));
+    }
+  }
+
+  img::Image<img::PixelRGBA<float>> wrongSize(9, 4);
+  EXPECT_THROW(expr.evaluateInto(wrongSize.view()), std::invalid_argument);
+}
+
+TEST(LazyExpression, ReadsTheSourceWhenEvaluated) {
+  img::ImageRGB rgb(4, 4);
+  rgb.fill({10, 20, 30, 255});
+  const auto expr = img::lazy(rgb).map([](const img::Color<uint8_t>& color) {
+    return img::Color<uint8_t>{color.blue, color.green, color.red, color.alpha};
+  });
+  rgb.setColor(1, 2, {1, 2, 3, 255});
+
+  const img::ImageRGB swapped = expr;
+  const auto [red, green, blue, alpha] = swapped.getColor(1, 2);
+  EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(3, 2, 1, 255));
+  const auto [otherRed, otherGreen, otherBlue, otherAlpha] = swapped.getColor(0, 0);
+  EXPECT_EQ(std::make_tuple(otherRed, otherGreen, otherBlue, otherAlpha), std::make_tuple(30, 20, 10, 255));
+}
+
+/** ----- Copy-on-write Check ----- **/
+
+TEST(CopyOnWrite, CopiesShareUntilWritten) {
+  CountingResource resource;
+  {
+    img::ImageRGB image(8, 4, img::RowAlignment::Packed, &resource);
+    image.fill({1, 2, 3, 255});
+    image.setCopyOnWrite(true);
+    EXPECT_TRUE(image.isCopyOnWrite());
+    EXPECT_FALSE(image.isShared());
+    const std::size_t allocations = resource.allocations;  // the buffer and its reference count
+
+    img::ImageRGB copy(image);
+    img::ImageRGB assigned;
+    assigned = image;
+    EXPECT_EQ(resource.allocations, allocations);
+    EXPECT_EQ(copy.getData(), image.getData());
+    EXPECT_EQ(assigned.getData(), image.getData());
+    EXPECT_TRUE(image.isShared());
+    EXPECT_TRUE(assigned.isCopyOnWrite());
+
+    copy.setColor(2, 1, {9, 9, 9, 255});
+    EXPECT_NE(copy.getData(), image.getData());
+    EXPECT_EQ(resource.allocations, allocations + 2);
+    const auto [red, green, blue, alpha] = image.getColor(2, 1);
+    EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(1, 2, 3, 255));
+    const auto [copyRed, copyGreen, copyBlue, copyAlpha] = copy.getColor(2, 1);
+    EXPECT_EQ(std::make_tuple(copyRed, copyGreen, copyBlue, copyAlpha), std::make_tuple(9, 9, 9, 255));
+    EXPECT_FALSE(copy.isShared());
+    EXPECT_TRUE(image.isShared());  // still with `assigned`
+
+    assigned.fill({0, 0, 0, 255});
+    EXPECT_FALSE(image.isShared());
+    EXPECT_EQ(image.getColor(0, 0).red, 1);
+  }
+  EXPECT_EQ(resource.deallocations, resource.allocations);
+}
+
+TEST(CopyOnWrite, EveryWriteDetaches) {
+  img::ImageRGBA image(5, 3);
+  image.fill({10, 20, 30, 40});
+  image.setCopyOnWrite(true);
+
+  img::ImageRGBA viewed(image);
+  viewed.view().setColor(0, 0, {0, 0, 0, 0});
+  EXPECT_NE(viewed.getData(), image.getData());
+
+  img::ImageRGBA reassigned(image);
+  reassigned = img::ImageBGRA(image);
+  EXPECT_NE(reassigned.getData(), image.getData());
+
+  img::ImageRGBA converted(image);
+  const img::ImageBGRA bgra = converted.convertInPlace<img::PixelBGRA<uint8_t>>();
+  EXPECT_NE(bgra.getData(), image.getData());
+  EXPECT_EQ(bgra.getColor(4, 2).blue, 30);
+
+  img::ImageRGBA disabled(image);
+  disabled.setCopyOnWrite(false);
+  EXPECT_NE(disabled.getData(), image.getData());
+  const img::ImageRGBA deepCopy(disabled);
+  EXPECT_NE(deepCopy.getData(), disabled.getData());
+
+  EXPECT_FALSE(image.isShared());
+  const auto [red, green, blue, alpha] = image.getColor(0, 0);
+  EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(10, 20, 30, 40));
+}
+
+TEST(CopyOnWrite, ConcurrentReaders) {
+  CountingResource resource;
+  {
+    img::ImageGray image(64, 64, img::RowAlignment::Packed, &resource);
+    image.fill({7, 7, 7, 255});
+    image.setCopyOnWrite(true);
+
+    std::vector<std::thread> readers;
+    std::atomic<int> mismatches{0};
+    for (int thread = 0; thread < 4; ++thread) {
+      readers.emplace_back([&image, &mismatches, thread] {
+        for (int i = 0; i < 200; ++i) {
+          img::ImageGray copy(image);
+          if (copy.getColor(i % 64, thread).red != 7) ++mismatches;
+          if (i % 50 == 0) copy.setColor(0, 0, {1, 1, 1, 255});
+        }
+      });
+    }
+    for (auto& reader : readers) reader.join();
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_FALSE(image.isShared());
+    EXPECT_EQ(image.getColor(0, 0).red, 7);
+  }
+  EXPECT_EQ(resource.deallocations, resource.allocations);
+}
+
+/** ----- Iterator Check ----- **/
+
+TEST(Iterators, RowSpans) {
+  img::ImageRGB image(5, 3, img::RowAlignment::Align64);
+  for (std::size_t row = 0; row < image.getHeight(); ++row) {
+    const auto pixels = image.row(row);
+    EXPECT_EQ(pixels.size(), 5u);
+    EXPECT_EQ(pixels.samples().size(), 15u);
+    for (std::size_t col = 0; col < pixels.size(); ++col) {
+      pixels[col] = img::Color<uint8_t>{uint8_t(col), uint8_t(row), 7, 255};
+    }
+  }
+  std::fill(image.row(1).samples().begin(), image.row(1).samples().end(), 9);
+
+  const img::ImageRGB& constImage = image;
+  for (std::size_t row = 0; row < image.getHeight(); ++row) {
+    for (std::size_t col = 0; col < image.getWidth(); ++col) {
+      const img::Color<uint8_t> color = constImage.row(row)[col];
+      const auto [red, green, blue, alpha] = image.getColor(col, row);
+      EXPECT_EQ(std::make_tuple(color.red, color.green, color.blue, color.alpha), std::make_tuple(red, green, blue, alpha));
+      EXPECT_EQ(red, row == 1 ? 9 : col);
+    }
+  }
+
+  // Planar rows give the samples of one plane, proxies index the planes.
+  img::Image<img::PlanarRGB<uint8_t>> planar(4, 2);
+  planar.fill({1, 2, 3, 255});
+  EXPECT_EQ(planar.row(1).samples(2).size(), 4u);
+  EXPECT_EQ(planar.row(1).samples(2)[3], 3);
+  planar.row(1)[3][1] = 8;
+  EXPECT_EQ(planar.getColor(3, 1).green, 8);
+
+  auto pixels = image.row(2);
+  std::reverse(pixels.begin(), pixels.end());
+  EXPECT_EQ(image.getColor(0, 2).red, 4);
+  EXPECT_EQ(image.getColor(4, 2).red, 0);
+}
+
+TEST(Iterators, WholeImageSkipsPadding) {
+  img::ImageRGBA padded(7, 5, img::RowAlignment::Align64);
+  for (std::size_t row = 0; row < padded.getHeight(); ++row) {
+    for (std::size_t col = 0; col < padded.getWidth(); ++col) {
+      padded.setColor(col, row, {uint8_t(col), uint8_t(row), uint8_t(col * row), 255});
+    }
+  }
+  const auto view = padded.view();
+  EXPECT_EQ(std::distance(view.begin(), view.end()), 35);
+
+  auto it = view.begin();
+  for (std::size_t i = 0; i < 35; ++i, ++it) {
+    EXPECT_EQ(view.begin()[i].get().red, i % 7);
+    EXPECT_EQ((*it).get().green, i / 7);
+  }
+  EXPECT_EQ(it, view.end());
+  --it;
+  EXPECT_EQ((*it).get().blue, 24);
+  EXPECT_EQ(view.end() - 8 + 1, view.begin() + 28);
+
+  // Copied into a packed image of another type, the pixels stay where they were.
+  img::ImageBGRA packed(7, 5);
+  std::transform(view.begin(), view.end(), packed.begin(), [](const img::Color<uint8_t>& color) { return color; });
+  checkSameImage<img::PixelRGBA<uint8_t>>(view, img::ImageRGBA(packed).view());
+
+  // Packed images can be walked as one long row, padded ones cannot.
+  const auto pixels = std::as_const(packed).pixels();
+  EXPECT_EQ(pixels.size(), 35u);
+  EXPECT_EQ(pixels[20].get().blue, 6 * 2);
+  EXPECT_EQ(pixels.samples().size(), 35u * 4);
+  EXPECT_THROW(padded.pixels(), std::logic_error);
+
+  const img::ImageBGRA empty;
+  EXPECT_EQ(empty.begin(), empty.end());
+}
+
+TEST(Iterators, ParallelAlgorithms) {
+  img::Image<img::PixelRGB<float>> image(97, 61, img::RowAlignment::Align32);
+  image.fill({0.25f, 0.5f, 1.0f, 1.0f});
+  std::for_each(std::execution::par_unseq, image.begin(), image.end(), [](const auto pixel) {
+    const img::Color<float> color = pixel;
+    pixel = img::Color<float>{1 - color.red, 1 - color.green, 1 - color.blue, color.alpha};
+  });
+  EXPECT_EQ(std::count_if(std::execution::par_unseq, image.begin(), image.end(), [](const img::Color<float>& color) {
+    return color.red == 0.75f && color.green == 0.5f && color.blue == 0.0f;
+  }), 97 * 61);
+
+  // Writes through an iterator detach a copy-on-write buffer first.
+  image.setCopyOnWrite(true);
+  img::Image<img::PixelRGB<float>> copy(image);
+  *copy.begin() = img::Color<float>{0, 0, 0, 1};
+  EXPECT_EQ(image.getColor(0, 0).red, 0.75f);
+  EXPECT_EQ(copy.getColor(0, 0).red, 0.0f);
+}
+
+/** ----- YUV Check ----- **/
+
+const img::YUVSpace yuvSpaces[] = {
+  {img::YUVMatrix::BT601, img::YUVRange::Limited}, {img::YUVMatrix::BT601, img::YUVRange::Full},
+  {img::YUVMatrix::BT709, img::YUVRange::Limited}, {img::YUVMatrix::BT709, img::YUVRange::Full}
+};
+
+// The textbook conversion in double precision, for one pixel.
+img::Color<double> referenceYUVToRgb(const img::YUVSpace space, const int y, const int u, const int v) {
+  const double kr = space.matrix == img::YUVMatrix::BT601 ? 0.299 : 0.2126;
+  const double kb = space.matrix == img::YUVMatrix::BT601 ? 0.114 : 0.0722;
+  const bool limited = space.range == img::YUVRange::Limited;
+  const double luma = limited ? (y - 16) * 255.0 / 219 : y;
+  const double cb = (u - 128) * (limited ? 255.0 / 224 : 1);
+  const double cr = (v - 128) * (limited ? 255.0 / 224 : 1);
+  const double red = luma + 2 * (1 - kr) * cr;
+  const double blue = luma + 2 * (1 - kb) * cb;
+  const double green = (luma - kr * red - kb * blue) / (1 - kr - kb);
+  return {std::clamp(red, 0.0, 255.0), std::clamp(green, 0.0, 255.0), std::clamp(blue, 0.0, 255.0), 255};
+}
+
+TEST(YUV, DecodeMatchesReference) {
+  constexpr std::size_t width = 37, height = 9;
+  std::vector<uint8_t> frame(img::I420Image::frameBytes(width, height));
+  fillPattern(frame.data(), frame.size());
+  for (const auto space : yuvSpaces) {
+    const img::ConstYUVView<img::I420> view(width, height, frame.data(), space);
+    const img::ImageRGB rgb = view;
+    for (std::size_t row = 0; row < height; ++row) {
+      for (std::size_t col = 0; col < width; ++col) {
+        const auto expected = referenceYUVToRgb(space, view.getLumaRow(row)[col], view.getURow(row / 2)[col / 2], view.getVRow(row / 2)[col / 2]);
+        const auto [red, green, blue, alpha] = rgb.getColor(col, row);
+        EXPECT_NEAR(red, expected.red, 1.0);
+        EXPECT_NEAR(green, expected.green, 1.0);
+        EXPECT_NEAR(blue, expected.blue, 1.0);
+      }
+    }
+  }
+
+  // Reference points: video black and white, and the limited range BT.601 red.
+  const uint8_t black[] = {16, 16, 16, 16, 128, 128};
+  const uint8_t red[] = {81, 81, 81, 81, 90, 240};
+  const auto [r0, g0, b0, a0] = img::ImageRGB(img::ConstYUVView<img::I420>(2, 2, black)).getColor(1, 1);
+  EXPECT_EQ(std::make_tuple(r0, g0, b0, a0), std::make_tuple(0, 0, 0, 255));
+  const auto [r1, g1, b1, a1] = img::ImageRGB(img::ConstYUVView<img::I420>(2, 2, red)).getColor(0, 1);
+  EXPECT_EQ(std::make_tuple(r1, g1, b1, a1), std::make_tuple(254, 0, 0, 255));
+}
+
+TEST(YUV, EncodeAndRoundTrip) {
+  // Blocks of 2x2 pixels of one color, so the chroma subsampling loses nothing.
+  constexpr std::size_t width = 46, height = 10;
+  img::ImageRGB rgb(width, height);
+  for (std::size_t row = 0; row < height; ++row) {
+    for (std::size_t col = 0; col < width; ++col) {
+      const std::size_t block = (row / 2) * width + col / 2;
+      rgb.setColor(col, row, {uint8_t(block * 37), uint8_t(block * 91 + 17), uint8_t(block * 13 + 200), 255});
+    }
+  }
+  for (const auto space : yuvSpaces) {
+    const img::NV12Image nv12(rgb, space);
+    const img::ImageRGB back = nv12;
+    for (std::size_t row = 0; row < height; ++row) {
+      for (std::size_t col = 0; col < width; ++col) {
+        const auto [red, green, blue, alpha] = rgb.getColor(col, row);
+        const auto [backRed, backGreen, backBlue, backAlpha] = back.getColor(col, row);
+        EXPECT_NEAR(backRed, red, 3);
+        EXPECT_NEAR(backGreen, green, 3);
+        EXPECT_NEAR(backBlue, blue, 3);
+      }
+    }
+  }
+
+  img::ImageRGB white(4, 2);
+  white.fill({255, 255, 255, 255});
+  const img::I420Image encoded(white, {img::YUVMatrix::BT709, img::YUVRange::Limited});
+  const img::ConstYUVView<img::I420> view = encoded;
+  EXPECT_EQ(view.getLumaRow(1)[3], 235);
+  EXPECT_EQ(view.getURow(0)[1], 128);
+  EXPECT_EQ(view.getVRow(0)[1], 128);
+}
+
+TEST(YUV, LayoutsPixelTypesAndSimdLevels) {
+  // Odd sizes and padded strides: NV12 and I420 of the same samples decode to the same pixels.
+  constexpr std::size_t width = 53, height = 7, chromaWidth = 27, chromaHeight = 4;
+  std::vector<uint8_t> luma(64 * height), u(32 * chromaHeight), v(32 * chromaHeight), uv(64 * chromaHeight);
+  fillPattern(luma.data(), luma.size());
+  fillPattern(u.data(), u.size());
+  std::reverse_copy(u.begin(), u.end(), v.begin());
+  for (std::size_t row = 0; row < chromaHeight; ++row) {
+    for (std::size_t col = 0; col < chromaWidth; ++col) {
+      uv[row * 64 + 2 * col] = u[row * 32 + col];
+      uv[row * 64 + 2 * col + 1] = v[row * 32 + col];
+    }
+  }
+  const img::YUVSpace space{img::YUVMatrix::BT709, img::YUVRange::Full};
+  const img::ConstYUVView<img::I420> i420(width, height, luma.data(), 64, u.data(), v.data(), 32, space);
+  const img::ConstYUVView<img::NV12> nv12(width, height, luma.data(), 64, uv.data(), 64, space);
+
+  const img::ImageRGBA expected = i420;
+  checkSameImage<img::PixelRGBA<uint8_t>>(expected.view(), img::ImageRGBA(nv12).view());
+  forEachSimdLevel([&] {
+    checkSameImage<img::PixelRGBA<uint8_t>>(expected.view(), img::ImageRGBA(nv12).view());
+    checkSameImage<img::PixelBGR<uint8_t>>(img::ImageBGR(expected).view(), img::ImageBGR(i420).view());
+    checkSameImage<img::PixelGray<uint8_t>>(img::ImageGray(expected).view(), img::ImageGray(i420).view());
+    checkSameImage<img::PlanarRGB<uint8_t>>(img::Image<img::PlanarRGB<uint8_t>>(expected).view(),
+                                            img::Image<img::PlanarRGB<uint8_t>>(nv12).view());
+    checkSameImage<img::PixelRGB<float>>(img::Image<img::PixelRGB<float>>(expected).view(),
+                                         img::Image<img::PixelRGB<float>>(i420).view());
+
+    // Every source layout encodes to the samples of the 8 bit RGB one.
+    const img::I420Image reference(img::ImageRGB(expected), space);
+    for (const auto& encoded : {img::I420Image(expected, space), img::I420Image(img::ImageBGRA(expected), space),
+                                img::I420Image(img::Image<img::PlanarRGBA<uint8_t>>(expected), space)}) {
+      EXPECT_TRUE(std::equal(reference.getData(), reference.getData() + img::I420Image::frameBytes(width, height), encoded.getData()));
+    }
+    const img::NV12Image interleaved(expected, space);
+    const img::ConstYUVView<img::NV12> frame = interleaved;
+    for (std::size_t row = 0; row < chromaHeight; ++row) {
+      for (std::size_t col = 0; col < chromaWidth; ++col) {
+        EXPECT_EQ(frame.getURow(row)[2 * col], reference.view().getURow(row)[col]);
+        EXPECT_EQ(frame.getVRow(row)[2 * col], reference.view().getVRow(row)[col]);
+      }
+    }
+  });
+
+  EXPECT_THROW(img::convert(i420, img::ImageRGB(4, 4).view()), std::invalid_argument);
+
+  // Mutable views only wrap mutable planes, strided ones included.
+  static_assert(!std::is_constructible_v<img::YUVView<img::I420>, std::size_t, std::size_t, const std::uint8_t*>);
+  static_assert(!std::is_constructible_v<img::YUVView<img::NV12>, std::size_t, std::size_t, const std::uint8_t*, std::size_t,
+                                         const std::uint8_t*, std::size_t>);
+  std::vector<std::uint8_t> lumaOut(64 * height), uvOut(64 * chromaHeight);
+  img::convert(expected.view(), img::YUVView<img::NV12>(width, height, lumaOut.data(), 64, uvOut.data(), 64, space));
+  const img::NV12Image encoded(expected, space);
+  for (std::size_t row = 0; row < height; ++row) {
+    EXPECT_TRUE(std::equal(encoded.view().getLumaRow(row), encoded.view().getLumaRow(row) + width, lumaOut.data() + row * 64));
+  }
+  EXPECT_EQ(uvOut[64 + 1], encoded.view().getVRow(1)[0]);
+}
+
+/** ----- Resize Check ----- **/
+
+const img::ResizeFilter resizeFilters[] = {
+  img::ResizeFilter::Nearest, img::ResizeFilter::Box, img::ResizeFilter::Bilinear,
+  img::ResizeFilter::Bicubic, img::ResizeFilter::Lanczos3
+};
+
+TEST(Resize, IdentityUniformColorAndNearest) {
+  const auto image = makePatternImage<img::PixelRGBA<uint8_t>>(23, 11, img::RowAlignment::Align64);
+  for (const auto filter : resizeFilters) {
+    checkSameImage<img::PixelRGBA<uint8_t>>(image.view(), img::resize(image, 23, 11, filter).view());
+
+    // The weights of every filter sum to one: a uniform color stays exact, up and down.
+    img::ImageRGB uniform(37, 19);
+    uniform.fill({201, 7, 96, 255});
+    img::Image<img::PixelRGB<float>> uniformFloat(37, 19);
+    uniformFloat.fill({0.25f, 0.5f, 0.75f, 1.0f});
+    for (const auto& [width, height] : {std::pair<std::size_t, std::size_t>{5, 3}, {80, 41}, {37, 4}, {9, 19}}) {
+      const auto resized = img::resize(uniform, width, height, filter);
+      const auto resizedFloat = img::resize(uniformFloat, width, height, filter);
+      for (std::size_t row = 0; row < height; ++row) {
+        for (std::size_t col = 0; col < width; ++col) {
+          const auto [red, green, blue, alpha] = resized.getColor(col, row);
+          EXPECT_EQ(std::make_tuple(red, green, blue), std::make_tuple(201, 7, 96));
+          const auto [redFloat, greenFloat, blueFloat, alphaFloat] = resizedFloat.getColor(col, row);
+          EXPECT_NEAR(redFloat, 0.25f, 1e-5f);
+          EXPECT_NEAR(greenFloat, 0.5f, 1e-5f);
+          EXPECT_NEAR(blueFloat, 0.75f, 1e-5f);
+        }
+      }
+    }
+  }
+
+  // Nearest picks the pixel under the center of every output pixel.
+  const auto half = img::resize(image, 11, 5, img::ResizeFilter::Nearest);
+  for (std::size_t row = 0; row < 5; ++row) {
+    for (std::size_t col = 0; col < 11; ++col) {
+      const auto [red, green, blue, alpha] = half.getColor(col, row);
+      const auto [srcRed, srcGreen, srcBlue, srcAlpha] = image.getColor((2 * col + 1) * 23 / 22, (2 * row + 1) * 11 / 10);
+      EXPECT_EQ(std::make_tuple(red, green, blue, alpha), std::make_tuple(srcRed, srcGreen, srcBlue, srcAlpha));
+    }
+  }
+
+  EXPECT_EQ(img::resize(img::ImageRGB(), 0, 0).getWidth(), 0u);
+  EXPECT_THROW(img::resize(img::ImageRGB(), 4, 4), std::invalid_argument);
+}
+
+TEST(Resize, SimdLevelsAndPixelTypes) {
+  // Every SIMD level computes the samples of the scalar kernels, for every filter and tap count.
+  const auto rgb = makePatternImage<img::PixelRGB<uint8_t>>(67, 29, img::RowAlignment::Align64);
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(67, 29);
+  const auto gray = makePatternImage<img::PixelGray<uint8_t>>(67, 29);
+  const img::Image<img::PlanarRGB<uint8_t>> planar(rgb);
+  const std::pair<std::size_t, std::size_t> sizes[] = {{13, 7}, {150, 61}, {67, 10}, {31, 29}};
+  for (const auto filter : resizeFilters) {
+    for (const auto& size : sizes) {
+      const std::size_t width = size.first, height = size.second;
+      img::simd::setLevel(img::simd::Level::Scalar);
+      const auto expectedRGB = img::resize(rgb, width, height, filter);
+      const auto expectedRGBA = img::resize(rgba, width, height, filter);
+      const auto expectedGray = img::resize(gray, width, height, filter);
+      forEachSimdLevel([&] {
+        checkSameImage<img::PixelRGB<uint8_t>>(expectedRGB.view(), img::resize(rgb, width, height, filter).view());
+        checkSameImage<img::PixelRGBA<uint8_t>>(expectedRGBA.view(), img::resize(rgba, width, height, filter).view());
+        checkSameImage<img::PixelGray<uint8_t>>(expectedGray.view(), img::resize(gray, width, height, filter).view());
+        // Planar pixels are resampled plane by plane, like interleaved ones.
+        checkSameImage<img::PixelRGB<uint8_t>>(expectedRGB.view(), img::ImageRGB(img::resize(planar, width, height, filter)).view());
+      });
+
+      // Without negative lobes, so without clamping, the fixed point weights stay within one step of
+      // the same filter in floating point.
+      if (filter != img::ResizeFilter::Box && filter != img::ResizeFilter::Bilinear) continue;
+      img::Image<img::PixelRGB<float>> samples(67, 29);
+      for (std::size_t row = 0; row < 29; ++row) {
+        std::copy(rgb.view().getRow(row), rgb.view().getRow(row) + 67 * 3, samples.view().getRow(row));
+      }
+      const auto resizedFloat = img::resize(samples, width, height, filter);
+      for (std::size_t row = 0; row < height; ++row) {
+        for (std::size_t i = 0; i < width * 3; ++i) {
+          EXPECT_NEAR(expectedRGB.view().getRow(row)[i], resizedFloat.view().getRow(row)[i], 1.0f);
+        }
+      }
+    }
+  }
+}
+
+TEST(Resize, BoxFastPathIsTheBlockMean) {
+  const auto image = makePatternImage<img::PixelRGBA<uint8_t>>(64, 36, img::RowAlignment::Align64);
+  const auto thumbnail = img::resize(image, 16, 9, img::ResizeFilter::Box);
+  const auto samples = image.view();
+  for (std::size_t row = 0; row < 9; ++row) {
+    for (std::size_t i = 0; i < 16 * 4; ++i) {
+      unsigned sum = 0;
+      for (std::size_t y = 0; y < 4; ++y) {
+        for (std::size_t x = 0; x < 4; ++x) sum += samples.getRow(row * 4 + y)[((i / 4) * 4 + x) * 4 + i % 4];
+      }
+      EXPECT_EQ(thumbnail.view().getRow(row)[i], (sum + 8) / 16);
+    }
+  }
+
+  // Other factors resample with the box filter, at most one step away from the exact area mean.
+  const auto wide = img::resize(image, 16, 12, img::ResizeFilter::Box);
+  const auto exact = img::resize(img::resize(image, 16, 36, img::ResizeFilter::Box), 16, 12, img::ResizeFilter::Box);
+  for (std::size_t row = 0; row < 12; ++row) {
+    for (std::size_t i = 0; i < 16 * 4; ++i) {
+      EXPECT_NEAR(wide.view().getRow(row)[i], exact.view().getRow(row)[i], 1);
+    }
+  }
+  const auto planar = img::resize(img::Image<img::PlanarRGBA<uint8_t>>(image), 16, 9, img::ResizeFilter::Box);
+  checkSameImage<img::PixelRGBA<uint8_t>>(thumbnail.view(), img::ImageRGBA(planar).view());
+}
+
+TEST(Resize, LargeDownscaleFactors) {
+  // Filters wider than the fixed point weights can represent (here, weights below 2^-15 which would
+  // round to 0) fall back to float weights: the result stays within one step of the same filter
+  // on float samples.
+  const auto gray = makePatternImage<img::PixelGray<uint8_t>>(200000, 3);
+  img::Image<img::PixelGray<float>> samples(200000, 3);
+  for (std::size_t row = 0; row < 3; ++row) {
+    std::copy(gray.view().getRow(row), gray.view().getRow(row) + 200000, samples.view().getRow(row));
+  }
+  for (const auto filter : {img::ResizeFilter::Bilinear, img::ResizeFilter::Lanczos3}) {
+    const auto resized = img::resize(gray, 3, 2, filter);
+    const auto resizedFloat = img::resize(samples, 3, 2, filter);
+    for (std::size_t row = 0; row < 2; ++row) {
+      for (std::size_t col = 0; col < 3; ++col) {
+        EXPECT_NEAR(resized.view().getRow(row)[col], resizedFloat.view().getRow(row)[col], 1.0f);
+      }
+    }
+  }
+}
+
+/** ----- Orientation Check ----- **/
+
+const img::Orientation orientations[] = {
+  img::Orientation::Identity, img::Orientation::FlipHorizontal, img::Orientation::Rotate180, img::Orientation::FlipVertical,
+  img::Orientation::Transpose, img::Orientation::Rotate90, img::Orientation::Transverse, img::Orientation::Rotate270
+};
+
+// The source pixel shown at (col, row) of an image of `width` x `height` once oriented.
+std::pair<std::size_t, std::size_t> orientedSource(const img::Orientation orientation, const std::size_t col, const std::size_t row,
+                                                   const std::size_t width, const std::size_t height) {
+  switch (orientation) {
+    case img::Orientation::FlipHorizontal: return {width - 1 - col, row};
+    case img::Orientation::Rotate180: return {width - 1 - col, height - 1 - row};
+    case img::Orientation::FlipVertical: return {col, height - 1 - row};
+    case img::Orientation::Transpose: return {row, col};
+    case img::Orientation::Rotate90: return {row, height - 1 - col};
+    case img::Orientation::Transverse: return {width - 1 - row, height - 1 - col};
+    case img::Orientation::Rotate270: return {width - 1 - row, col};
+    default: return {col, row};
+  }
+}
+
+template<typename Pixel>
+void checkOriented(const img::ConstImageView<Pixel>& src, const img::ConstImageView<Pixel>& oriented, const img::Orientation orientation) {
+  const bool swap = img::swapsAxes(orientation);
+  ASSERT_EQ(oriented.getWidth(), swap ? src.getHeight() : src.getWidth());
+  ASSERT_EQ(oriented.getHeight(), swap ? src.getWidth() : src.getHeight());
+  for (std::size_t row = 0; row < oriented.getHeight(); ++row) {
+    for (std::size_t col = 0; col < oriented.getWidth(); ++col) {
+      const auto [srcCol, srcRow] = orientedSource(orientation, col, row, src.getWidth(), src.getHeight());
+      const auto expected = src.getColor(srcCol, srcRow);
+      const auto actual = oriented.getColor(col, row);
+      ASSERT_EQ(std::make_tuple(actual.red, actual.green, actual.blue, actual.alpha),
+                std::make_tuple(expected.red, expected.green, expected.blue, expected.alpha)) << col << ", " << row;
+    }
+  }
+}
+
+template<typename Pixel>
+void checkOrientations(const std::size_t width, const std::size_t height) {
+  const auto image = makePatternImage<Pixel>(width, height, img::RowAlignment::Align64);
+  for (const auto orientation : orientations) {
+    checkOriented<Pixel>(image.view(), img::orient(image, orientation).view(), orientation);
+  }
+}
+
+TEST(Orientation, MatchesPerPixelReference) {
+  // Sizes around the tiles of 64 and 128 elements and the register blocks of 4 and 16.
+  forEachSimdLevel([] {
+    for (const auto& [width, height] : {std::pair<std::size_t, std::size_t>{37, 21}, {130, 67}, {1, 5}, {16, 16}}) {
+      checkOrientations<img::PixelGray<uint8_t>>(width, height);
+      checkOrientations<img::PixelRGB<uint8_t>>(width, height);
+      checkOrientations<img::PixelBGRA<uint8_t>>(width, height);
+      checkOrientations<img::PixelGray<uint16_t>>(width, height);
+      checkOrientations<img::PixelRGB<float>>(width, height);
+      checkOrientations<img::PixelRGBA<float>>(width, height);
+      checkOrientations<img::PlanarRGB<uint8_t>>(width, height);
+    }
+  });
+
+  const auto image = makePatternImage<img::PixelRGB<uint8_t>>(5, 3);
+  img::ImageRGB wrong(5, 3);
+  EXPECT_THROW(img::orient(image.view(), wrong.view(), img::Orientation::Rotate90), std::invalid_argument);
+  EXPECT_EQ(img::orient(img::ImageRGB(0, 7), img::Orientation::Transpose).getWidth(), 7u);
+}
+
+template<typename Pixel>
+void checkOrientInPlace(const std::size_t width, const std::size_t height) {
+  const auto image = makePatternImage<Pixel>(width, height, img::RowAlignment::Align64);
+  for (const auto orientation : orientations) {
+    if (img::swapsAxes(orientation) && width != height) continue;
+    img::Image<Pixel> copy = image;
+    img::orientInPlace(copy.view(), orientation);
+    checkOriented<Pixel>(image.view(), std::as_const(copy).view(), orientation);
+  }
+}
+
+TEST(Orientation, InPlace) {
+  forEachSimdLevel([] {
+    // Odd and even heights (the middle row of the vertical flips), squares across the tiles.
+    for (const auto& [width, height] : {std::pair<std::size_t, std::size_t>{37, 21}, {70, 70}, {129, 129}, {5, 5}, {8, 2}}) {
+      checkOrientInPlace<img::PixelGray<uint8_t>>(width, height);
+      checkOrientInPlace<img::PixelRGB<uint8_t>>(width, height);
+      checkOrientInPlace<img::PixelRGBA<uint8_t>>(width, height);
+      checkOrientInPlace<img::PixelRGBA<float>>(width, height);
+      checkOrientInPlace<img::PlanarRGBA<uint8_t>>(width, height);
+    }
+  });
+
+  img::ImageRGB wide(6, 4);
+  EXPECT_THROW(img::orientInPlace(wide.view(), img::Orientation::Rotate270), std::invalid_argument);
+  EXPECT_NO_THROW(img::orientInPlace(wide.view(), img::Orientation::Rotate180));
+}
+
+TEST(Orientation, Compositions) {
+  const auto image = makePatternImage<img::PixelRGBA<uint8_t>>(77, 45);
+  const auto quarter = img::orient(image, img::Orientation::Rotate90);
+  checkSameImage<img::PixelRGBA<uint8_t>>(image.view(), img::orient(quarter, img::Orientation::Rotate270).view());
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::orient(image, img::Orientation::Rotate180).view(),
+                                          img::orient(quarter, img::Orientation::Rotate90).view());
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::orient(image, img::Orientation::Transverse).view(),
+                                          img::orient(img::orient(image, img::Orientation::Rotate180), img::Orientation::Transpose).view());
+  for (const auto orientation : {img::Orientation::FlipHorizontal, img::Orientation::FlipVertical, img::Orientation::Transpose,
+                                 img::Orientation::Transverse}) {
+    checkSameImage<img::PixelRGBA<uint8_t>>(image.view(), img::orient(img::orient(image, orientation), orientation).view());
+  }
+}
+
+/** ----- Compositing Check ----- **/
+
+const img::BlendMode blendModes[] = {img::BlendMode::Over, img::BlendMode::Add, img::BlendMode::Multiply};
+
+// The blend of one pixel in double precision, samples in [0, 1].
+img::Color<double> referenceBlend(const img::BlendMode mode, const bool premultiplied, img::Color<double> s, img::Color<double> d) {
+  const auto blend = [mode](const double source, const double dest, const double as, const double ad) {
+    switch (mode) {
+      case img::BlendMode::Over: return std::min(source + dest * (1 - as), 1.0);
+      case img::BlendMode::Add: return std::min(source + dest, 1.0);
+      default: return std::min(source * dest + source * (1 - ad) + dest * (1 - as), 1.0);
+    }
+  };
+  const double ao = blend(s.alpha, d.alpha, s.alpha, d.alpha);
+  const auto channel = [&](const double source, const double dest) {
+    const double o = blend(premultiplied ? source : source * s.alpha, premultiplied ? dest : dest * d.alpha, s.alpha, d.alpha);
+    return premultiplied ? o : ao > 0 ? std::min(o / ao, 1.0) : 0.0;
+  };
+  return {channel(s.red, d.red), channel(s.green, d.green), channel(s.blue, d.blue), ao};
+}
+
+TEST(Compositing, MatchesReference) {
+  // Every pair of alphas with a few colors, straight and premultiplied (colors at most the alpha).
+  img::ImageRGBA layer(256, 16), base(256, 16);
+  for (std::size_t row = 0; row < 16; ++row) {
+    for (std::size_t col = 0; col < 256; ++col) {
+      const auto as = static_cast<uint8_t>(col), ad = static_cast<uint8_t>(row * 17);
+      layer.setColor(col, row, {uint8_t(col * 7 % 256), uint8_t(row * 31 % 256), uint8_t(255 - col), as});
+      base.setColor(col, row, {uint8_t(row * 13 % 256), uint8_t(col * 3 % 256), uint8_t(col / 2), ad});
+    }
+  }
+  for (const auto alpha : {img::AlphaMode::Straight, img::AlphaMode::Premultiplied}) {
+    const bool premultiplied = alpha == img::AlphaMode::Premultiplied;
+    img::ImageRGBA src = layer, dst = base;
+    if (premultiplied) {
+      img::premultiply(src.view());
+      img::premultiply(dst.view());
+    }
+    for (const auto mode : blendModes) {
+      img::ImageRGBA result = dst;
+      img::composite(src, result, 0, 0, mode, alpha);
+      for (std::size_t row = 0; row < 16; ++row) {
+        for (std::size_t col = 0; col < 256; ++col) {
+          const auto s = src.getColor(col, row), d = dst.getColor(col, row), o = result.getColor(col, row);
+          const auto scale = [](const img::Color<uint8_t>& c) {
+            return img::Color<double>{c.red / 255.0, c.green / 255.0, c.blue / 255.0, c.alpha / 255.0};
+          };
+          const auto expected = referenceBlend(mode, premultiplied, scale(s), scale(d));
+          EXPECT_NEAR(o.alpha, expected.alpha * 255, 0.5 + 1e-9);
+          // Premultiplied results round each product once; straight ones also the premultiplied inputs,
+          // amplified by the division when the result is nearly transparent.
+          const double tolerance = premultiplied ? 1.0 : 0.5 + 2 * 255.0 / std::max<int>(o.alpha, 1);
+          EXPECT_NEAR(o.red, expected.red * 255, tolerance);
+          EXPECT_NEAR(o.green, expected.green * 255, tolerance);
+          EXPECT_NEAR(o.blue, expected.blue * 255, tolerance);
+        }
+      }
+    }
+  }
+
+  // Exact cases: an opaque layer replaces, a transparent one changes nothing, add saturates.
+  img::ImageRGBA opaque(3, 1), transparent(3, 1), target(3, 1);
+  opaque.fill({10, 20, 30, 255});
+  transparent.fill({200, 100, 50, 0});
+  target.fill({90, 250, 7, 255});
+  img::ImageRGBA over = target, clear = target, added = target;
+  img::composite(opaque, over);
+  img::composite(transparent, clear);
+  img::composite(target, added, 0, 0, img::BlendMode::Add);
+  const auto [r0, g0, b0, a0] = over.getColor(2, 0);
+  EXPECT_EQ(std::make_tuple(r0, g0, b0, a0), std::make_tuple(10, 20, 30, 255));
+  checkSameImage<img::PixelRGBA<uint8_t>>(target.view(), clear.view());
+  const auto [r1, g1, b1, a1] = added.getColor(0, 0);
+  EXPECT_EQ(std::make_tuple(r1, g1, b1, a1), std::make_tuple(180, 255, 14, 255));
+
+  // Destinations converted to RGBA and back keep every sample under a transparent layer.
+  img::ImageGray levels(256, 1);
+  for (std::size_t i = 0; i < 256; ++i) levels.view().getRow(0)[i] = static_cast<uint8_t>(i);
+  img::ImageRGBA clearLayer(256, 25);
+  clearLayer.fill({200, 100, 50, 0});
+  img::ImageGray grayCleared = levels;
+  img::composite(clearLayer, grayCleared);
+  checkSameImage<img::PixelGray<uint8_t>>(levels.view(), grayCleared.view());
+  const auto deep = makePatternImage<img::PixelGray<uint16_t>>(40, 25);
+  img::Image<img::PixelGray<uint16_t>> deepCleared = deep;
+  img::composite(clearLayer, deepCleared);
+  checkSameImage<img::PixelGray<uint16_t>>(deep.view(), deepCleared.view());
+}
+
+TEST(Compositing, SimdLevelsAgree) {
+  for (std::size_t count = 0; count <= 70; ++count) {
+    std::vector<uint8_t> src(count * 4), dst(count * 4);
+    fillPattern(src.data(), src.size());
+    std::reverse_copy(src.begin(), src.end(), dst.begin());
+    for (const auto op : {img::simd::Blend::Over, img::simd::Blend::Add, img::simd::Blend::Multiply}) {
+      for (const bool premultiplied : {false, true}) {
+        std::vector<uint8_t> expected = dst;
+        img::simd::blendRowScalar(src.data(), expected.data(), count, op, premultiplied);
+        forEachSimdLevel([&] {
+          std::vector<uint8_t> actual = dst;
+          img::simd::blendRow(src.data(), actual.data(), count, op, premultiplied);
+          EXPECT_EQ(expected, actual);
+        });
+      }
+    }
+  }
+}
+
+TEST(Compositing, PixelTypesAndRegions) {
+  const auto layer = makePatternImage<img::PixelRGBA<uint8_t>>(9, 7);
+  const auto base = makePatternImage<img::PixelBGRA<uint8_t>>(20, 10, img::RowAlignment::Align64);
+
+  // The reference: the layer and the overlapped region as RGBA images, composited at the origin.
+  const auto check = [&](const std::ptrdiff_t x, const std::ptrdiff_t y) {
+    img::Image<img::PixelBGRA<uint8_t>> result = base;
+    img::composite(layer.view(), result.view(), x, y, img::BlendMode::Multiply);
+    for (std::size_t row = 0; row < 10; ++row) {
+      for (std::size_t col = 0; col < 20; ++col) {
+        const auto srcCol = static_cast<std::ptrdiff_t>(col) - x, srcRow = static_cast<std::ptrdiff_t>(row) - y;
+        img::ImageRGBA expected(1, 1), pixel(1, 1);
+        expected.setColor(0, 0, base.getColor(col, row));
+        if (srcCol >= 0 && srcCol < 9 && srcRow >= 0 && srcRow < 7) {
+          pixel.setColor(0, 0, layer.getColor(static_cast<std::size_t>(srcCol), static_cast<std::size_t>(srcRow)));
+          img::composite(pixel, expected, 0, 0, img::BlendMode::Multiply);
+        }
+        const auto e = expected.getColor(0, 0), o = result.getColor(col, row);
+        ASSERT_EQ(std::make_tuple(o.red, o.green, o.blue, o.alpha), std::make_tuple(e.red, e.green, e.blue, e.alpha))
+          << x << ", " << y << ": " << col << ", " << row;
+      }
+    }
+  };
+  for (const auto& [x, y] : {std::pair<std::ptrdiff_t, std::ptrdiff_t>{0, 0}, {5, 2}, {-4, -3}, {15, 6}, {-9, 0}, {20, 10}}) {
+    check(x, y);
+  }
+
+  // Other pixel types go through the 8 bit RGBA or the floating point blend and back.
+  img::ImageRGB opaque(20, 10);
+  opaque.fill({50, 60, 70, 255});
+  img::composite(layer, opaque, 3, 1);
+  img::ImageRGBA expanded(20, 10);
+  expanded.fill({50, 60, 70, 255});
+  img::composite(layer, expanded, 3, 1);
+  checkSameImage<img::PixelRGB<uint8_t>>(img::ImageRGB(expanded).view(), opaque.view());
+
+  img::Image<img::PlanarRGBA<uint8_t>> planar(base);
+  img::composite(layer, planar, 2, 2, img::BlendMode::Add);
+  img::Image<img::PixelBGRA<uint8_t>> interleaved = base;
+  img::composite(layer, interleaved, 2, 2, img::BlendMode::Add);
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::ImageRGBA(interleaved).view(), img::ImageRGBA(planar).view());
+
+  img::Image<img::PixelRGBA<float>> floats(base);
+  img::composite(layer, floats, 2, 2, img::BlendMode::Over, img::AlphaMode::Premultiplied);
+  img::ImageRGBA premultiplied(base);
+  img::composite(layer, premultiplied, 2, 2, img::BlendMode::Over, img::AlphaMode::Premultiplied);
+  for (std::size_t row = 0; row < 10; ++row) {
+    for (std::size_t col = 0; col < 20; ++col) {
+      const auto f = floats.getColor(col, row);
+      const auto u = premultiplied.getColor(col, row);
+      EXPECT_NEAR(f.red * 255, u.red, 1.0);
+      EXPECT_NEAR(f.alpha * 255, u.alpha, 1.0);
+    }
+  }
+}
+
+/** ----- Filter Check ----- **/
+
+const img::Border borders[] = {img::Border::Clamp, img::Border::Mirror, img::Border::Wrap, img::Border::Zero};
+
+// The index read for `i` on an axis of `size` samples, -1 for zero samples, by walking the reflections.
+std::ptrdiff_t referenceBorder(std::ptrdiff_t i, const std::ptrdiff_t size, const img::Border border) {
+  if (border == img::Border::Zero) return i < 0 || i >= size ? -1 : i;
+  if (border == img::Border::Clamp) return std::clamp<std::ptrdiff_t>(i, 0, size - 1);
+  if (border == img::Border::Wrap) return ((i % size) + size) % size;
+  while (size > 1 && (i < 0 || i >= size)) i = i < 0 ? -i : 2 * (size - 1) - i;
+  return size > 1 ? i : 0;
+}
+
+// Convolution of the samples of interleaved pixels in double precision, rounded like the filters.
+template<typename Pixel>
+img::Image<img::PixelRGBA<double>> referenceConvolve(const img::Image<Pixel>& src, const img::Kernel& kernel, const img::Border border) {
+  const auto w = static_cast<std::ptrdiff_t>(src.getWidth()), h = static_cast<std::ptrdiff_t>(src.getHeight());
+  const auto cx = static_cast<std::ptrdiff_t>(kernel.getWidth() / 2), cy = static_cast<std::ptrdiff_t>(kernel.getHeight() / 2);
+  img::Image<img::PixelRGBA<double>> result(src.getWidth(), src.getHeight());
+  for (std::ptrdiff_t row = 0; row < h; ++row) {
+    for (std::ptrdiff_t col = 0; col < w; ++col) {
+      double sums[4] = {};
+      for (std::size_t y = 0; y < kernel.getHeight(); ++y) {
+        for (std::size_t x = 0; x < kernel.getWidth(); ++x) {
+          const std::ptrdiff_t r = referenceBorder(row + static_cast<std::ptrdiff_t>(y) - cy, h, border);
+          const std::ptrdiff_t c = referenceBorder(col + static_cast<std::ptrdiff_t>(x) - cx, w, border);
+          if (r < 0 || c < 0) continue;
+          for (int channel = 0; channel < Pixel::PlaneCount; ++channel) {
+            sums[channel] += kernel.getWeight(x, y) * static_cast<double>(src.view().getRow(static_cast<std::size_t>(r))[c * Pixel::PlaneCount + channel]);
+          }
+        }
+      }
+      result.setColor(static_cast<std::size_t>(col), static_cast<std::size_t>(row), {sums[0], sums[1], sums[2], sums[3]});
+    }
+  }
+  return result;
+}
+
+// Compare the samples of an interleaved image with the reference, `tolerance` apart.
+template<typename Pixel>
+void checkFiltered(const img::Image<img::PixelRGBA<double>>& expected, const img::Image<Pixel>& actual, const double tolerance) {
+  using T = typename Pixel::DataType;
+  for (std::size_t row = 0; row < actual.getHeight(); ++row) {
+    for (std::size_t col = 0; col < actual.getWidth(); ++col) {
+      const auto e = expected.getColor(col, row);
+      const double values[4] = {e.red, e.green, e.blue, e.alpha};
+      for (int channel = 0; channel < Pixel::PlaneCount; ++channel) {
+        double value = values[channel];
+        if constexpr (std::is_integral_v<T>) value = std::clamp(std::floor(value + 0.5), 0.0, static_cast<double>(Pixel::Max));
+        ASSERT_NEAR(actual.view().getRow(row)[col * Pixel::PlaneCount + channel], value, tolerance)
+          << "at (" << col << ", " << row << ") channel " << channel;
+      }
+    }
+  }
+}
+
+TEST(Filter, ConvolveMatchesReference) {
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(37, 23, img::RowAlignment::Align64);
+  const auto tiny = makePatternImage<img::PixelRGB<uint8_t>>(4, 3);
+  const auto floats = img::Image<img::PixelRGB<float>>(makePatternImage<img::PixelRGB<uint8_t>>(29, 17));
+  const img::Kernel kernels[] = {
+    img::Kernel(3, 3, {0, -1, 0, -1, 5, -1, 0, -1, 0}),
+    img::Kernel(4, 3, {0.1f, 0.0f, 0.2f, 0.05f, 0.0f, 0.3f, 0.1f, 0.0f, 0.05f, 0.1f, 0.0f, 0.1f}),
+    img::Kernel::gaussian(1.2),
+    img::Kernel::separable({-0.5f, 2.0f, -0.5f}, {0.25f, 0.5f, 0.25f}),
+    img::Kernel::separable({0.2f, 0.3f, 0.2f}, {0.4f, 0.7f, 0.3f}),
+    img::Kernel::box(2)
+  };
+  for (const auto border : borders) {
+    for (const auto& kernel : kernels) {
+      // Two 8 bit passes with fixed point weights stay within one step of the exact result.
+      checkFiltered(referenceConvolve(rgba, kernel, border), img::convolve(rgba, kernel, border), 1.0);
+      checkFiltered(referenceConvolve(tiny, kernel, border), img::convolve(tiny, kernel, border), 1.0);
+      checkFiltered(referenceConvolve(floats, kernel, border), img::convolve(floats, kernel, border), 1e-3);
+    }
+    // A vertical factor above 1 must not clamp before the horizontal one scales it back.
+    img::ImageGray flat(5, 4);
+    for (std::size_t row = 0; row < 4; ++row) std::fill_n(flat.view().getRow(row), 5, std::uint8_t{200});
+    const auto amplify = img::Kernel::separable({0.5f}, {1.4f});
+    checkFiltered(referenceConvolve(flat, amplify, border), img::convolve(flat, amplify, border), 0.0);
+
+    // Every SIMD level gives the samples of the scalar kernels; planes are filtered like interleaved samples.
+    img::simd::setLevel(img::simd::Level::Scalar);
+    const auto expected = img::convolve(rgba, img::Kernel::gaussian(2.0), border);
+    forEachSimdLevel([&] {
+      checkSameImage<img::PixelRGBA<uint8_t>>(expected.view(), img::convolve(rgba, img::Kernel::gaussian(2.0), border).view());
+    });
+    const auto planar = img::convolve(img::Image<img::PlanarRGBA<uint8_t>>(rgba), img::Kernel::gaussian(2.0), border);
+    checkSameImage<img::PixelRGBA<uint8_t>>(expected.view(), img::ImageRGBA(planar).view());
+  }
+}
+
+TEST(Filter, BoxBlurIsExact) {
+  const auto rgb = makePatternImage<img::PixelRGB<uint8_t>>(25, 17, img::RowAlignment::Align64);
+  const auto gray = makePatternImage<img::PixelGray<uint8_t>>(25, 17);
+  const auto floats = img::Image<img::PixelRGBA<float>>(makePatternImage<img::PixelRGBA<uint8_t>>(19, 13));
+  for (const auto border : borders) {
+    for (const std::size_t radius : {0, 1, 4, 19}) {
+      const auto kernel = img::Kernel::box(radius);
+      // Integer sums, the mean rounded to nearest: exactly the reference.
+      checkFiltered(referenceConvolve(rgb, kernel, border), img::boxBlur(rgb, radius, border), 1e-6);
+      checkFiltered(referenceConvolve(gray, kernel, border), img::boxBlur(gray, radius, border), 1e-6);
+      checkFiltered(referenceConvolve(floats, kernel, border), img::boxBlur(floats, radius, border), 1e-4);
+      img::simd::setLevel(img::simd::Level::Scalar);
+      const auto expected = img::boxBlur(rgb, radius, border);
+      forEachSimdLevel([&] { checkSameImage<img::PixelRGB<uint8_t>>(expected.view(), img::boxBlur(rgb, radius, border).view()); });
+      const auto planar = img::boxBlur(img::Image<img::PlanarRGB<uint8_t>>(rgb), radius, border);
+      checkSameImage<img::PixelRGB<uint8_t>>(img::boxBlur(rgb, radius, border).view(), img::ImageRGB(planar).view());
+    }
+  }
+}
+
+TEST(Filter, GaussianBlurAndErrors) {
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(48, 32, img::RowAlignment::Align64);
+  // Small deviations are the sampled kernel, large ones 3 box blurs close to it.
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::convolve(rgba, img::Kernel::gaussian(1.5)).view(),
+                                          img::gaussianBlur(rgba, 1.5).view());
+  for (const double sigma : {4.0, 5.5, 9.0}) {
+    const auto approximate = img::gaussianBlur(rgba, sigma, img::Border::Mirror);
+    const auto exact = referenceConvolve(rgba, img::Kernel::gaussian(sigma), img::Border::Mirror);
+    checkFiltered(exact, approximate, 3.0);
+  }
+  const auto floats = img::gaussianBlur(img::Image<img::PixelGray<float>>(img::ImageGray(rgba)), 4.0);
+  EXPECT_EQ(floats.getWidth(), 48u);
+
+  EXPECT_THROW(img::Kernel(3, 3, {1.0f, 2.0f}), std::invalid_argument);
+  EXPECT_THROW(img::Kernel::gaussian(0), std::invalid_argument);
+  EXPECT_THROW(img::gaussianBlur(rgba, -1.0), std::invalid_argument);
+  img::ImageRGBA other(10, 10);
+  EXPECT_THROW(img::convolve(rgba.view(), other.view(), img::Kernel::box(1)), std::invalid_argument);
+  EXPECT_THROW(img::boxBlur(other.view(), other.view(), 1), std::invalid_argument);
+  // Sub-images of one image whose rows interleave overlap too.
+  EXPECT_THROW(img::boxBlur(other.subImage(0, 0, 6, 6), other.subImage(2, 3, 6, 6), 1), std::invalid_argument);
+  EXPECT_THROW(img::gaussianBlur(other.subImage(0, 0, 5, 5), other.subImage(5, 2, 5, 5), 1.0), std::invalid_argument);
+  img::gaussianBlur(other.subImage(0, 0, 10, 5), other.subImage(0, 5, 10, 5), 1.0);
+  EXPECT_EQ(img::boxBlur(img::ImageRGBA(), 3).getWidth(), 0u);
+}
+
+/** ----- Statistics Check ----- **/
+
+// Compare with the statistics of each plane of interleaved pixels in double precision, `stats` possibly of planar pixels.
+template<typename Pixel, typename Statistics>
+void checkStatistics(const img::Image<Pixel>& image, const Statistics& stats, const std::size_t bins,
+                     const double tolerance) {
+  constexpr int channels = Pixel::PlaneCount;
+  ASSERT_EQ(stats.count, image.getWidth() * image.getHeight());
+  for (int channel = 0; channel < channels; ++channel) {
+    double low = 1e300, high = -1e300, sum = 0, squares = 0;
+    std::vector<std::uint64_t> histogram(bins);
+    for (std::size_t row = 0; row < image.getHeight(); ++row) {
+      for (std::size_t col = 0; col < image.getWidth(); ++col) {
+        const double value = image.view().getRow(row)[col * channels + channel];
+        low = std::min(low, value);
+        high = std::max(high, value);
+        sum += value;
+        squares += value * value;
+        const double position = value / static_cast<double>(Pixel::Max) * static_cast<double>(bins);
+        ++histogram[position <= 0 ? 0 : std::min(static_cast<std::size_t>(position), bins - 1)];
+      }
+    }
+    const double mean = sum / static_cast<double>(stats.count);
+    const auto& actual = stats.channels[static_cast<std::size_t>(channel)];
+    EXPECT_EQ(actual.min, low);
+    EXPECT_EQ(actual.max, high);
+    EXPECT_NEAR(actual.mean, mean, tolerance);
+    EXPECT_NEAR(actual.variance, squares / static_cast<double>(stats.count) - mean * mean, tolerance);
+    EXPECT_EQ(actual.histogram, histogram);
+  }
+}
+
+TEST(Statistics, MatchesReference) {
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(67, 31, img::RowAlignment::Align64);
+  const auto rgb = makePatternImage<img::PixelRGB<uint8_t>>(53, 29);
+  const auto gray = makePatternImage<img::PixelGray<uint8_t>>(101, 7);
+  const img::Image<img::PixelBGRA<float>> floats(rgba);
+  for (const std::size_t bins : {256, 10, 1}) {
+    checkStatistics(rgba, img::computeStatistics(rgba, img::Statistic::All, bins), bins, 1e-9);
+    checkStatistics(rgb, img::computeStatistics(rgb, img::Statistic::All, bins), bins, 1e-9);
+    checkStatistics(gray, img::computeStatistics(gray, img::Statistic::All, bins), bins, 1e-9);
+    checkStatistics(floats, img::computeStatistics(floats, img::Statistic::All, bins), bins, 1e-6);
+  }
+
+  // Without histogram, the vectorized sums give the same statistics as the bins.
+  const auto with = img::computeStatistics(rgb);
+  const auto without = img::computeStatistics(rgb, img::Statistic::MinMax | img::Statistic::Variance);
+  for (std::size_t channel = 0; channel < 3; ++channel) {
+    EXPECT_EQ(with.channels[channel].min, without.channels[channel].min);
+    EXPECT_EQ(with.channels[channel].max, without.channels[channel].max);
+    EXPECT_DOUBLE_EQ(with.channels[channel].mean, without.channels[channel].mean);
+    EXPECT_DOUBLE_EQ(with.channels[channel].variance, without.channels[channel].variance);
+    EXPECT_TRUE(without.channels[channel].histogram.empty());
+  }
+
+  // Planar pixels give the statistics of their planes, in the same order.
+  const auto planar = img::computeStatistics(img::Image<img::PlanarRGBA<uint8_t>>(rgba), img::Statistic::All, 16);
+  const auto planarFloat = img::computeStatistics(img::Image<img::PlanarRGB<float>>(rgb), img::Statistic::MinMax | img::Statistic::Variance);
+  checkStatistics(rgba, planar, 16, 1e-9);
+  const auto interleavedFloat = img::computeStatistics(img::Image<img::PixelRGB<float>>(rgb), img::Statistic::MinMax | img::Statistic::Variance);
+  for (std::size_t channel = 0; channel < 3; ++channel) {
+    EXPECT_EQ(planarFloat.channels[channel].max, interleavedFloat.channels[channel].max);
+    EXPECT_NEAR(planarFloat.channels[channel].variance, interleavedFloat.channels[channel].variance, 1e-6);
+  }
+}
+
+TEST(Statistics, SimdLevelsAndThreadsAgree) {
+  const auto rgb = makePatternImage<img::PixelRGB<uint8_t>>(331, 97);
+  const auto rgba = makePatternImage<img::PixelRGBA<uint8_t>>(257, 61, img::RowAlignment::Align64);
+  const img::Image<img::PixelRGBA<float>> floats(rgba);
+  const auto run = [&] {
+    return std::make_tuple(img::computeStatistics(rgb, img::Statistic::MinMax | img::Statistic::Variance),
+                           img::computeStatistics(rgba, img::Statistic::MinMax | img::Statistic::Variance),
+                           img::computeStatistics(rgba), img::computeStatistics(floats));
+  };
+  const auto same = [](const auto& expected, const auto& actual, const double tolerance) {
+    for (std::size_t channel = 0; channel < expected.channels.size(); ++channel) {
+      EXPECT_EQ(expected.channels[channel].min, actual.channels[channel].min);
+      EXPECT_EQ(expected.channels[channel].max, actual.channels[channel].max);
+      EXPECT_NEAR(expected.channels[channel].mean, actual.channels[channel].mean, tolerance);
+      EXPECT_NEAR(expected.channels[channel].variance, actual.channels[channel].variance, tolerance);
+      EXPECT_EQ(expected.channels[channel].histogram, actual.channels[channel].histogram);
+    }
+  };
+
+  img::simd::setLevel(img::simd::Level::Scalar);
+  const auto expected = run();
+  forEachSimdLevel([&] {
+    const auto actual = run();
+    same(std::get<0>(expected), std::get<0>(actual), 0);
+    same(std::get<1>(expected), std::get<1>(actual), 0);
+  });
+
+  // Per-chunk histograms and sums merged in row order: integer statistics are exact with any thread count.
+  const std::size_t threshold = img::getParallelThreshold();
+  img::ThreadPool::setGlobalThreadCount(4);
+  img::setParallelThreshold(0);
+  const auto parallel = run();
+  img::setParallelThreshold(threshold);
+  img::ThreadPool::setGlobalThreadCount(std::thread::hardware_concurrency());
+  same(std::get<0>(expected), std::get<0>(parallel), 0);
+  same(std::get<1>(expected), std::get<1>(parallel), 0);
+  same(std::get<2>(expected), std::get<2>(parallel), 0);
+  same(std::get<3>(expected), std::get<3>(parallel), 1e-9);
+}
+
+TEST(Statistics, SelectionAndEdgeCases) {
+  img::ImageGray uniform(9, 5);
+  uniform.fill({77, 77, 77, 255});
+  const auto minMax = img::computeStatistics(uniform, img::Statistic::MinMax);
+  EXPECT_EQ(minMax.channels[0].min, 77);
+  EXPECT_EQ(minMax.channels[0].max, 77);
+  EXPECT_EQ(minMax.channels[0].mean, 0.0);
+  EXPECT_TRUE(minMax.channels[0].histogram.empty());
+  const auto all = img::computeStatistics(uniform);
+  EXPECT_EQ(all.channels[0].mean, 77.0);
+  EXPECT_EQ(all.channels[0].variance, 0.0);
+  EXPECT_EQ(all.channels[0].histogram[77], 45u);
+
+  // Floating point samples outside of [0, 1] count in the end bins.
+  img::Image<img::PixelGray<float>> outside(3, 1);
+  outside.view().getRow(0)[0] = -0.5f;
+  outside.view().getRow(0)[1] = 1.5f;
+  outside.view().getRow(0)[2] = 0.5f;
+  const auto histogram = img::computeStatistics(outside, img::Statistic::Histogram | img::Statistic::MinMax, 4);
+  EXPECT_EQ(histogram.channels[0].histogram, (std::vector<std::uint64_t>{1, 0, 1, 1}));
+  EXPECT_EQ(histogram.channels[0].min, -0.5f);
+  EXPECT_EQ(histogram.channels[0].max, 1.5f);
+
+  const auto empty = img::computeStatistics(img::ImageRGBA());
+  EXPECT_EQ(empty.count, 0u);
+  EXPECT_EQ(empty.channels[2].histogram.size(), 256u);
+  EXPECT_THROW(img::computeStatistics(uniform, img::Statistic::Histogram, 0), std::invalid_argument);
+}
+
+TEST(Statistics, WideIntegerSamples) {
+  // Squares of 32 bit samples overflow 64 bit sums after a few pixels.
+  img::Image<img::PixelGray<int>> image(4, 4);
+  for (std::size_t row = 0; row < 4; ++row) {
+    for (std::size_t col = 0; col < 4; ++col) {
+      image.view().getRow(row)[col] = col % 2 == 0 ? 2000000000 : -2000000000;
+    }
+  }
+  for (const auto statistics : {img::Statistic::All, img::Statistic::MinMax | img::Statistic::Variance}) {
+    const auto stats = img::computeStatistics(image, statistics, 4);
+    EXPECT_EQ(stats.channels[0].min, -2000000000);
+    EXPECT_EQ(stats.channels[0].max, 2000000000);
+    EXPECT_EQ(stats.channels[0].mean, 0.0);
+    EXPECT_DOUBLE_EQ(stats.channels[0].variance, 4e18);
+  }
+
+  img::Image<img::PixelGray<unsigned long long>> wide(3, 1);
+  wide.view().getRow(0)[0] = 1ull << 62;
+  wide.view().getRow(0)[1] = 1ull << 62;
+  wide.view().getRow(0)[2] = 1ull << 62;
+  const auto stats = img::computeStatistics(wide, img::Statistic::Mean | img::Statistic::Variance);
+  EXPECT_DOUBLE_EQ(stats.channels[0].mean, 0x1p62);
+  EXPECT_NEAR(stats.channels[0].variance, 0.0, 0x1p72);
+}
+
+/** ----- Sub-image Check ----- **/
+
+template<typename T>
+std::tuple<T, T, T, T> colorTuple(const img::Color<T>& color) {
+  return {color.red, color.green, color.blue, color.alpha};
+}
+
+TEST(SubImage, SharesTheParentBuffer) {
+  auto image = makePatternImage<img::PixelRGBA<uint8_t>>(9, 7, img::RowAlignment::Align64);
+  const auto crop = image.subImage(2, 3, 5, 4);
+  EXPECT_EQ(crop.getWidth(), 5u);
+  EXPECT_EQ(crop.getHeight(), 4u);
+  EXPECT_EQ(crop.getStride(), image.getStride());
+  EXPECT_EQ(crop.getData(), image.getRow(3) + 2 * 4);
+  for (std::size_t row = 0; row < crop.getHeight(); ++row) {
+    for (std::size_t col = 0; col < crop.getWidth(); ++col) {
+      EXPECT_EQ(colorTuple(crop.getColor(col, row)), colorTuple(image.getColor(col + 2, row + 3)));
+    }
+  }
+
+  // Writes go to the parent, nested crops add their offsets.
+  crop.subImage(1, 2, 2, 2).setColor(1, 1, {1, 2, 3, 4});
+  EXPECT_EQ(colorTuple(image.getColor(4, 6)), std::make_tuple(1, 2, 3, 4));
+  crop.subImage(0, 0, 5, 1).fill({9, 9, 9, 9});
+  EXPECT_EQ(image.getColor(6, 3).red, 9);
+  EXPECT_NE(image.getColor(7, 3).red, 9);
+  EXPECT_NE(image.getColor(2, 4).red, 9);
+
+  // Planar views keep the distance between the planes of the parent.
+  const auto planar = makePatternImage<img::PlanarRGB<uint8_t>>(6, 5);
+  const auto planarCrop = planar.subImage(1, 2, 4, 3);
+  EXPECT_EQ(planarCrop.getPlaneStride(), planar.view().getPlaneStride());
+  EXPECT_EQ(colorTuple(planarCrop.getColor(3, 2)), colorTuple(planar.getColor(4, 4)));
+}
+
+TEST(SubImage, ConversionsAndOperationsAcceptViews) {
+  const auto image = makePatternImage<img::PixelRGBA<uint8_t>>(23, 17);
+  const auto crop = image.subImage(5, 4, 13, 9);
+  const img::ImageRGBA copy(crop);
+
+  const img::ImageBGR converted(crop);
+  const img::ImageBGR expected(copy);
+  checkSameImage<img::PixelBGR<uint8_t>>(expected.view(), converted.view());
+
+  const auto planar = img::Image<img::PlanarRGBA<uint8_t>>(crop);
+  checkSameImage<img::PixelRGBA<uint8_t>>(copy.view(), img::ImageRGBA(planar).view());
+
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::resize(copy, 6, 5).view(), img::resize(crop, 6, 5).view());
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::boxBlur(copy, 2).view(), img::boxBlur(crop, 2).view());
+  checkSameImage<img::PixelRGBA<uint8_t>>(img::orient(copy, img::Orientation::Rotate90).view(),
+                                          img::orient(crop, img::Orientation::Rotate90).view());
+  EXPECT_EQ(img::computeStatistics(crop).channels[1].histogram, img::computeStatistics(copy).channels[1].histogram);
+
+  // Operations writing into a crop leave the rest of the parent untouched.
+  img::ImageRGBA target(23, 17);
+  target.fill({7, 7, 7, 7});
+  img::convert(copy.view(), target.subImage(5, 4, 13, 9));
+  checkSameImage<img::PixelRGBA<uint8_t>>(copy.view(), target.subImage(5, 4, 13, 9));
+  EXPECT_EQ(colorTuple(target.getColor(4, 4)), std::make_tuple(7, 7, 7, 7));
+  EXPECT_EQ(colorTuple(target.getColor(18, 12)), std::make_tuple(7, 7, 7, 7));
+}
+
+TEST(SubImage, MaterializeAndBounds) {
+  const auto image = makePatternImage<img::PixelRGB<uint8_t>>(10, 8);
+  img::ImageRGB storage;
+
+  // Whole rows of a packed image are contiguous: no copy.
+  const auto rows = image.subImage(0, 2, 10, 3);
+  EXPECT_TRUE(rows.isContiguous());
+  EXPECT_EQ(rows.materialize(storage).getData(), rows.getData());
+  EXPECT_EQ(storage.getData(), nullptr);
+
+  const auto crop = image.subImage(3, 1, 4, 5);
+  EXPECT_FALSE(crop.isContiguous());
+  const auto packed = crop.materialize(storage);
+  EXPECT_EQ(packed.getData(), storage.getData());
+  EXPECT_TRUE(packed.isContiguous());
+  checkSameImage<img::PixelRGB<uint8_t>>(crop, packed);
+  // The buffer of the storage is reused for a crop of the same size.
+  const auto* const buffer = storage.getData();
+  checkSameImage<img::PixelRGB<uint8_t>>(image.subImage(6, 3, 4, 5), image.subImage(6, 3, 4, 5).materialize(storage));
+  EXPECT_EQ(storage.getData(), buffer);
+  EXPECT_TRUE(image.subImage(2, 2, 5, 1).isContiguous());
+
+  EXPECT_EQ(image.subImage(10, 8, 0, 0).getWidth(), 0u);
+  EXPECT_THROW(image.subImage(8, 0, 3, 1), std::invalid_argument);
+  EXPECT_THROW(image.subImage(0, 7, 1, 2), std::invalid_argument);
+  EXPECT_THROW(image.subImage(11, 0, 0, 1), std::invalid_argument);
+  EXPECT_THROW(image.subImage(1, 0, SIZE_MAX, 1), std::invalid_argument);
+  EXPECT_THROW(rows.subImage(0, 0, 10, 4), std::invalid_argument);
+}
+
+TEST(SubImage, CropsIntoTheParentItself) {
+  img::ImageRGB image = makePatternImage<img::PixelRGB<uint8_t>>(64, 64);
+  const img::ImageRGB original(image);
+  image = image.subImage(10, 10, 20, 20);
+  ASSERT_EQ(image.getWidth(), 20u);
+  checkSameImage<img::PixelRGB<uint8_t>>(original.subImage(10, 10, 20, 20), image.view());
+
+  // Same number of samples: the buffer would be kept without the overlap check.
+  img::ImageRGB square = makePatternImage<img::PixelRGB<uint8_t>>(8, 8);
+  square.setCopyOnWrite(true);
+  const img::ImageRGB squareCopy(makePatternImage<img::PixelRGB<uint8_t>>(8, 8));
+  square = square.subImage(1, 0, 4, 8).materialize(square);
+  EXPECT_TRUE(square.isCopyOnWrite());
+  checkSameImage<img::PixelRGB<uint8_t>>(squareCopy.subImage(1, 0, 4, 8), square.view());
+
+  // A view into the storage of `materialize` is copied through a new buffer.
+  img::ImageBGR storage = makePatternImage<img::PixelBGR<uint8_t>>(16, 12);
+  const img::ImageBGR expected(storage.view().subImage(3, 2, 9, 7));
+  const auto packed = storage.subImage(3, 2, 9, 7).materialize(storage);
+  checkSameImage<img::PixelBGR<uint8_t>>(expected.view(), packed);
+
+  const img::ImageGray other(4, 4);
+  EXPECT_FALSE(other.view().overlaps(image.view()));
+  EXPECT_TRUE(original.subImage(5, 5, 2, 2).overlaps(original.subImage(6, 6, 3, 3)));
+  EXPECT_FALSE(original.subImage(0, 0, 64, 2).overlaps(original.subImage(0, 2, 64, 2)));
+  EXPECT_FALSE(original.subImage(0, 0, 0, 0).overlaps(original.view()));
+}
+
+/** ----- Instrumentation Check ----- **/
+
+// The counters are checked by testImageInstrumented, this file built with IMG_INSTRUMENTATION.
+#if IMG_INSTRUMENTATION
+
+TEST(Instrumentation, CountsOperationsPerPixelPair) {
+  using img::instrumentation::Operation;
+  using RGBA = img::PixelRGBA<uint8_t>;
+  using RGB = img::PixelRGB<uint8_t>;
+  img::instrumentation::reset();
+
+  const img::ImageRGBA rgba(8, 4);
+  const img::ImageRGB rgb(rgba);
+  img::ImageRGBA copy(rgba);
+  const img::ImageRGBA moved(std::move(copy));
+  const auto stats = img::instrumentation::snapshot();
+
+  EXPECT_EQ(stats.get<RGBA>(Operation::Construct).calls, 1u);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Construct).pixels, 32u);
+  EXPECT_EQ((stats.get<RGBA, RGB>(Operation::Construct).calls), 1u);
+  EXPECT_EQ((stats.get<RGBA, RGB>(Operation::Convert).pixels), 32u);
+  EXPECT_EQ((stats.get<RGBA, RGB>(Operation::Convert).bytesCopied), 32u * 3);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Copy).calls, 1u);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Convert).bytesCopied, 32u * 4);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Move).calls, 1u);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Allocate).calls, 2u);
+  EXPECT_EQ(stats.get<RGBA>(Operation::Allocate).bytesAllocated, 2u * 32 * 4);
+  EXPECT_EQ(stats.get<RGB>(Operation::Allocate).bytesAllocated, 32u * 3);
+  EXPECT_GT(stats.total(Operation::Construct).nanoseconds, 0u);
+  EXPECT_EQ(stats.get<RGB>(Operation::Move).calls, 0u);
+
+  // Sharing a copy-on-write buffer copies nothing until the first write.
+  img::ImageRGBA shared(rgba);
+  shared.setCopyOnWrite(true);
+  img::instrumentation::reset();
+  img::ImageRGBA other(shared);
+  EXPECT_EQ(img::instrumentation::snapshot().get<RGBA>(Operation::Copy).bytesCopied, 0u);
+  other.setColor(0, 0, {1, 2, 3, 4});
+  EXPECT_EQ(img::instrumentation::snapshot().get<RGBA>(Operation::Copy).bytesCopied, 32u * 4);
+  const auto bgra = std::move(other).convertInPlace<img::PixelBGRA<uint8_t>>();
+  EXPECT_EQ((img::instrumentation::snapshot().get<RGBA, img::PixelBGRA<uint8_t>>(Operation::Convert).pixels), 32u);
+}
+
+TEST(Instrumentation, KeepsTheCountersOfEveryThread) {
+  using BGR = img::PixelBGR<uint8_t>;
+  using Gray = img::PixelGray<uint8_t>;
+  img::instrumentation::reset();
+  const img::ImageBGR bgr(16, 16);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&bgr] {
+      for (int i = 0; i < 10; ++i) {
+        const img::ImageGray gray(bgr);
+      }
+    });
+  }
+  // A snapshot taken while the threads run sees part of their counters.
+  EXPECT_LE((img::instrumentation::snapshot().get<BGR, Gray>(img::instrumentation::Operation::Convert).calls), 40u);
+  for (auto& thread : threads) thread.join();
+
+  const auto stats = img::instrumentation::snapshot();
+  EXPECT_EQ((stats.get<BGR, Gray>(img::instrumentation::Operation::Convert).calls), 40u);
+  EXPECT_EQ((stats.get<BGR, Gray>(img::instrumentation::Operation::Convert).pixels), 40u * 256);
+  EXPECT_EQ(stats.get<Gray>(img::instrumentation::Operation::Allocate).bytesAllocated, 40u * 256);
+
+  img::instrumentation::reset();
+  EXPECT_EQ((img::instrumentation::snapshot().get<BGR, Gray>(img::instrumentation::Operation::Convert).calls), 0u);
+}
+
+TEST(Instrumentation, ExportsJsonAndText) {
+  img::instrumentation::reset();
+  const img::Image<img::PixelRGBA<float>> rgba(img::ImageRGB(2, 3));
+  const auto stats = img::instrumentation::snapshot();
+
+  const std::string json = stats.toJson();
+  EXPECT_EQ(json.front(), '[');
+  EXPECT_NE(json.find("{\"operation\": \"convert\", \"source\": \"PixelRGB<unsigned char>\", \"target\": \"PixelRGBA<float>\", "
+                      "\"calls\": 1, \"bytesAllocated\": 0, \"bytesCopied\": 96, \"pixels\": 6, \"nanoseconds\": "),
+            std::string::npos);
+  EXPECT_NE(json.find("\"operation\": \"allocate\", \"source\": \"PixelRGBA<float>\", \"target\": \"PixelRGBA<float>\", "
+                      "\"calls\": 1, \"bytesAllocated\": 96,"),
+            std::string::npos);
+
+  const std::string text = stats.toText();
+  EXPECT_NE(text.find("construct  PixelRGB<unsigned char> -> PixelRGBA<float>  1  0  0  6  "), std::string::npos);
+  EXPECT_EQ(img::instrumentation::Snapshot().toJson(), "[]\n");
+}
+
+#else
+
+TEST(Instrumentation, DisabledByDefault) {
+  static_assert(!img::instrumentation::enabled);
+  static_assert(std::is_empty_v<img::instrumentation::Probe<img::instrumentation::Operation::Convert,
+                                                            img::PixelRGB<uint8_t>, img::PixelGray<uint8_t>>>);
+  const img::ImageGray gray(img::ImageRGB(4, 4));
+  img::instrumentation::reset();
+  EXPECT_TRUE(img::instrumentation::snapshot().entries.empty());
+  EXPECT_EQ(img::instrumentation::snapshot().toJson(), "[]\n");
+  EXPECT_EQ(img::instrumentation::snapshot().get<img::PixelRGB<uint8_t>>(img::instrumentation::Operation::Construct).calls, 0u);
+}
+
+#endif